@@ -0,0 +1,604 @@
+/**
+ * @file client_batch.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 13.12.18
+ *
+ * @brief Batch posting mode of the client.
+ * The messages are read from a file or stdin, one per line, and posted over a small pool of connections. The
+ * server address is resolved once, every connection is persistent (length framed requests and responses) and
+ * keeps up to BATCH_PIPELINE requests in flight. One thread drives all connections with poll(). The first
+ * connection is a probe: it sends one framed request and shuts down its write direction, so a server which does
+ * not know the framing answers as well. If it does not, all messages are sent the old way, one connection per
+ * message. The status of every message is printed when it completes, the timing at the end.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#define _GNU_SOURCE         // provides getline()
+#include <stdlib.h>         // provides malloc(), free(), strtol()
+#include <stdio.h>          // provides the printf()
+#include <string.h>         // provide strerror(), strlen()
+#include <errno.h>          // provides errno
+#include <fcntl.h>          // provides fcntl(), O_NONBLOCK
+#include <poll.h>           // provides poll()
+#include <time.h>           // provides clock_gettime()
+#include <unistd.h>         // provides close()
+#include <netdb.h>          // provides getaddrinfo()
+#include <sys/types.h>
+#include <sys/socket.h>     // provides socket(), send(), recv()
+#include "client_batch.h"
+#include "client_parser.h"  // provides parser_next()
+#include "trace.h"          // provides TRACE()
+
+// --------------------------------------------------------------- defines --
+/** @brief Line output. prints filename, functionname and linenumber from caller */
+#define LINEOUTPUT fprintf(stdout, "[%s, %s, %d]: ",  __FILE__, __func__, __LINE__)
+/** @brief requests in flight per persistent connection */
+#define BATCH_PIPELINE 8
+/** @brief attempts per message before it is reported as failed */
+#define BATCH_ATTEMPTS 3
+/** @brief size of the receive buffer, the response contents are skipped */
+#define BATCH_RECEIVEBUFFER (64 * 1024)
+/** @brief maximal length of the length line of a request */
+#define BATCH_LINELENGTH 64
+/** @brief field delimiter of the input lines */
+#define BATCH_SEPARATOR '\t'
+/** @brief status reported for a message without an answer of the server */
+#define BATCH_STATUS_FAILED (-1)
+
+// -------------------------------------------------------------- typedefs --
+/** @brief One message of the input */
+typedef struct batchMessage {
+    char* line;                 /**< The input line, user, text and image point into it */
+    const char* user;           /**< Name of the posting user */
+    const char* text;           /**< The message */
+    const char* image;          /**< URL of the image, NULL if none */
+    int status;                 /**< Status of the answer, BATCH_STATUS_FAILED until answered */
+    int attempts;               /**< Number of times the message was sent */
+    struct timespec sent;       /**< Time the message was queued for sending */
+} batchMessage;
+
+/** @brief One connection of the pool */
+typedef struct batchConnection {
+    int fd;                             /**< Connected non blocking socket, -1 if closed */
+    int legacy;                         /**< 1 if the connection speaks the old protocol */
+    int probe;                          /**< 1 if the connection finds out if the server knows the framing */
+    size_t inFlight[BATCH_PIPELINE];    /**< Messages sent and not answered, oldest first */
+    size_t inFlightCount;               /**< Number of entries of inFlight */
+    char* out;                          /**< Requests not sent yet */
+    size_t outLength;                   /**< Bytes in out */
+    size_t outCapacity;                 /**< Allocated size of out */
+    size_t outSent;                     /**< Bytes of out already sent */
+    responseParser parser;              /**< Position in the current response */
+} batchConnection;
+
+/** @brief State of a batch run */
+typedef struct batchState {
+    const batchConfig* config;          /**< Configuration of the run */
+    struct addrinfo* addresses;         /**< Addresses of the server, resolved once */
+    batchMessage* messages;             /**< All messages */
+    size_t messageCount;                /**< Number of messages */
+    size_t next;                        /**< Next message never sent */
+    size_t* retry;                      /**< Messages to send again */
+    size_t retryCount;                  /**< Number of entries of retry */
+    size_t completed;                   /**< Messages answered or failed */
+    size_t failed;                      /**< Messages with a status other than 0 */
+    int legacy;                         /**< 1 once the server turned out to speak the old protocol only */
+    int framed;                         /**< 1 once the server answered a framed request framed */
+    int probing;                        /**< 1 while the probe connection is open */
+    double latencyMin;                  /**< Shortest time between sending and answer in ms */
+    double latencyMax;                  /**< Longest time between sending and answer in ms */
+    double latencySum;                  /**< Sum of all times between sending and answer in ms */
+} batchState;
+
+// ------------------------------------------------------------- functions --
+static int readMessages(batchState* state);
+static int parseMessage(char* line, batchMessage* message);
+static int openConnection(batchState* state, batchConnection* connection);
+static void closeConnection(batchState* state, batchConnection* connection, int requeue);
+static int queueRequests(batchState* state, batchConnection* connection);
+static int sendRequests(batchConnection* connection);
+static int receiveResponses(batchState* state, batchConnection* connection);
+static int parseResponses(batchState* state, batchConnection* connection, const char* data, size_t length);
+static void completeMessage(batchState* state, batchConnection* connection, int status);
+static double elapsedMs(const struct timespec* since);
+
+/**
+ * @brief posts all messages of config->input and prints the status of every message and the timing
+ * @param config const batchConfig*: configuration of the run
+ * @return int: 0 if every message was posted with status 0, 1 if not, -1 if the run could not start (errno
+ * is set)
+ */
+int batch_run(const batchConfig* config) {
+    batchState state;
+    memset(&state, 0, sizeof(state));
+    state.config = config;
+    if (readMessages(&state) == -1) {
+        return -1;
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int addrinfoError = getaddrinfo(config->server, config->port, &hints, &state.addresses);
+    if (addrinfoError != 0) {
+        fprintf(stderr, "Could not resolve hostname: %s\n", gai_strerror(addrinfoError));
+        for (size_t i = 0; i < state.messageCount; i++) {
+            free(state.messages[i].line);
+        }
+        free(state.messages);
+        errno = EHOSTUNREACH;
+        return -1;
+    }
+
+    int count = config->connections;
+    batchConnection* connections = calloc((size_t) count, sizeof(batchConnection));
+    struct pollfd* fds = calloc((size_t) count, sizeof(struct pollfd));
+    state.retry = malloc((state.messageCount + 1) * sizeof(size_t));
+    if ((connections == NULL) || (fds == NULL) || (state.retry == NULL)) {
+        freeaddrinfo(state.addresses);
+        free(connections);
+        free(fds);
+        free(state.retry);
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        connections[i].fd = -1;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int result = 0;
+    while (state.completed < state.messageCount) {
+        for (int i = 0; i < count; i++) {
+            batchConnection* connection = &connections[i];
+            int work = (state.next < state.messageCount) || (state.retryCount > 0);
+            // further connections wait until the probe has shown how to talk to the server
+            int known = state.legacy || state.framed;
+            if ((connection->fd == -1) && work && (known || !state.probing) &&
+                (openConnection(&state, connection) == -1)) {
+                result = -1;
+                break;
+            }
+            if ((connection->fd != -1) && (queueRequests(&state, connection) == -1)) {
+                closeConnection(&state, connection, 1);
+            }
+            // an idle persistent connection holds a worker of a blocking server, it is released as soon as
+            // there is nothing left to send
+            if ((connection->fd != -1) && !work && (connection->inFlightCount == 0)) {
+                closeConnection(&state, connection, 0);
+            }
+            fds[i].fd = connection->fd;     // closed connections (-1) are ignored by poll()
+            fds[i].events = POLLIN;
+            if (connection->outSent < connection->outLength) {
+                fds[i].events |= POLLOUT;
+            }
+            fds[i].revents = 0;
+        }
+        if (result == -1) {
+            break;
+        }
+        if (poll(fds, (nfds_t) count, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            result = -1;
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            batchConnection* connection = &connections[i];
+            if ((fds[i].revents == 0) || (connection->fd == -1)) {
+                continue;
+            }
+            if ((fds[i].revents & POLLOUT) && (sendRequests(connection) == -1)) {
+                closeConnection(&state, connection, 1);
+                continue;
+            }
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                receiveResponses(&state, connection);
+            }
+        }
+    }
+    double elapsed = elapsedMs(&start);
+
+    for (int i = 0; i < count; i++) {
+        closeConnection(&state, &connections[i], 0);
+        free(connections[i].out);
+    }
+    if (result == 0) {
+        fprintf(stdout, "messages: %zu, failed: %zu, connections: %d%s\n", state.messageCount, state.failed, count,
+                state.legacy ? " (one per message, server does not support persistent connections)" : "");
+        fprintf(stdout, "elapsed: %.3f ms, rate: %.1f messages/s\n", elapsed,
+                (elapsed > 0) ? (double) state.messageCount * 1000.0 / elapsed : 0.0);
+        if (state.messageCount > state.failed) {
+            fprintf(stdout, "latency min/avg/max: %.3f/%.3f/%.3f ms\n", state.latencyMin,
+                    state.latencySum / (double) (state.messageCount - state.failed), state.latencyMax);
+        }
+        result = (state.failed > 0) ? 1 : 0;
+    }
+    for (size_t i = 0; i < state.messageCount; i++) {
+        free(state.messages[i].line);
+    }
+    free(state.messages);
+    free(state.retry);
+    free(fds);
+    free(connections);
+    freeaddrinfo(state.addresses);
+    return result;
+}
+
+/**
+ * @brief reads the messages of the input, one per line: user, message and optionally the image URL separated
+ * by tabs. Empty lines and lines starting with '#' are skipped.
+ * @param state batchState*: messages and messageCount are set
+ * @return int: 0 in case of success, -1 on failure (errno is set)
+ */
+static int readMessages(batchState* state) {
+    FILE* input = stdin;
+    if (strcmp(state->config->input, "-") != 0) {
+        input = fopen(state->config->input, "r");
+        if (input == NULL) {
+            fprintf(stderr, "Could not open %s: %s\n", state->config->input, strerror(errno));
+            return -1;
+        }
+    }
+    size_t capacity = 0;
+    size_t lineNumber = 0;
+    char* line = NULL;
+    size_t lineSize = 0;
+    int result = 0;
+    while (getline(&line, &lineSize, input) != -1) {
+        lineNumber++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if ((line[0] == '\0') || (line[0] == '#')) {
+            continue;
+        }
+        if (state->messageCount == capacity) {
+            capacity = (capacity == 0) ? 64 : 2 * capacity;
+            batchMessage* grown = realloc(state->messages, capacity * sizeof(batchMessage));
+            if (grown == NULL) {
+                result = -1;
+                break;
+            }
+            state->messages = grown;
+        }
+        batchMessage* message = &state->messages[state->messageCount];
+        message->line = strdup(line);
+        if (message->line == NULL) {
+            result = -1;
+            break;
+        }
+        if (parseMessage(message->line, message) == -1) {
+            fprintf(stderr, "%s:%zu: expected user<TAB>message[<TAB>image]\n", state->config->input, lineNumber);
+            free(message->line);
+            errno = EINVAL;
+            result = -1;
+            break;
+        }
+        state->messageCount++;
+    }
+    if ((result == 0) && ferror(input)) {
+        result = -1;
+    }
+    free(line);
+    if (input != stdin) {
+        fclose(input);
+    }
+    if (result == -1) {
+        int error = errno;
+        for (size_t i = 0; i < state->messageCount; i++) {
+            free(state->messages[i].line);
+        }
+        free(state->messages);
+        state->messages = NULL;
+        errno = error;
+    }
+    return result;
+}
+
+/**
+ * @brief splits an input line into its fields, "\n", "\t" and "\\" in the message are unescaped
+ * @param line char*: the line, modified
+ * @param message batchMessage*: user, text and image are set
+ * @return int: 0 in case of success, -1 if the user or the message is missing
+ */
+static int parseMessage(char* line, batchMessage* message) {
+    message->user = line;
+    message->image = NULL;
+    message->status = BATCH_STATUS_FAILED;
+    message->attempts = 0;
+    char* separator = strchr(line, BATCH_SEPARATOR);
+    if ((separator == NULL) || (separator == line)) {
+        return -1;
+    }
+    *separator = '\0';
+    char* text = separator + 1;
+    separator = strchr(text, BATCH_SEPARATOR);
+    if (separator != NULL) {
+        *separator = '\0';
+        message->image = (separator[1] != '\0') ? separator + 1 : NULL;
+    }
+    char* write = text;
+    for (const char* read = text; *read != '\0'; read++) {
+        if ((read[0] == '\\') && (read[1] != '\0')) {
+            read++;
+            *write++ = (*read == 'n') ? '\n' : ((*read == 't') ? '\t' : *read);
+        } else {
+            *write++ = *read;
+        }
+    }
+    *write = '\0';
+    message->text = text;
+    return 0;
+}
+
+/**
+ * @brief connects to the first working address of the server, the socket is non blocking afterwards
+ * @param connection batchConnection*: closed connection, fd is set
+ * @return int: 0 in case of success, -1 if no address could be connected
+ */
+static int openConnection(batchState* state, batchConnection* connection) {
+    for (struct addrinfo* address = state->addresses; address != NULL; address = address->ai_next) {
+        int fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+        if (fd == -1) {
+            continue;
+        }
+        if (connect(fd, address->ai_addr, address->ai_addrlen) == -1) {
+            close(fd);
+            continue;
+        }
+        int flags = fcntl(fd, F_GETFL);
+        if ((flags == -1) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)) {
+            close(fd);
+            continue;
+        }
+        connection->fd = fd;
+        connection->legacy = state->legacy;
+        connection->probe = !state->legacy && !state->framed;
+        state->probing |= connection->probe;
+        connection->inFlightCount = 0;
+        connection->outLength = 0;
+        connection->outSent = 0;
+        parser_init(&connection->parser);
+        TRACE(TRACE_CONNECT, (uint64_t) fd, (uint32_t) state->legacy);
+        return 0;
+    }
+    fprintf(stderr, "Could not connect to %s:%s: %s\n", state->config->server, state->config->port,
+            strerror(errno));
+    return -1;
+}
+
+/**
+ * @brief closes the connection, the messages in flight are sent again on another connection
+ * @param connection batchConnection*: the connection, ignored if it is closed already
+ * @param requeue int: 1 if the messages in flight count as an attempt, 0 if they are retried for free
+ */
+static void closeConnection(batchState* state, batchConnection* connection, int requeue) {
+    if (connection->fd == -1) {
+        return;
+    }
+    close(connection->fd);
+    connection->fd = -1;
+    if (connection->probe) {
+        state->probing = 0;
+    }
+    for (size_t i = 0; i < connection->inFlightCount; i++) {
+        size_t index = connection->inFlight[i];
+        if (requeue && (state->messages[index].attempts >= BATCH_ATTEMPTS)) {
+            fprintf(stdout, "%zu\t%d\tno answer after %d attempts\n", index + 1, BATCH_STATUS_FAILED,
+                    BATCH_ATTEMPTS);
+            state->completed++;
+            state->failed++;
+            continue;
+        }
+        if (!requeue) {
+            state->messages[index].attempts--;
+        }
+        state->retry[state->retryCount++] = index;
+    }
+    connection->inFlightCount = 0;
+}
+
+/**
+ * @brief appends requests to the output of the connection while the pipeline has room, a connection in the
+ * old protocol and the probe get exactly one request and shut down their write direction afterwards
+ * @param connection batchConnection*: open connection
+ * @return int: 0 in case of success, -1 if out of memory
+ */
+static int queueRequests(batchState* state, batchConnection* connection) {
+    int single = connection->legacy || connection->probe;
+    size_t depth = single ? 1 : BATCH_PIPELINE;
+    // a connection with a single request is closed by the server after the answer
+    if (single && (connection->outLength > 0)) {
+        return 0;
+    }
+    while ((connection->inFlightCount < depth) && ((state->retryCount > 0) || (state->next < state->messageCount))) {
+        size_t index = (state->retryCount > 0) ? state->retry[--state->retryCount] : state->next++;
+        batchMessage* message = &state->messages[index];
+        const char* format = (message->image == NULL) ? "user=%s\n%s%s" : "user=%s\nimg=%s\n%s";
+        const char* second = (message->image == NULL) ? message->text : message->image;
+        const char* third = (message->image == NULL) ? "" : message->text;
+        int requestLength = snprintf(NULL, 0, format, message->user, second, third);
+        char frame[BATCH_LINELENGTH];
+        int frameLength = connection->legacy ? 0 : snprintf(frame, sizeof(frame), "request=%d\n", requestLength);
+        size_t needed = connection->outLength + (size_t) frameLength + (size_t) requestLength + 1;
+        if (needed > connection->outCapacity) {
+            char* grown = realloc(connection->out, needed);
+            if (grown == NULL) {
+                state->retry[state->retryCount++] = index;
+                return -1;
+            }
+            connection->out = grown;
+            connection->outCapacity = needed;
+        }
+        memcpy(connection->out + connection->outLength, frame, (size_t) frameLength);
+        connection->outLength += (size_t) frameLength;
+        snprintf(connection->out + connection->outLength, (size_t) requestLength + 1, format, message->user,
+                 second, third);
+        connection->outLength += (size_t) requestLength;
+        message->attempts++;
+        clock_gettime(CLOCK_MONOTONIC, &message->sent);
+        connection->inFlight[connection->inFlightCount++] = index;
+    }
+    return 0;
+}
+
+/**
+ * @brief sends as much of the queued requests as the socket takes
+ * @param connection batchConnection*: open connection with queued requests
+ * @return int: 0 in case of success, -1 on failure
+ */
+static int sendRequests(batchConnection* connection) {
+    while (connection->outSent < connection->outLength) {
+        ssize_t sent = send(connection->fd, connection->out + connection->outSent,
+                            connection->outLength - connection->outSent, MSG_NOSIGNAL);
+        if (sent == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? 0 : -1;
+        }
+        connection->outSent += (size_t) sent;
+    }
+    if (connection->legacy || connection->probe) {
+        // the old protocol ends the request with the shutdown of the write direction
+        return shutdown(connection->fd, SHUT_WR);
+    }
+    // everything is sent, the buffer is reused for the next requests
+    connection->outLength = 0;
+    connection->outSent = 0;
+    return 0;
+}
+
+/**
+ * @brief receives everything available and parses the responses, closes the connection at its end
+ * @param connection batchConnection*: open connection
+ * @return int: 0 if the connection is still open, -1 if it was closed
+ */
+static int receiveResponses(batchState* state, batchConnection* connection) {
+    char buffer[BATCH_RECEIVEBUFFER];
+    while (1) {
+        ssize_t received = recv(connection->fd, buffer, sizeof(buffer), 0);
+        if (received == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                return 0;
+            }
+            closeConnection(state, connection, 1);
+            return -1;
+        }
+        if (received == 0) {
+            // the end of a legacy response, for a framed connection the answers in flight are lost
+            if (connection->legacy && (connection->inFlightCount == 1) && parser_complete(&connection->parser)) {
+                completeMessage(state, connection, connection->parser.status);
+            }
+            closeConnection(state, connection, 1);
+            return -1;
+        }
+        int parsed = parseResponses(state, connection, buffer, (size_t) received);
+        if (parsed != 0) {
+            // 1: the server does not know the framing, its answer is not meant for these requests
+            if (parsed == 1) {
+                if ((state->legacy == 0) && (state->config->verbose == 1)) {
+                    LINEOUTPUT;
+                    fprintf(stdout, "Server does not support persistent connections, one connection per message\n");
+                }
+                state->legacy = 1;
+            } else {
+                fprintf(stderr, "Invalid response on connection %d: %s\n", connection->fd,
+                        (connection->parser.error != NULL) ? connection->parser.error : "not requested");
+            }
+            closeConnection(state, connection, parsed == -1);
+            return -1;
+        }
+    }
+}
+
+/**
+ * @brief parses the received bytes with the response parser, the files are skipped
+ * @param connection batchConnection*: the connection
+ * @param data const char*: received bytes
+ * @param length size_t: number of received bytes
+ * @return int: 0 in case of success, 1 if the server answered without framing, -1 on a protocol error
+ */
+static int parseResponses(batchState* state, batchConnection* connection, const char* data, size_t length) {
+    while (1) {
+        if (connection->inFlightCount == 0) {
+            return (length > 0) ? -1 : 0;      // nothing was asked
+        }
+        parserView view;
+        switch (parser_next(&connection->parser, &data, &length, &view)) {
+            case PARSER_MORE:
+                return 0;
+            case PARSER_FRAME:
+                state->framed = 1;
+                break;
+            case PARSER_STATUS:
+                if (!connection->legacy && !connection->parser.framed) {
+                    return 1;
+                }
+                break;
+            case PARSER_FILE:
+            case PARSER_CONTENT:
+                break;
+            case PARSER_END:
+                completeMessage(state, connection, connection->parser.status);
+                parser_init(&connection->parser);
+                break;
+            case PARSER_ERROR:
+                TRACE(TRACE_ERROR, EPROTO, (uint32_t) connection->fd);
+                return -1;
+        }
+    }
+}
+
+/**
+ * @brief reports the oldest message in flight of the connection as answered
+ * @param connection batchConnection*: the connection
+ * @param status int: status of the answer
+ */
+static void completeMessage(batchState* state, batchConnection* connection, int status) {
+    size_t index = connection->inFlight[0];
+    memmove(connection->inFlight, connection->inFlight + 1, (connection->inFlightCount - 1) * sizeof(size_t));
+    connection->inFlightCount--;
+    batchMessage* message = &state->messages[index];
+    message->status = status;
+    double latency = elapsedMs(&message->sent);
+    state->completed++;
+    if (status != 0) {
+        state->failed++;
+    } else {
+        if ((state->latencyMin == 0) || (latency < state->latencyMin)) {
+            state->latencyMin = latency;
+        }
+        if (latency > state->latencyMax) {
+            state->latencyMax = latency;
+        }
+        state->latencySum += latency;
+    }
+    // number of the message in the input, status and time from sending to the answer
+    fprintf(stdout, "%zu\t%d\t%.3f ms\n", index + 1, status, latency);
+}
+
+/**
+ * @brief milliseconds since the given time
+ * @param since const struct timespec*: start, CLOCK_MONOTONIC
+ * @return double: elapsed milliseconds
+ */
+static double elapsedMs(const struct timespec* since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) (now.tv_sec - since->tv_sec) * 1000.0 + (double) (now.tv_nsec - since->tv_nsec) / 1000000.0;
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
@@ -0,0 +1,32 @@
+/**
+ * @file client_batch.h
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 13.12.18
+ *
+ * @brief Batch posting mode of the client, many messages over a pool of persistent connections
+ * TCP/IP Lecture Distributed Systems
+ */
+#ifndef CLIENT_BATCH_H
+#define CLIENT_BATCH_H
+
+// --------------------------------------------------------------- defines --
+/** @brief default number of concurrent connections */
+#define BATCH_DEFAULTCONNECTIONS 4
+/** @brief maximal number of concurrent connections */
+#define BATCH_MAXCONNECTIONS 256
+
+// -------------------------------------------------------------- typedefs --
+/** @brief Configuration of a batch run */
+typedef struct batchConfig {
+    const char* server;         /**< Hostname or address of the server */
+    const char* port;           /**< Port of the server */
+    const char* input;          /**< File with the messages, "-" for stdin */
+    int connections;            /**< Concurrent connections */
+    int verbose;                /**< Output in verbose mode 0 off, 1 on */
+} batchConfig;
+
+// ------------------------------------------------------------- functions --
+int batch_run(const batchConfig* config);
+
+#endif // CLIENT_BATCH_H
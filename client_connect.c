@@ -0,0 +1,269 @@
+/**
+ * @file client_connect.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 16.12.18
+ *
+ * @brief Non blocking connection setup of the client, racing the addresses of a server (happy eyeballs).
+ * The addresses are tried in the order of getaddrinfo(), but alternating between IPv6 and IPv4. Every attempt is
+ * a non blocking connect(), the next address is tried when the attempt before failed or after
+ * CONNECT_ATTEMPTDELAY ms without an answer, the attempts before stay pending. The first connected socket wins,
+ * the other attempts are closed. A host whose preferred family is broken (no route, silently dropped SYNs) costs
+ * CONNECT_ATTEMPTDELAY instead of a connect timeout. The race is driven by the caller's poll() loop, so many
+ * servers can be connected in parallel (client_fanout.c), connect_server() drives a single one.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#include <string.h>         // provides memcpy(), memset()
+#include <errno.h>          // provides errno
+#include <fcntl.h>          // provides fcntl(), O_NONBLOCK
+#include <time.h>           // provides clock_gettime()
+#include <unistd.h>         // provides close()
+#include "client_connect.h"
+
+// ------------------------------------------------------------- functions --
+static int startAttempts(connectRace* race);
+static void closePending(connectRace* race);
+
+/**
+ * @brief prepares the race over the addresses of a server and starts the first attempt
+ * @param race connectRace*: the race
+ * @param addresses const struct addrinfo*: result of getaddrinfo(), copied, at most CONNECT_MAXADDRESSES are used
+ * @return int: 1 if already connected (race->fd), 0 if attempts are pending, -1 if every attempt failed
+ * (race->error)
+ */
+int connect_start(connectRace* race, const struct addrinfo* addresses) {
+    memset(race, 0, sizeof(*race));
+    race->fd = -1;
+    race->winner = -1;
+    race->error = EHOSTUNREACH;
+    // the addresses of the preferred family, the first one, and of the others alternate
+    int firstFamily = (addresses != NULL) ? addresses->ai_family : AF_UNSPEC;
+    const struct addrinfo* preferred = addresses;
+    const struct addrinfo* other = addresses;
+    while (race->count < CONNECT_MAXADDRESSES) {
+        while ((preferred != NULL) && (preferred->ai_family != firstFamily)) {
+            preferred = preferred->ai_next;
+        }
+        while ((other != NULL) && (other->ai_family == firstFamily)) {
+            other = other->ai_next;
+        }
+        const struct addrinfo* take = ((race->count % 2 == 0) && (preferred != NULL)) || (other == NULL) ? preferred
+                                                                                                       : other;
+        if (take == NULL) {
+            break;
+        }
+        if (take == preferred) {
+            preferred = preferred->ai_next;
+        } else {
+            other = other->ai_next;
+        }
+        if (take->ai_addrlen > sizeof(struct sockaddr_storage)) {
+            continue;
+        }
+        connectAddress* address = &race->addresses[race->count++];
+        memcpy(&address->address, take->ai_addr, take->ai_addrlen);
+        address->length = take->ai_addrlen;
+        address->fd = -1;
+    }
+    return startAttempts(race);
+}
+
+/**
+ * @brief fills the poll entries of the pending attempts, they wait for POLLOUT
+ * @param race const connectRace*: the race
+ * @param fds struct pollfd*: entries to fill
+ * @param max int: number of entries
+ * @return int: number of entries filled
+ */
+int connect_pollfds(const connectRace* race, struct pollfd* fds, int max) {
+    int filled = 0;
+    for (int i = 0; (i < race->count) && (filled < max); i++) {
+        if (race->addresses[i].fd != -1) {
+            fds[filled].fd = race->addresses[i].fd;
+            fds[filled].events = POLLOUT;
+            fds[filled].revents = 0;
+            filled++;
+        }
+    }
+    return filled;
+}
+
+/**
+ * @brief time until the race needs connect_process() without an event
+ * @param race const connectRace*: the race
+ * @return int: ms until the next attempt is due, -1 if no attempt is due
+ */
+int connect_timeout(const connectRace* race) {
+    if ((race->fd != -1) || (race->pending == 0) || (race->next >= race->count)) {
+        return -1;
+    }
+    uint64_t now = connect_now();
+    return (race->nextAttempt > now) ? (int) (race->nextAttempt - now) : 0;
+}
+
+/**
+ * @brief handles the poll results of the pending attempts and starts the next attempt when it is due
+ * @param race connectRace*: the race
+ * @param fds const struct pollfd*: poll entries, entries of other sockets are ignored
+ * @param count int: number of entries
+ * @return int: 1 if connected (race->fd), 0 if attempts are pending, -1 if every attempt failed (race->error)
+ */
+int connect_process(connectRace* race, const struct pollfd* fds, int count) {
+    if (race->fd != -1) {
+        return 1;
+    }
+    for (int f = 0; f < count; f++) {
+        if (fds[f].revents == 0) {
+            continue;
+        }
+        for (int i = 0; i < race->count; i++) {
+            connectAddress* address = &race->addresses[i];
+            if (address->fd != fds[f].fd) {
+                continue;
+            }
+            int error = 0;
+            socklen_t length = sizeof(error);
+            if (getsockopt(address->fd, SOL_SOCKET, SO_ERROR, &error, &length) == -1) {
+                error = errno;
+            }
+            if (error == 0) {
+                race->fd = address->fd;
+                race->winner = i;
+                address->fd = -1;
+                race->pending--;
+                closePending(race);
+                return 1;
+            }
+            race->error = error;
+            close(address->fd);
+            address->fd = -1;
+            race->pending--;
+        }
+    }
+    // a failed attempt makes the next one due at once
+    if ((race->pending == 0) || (connect_now() >= race->nextAttempt)) {
+        return startAttempts(race);
+    }
+    return 0;
+}
+
+/**
+ * @brief closes the pending attempts, a connected socket (race->fd) belongs to the caller
+ * @param race connectRace*: the race
+ */
+void connect_cancel(connectRace* race) {
+    closePending(race);
+    race->next = race->count;
+}
+
+/**
+ * @brief connects to a server, racing its addresses
+ * @param server const char*: hostname or address
+ * @param port const char*: port or service
+ * @param peer struct sockaddr_storage*: the connected address
+ * @param error const char**: description of the error
+ * @return int: connected blocking socket, -1 in case of an error
+ */
+int connect_server(const char* server, const char* port, struct sockaddr_storage* peer, const char** error) {
+    struct addrinfo hints;
+    struct addrinfo* addresses;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;            // Allows IP4 and IP6
+    hints.ai_socktype = SOCK_STREAM;        // TCP
+    int addrinfoError = getaddrinfo(server, port, &hints, &addresses);
+    if (addrinfoError != 0) {
+        *error = gai_strerror(addrinfoError);
+        return -1;
+    }
+    connectRace race;
+    int result = connect_start(&race, addresses);
+    freeaddrinfo(addresses);
+    while (result == 0) {
+        struct pollfd fds[CONNECT_MAXADDRESSES];
+        int count = connect_pollfds(&race, fds, CONNECT_MAXADDRESSES);
+        if ((poll(fds, (nfds_t) count, connect_timeout(&race)) == -1) && (errno != EINTR)) {
+            race.error = errno;
+            connect_cancel(&race);
+            break;
+        }
+        result = connect_process(&race, fds, count);
+    }
+    if (race.fd == -1) {
+        *error = strerror(race.error);
+        return -1;
+    }
+    int flags = fcntl(race.fd, F_GETFL);
+    if ((flags == -1) || (fcntl(race.fd, F_SETFL, flags & ~O_NONBLOCK) == -1)) {
+        *error = strerror(errno);
+        close(race.fd);
+        return -1;
+    }
+    memcpy(peer, &race.addresses[race.winner].address, race.addresses[race.winner].length);
+    return race.fd;
+}
+
+/**
+ * @brief reads the monotonic clock
+ * @return uint64_t: time in ms
+ */
+uint64_t connect_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+/**
+ * @brief starts attempts until one is pending or connected, an address which fails at once is skipped
+ * @param race connectRace*: the race
+ * @return int: 1 if connected, 0 if attempts are pending, -1 if every attempt failed
+ */
+static int startAttempts(connectRace* race) {
+    while (race->next < race->count) {
+        connectAddress* address = &race->addresses[race->next++];
+        int fd = socket(address->address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd == -1) {
+            race->error = errno;
+            continue;
+        }
+        if (connect(fd, (struct sockaddr*) &address->address, address->length) == 0) {
+            race->fd = fd;      // a local server may accept at once
+            race->winner = race->next - 1;
+            closePending(race);
+            return 1;
+        }
+        if (errno != EINPROGRESS) {
+            race->error = errno;
+            close(fd);
+            continue;
+        }
+        address->fd = fd;
+        race->pending++;
+        race->nextAttempt = connect_now() + CONNECT_ATTEMPTDELAY;
+        return 0;
+    }
+    return (race->pending > 0) ? 0 : -1;
+}
+
+/**
+ * @brief closes the sockets of the pending attempts
+ * @param race connectRace*: the race
+ */
+static void closePending(connectRace* race) {
+    for (int i = 0; i < race->count; i++) {
+        if (race->addresses[i].fd != -1) {
+            close(race->addresses[i].fd);
+            race->addresses[i].fd = -1;
+        }
+    }
+    race->pending = 0;
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
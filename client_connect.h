@@ -0,0 +1,53 @@
+/**
+ * @file client_connect.h
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 16.12.18
+ *
+ * @brief Non blocking connection setup of the client, racing the addresses of a server (happy eyeballs)
+ * TCP/IP Lecture Distributed Systems
+ */
+#ifndef CLIENT_CONNECT_H
+#define CLIENT_CONNECT_H
+
+#include <stdint.h>         // provides uint64_t
+#include <poll.h>           // provides struct pollfd
+#include <netdb.h>          // provides struct addrinfo
+#include <sys/socket.h>     // provides struct sockaddr_storage
+
+// --------------------------------------------------------------- defines --
+/** @brief addresses of a server which are tried */
+#define CONNECT_MAXADDRESSES 16
+/** @brief delay in ms before the next address is tried while the attempts before are pending */
+#define CONNECT_ATTEMPTDELAY 250
+
+// -------------------------------------------------------------- typedefs --
+/** @brief An address of a server */
+typedef struct connectAddress {
+    struct sockaddr_storage address;    /**< The address */
+    socklen_t length;                   /**< Length of address */
+    int fd;                             /**< Socket of a pending attempt, -1 if none */
+} connectAddress;
+
+/** @brief Connection attempts to the addresses of one server */
+typedef struct connectRace {
+    connectAddress addresses[CONNECT_MAXADDRESSES];     /**< Addresses, families alternating */
+    int count;                          /**< Number of addresses */
+    int next;                           /**< Next address to try */
+    int pending;                        /**< Attempts in progress */
+    uint64_t nextAttempt;               /**< Time in ms of the next attempt while others are pending */
+    int fd;                             /**< Connected non blocking socket, -1 until an attempt succeeded */
+    int winner;                         /**< Index of the connected address */
+    int error;                          /**< errno of the last failed attempt */
+} connectRace;
+
+// ------------------------------------------------------------- functions --
+int connect_start(connectRace* race, const struct addrinfo* addresses);
+int connect_pollfds(const connectRace* race, struct pollfd* fds, int max);
+int connect_timeout(const connectRace* race);
+int connect_process(connectRace* race, const struct pollfd* fds, int count);
+void connect_cancel(connectRace* race);
+int connect_server(const char* server, const char* port, struct sockaddr_storage* peer, const char** error);
+uint64_t connect_now(void);
+
+#endif // CLIENT_CONNECT_H
@@ -0,0 +1,126 @@
+/**
+ * @file client_decoder.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 21.12.18
+ *
+ * @brief Streaming decoder of the deflate encoded files of a response.
+ * The compressed contents are fed in the chunks the parser hands out, the decoded bytes go to a sink in pieces of
+ * DECODER_CHUNK bytes, so a file is never held in memory as a whole. The decoded length is checked against the
+ * file limit while it grows: a small compressed file may expand to any length, the announced length only bounds
+ * the compressed bytes.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#include <string.h>         // provides memset()
+#include <errno.h>          // provides errno
+#include "client_decoder.h"
+
+// ------------------------------------------------------------- functions --
+static int fail(contentDecoder* decoder, const char* error);
+
+/**
+ * @brief starts the decoding of a file
+ * @param decoder contentDecoder*: the decoder, not active
+ * @param limit uint64_t: maximal decoded length, 0 is no limit
+ * @param sink decoderSink: receives the decoded bytes
+ * @param context void*: passed to the sink
+ * @return int: 0 in case of success, -1 if zlib has no memory (error is set)
+ */
+int decoder_start(contentDecoder* decoder, uint64_t limit, decoderSink sink, void* context) {
+    memset(&decoder->stream, 0, sizeof(decoder->stream));
+    decoder->active = 0;
+    decoder->ended = 0;
+    decoder->decoded = 0;
+    decoder->limit = limit;
+    decoder->sink = sink;
+    decoder->context = context;
+    decoder->error = NULL;
+    if (inflateInit(&decoder->stream) != Z_OK) {
+        decoder->error = "could not start the decompression";
+        return -1;
+    }
+    decoder->active = 1;
+    return 0;
+}
+
+/**
+ * @brief decodes the next part of the compressed contents and hands the decoded bytes to the sink
+ * @param decoder contentDecoder*: the active decoder
+ * @param data const char*: compressed bytes
+ * @param length size_t: number of bytes
+ * @return int: 0 in case of success, -1 on failure (error is set, errno as well if the sink failed)
+ */
+int decoder_feed(contentDecoder* decoder, const char* data, size_t length) {
+    decoder->stream.next_in = (Bytef*) data;
+    decoder->stream.avail_in = (uInt) length;
+    while (decoder->stream.avail_in > 0) {
+        if (decoder->ended) {
+            return fail(decoder, "data after the end of the compressed file");
+        }
+        decoder->stream.next_out = (Bytef*) decoder->out;
+        decoder->stream.avail_out = sizeof(decoder->out);
+        int result = inflate(&decoder->stream, Z_NO_FLUSH);
+        if ((result != Z_OK) && (result != Z_STREAM_END)) {
+            return fail(decoder, "corrupt compressed file");
+        }
+        size_t produced = sizeof(decoder->out) - decoder->stream.avail_out;
+        decoder->decoded += produced;
+        if ((decoder->limit > 0) && (decoder->decoded > decoder->limit)) {
+            return fail(decoder, "file exceeds the limit");
+        }
+        if ((produced > 0) && (decoder->sink(decoder->context, decoder->out, produced) == -1)) {
+            int error = errno;
+            fail(decoder, "could not write the decoded file");
+            errno = error;
+            return -1;
+        }
+        decoder->ended = (result == Z_STREAM_END);
+    }
+    return 0;
+}
+
+/**
+ * @brief ends the decoding after the last compressed byte
+ * @param decoder contentDecoder*: the active decoder
+ * @return int: 0 in case of success, -1 if the compressed file is truncated (error is set)
+ */
+int decoder_finish(contentDecoder* decoder) {
+    if (!decoder->ended) {
+        return fail(decoder, "truncated compressed file");
+    }
+    decoder_end(decoder);
+    return 0;
+}
+
+/**
+ * @brief releases the memory of zlib, also of an unfinished decoding
+ * @param decoder contentDecoder*: the decoder
+ */
+void decoder_end(contentDecoder* decoder) {
+    if (decoder->active) {
+        inflateEnd(&decoder->stream);
+        decoder->active = 0;
+    }
+}
+
+/**
+ * @brief ends the decoding with an error
+ * @param decoder contentDecoder*: the decoder
+ * @param error const char*: description of the failure
+ * @return int: -1
+ */
+static int fail(contentDecoder* decoder, const char* error) {
+    decoder->error = error;
+    decoder_end(decoder);
+    return -1;
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
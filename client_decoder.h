@@ -0,0 +1,44 @@
+/**
+ * @file client_decoder.h
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 21.12.18
+ *
+ * @brief Streaming decoder of the deflate encoded files of a response
+ * TCP/IP Lecture Distributed Systems
+ */
+#ifndef CLIENT_DECODER_H
+#define CLIENT_DECODER_H
+
+#include <stddef.h>         // provides size_t
+#include <stdint.h>         // provides uint64_t
+#include <zlib.h>           // provides z_stream
+
+// --------------------------------------------------------------- defines --
+/** @brief decoded bytes handed to the sink at once */
+#define DECODER_CHUNK (64 * 1024)
+
+// -------------------------------------------------------------- typedefs --
+/** @brief Receives the decoded contents, returns 0 in case of success, -1 on failure (errno is set) */
+typedef int (*decoderSink)(void* context, const char* data, size_t length);
+
+/** @brief State of the decoding of one file */
+typedef struct contentDecoder {
+    z_stream stream;            /**< The inflate stream */
+    int active;                 /**< 1 between decoder_start() and decoder_finish() */
+    int ended;                  /**< 1 when the zlib stream is complete */
+    uint64_t decoded;           /**< Decoded bytes so far */
+    uint64_t limit;             /**< Maximal decoded length, 0 is no limit */
+    decoderSink sink;           /**< Receives the decoded bytes */
+    void* context;              /**< Passed to the sink */
+    const char* error;          /**< Description of the failure */
+    char out[DECODER_CHUNK];    /**< Decoded bytes before they go to the sink */
+} contentDecoder;
+
+// ------------------------------------------------------------- functions --
+int decoder_start(contentDecoder* decoder, uint64_t limit, decoderSink sink, void* context);
+int decoder_feed(contentDecoder* decoder, const char* data, size_t length);
+int decoder_finish(contentDecoder* decoder);
+void decoder_end(contentDecoder* decoder);
+
+#endif // CLIENT_DECODER_H
@@ -0,0 +1,503 @@
+/**
+ * @file client_fanout.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 16.12.18
+ *
+ * @brief Fan-out mode of the client.
+ * The same message is posted to several servers at the same time. Every server is resolved, then one thread
+ * drives all connections with poll(): the non blocking connects race the addresses of every server
+ * (client_connect.c), the requests are sent unframed and the responses parsed as they arrive. The files of
+ * every server are written into a directory named after it, so the responses can be compared. With
+ * allAddresses every resolved address is a server of its own, e.g. to post to all replicas behind one name. At
+ * the end a line per server reports its address, status, files and timing.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#define _GNU_SOURCE         // provides strtok_r(), MSG_NOSIGNAL
+#include <stdlib.h>         // provides malloc(), free()
+#include <stdio.h>          // provides the printf()
+#include <string.h>         // provide strerror(), strlen()
+#include <errno.h>          // provides errno
+#include <fcntl.h>          // provides openat(), fallocate(), O_DIRECTORY
+#include <poll.h>           // provides poll()
+#include <time.h>           // provides clock_gettime()
+#include <unistd.h>         // provides close(), write()
+#include <netdb.h>          // provides getaddrinfo(), getnameinfo()
+#include <sys/types.h>
+#include <sys/stat.h>       // provides mkdir()
+#include <sys/socket.h>     // provides send(), recv(), shutdown()
+#include "client_fanout.h"
+#include "client_connect.h" // provides connect_start()
+#include "client_parser.h"  // provides parser_next()
+#include "trace.h"          // provides TRACE()
+
+// --------------------------------------------------------------- defines --
+/** @brief size of the receive buffer shared by all connections */
+#define FANOUT_RECEIVEBUFFER (64 * 1024)
+/** @brief ms a server may take to accept the connection, a dropped SYN would hold the fan-out for minutes */
+#define FANOUT_CONNECTTIMEOUT 10000
+/** @brief length of the name of a server, also the name of its directory */
+#define FANOUT_LABELLENGTH NI_MAXHOST
+
+// -------------------------------------------------------------- typedefs --
+/** @brief Progress of the post to one server */
+enum fanoutPhase {
+    PHASE_CONNECTING,           /**< The addresses of the server are raced */
+    PHASE_SENDING,              /**< The request is sent */
+    PHASE_RECEIVING,            /**< The response is received */
+    PHASE_DONE                  /**< Finished, error is set if it failed */
+};
+
+/** @brief One server of the fan-out */
+typedef struct fanoutTarget {
+    char label[FANOUT_LABELLENGTH];     /**< Name of the server and of its directory */
+    char address[NI_MAXHOST];           /**< Connected address */
+    enum fanoutPhase phase;             /**< Progress */
+    connectRace race;                   /**< Connection attempts */
+    int fd;                             /**< Connected socket, -1 if none */
+    size_t sent;                        /**< Bytes of the request sent */
+    responseParser parser;              /**< Position in the response */
+    int directory;                      /**< Directory of the files, -1 until the first file */
+    int file;                           /**< File being written, -1 if none */
+    size_t files;                       /**< Files received */
+    unsigned long long bytes;           /**< Bytes of the response */
+    int status;                         /**< Status of the response, -1 if none */
+    const char* error;                  /**< Description of the failure, NULL on success */
+    double connected;                   /**< ms from the start to the connection */
+    double finished;                    /**< ms from the start to the end of the response */
+    int pollIndex;                      /**< First entry of the target in the poll entries */
+    int pollCount;                      /**< Number of entries of the target */
+} fanoutTarget;
+
+/** @brief State of a fan-out */
+typedef struct fanoutState {
+    const fanoutConfig* config;         /**< Configuration */
+    fanoutTarget* targets;              /**< The servers */
+    int count;                          /**< Number of servers */
+    char* request;                      /**< The request, the same for every server */
+    size_t requestLength;               /**< Length of the request */
+    struct timespec start;              /**< Start of the fan-out */
+} fanoutState;
+
+// ------------------------------------------------------------- functions --
+static int addTargets(fanoutState* state, const char* server);
+static fanoutTarget* newTarget(fanoutState* state, const char* label);
+static void handleTarget(fanoutState* state, fanoutTarget* target, const struct pollfd* fds, char* buffer);
+static void parseResponse(fanoutState* state, fanoutTarget* target, const char* data, size_t length);
+static void finishTarget(fanoutState* state, fanoutTarget* target, const char* error);
+static void connected(fanoutState* state, fanoutTarget* target);
+static double elapsedMs(const struct timespec* since);
+
+/**
+ * @brief posts the message to every server of the configuration and prints the result of every server
+ * @param config const fanoutConfig*: configuration of the fan-out
+ * @return int: 0 if every server answered with status 0, 1 if not, -1 if the fan-out could not start (errno is
+ * set)
+ */
+int fanout_run(const fanoutConfig* config) {
+    fanoutState state;
+    memset(&state, 0, sizeof(state));
+    state.config = config;
+    clock_gettime(CLOCK_MONOTONIC, &state.start);
+    state.targets = calloc(FANOUT_MAXTARGETS, sizeof(fanoutTarget));
+    int requestLength = (config->image == NULL)
+                        ? snprintf(NULL, 0, "user=%s\n%s", config->user, config->message)
+                        : snprintf(NULL, 0, "user=%s\nimg=%s\n%s", config->user, config->image, config->message);
+    state.request = malloc((size_t) requestLength + 1);
+    char* servers = strdup(config->servers);
+    char* buffer = malloc(FANOUT_RECEIVEBUFFER);
+    struct pollfd* fds = malloc(FANOUT_MAXTARGETS * CONNECT_MAXADDRESSES * sizeof(struct pollfd));
+    if ((state.targets == NULL) || (state.request == NULL) || (servers == NULL) || (buffer == NULL) ||
+        (fds == NULL)) {
+        free(state.targets);
+        free(state.request);
+        free(servers);
+        free(buffer);
+        free(fds);
+        return -1;
+    }
+    if (config->image == NULL) {
+        snprintf(state.request, (size_t) requestLength + 1, "user=%s\n%s", config->user, config->message);
+    } else {
+        snprintf(state.request, (size_t) requestLength + 1, "user=%s\nimg=%s\n%s", config->user, config->image,
+                 config->message);
+    }
+    state.requestLength = (size_t) requestLength;
+
+    // resolve every server and start its first connection attempt
+    char* position = NULL;
+    for (char* server = strtok_r(servers, FANOUT_SEPARATOR, &position); server != NULL;
+         server = strtok_r(NULL, FANOUT_SEPARATOR, &position)) {
+        if (addTargets(&state, server) == -1) {
+            fprintf(stderr, "Too many servers, at most %d are posted to\n", FANOUT_MAXTARGETS);
+            break;
+        }
+    }
+    free(servers);
+
+    //---------------------------------------------------------------------------------------------------
+    //------------------ drive all connections until every server is done -------------------------------
+    //---------------------------------------------------------------------------------------------------
+    while (1) {
+        int count = 0;
+        int timeout = -1;
+        for (int i = 0; i < state.count; i++) {
+            fanoutTarget* target = &state.targets[i];
+            target->pollIndex = count;
+            if (target->phase == PHASE_CONNECTING) {
+                count += connect_pollfds(&target->race, fds + count, CONNECT_MAXADDRESSES);
+                int due = connect_timeout(&target->race);
+                int left = FANOUT_CONNECTTIMEOUT - (int) elapsedMs(&state.start);
+                due = ((due == -1) || (left < due)) ? ((left > 0) ? left : 0) : due;
+                if ((timeout == -1) || (due < timeout)) {
+                    timeout = due;
+                }
+            } else if (target->phase != PHASE_DONE) {
+                fds[count].fd = target->fd;
+                fds[count].events = (target->phase == PHASE_SENDING) ? POLLOUT : POLLIN;
+                fds[count].revents = 0;
+                count++;
+            }
+            target->pollCount = count - target->pollIndex;
+        }
+        if ((count == 0) && (timeout == -1)) {
+            break;
+        }
+        if (poll(fds, (nfds_t) count, timeout) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            for (int i = 0; i < state.count; i++) {
+                finishTarget(&state, &state.targets[i], strerror(errno));
+            }
+            break;
+        }
+        for (int i = 0; i < state.count; i++) {
+            handleTarget(&state, &state.targets[i], fds, buffer);
+            if ((state.targets[i].phase == PHASE_CONNECTING) && (elapsedMs(&state.start) >= FANOUT_CONNECTTIMEOUT)) {
+                finishTarget(&state, &state.targets[i], strerror(ETIMEDOUT));
+            }
+        }
+    }
+
+    // the result of every server: name, address, status, files, bytes, connect and total time
+    int failed = 0;
+    for (int i = 0; i < state.count; i++) {
+        fanoutTarget* target = &state.targets[i];
+        failed |= (target->error != NULL) || (target->status != 0);
+        if (target->error != NULL) {
+            fprintf(stdout, "%s\t%s\t-1\t%s\n", target->label, (target->address[0] != '\0') ? target->address : "-",
+                    target->error);
+        } else {
+            fprintf(stdout, "%s\t%s\t%d\t%zu files\t%llu bytes\t%.3f ms\t%.3f ms\n", target->label, target->address,
+                    target->status, target->files, target->bytes, target->connected, target->finished);
+        }
+    }
+    if (state.count == 0) {
+        failed = 1;
+    }
+    free(state.targets);
+    free(state.request);
+    free(buffer);
+    free(fds);
+    return failed;
+}
+
+/**
+ * @brief resolves a server and adds it, or every address of it, as target
+ * @param server const char*: hostname or address
+ * @return int: 0 in case of success, -1 if there are too many targets
+ */
+static int addTargets(fanoutState* state, const char* server) {
+    struct addrinfo hints;
+    struct addrinfo* addresses;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int addrinfoError = getaddrinfo(server, state->config->port, &hints, &addresses);
+    if (addrinfoError != 0) {
+        fanoutTarget* target = newTarget(state, server);
+        if (target == NULL) {
+            return -1;
+        }
+        finishTarget(state, target, gai_strerror(addrinfoError));
+        return 0;
+    }
+    if (!state->config->allAddresses) {
+        fanoutTarget* target = newTarget(state, server);
+        if (target == NULL) {
+            freeaddrinfo(addresses);
+            return -1;
+        }
+        int result = connect_start(&target->race, addresses);
+        freeaddrinfo(addresses);
+        if (result == 1) {
+            connected(state, target);
+        } else if (result == -1) {
+            finishTarget(state, target, strerror(target->race.error));
+        }
+        return 0;
+    }
+    for (struct addrinfo* address = addresses; address != NULL; address = address->ai_next) {
+        char label[FANOUT_LABELLENGTH];
+        if (getnameinfo(address->ai_addr, address->ai_addrlen, label, sizeof(label), NULL, 0, NI_NUMERICHOST) != 0) {
+            continue;
+        }
+        // the same address of several names is posted to once
+        int known = 0;
+        for (int i = 0; i < state->count; i++) {
+            known |= (strcmp(state->targets[i].label, label) == 0);
+        }
+        if (known) {
+            continue;
+        }
+        fanoutTarget* target = newTarget(state, label);
+        if (target == NULL) {
+            freeaddrinfo(addresses);
+            return -1;
+        }
+        // a race over this address only
+        struct addrinfo single = *address;
+        single.ai_next = NULL;
+        int result = connect_start(&target->race, &single);
+        if (result == 1) {
+            connected(state, target);
+        } else if (result == -1) {
+            finishTarget(state, target, strerror(target->race.error));
+        }
+    }
+    freeaddrinfo(addresses);
+    return 0;
+}
+
+/**
+ * @brief adds a target
+ * @param label const char*: name of the server, the name of its directory
+ * @return fanoutTarget*: the target, NULL if there are too many
+ */
+static fanoutTarget* newTarget(fanoutState* state, const char* label) {
+    if (state->count == FANOUT_MAXTARGETS) {
+        return NULL;
+    }
+    fanoutTarget* target = &state->targets[state->count++];
+    snprintf(target->label, sizeof(target->label), "%s", label);
+    target->phase = PHASE_CONNECTING;
+    target->race.fd = -1;
+    target->fd = -1;
+    target->directory = -1;
+    target->file = -1;
+    target->status = -1;
+    parser_init(&target->parser);
+    parser_limit(&target->parser, &state->config->limits);
+    return target;
+}
+
+/**
+ * @brief handles the poll results of a target
+ * @param target fanoutTarget*: the target
+ * @param fds const struct pollfd*: all poll entries
+ * @param buffer char*: the receive buffer
+ */
+static void handleTarget(fanoutState* state, fanoutTarget* target, const struct pollfd* fds, char* buffer) {
+    const struct pollfd* own = fds + target->pollIndex;
+    switch (target->phase) {
+        case PHASE_CONNECTING: {
+            int result = connect_process(&target->race, own, target->pollCount);
+            if (result == 1) {
+                connected(state, target);
+            } else if (result == -1) {
+                finishTarget(state, target, strerror(target->race.error));
+            }
+            break;
+        }
+        case PHASE_SENDING: {
+            if ((target->pollCount == 0) || (own->revents == 0)) {
+                break;
+            }
+            ssize_t sent = send(target->fd, state->request + target->sent, state->requestLength - target->sent,
+                                MSG_NOSIGNAL);
+            if (sent == -1) {
+                if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)) {
+                    finishTarget(state, target, strerror(errno));
+                }
+                break;
+            }
+            target->sent += (size_t) sent;
+            if (target->sent == state->requestLength) {
+                // the end of the request, the server answers and closes the connection
+                if (shutdown(target->fd, SHUT_WR) == -1) {
+                    finishTarget(state, target, strerror(errno));
+                    break;
+                }
+                target->phase = PHASE_RECEIVING;
+            }
+            break;
+        }
+        case PHASE_RECEIVING: {
+            if ((target->pollCount == 0) || (own->revents == 0)) {
+                break;
+            }
+            ssize_t received = recv(target->fd, buffer, FANOUT_RECEIVEBUFFER, 0);
+            if (received == -1) {
+                if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)) {
+                    finishTarget(state, target, strerror(errno));
+                }
+                break;
+            }
+            if (received == 0) {
+                finishTarget(state, target, parser_complete(&target->parser) ? NULL : "The response is incomplete");
+                break;
+            }
+            target->bytes += (unsigned long long) received;
+            parseResponse(state, target, buffer, (size_t) received);
+            break;
+        }
+        case PHASE_DONE:
+            break;
+    }
+}
+
+/**
+ * @brief parses received bytes of a response and writes the files into the directory of the target
+ * @param target fanoutTarget*: the target
+ * @param data const char*: received bytes
+ * @param length size_t: number of received bytes
+ */
+static void parseResponse(fanoutState* state, fanoutTarget* target, const char* data, size_t length) {
+    while (target->phase == PHASE_RECEIVING) {
+        parserView view;
+        switch (parser_next(&target->parser, &data, &length, &view)) {
+            case PARSER_MORE:
+                return;
+            case PARSER_FRAME:
+                break;
+            case PARSER_STATUS:
+                target->status = target->parser.status;
+                break;
+            case PARSER_FILE:
+                if (target->directory == -1) {
+                    if ((mkdir(target->label, 0777) == -1) && (errno != EEXIST)) {
+                        finishTarget(state, target, strerror(errno));
+                        return;
+                    }
+                    target->directory = open(target->label, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                    if (target->directory == -1) {
+                        finishTarget(state, target, strerror(errno));
+                        return;
+                    }
+                }
+                // the parser accepts plain names only, the file stays in the directory
+                target->file = openat(target->directory, view.data, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+                if (target->file == -1) {
+                    finishTarget(state, target, strerror(errno));
+                    return;
+                }
+                // large files are allocated at once instead of growing with every write
+                if ((target->parser.remaining >= FANOUT_RECEIVEBUFFER) &&
+                    (fallocate(target->file, FALLOC_FL_KEEP_SIZE, 0, (off_t) target->parser.remaining) == -1) &&
+                    ((errno == ENOSPC) || (errno == EFBIG))) {
+                    finishTarget(state, target, strerror(errno));
+                    return;
+                }
+                target->files++;
+                break;
+            case PARSER_CONTENT:
+                while (view.length > 0) {
+                    ssize_t written = write(target->file, view.data, view.length);
+                    if (written == -1) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        finishTarget(state, target, strerror(errno));
+                        return;
+                    }
+                    view.data += written;
+                    view.length -= (size_t) written;
+                }
+                break;
+            case PARSER_END:
+                finishTarget(state, target, NULL);
+                return;
+            case PARSER_ERROR:
+                finishTarget(state, target, target->parser.error);
+                return;
+        }
+        // a file is complete when the parser waits for the next one
+        if ((target->file != -1) && (target->parser.state != PARSER_STATE_CONTENT)) {
+            if (close(target->file) == -1) {
+                target->file = -1;
+                finishTarget(state, target, strerror(errno));
+                return;
+            }
+            target->file = -1;
+        }
+    }
+}
+
+/**
+ * @brief the connection of a target is established, the request is sent next
+ * @param target fanoutTarget*: the target with a connected race
+ */
+static void connected(fanoutState* state, fanoutTarget* target) {
+    target->fd = target->race.fd;
+    target->race.fd = -1;
+    target->connected = elapsedMs(&state->start);
+    connectAddress* winner = &target->race.addresses[target->race.winner];
+    if (getnameinfo((struct sockaddr*) &winner->address, winner->length, target->address, sizeof(target->address),
+                    NULL, 0, NI_NUMERICHOST) != 0) {
+        snprintf(target->address, sizeof(target->address), "?");
+    }
+    target->phase = PHASE_SENDING;
+    TRACE(TRACE_CONNECT, (uint64_t) target->fd, (uint32_t) (target - state->targets));
+}
+
+/**
+ * @brief ends the post to a target and releases its sockets and files
+ * @param target fanoutTarget*: the target
+ * @param error const char*: description of the failure, NULL on success
+ */
+static void finishTarget(fanoutState* state, fanoutTarget* target, const char* error) {
+    if (target->phase == PHASE_DONE) {
+        return;
+    }
+    if (target->phase == PHASE_CONNECTING) {
+        connect_cancel(&target->race);
+    }
+    if (target->fd != -1) {
+        TRACE(TRACE_CLOSE, (uint64_t) target->fd, error != NULL);
+        close(target->fd);
+        target->fd = -1;
+    }
+    if ((target->file != -1) && (close(target->file) == -1) && (error == NULL)) {
+        error = strerror(errno);
+    }
+    target->file = -1;
+    if (target->directory != -1) {
+        close(target->directory);
+        target->directory = -1;
+    }
+    target->error = error;
+    target->finished = elapsedMs(&state->start);
+    target->phase = PHASE_DONE;
+}
+
+/**
+ * @brief time since a point in time
+ * @param since const struct timespec*: the point in time
+ * @return double: elapsed ms
+ */
+static double elapsedMs(const struct timespec* since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) (now.tv_sec - since->tv_sec) * 1000.0 + (double) (now.tv_nsec - since->tv_nsec) / 1000000.0;
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
@@ -0,0 +1,37 @@
+/**
+ * @file client_fanout.h
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 16.12.18
+ *
+ * @brief Fan-out mode of the client, one message posted to several servers in parallel
+ * TCP/IP Lecture Distributed Systems
+ */
+#ifndef CLIENT_FANOUT_H
+#define CLIENT_FANOUT_H
+
+#include "client_parser.h"  // provides parserLimits
+
+// --------------------------------------------------------------- defines --
+/** @brief separator of the servers in the -s argument */
+#define FANOUT_SEPARATOR ","
+/** @brief maximal number of servers, or addresses with allAddresses */
+#define FANOUT_MAXTARGETS 64
+
+// -------------------------------------------------------------- typedefs --
+/** @brief Configuration of a fan-out */
+typedef struct fanoutConfig {
+    int enabled;                /**< 1 if the fan-out mode is selected */
+    int allAddresses;           /**< 1 if every resolved address is a server of its own */
+    const char* servers;        /**< Hostnames or addresses separated by FANOUT_SEPARATOR */
+    const char* port;           /**< Port of the servers */
+    const char* user;           /**< Name of the posting user */
+    const char* message;        /**< The message */
+    const char* image;          /**< URL of the image, NULL if none */
+    parserLimits limits;        /**< Limits of every response */
+} fanoutConfig;
+
+// ------------------------------------------------------------- functions --
+int fanout_run(const fanoutConfig* config);
+
+#endif // CLIENT_FANOUT_H
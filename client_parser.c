@@ -0,0 +1,317 @@
+/**
+ * @file client_parser.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 15.12.18
+ *
+ * @brief Incremental parser of the responses.
+ * The parser is a state machine fed with the received chunks as they are, a chunk may end anywhere, also inside
+ * a header line or a number. Header lines completely inside a chunk are parsed in place, only a line split over
+ * two chunks is collected in the parser itself, nothing is allocated. File contents are handed out as views into
+ * the chunk. Every line is checked strictly: known key, digits only, no overflow, bounded length, and a file name
+ * must be a single path component. A framed response is never consumed beyond its length, the bytes of the next
+ * response stay in the chunk. Lengths beyond the limits are rejected when they are announced, before a byte of
+ * the file is received.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#include <string.h>         // provides memchr(), memcpy()
+#include <limits.h>         // provides INT_MAX
+#include "client_parser.h"
+
+// --------------------------------------------------------------- defines --
+/** @brief FIELD_DELIMITER defines the delimiter between the fields defined in the protocol */
+#define FIELD_DELIMITER '\n'
+/** @brief keys of the header lines */
+#define KEY_RESPONSE "response="
+#define KEY_STATUS "status="
+#define KEY_FILE "file="
+#define KEY_LENGTH "len="
+#define KEY_ENCODING "enc="
+/** @brief name of the deflate encoding in the enc= line */
+#define ENCODING_DEFLATE "deflate"
+
+// ------------------------------------------------------------- functions --
+static int takeLine(responseParser* parser, const char** data, size_t* length, parserView* line);
+static int parseNumber(parserView line, const char* key, uint64_t max, uint64_t* value);
+static enum parserEvent fail(responseParser* parser, const char* error);
+
+/**
+ * @brief prepares the parser for a new response
+ * @param parser responseParser*: the parser
+ */
+void parser_init(responseParser* parser) {
+    parser->state = PARSER_STATE_START;
+    parser->lineLength = 0;
+    parser->name[0] = '\0';
+    parser->framed = 0;
+    parser->frameEnd = 0;
+    parser->frameLength = 0;
+    parser->status = -1;
+    parser->remaining = 0;
+    parser->encoding = PARSER_IDENTITY;
+    parser->consumed = 0;
+    parser->limits.file = 0;
+    parser->limits.response = 0;
+    parser->error = NULL;
+}
+
+/**
+ * @brief sets the limits of the response, called after parser_init()
+ * @param parser responseParser*: the parser
+ * @param limits const parserLimits*: the limits, 0 is no limit
+ */
+void parser_limit(responseParser* parser, const parserLimits* limits) {
+    parser->limits = *limits;
+}
+
+/**
+ * @brief consumes bytes of the chunk until the next event
+ * @param parser responseParser*: the parser
+ * @param data const char**: the unconsumed part of the chunk, advanced past the consumed bytes
+ * @param length size_t*: bytes at *data, decreased by the consumed bytes
+ * @param view parserView*: the name for PARSER_FILE, the contents for PARSER_CONTENT
+ * @return enum parserEvent: the event, PARSER_MORE if the chunk is consumed completely
+ */
+enum parserEvent parser_next(responseParser* parser, const char** data, size_t* length, parserView* view) {
+    if (parser->state == PARSER_STATE_FAILED) {
+        return PARSER_ERROR;
+    }
+    if (parser->framed && (parser->consumed == parser->frameEnd)) {
+        if (parser->state != PARSER_STATE_NAME) {
+            return fail(parser, "response ends inside a record");
+        }
+        return PARSER_END;
+    }
+    // a framed response is not consumed beyond its end
+    size_t available = *length;
+    if (parser->framed && (parser->frameEnd - parser->consumed < available)) {
+        available = (size_t) (parser->frameEnd - parser->consumed);
+    }
+    if (available == 0) {
+        return PARSER_MORE;
+    }
+
+    if (parser->state == PARSER_STATE_CONTENT) {
+        size_t part = (parser->remaining < available) ? (size_t) parser->remaining : available;
+        view->data = *data;
+        view->length = part;
+        *data += part;
+        *length -= part;
+        parser->consumed += part;
+        parser->remaining -= part;
+        if (parser->remaining == 0) {
+            parser->state = PARSER_STATE_NAME;
+        }
+        return PARSER_CONTENT;
+    }
+
+    const char* start = *data;
+    size_t rest = available;
+    parserView line;
+    int taken = takeLine(parser, &start, &rest, &line);
+    parser->consumed += available - rest;
+    *length -= available - rest;
+    *data = start;
+    if (taken == -1) {
+        return fail(parser, "header line too long");
+    }
+    if (taken == 0) {
+        if (parser->framed && (parser->consumed == parser->frameEnd)) {
+            return fail(parser, "response ends inside a header line");
+        }
+        return PARSER_MORE;
+    }
+    // records without contents let the response grow as well
+    if ((parser->limits.response > 0) && (parser->consumed > parser->limits.response)) {
+        return fail(parser, "response exceeds the limit");
+    }
+
+    uint64_t value;
+    switch (parser->state) {
+        case PARSER_STATE_START:
+            if ((line.length >= strlen(KEY_RESPONSE)) &&
+                (memcmp(line.data, KEY_RESPONSE, strlen(KEY_RESPONSE)) == 0)) {
+                if (parseNumber(line, KEY_RESPONSE, PARSER_MAXFILELENGTH, &value) == -1) {
+                    return fail(parser, "invalid response length");
+                }
+                if ((parser->limits.response > 0) && (value > parser->limits.response)) {
+                    return fail(parser, "response exceeds the limit");
+                }
+                parser->framed = 1;
+                parser->frameLength = value;
+                parser->frameEnd = parser->consumed + value;
+                parser->state = PARSER_STATE_STATUS;
+                return PARSER_FRAME;
+            }
+            // a response without length line starts with the status
+            // fall through
+        case PARSER_STATE_STATUS:
+            if (parseNumber(line, KEY_STATUS, INT_MAX, &value) == -1) {
+                return fail(parser, "invalid status line");
+            }
+            parser->status = (int) value;
+            parser->state = PARSER_STATE_NAME;
+            return PARSER_STATUS;
+        case PARSER_STATE_NAME:
+            if ((line.length <= strlen(KEY_FILE)) || (memcmp(line.data, KEY_FILE, strlen(KEY_FILE)) != 0)) {
+                return fail(parser, "invalid file line");
+            }
+            line.data += strlen(KEY_FILE);
+            line.length -= strlen(KEY_FILE);
+            // the name is used as path by the client, only plain names in the working directory are accepted
+            if ((line.length > PARSER_MAXNAME) || (memchr(line.data, '/', line.length) != NULL) ||
+                (memchr(line.data, '\0', line.length) != NULL) ||
+                ((line.length == 1) && (line.data[0] == '.')) ||
+                ((line.length == 2) && (line.data[0] == '.') && (line.data[1] == '.'))) {
+                return fail(parser, "invalid file name");
+            }
+            memcpy(parser->name, line.data, line.length);
+            parser->name[line.length] = '\0';
+            parser->encoding = PARSER_IDENTITY;
+            parser->state = PARSER_STATE_LENGTH;
+            return parser_next(parser, data, length, view);
+        case PARSER_STATE_LENGTH:
+            // at most one enc= line, the server sends it only if the client offered the encoding
+            if ((parser->encoding == PARSER_IDENTITY) && (line.length >= strlen(KEY_ENCODING)) &&
+                (memcmp(line.data, KEY_ENCODING, strlen(KEY_ENCODING)) == 0)) {
+                if ((line.length != strlen(KEY_ENCODING ENCODING_DEFLATE)) ||
+                    (memcmp(line.data, KEY_ENCODING ENCODING_DEFLATE, line.length) != 0)) {
+                    return fail(parser, "unknown file encoding");
+                }
+                parser->encoding = PARSER_DEFLATE;
+                return parser_next(parser, data, length, view);
+            }
+            if (parseNumber(line, KEY_LENGTH, PARSER_MAXFILELENGTH, &value) == -1) {
+                return fail(parser, "invalid file length");
+            }
+            if (parser->framed && (value > parser->frameEnd - parser->consumed)) {
+                return fail(parser, "file exceeds the response length");
+            }
+            if ((parser->limits.file > 0) && (value > parser->limits.file)) {
+                return fail(parser, "file exceeds the limit");
+            }
+            if ((parser->limits.response > 0) && (value > parser->limits.response - parser->consumed)) {
+                return fail(parser, "response exceeds the limit");
+            }
+            parser->remaining = value;
+            parser->state = (value > 0) ? PARSER_STATE_CONTENT : PARSER_STATE_NAME;
+            view->data = parser->name;
+            view->length = strlen(parser->name);
+            return PARSER_FILE;
+        default:
+            return fail(parser, "invalid state");
+    }
+}
+
+/**
+ * @brief marks contents of the current file as consumed which were received without the parser
+ * @param parser responseParser*: the parser in a file, length must not exceed remaining
+ * @param length uint64_t: bytes received
+ */
+void parser_skip(responseParser* parser, uint64_t length) {
+    if ((parser->state != PARSER_STATE_CONTENT) || (length > parser->remaining)) {
+        fail(parser, "skipped beyond the file");
+        return;
+    }
+    parser->remaining -= length;
+    parser->consumed += length;
+    if (parser->remaining == 0) {
+        parser->state = PARSER_STATE_NAME;
+    }
+}
+
+/**
+ * @brief checks if the response may end here: after the status line or a complete file, a framed response only
+ * at its length
+ * @param parser const responseParser*: the parser
+ * @return int: 1 if the response is complete, 0 if not
+ */
+int parser_complete(const responseParser* parser) {
+    if (parser->state != PARSER_STATE_NAME) {
+        return 0;
+    }
+    return (!parser->framed || (parser->consumed == parser->frameEnd)) ? 1 : 0;
+}
+
+/**
+ * @brief takes the next header line, from the chunk if it is completely inside, otherwise it is collected in the
+ * parser
+ * @param data const char**: the chunk, advanced past the taken bytes
+ * @param length size_t*: bytes of the chunk, decreased by the taken bytes
+ * @param line parserView*: the line without the '\n'
+ * @return int: 1 if a line was taken, 0 if the chunk ended before the line, -1 if the line is too long
+ */
+static int takeLine(responseParser* parser, const char** data, size_t* length, parserView* line) {
+    size_t room = PARSER_MAXLINE - parser->lineLength;
+    size_t searched = (*length < room + 1) ? *length : room + 1;
+    const char* end = memchr(*data, FIELD_DELIMITER, searched);
+    if (end == NULL) {
+        if (*length > room) {
+            return -1;
+        }
+        memcpy(parser->line + parser->lineLength, *data, *length);
+        parser->lineLength += *length;
+        *data += *length;
+        *length = 0;
+        return 0;
+    }
+    size_t part = (size_t) (end - *data);
+    if (parser->lineLength == 0) {
+        line->data = *data;     // in place, the chunk stays valid until the next call
+        line->length = part;
+    } else {
+        memcpy(parser->line + parser->lineLength, *data, part);
+        line->data = parser->line;
+        line->length = parser->lineLength + part;
+        parser->lineLength = 0;
+    }
+    *data += part + 1;
+    *length -= part + 1;
+    return 1;
+}
+
+/**
+ * @brief parses key=<decimal> strictly: the key, at least one digit, only digits, not above max
+ * @param line parserView: the line without '\n'
+ * @param key const char*: the expected key including '='
+ * @param max uint64_t: largest allowed value
+ * @param value uint64_t*: the value
+ * @return int: 0 in case of success, -1 if the line is invalid
+ */
+static int parseNumber(parserView line, const char* key, uint64_t max, uint64_t* value) {
+    size_t keyLength = strlen(key);
+    if ((line.length <= keyLength) || (memcmp(line.data, key, keyLength) != 0)) {
+        return -1;
+    }
+    uint64_t result = 0;
+    for (size_t i = keyLength; i < line.length; i++) {
+        unsigned digit = (unsigned) (line.data[i] - '0');
+        if ((digit > 9) || (result > (max - digit) / 10)) {
+            return -1;
+        }
+        result = result * 10 + digit;
+    }
+    *value = result;
+    return 0;
+}
+
+/**
+ * @brief puts the parser into the failed state
+ * @param error const char*: description of the error
+ * @return enum parserEvent: PARSER_ERROR
+ */
+static enum parserEvent fail(responseParser* parser, const char* error) {
+    parser->state = PARSER_STATE_FAILED;
+    parser->error = error;
+    return PARSER_ERROR;
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
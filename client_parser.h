@@ -0,0 +1,89 @@
+/**
+ * @file client_parser.h
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 15.12.18
+ *
+ * @brief Incremental parser of the responses (status=, file=, len= and the file contents)
+ * TCP/IP Lecture Distributed Systems
+ */
+#ifndef CLIENT_PARSER_H
+#define CLIENT_PARSER_H
+
+#include <stddef.h>         // provides size_t
+#include <stdint.h>         // provides uint64_t
+
+// --------------------------------------------------------------- defines --
+/** @brief maximal length of a file name, a single path component */
+#define PARSER_MAXNAME 255
+/** @brief maximal length of a header line without the '\n', the file= line is the longest */
+#define PARSER_MAXLINE (PARSER_MAXNAME + 5)
+/** @brief maximal length of a file */
+#define PARSER_MAXFILELENGTH ((uint64_t) INT64_MAX)
+
+// -------------------------------------------------------------- typedefs --
+/** @brief Bytes of a buffer, not terminated unless stated otherwise */
+typedef struct parserView {
+    const char* data;           /**< First byte */
+    size_t length;              /**< Number of bytes */
+} parserView;
+
+/** @brief Result of parser_next() */
+enum parserEvent {
+    PARSER_MORE,                /**< All given bytes are consumed, more are needed */
+    PARSER_FRAME,               /**< response=<length> line of a persistent connection, frameLength is set */
+    PARSER_STATUS,              /**< status= line, status is set */
+    PARSER_FILE,                /**< file=, enc= and len= lines, the view is the terminated name, remaining and
+                                     encoding are set */
+    PARSER_CONTENT,             /**< The view is the next part of the file contents */
+    PARSER_END,                 /**< End of a framed response, further bytes belong to the next response */
+    PARSER_ERROR                /**< The response violates the protocol, error describes it */
+};
+
+/** @brief Encoding of the contents of a file, given by an enc= line between the file= and len= lines */
+enum parserEncoding {
+    PARSER_IDENTITY,            /**< The contents as they are, no enc= line */
+    PARSER_DEFLATE              /**< zlib stream of the contents, len= is the compressed length */
+};
+
+/** @brief Limits of a response, 0 is no limit */
+typedef struct parserLimits {
+    uint64_t file;              /**< Maximal length of a file */
+    uint64_t response;          /**< Maximal length of a response, headers included */
+} parserLimits;
+
+/** @brief Position of the parser in the response */
+enum parserState {
+    PARSER_STATE_START,         /**< Length line of a frame or status line expected */
+    PARSER_STATE_STATUS,        /**< Status line expected after the length line */
+    PARSER_STATE_NAME,          /**< file= line expected, or the end of the response */
+    PARSER_STATE_LENGTH,        /**< enc= or len= line expected */
+    PARSER_STATE_CONTENT,       /**< Contents of the current file */
+    PARSER_STATE_FAILED         /**< Protocol error, no further events */
+};
+
+/** @brief State of the parser, no heap memory is used */
+typedef struct responseParser {
+    enum parserState state;             /**< Position in the response */
+    char line[PARSER_MAXLINE];          /**< Header line split over several chunks */
+    size_t lineLength;                  /**< Bytes in line */
+    char name[PARSER_MAXNAME + 1];      /**< Name of the current file, terminated */
+    int framed;                         /**< 1 if the response started with a length line */
+    uint64_t frameEnd;                  /**< Value of consumed at the end of a framed response */
+    uint64_t frameLength;               /**< Length of a framed response */
+    int status;                         /**< Value of the status line */
+    uint64_t remaining;                 /**< Bytes of the current file not consumed yet */
+    enum parserEncoding encoding;       /**< Encoding of the current file */
+    uint64_t consumed;                  /**< Bytes of the response consumed so far */
+    parserLimits limits;                /**< Limits checked against the announced lengths, none after init */
+    const char* error;                  /**< Description of the protocol error */
+} responseParser;
+
+// ------------------------------------------------------------- functions --
+void parser_init(responseParser* parser);
+enum parserEvent parser_next(responseParser* parser, const char** data, size_t* length, parserView* view);
+void parser_limit(responseParser* parser, const parserLimits* limits);
+void parser_skip(responseParser* parser, uint64_t length);
+int parser_complete(const responseParser* parser);
+
+#endif // CLIENT_PARSER_H
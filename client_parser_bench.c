@@ -0,0 +1,289 @@
+/**
+ * @file client_parser_bench.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 15.12.18
+ *
+ * @brief Microbenchmark of the response parser.
+ * The responses are parsed from memory in chunks of different sizes, from single bytes as on a slow connection
+ * up to the whole response, the chunks are views into the response, so only the parser is measured. The
+ * responses are the captured ones of the files given as arguments and two synthetic ones, many small records and
+ * a few large files. For comparison the responses are also parsed like the client did before, with fgets() from a
+ * stream, a copy of every field on the heap and strtol().
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#include <stdlib.h>         // provides malloc(), free(), strtol()
+#include <stdio.h>          // provides the printf(), fmemopen()
+#include <string.h>         // provides memcpy(), strlen(), strerror()
+#include <errno.h>          // provides errno
+#include <limits.h>         // provides _POSIX_PATH_MAX
+#include <time.h>           // provides clock_gettime()
+#include "client_parser.h"
+#include "pcap_reader.h"
+
+// --------------------------------------------------------------- defines --
+/** @brief minimal time of a measurement in ns */
+#define BENCH_MINTIME 200000000ull
+/** @brief records of the synthetic response with small records */
+#define BENCH_SMALLRECORDS 20000
+/** @brief contents of a small record */
+#define BENCH_SMALLLENGTH 64
+/** @brief files and length of a file of the synthetic response with large files */
+#define BENCH_LARGEFILES 4
+#define BENCH_LARGELENGTH (4 * 1024 * 1024)
+/** @brief chunk sizes, 0 is the whole response */
+static const size_t chunkSizes[] = {1, 16, 1460, 65536, 0};
+
+// -------------------------------------------------------------- typedefs --
+/** @brief A response to parse */
+typedef struct benchResponse {
+    char* data;                 /**< The response */
+    size_t length;              /**< Length of the response */
+    size_t records;             /**< Files of the response */
+} benchResponse;
+
+/** @brief A named set of responses */
+typedef struct benchWorkload {
+    const char* name;           /**< Name in the report */
+    benchResponse* responses;   /**< The responses */
+    size_t count;               /**< Number of responses */
+} benchWorkload;
+
+// ------------------------------------------------------------- functions --
+static size_t parseResponse(const benchResponse* response, size_t chunkSize);
+static size_t parseStdio(const benchResponse* response);
+static void measure(const benchWorkload* workload, size_t chunkSize);
+static int addResponse(benchWorkload* workload, char* data, size_t length);
+static char* synthetic(size_t files, size_t fileLength, size_t* length);
+static uint64_t now(void);
+
+/**
+ * @brief runs the benchmark over the responses of the given captures and the synthetic responses
+ * @param argc int: number of arguments
+ * @param argv char**: captures, pcap files or the text output of tcpdump -X
+ * @return int: EXIT_SUCCESS or EXIT_FAILURE
+ */
+int main(int argc, char** argv) {
+    benchWorkload workloads[3] = {{"captured", NULL, 0}, {"small records", NULL, 0}, {"large files", NULL, 0}};
+    for (int i = 1; i < argc; i++) {
+        pcapCapture capture;
+        if (pcap_read(argv[i], &capture) == -1) {
+            fprintf(stderr, "%s: %s: %s, skipped\n", argv[0], argv[i],
+                    (errno == EINVAL) ? "no packets in the file" : strerror(errno));
+            pcap_free(&capture);
+            continue;
+        }
+        for (size_t s = 0; s < capture.count; s++) {
+            pcapData* response = &capture.streams[s].response;
+            if (response->length == 0) {
+                continue;
+            }
+            char* copy = malloc(response->length);
+            if ((copy == NULL) || (memcpy(copy, response->data, response->length),
+                                   addResponse(&workloads[0], copy, response->length) == -1)) {
+                fprintf(stderr, "%s: %s\n", argv[0], strerror(ENOMEM));
+                return EXIT_FAILURE;
+            }
+        }
+        pcap_free(&capture);
+    }
+    size_t length;
+    char* small = synthetic(BENCH_SMALLRECORDS, BENCH_SMALLLENGTH, &length);
+    if ((small == NULL) || (addResponse(&workloads[1], small, length) == -1)) {
+        fprintf(stderr, "%s: %s\n", argv[0], strerror(ENOMEM));
+        return EXIT_FAILURE;
+    }
+    char* large = synthetic(BENCH_LARGEFILES, BENCH_LARGELENGTH, &length);
+    if ((large == NULL) || (addResponse(&workloads[2], large, length) == -1)) {
+        fprintf(stderr, "%s: %s\n", argv[0], strerror(ENOMEM));
+        return EXIT_FAILURE;
+    }
+
+    fprintf(stdout, "%-14s %-8s %12s %12s %12s\n", "workload", "chunk", "MB/s", "ns/record", "ns/response");
+    for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++) {
+        if (workloads[w].count == 0) {
+            continue;
+        }
+        for (size_t c = 0; c < sizeof(chunkSizes) / sizeof(chunkSizes[0]); c++) {
+            measure(&workloads[w], chunkSizes[c]);
+        }
+        measure(&workloads[w], (size_t) -1);
+        for (size_t r = 0; r < workloads[w].count; r++) {
+            free(workloads[w].responses[r].data);
+        }
+        free(workloads[w].responses);
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief parses the responses of a workload repeatedly and prints the throughput
+ * @param workload const benchWorkload*: the responses
+ * @param chunkSize size_t: size of the chunks, 0 for the whole response, (size_t) -1 for the stdio parser
+ */
+static void measure(const benchWorkload* workload, size_t chunkSize) {
+    uint64_t bytes = 0, records = 0, responses = 0;
+    uint64_t start = now(), elapsed;
+    do {
+        for (size_t r = 0; r < workload->count; r++) {
+            const benchResponse* response = &workload->responses[r];
+            size_t parsed = (chunkSize == (size_t) -1) ? parseStdio(response) : parseResponse(response, chunkSize);
+            if (parsed != response->records) {
+                fprintf(stderr, "%s: response %zu: %zu of %zu records\n", workload->name, r, parsed,
+                        response->records);
+                exit(EXIT_FAILURE);
+            }
+            bytes += response->length;
+            records += parsed;
+            responses++;
+        }
+        elapsed = now() - start;
+    } while (elapsed < BENCH_MINTIME);
+    char chunk[24];
+    if (chunkSize == (size_t) -1) {
+        snprintf(chunk, sizeof(chunk), "fgets");
+    } else if (chunkSize == 0) {
+        snprintf(chunk, sizeof(chunk), "whole");
+    } else {
+        snprintf(chunk, sizeof(chunk), "%zu", chunkSize);
+    }
+    fprintf(stdout, "%-14s %-8s %12.1f %12.1f %12.1f\n", workload->name, chunk, bytes * 1000.0 / elapsed,
+            (records > 0) ? (double) elapsed / records : 0.0, (double) elapsed / responses);
+}
+
+/**
+ * @brief parses a response in chunks with the response parser
+ * @param response const benchResponse*: the response
+ * @param chunkSize size_t: size of the chunks, 0 for the whole response
+ * @return size_t: number of files, (size_t) -1 in case of a protocol error
+ */
+static size_t parseResponse(const benchResponse* response, size_t chunkSize) {
+    responseParser parser;
+    parser_init(&parser);
+    size_t files = 0;
+    for (size_t position = 0; position < response->length;) {
+        size_t chunk = response->length - position;
+        if ((chunkSize > 0) && (chunkSize < chunk)) {
+            chunk = chunkSize;
+        }
+        const char* data = response->data + position;
+        size_t length = chunk;
+        parserView view;
+        enum parserEvent event;
+        while ((event = parser_next(&parser, &data, &length, &view)) != PARSER_MORE) {
+            if ((event == PARSER_ERROR) || (event == PARSER_END)) {
+                return (event == PARSER_END) ? files : (size_t) -1;
+            }
+            files += (event == PARSER_FILE);
+        }
+        position += chunk;
+    }
+    return parser_complete(&parser) ? files : (size_t) -1;
+}
+
+/**
+ * @brief parses a response like the client before the response parser: fgets() into fixed buffers, every field
+ * copied to the heap, the numbers with strtol(), the contents read with fread()
+ * @param response const benchResponse*: the response
+ * @return size_t: number of files, (size_t) -1 in case of a protocol error
+ */
+static size_t parseStdio(const benchResponse* response) {
+    FILE* stream = fmemopen(response->data, response->length, "r");
+    if (stream == NULL) {
+        return (size_t) -1;
+    }
+    char status[10], name[_POSIX_PATH_MAX], length[20], contents[4096];
+    size_t files = (size_t) -1;
+    if ((fgets(status, sizeof(status), stream) != NULL) && (strncmp(status, "status=", 7) == 0)) {
+        files = 0;
+        while (fgets(name, sizeof(name), stream) != NULL) {
+            char* field = malloc(strlen(name) + 1);
+            if ((field == NULL) || (fgets(length, sizeof(length), stream) == NULL)) {
+                free(field);
+                files = (size_t) -1;
+                break;
+            }
+            strcpy(field, name + strlen("file="));
+            long remaining = strtol(length + strlen("len="), NULL, 10);
+            while (remaining > 0) {
+                size_t part = fread(contents, 1, (remaining < (long) sizeof(contents)) ? (size_t) remaining
+                                                                                      : sizeof(contents), stream);
+                if (part == 0) {
+                    break;
+                }
+                remaining -= (long) part;
+            }
+            free(field);
+            files++;
+        }
+    }
+    fclose(stream);
+    return files;
+}
+
+/**
+ * @brief adds a response to a workload, the number of its files is counted, an incomplete one is left out
+ * @param workload benchWorkload*: the workload
+ * @param data char*: the response, owned by the workload from now on
+ * @param length size_t: length of the response
+ * @return int: 0 in case of success, -1 if no memory is left
+ */
+static int addResponse(benchWorkload* workload, char* data, size_t length) {
+    benchResponse response = {data, length, 0};
+    response.records = parseResponse(&response, 0);
+    if (response.records == (size_t) -1) {
+        fprintf(stderr, "%s: incomplete response of %zu bytes left out\n", workload->name, length);
+        free(data);
+        return 0;
+    }
+    benchResponse* grown = realloc(workload->responses, (workload->count + 1) * sizeof(benchResponse));
+    if (grown == NULL) {
+        free(data);
+        return -1;
+    }
+    workload->responses = grown;
+    workload->responses[workload->count++] = response;
+    return 0;
+}
+
+/**
+ * @brief builds a response with files of the given length
+ * @param files size_t: number of files
+ * @param fileLength size_t: length of every file
+ * @param length size_t*: length of the response
+ * @return char*: the response, NULL if no memory is left
+ */
+static char* synthetic(size_t files, size_t fileLength, size_t* length) {
+    size_t capacity = 16 + files * (fileLength + 48);
+    char* response = malloc(capacity);
+    if (response == NULL) {
+        return NULL;
+    }
+    *length = (size_t) sprintf(response, "status=0\n");
+    for (size_t i = 0; i < files; i++) {
+        *length += (size_t) sprintf(response + *length, "file=record-%zu.html\nlen=%zu\n", i, fileLength);
+        memset(response + *length, 'a' + (int) (i % 26), fileLength);
+        *length += fileLength;
+    }
+    return response;
+}
+
+/**
+ * @brief reads the monotonic clock
+ * @return uint64_t: time in ns
+ */
+static uint64_t now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) time.tv_sec * 1000000000ull + (uint64_t) time.tv_nsec;
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
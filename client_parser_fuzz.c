@@ -0,0 +1,514 @@
+/**
+ * @file client_parser_fuzz.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 15.12.18
+ *
+ * @brief Fuzz target of the response parser.
+ * Every input is parsed several times, as a whole, byte by byte, in chunks of a fixed and of random sizes, and
+ * every chunk is copied into a buffer of exactly its size, so a read behind the chunk is found by the address
+ * sanitizer. The results must not depend on the chunks: the same status, the same files with the same names and
+ * contents, the same end. On every event the invariants of the parser are checked, a violation aborts.
+ * Built with -DFUZZ_LIBFUZZER the file is a libFuzzer target, otherwise it has an own driver: the server to client
+ * streams of the captures in tcpDump_Protocols are the seeds, as they are and framed like on a persistent
+ * connection, they are cut at every position and mutated.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#include <stdlib.h>         // provides malloc(), free(), abort()
+#include <stdio.h>          // provides the printf()
+#include <string.h>         // provides memcpy(), strlen(), strerror()
+#include <stdint.h>         // provides uint64_t
+#include <errno.h>          // provides errno
+#include "client_parser.h"
+#ifndef FUZZ_LIBFUZZER
+#include <unistd.h>         // provides getopt()
+#include "pcap_reader.h"    // provides pcap_read()
+#endif
+
+// --------------------------------------------------------------- defines --
+/** @brief CHECK aborts with the position if the condition does not hold */
+#define CHECK(condition) do { if (!(condition)) { \
+    fprintf(stderr, "[%s, %s, %d]: invariant violated: %s\n", __FILE__, __func__, __LINE__, #condition); \
+    abort(); } } while (0)
+/** @brief largest seed which is cut at every position, longer ones at some */
+#define FUZZ_ALLSPLITS (16 * 1024)
+/** @brief cut positions of a longer seed */
+#define FUZZ_SPLITS 1024
+/** @brief default number of mutations of every seed */
+#define FUZZ_MUTATIONS 2000
+/** @brief FNV-1a offset basis and prime of the hash over the results */
+#define HASH_BASIS 14695981039346656037ull
+#define HASH_PRIME 1099511628211ull
+
+// -------------------------------------------------------------- typedefs --
+/** @brief How the input is cut into chunks */
+enum chunkMode {
+    CHUNK_WHOLE,                /**< One chunk */
+    CHUNK_SPLIT,                /**< Two chunks, cut at parameter */
+    CHUNK_STEP,                 /**< Chunks of parameter bytes */
+    CHUNK_RANDOM                /**< Chunks of 1 to 64 bytes, parameter is the random seed */
+};
+
+/** @brief Result of parsing an input, independent of the chunks */
+typedef struct parseResult {
+    enum parserEvent last;      /**< PARSER_END, PARSER_ERROR, or PARSER_MORE if the input ended */
+    int status;                 /**< Value of the status line, -1 if none */
+    size_t files;               /**< Number of files */
+    uint64_t contents;          /**< Bytes of file contents */
+    uint64_t hash;              /**< Hash over the status, names, lengths and contents */
+    uint64_t consumed;          /**< Bytes consumed by the parser */
+    int complete;               /**< parser_complete() at the end */
+} parseResult;
+
+// ------------------------------------------------------------- functions --
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+static void parseInput(const uint8_t* input, size_t size, enum chunkMode mode, uint64_t parameter,
+                       parseResult* result);
+static size_t feedChunk(responseParser* parser, const char* chunk, size_t size, parseResult* result);
+static void compareResults(const parseResult* expected, const parseResult* actual, const char* mode,
+                           uint64_t parameter);
+static uint64_t hashBytes(uint64_t hash, const void* bytes, size_t length);
+static uint64_t nextRandom(uint64_t* state);
+
+/**
+ * @brief the fuzz target: parses the input with different chunks and compares the results
+ * @param data const uint8_t*: the input, a response
+ * @param size size_t: length of the input
+ * @return int: 0
+ */
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    parseResult whole, other;
+    parseInput(data, size, CHUNK_WHOLE, 0, &whole);
+    if (size <= FUZZ_ALLSPLITS) {
+        parseInput(data, size, CHUNK_STEP, 1, &other);
+        compareResults(&whole, &other, "byte by byte", 1);
+    }
+    uint64_t step = (size > 0) ? (uint64_t) data[0] % 64 + 2 : 2;
+    parseInput(data, size, CHUNK_STEP, step, &other);
+    compareResults(&whole, &other, "step", step);
+    uint64_t seed = hashBytes(HASH_BASIS, data, size < 16 ? size : 16);
+    parseInput(data, size, CHUNK_RANDOM, seed, &other);
+    compareResults(&whole, &other, "random", seed);
+    return 0;
+}
+
+/**
+ * @brief parses an input in chunks
+ * @param input const uint8_t*: the input
+ * @param size size_t: length of the input
+ * @param mode enum chunkMode: how the input is cut
+ * @param parameter uint64_t: cut position, chunk size or random seed
+ * @param result parseResult*: the result
+ */
+static void parseInput(const uint8_t* input, size_t size, enum chunkMode mode, uint64_t parameter,
+                       parseResult* result) {
+    responseParser parser;
+    parser_init(&parser);
+    memset(result, 0, sizeof(*result));
+    result->status = -1;
+    result->hash = HASH_BASIS;
+    result->last = PARSER_MORE;
+    size_t position = 0;
+    uint64_t random = parameter | 1;
+    while ((position < size) && (result->last == PARSER_MORE)) {
+        size_t chunk = size - position;
+        if ((mode == CHUNK_SPLIT) && (position < parameter)) {
+            chunk = (size_t) parameter - position;
+        } else if (mode == CHUNK_STEP) {
+            chunk = (parameter < chunk) ? (size_t) parameter : chunk;
+        } else if (mode == CHUNK_RANDOM) {
+            size_t random64 = (size_t) (nextRandom(&random) % 64) + 1;
+            chunk = (random64 < chunk) ? random64 : chunk;
+        }
+        // a buffer of exactly the chunk, the address sanitizer finds every read behind it
+        char* buffer = malloc(chunk);
+        CHECK(buffer != NULL);
+        memcpy(buffer, input + position, chunk);
+        size_t used = feedChunk(&parser, buffer, chunk, result);
+        free(buffer);
+        CHECK(used <= chunk);
+        CHECK((used == chunk) || (result->last != PARSER_MORE));
+        position += used;
+    }
+    if (result->last == PARSER_MORE) {
+        // the input ended where the next chunk would start, a framed response may end exactly here
+        const char* empty = "";
+        feedChunk(&parser, empty, 0, result);
+    }
+    CHECK(parser.consumed == position);
+    result->consumed = parser.consumed;
+    result->complete = parser_complete(&parser);
+    CHECK((result->last != PARSER_END) || result->complete);
+}
+
+/**
+ * @brief gives a chunk to the parser until it is consumed, checks every event
+ * @param parser responseParser*: the parser
+ * @param chunk const char*: the chunk
+ * @param size size_t: length of the chunk
+ * @param result parseResult*: the result, last is set to PARSER_END or PARSER_ERROR at the end of the response
+ * @return size_t: bytes consumed
+ */
+static size_t feedChunk(responseParser* parser, const char* chunk, size_t size, parseResult* result) {
+    const char* data = chunk;
+    size_t length = size;
+    while (1) {
+        uint64_t consumed = parser->consumed;
+        uint64_t remaining = parser->remaining;
+        const char* before = data;
+        parserView view;
+        enum parserEvent event = parser_next(parser, &data, &length, &view);
+        CHECK((data >= before) && (data + length == chunk + size));
+        CHECK(parser->consumed - consumed == (uint64_t) (data - before));
+        CHECK(!parser->framed || (parser->consumed <= parser->frameEnd));
+        switch (event) {
+            case PARSER_MORE:
+                CHECK(length == 0);
+                return size;
+            case PARSER_FRAME:
+                CHECK(parser->framed && (parser->frameEnd - parser->consumed == parser->frameLength));
+                result->hash = hashBytes(result->hash, &parser->frameLength, sizeof(parser->frameLength));
+                break;
+            case PARSER_STATUS:
+                CHECK((parser->status >= 0) && (result->status == -1));
+                result->status = parser->status;
+                result->hash = hashBytes(result->hash, &parser->status, sizeof(parser->status));
+                break;
+            case PARSER_FILE:
+                CHECK((view.data == parser->name) && (view.length == strlen(parser->name)));
+                CHECK((view.length > 0) && (view.length <= PARSER_MAXNAME));
+                CHECK(memchr(view.data, '/', view.length) == NULL);
+                CHECK((strcmp(view.data, ".") != 0) && (strcmp(view.data, "..") != 0));
+                CHECK(!parser->framed || (parser->remaining <= parser->frameEnd - parser->consumed));
+                result->files++;
+                result->hash = hashBytes(result->hash, view.data, view.length + 1);
+                result->hash = hashBytes(result->hash, &parser->remaining, sizeof(parser->remaining));
+                break;
+            case PARSER_CONTENT:
+                CHECK((view.data == before) && (view.length > 0) && (view.length == (size_t) (data - before)));
+                CHECK(view.length <= remaining);
+                CHECK(parser->remaining == remaining - view.length);
+                result->contents += view.length;
+                result->hash = hashBytes(result->hash, view.data, view.length);
+                break;
+            case PARSER_END:
+                CHECK(parser->framed && (parser->consumed == parser->frameEnd));
+                result->last = PARSER_END;
+                return (size_t) (data - chunk);
+            case PARSER_ERROR:
+                CHECK(parser->error != NULL);
+                CHECK(parser_next(parser, &data, &length, &view) == PARSER_ERROR);
+                result->last = PARSER_ERROR;
+                return (size_t) (data - chunk);
+        }
+    }
+}
+
+/**
+ * @brief aborts if two results of the same input differ, after a protocol error the consumed bytes may differ: a
+ * line which is too long is found as soon as the chunks hold too many bytes of it
+ * @param expected const parseResult*: result of parsing the input as a whole
+ * @param actual const parseResult*: result of parsing the input in chunks
+ * @param mode const char*: name of the chunks for the message
+ * @param parameter uint64_t: parameter of the chunks for the message
+ */
+static void compareResults(const parseResult* expected, const parseResult* actual, const char* mode,
+                           uint64_t parameter) {
+    if ((expected->last != actual->last) || (expected->status != actual->status) ||
+        (expected->files != actual->files) || (expected->contents != actual->contents) ||
+        (expected->hash != actual->hash) || (expected->complete != actual->complete) ||
+        ((expected->consumed != actual->consumed) && (expected->last != PARSER_ERROR))) {
+        fprintf(stderr, "Results differ in chunks %s %llu: end %d/%d, status %d/%d, files %zu/%zu, "
+                "consumed %llu/%llu\n", mode, (unsigned long long) parameter, expected->last, actual->last,
+                expected->status, actual->status, expected->files, actual->files,
+                (unsigned long long) expected->consumed, (unsigned long long) actual->consumed);
+        abort();
+    }
+}
+
+/**
+ * @brief FNV-1a hash
+ * @param hash uint64_t: the hash so far
+ * @param bytes const void*: bytes to add
+ * @param length size_t: number of bytes
+ * @return uint64_t: the hash
+ */
+static uint64_t hashBytes(uint64_t hash, const void* bytes, size_t length) {
+    const unsigned char* byte = bytes;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ byte[i]) * HASH_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief xorshift64 random numbers, the same seed gives the same numbers on every run
+ * @param state uint64_t*: state, not 0
+ * @return uint64_t: the next number
+ */
+static uint64_t nextRandom(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+#ifndef FUZZ_LIBFUZZER
+// ------------------------------------------------------------- standalone driver --
+/** @brief statistics of a run of the driver */
+typedef struct fuzzStatistics {
+    size_t seeds;               /**< Seeds checked */
+    size_t inputs;              /**< Inputs given to the fuzz target */
+    size_t complete;            /**< Inputs parsed to a complete response */
+    size_t errors;              /**< Inputs with a protocol error */
+    size_t incomplete;          /**< Inputs which ended inside a response */
+} fuzzStatistics;
+
+static void checkSeed(const uint8_t* seed, size_t size, size_t mutations, uint64_t* random,
+                      fuzzStatistics* statistics);
+static size_t mutate(uint8_t* input, size_t size, size_t capacity, uint64_t* random);
+static int writeCorpus(const char* directory, size_t number, const uint8_t* seed, size_t size);
+static void usage(const char* programName);
+
+/**
+ * @brief reads the captures or raw responses given as arguments and fuzzes the parser with their responses
+ * @param argc int: number of arguments
+ * @param argv char**: arguments, see usage()
+ * @return int: 0 if no invariant was violated, the program aborts otherwise
+ */
+int main(int argc, char** argv) {
+    size_t mutations = FUZZ_MUTATIONS;
+    const char* corpus = NULL;
+    uint64_t random = 0x2545f4914f6cdd1dull;
+    int option;
+    while ((option = getopt(argc, argv, "n:c:s:h")) != -1) {
+        switch (option) {
+            case 'n':
+                mutations = strtoul(optarg, NULL, 10);
+                break;
+            case 'c':
+                corpus = optarg;
+                break;
+            case 's':
+                random = strtoull(optarg, NULL, 10) | 1;
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if (optind == argc) {
+        usage(argv[0]);
+    }
+    fuzzStatistics statistics;
+    memset(&statistics, 0, sizeof(statistics));
+    for (int i = optind; i < argc; i++) {
+        pcapCapture capture;
+        if (pcap_read(argv[i], &capture) == -1) {
+            pcap_free(&capture);
+            if (errno != EINVAL) {
+                fprintf(stderr, "%s: %s: %s\n", argv[0], argv[i], strerror(errno));
+                return EXIT_FAILURE;
+            }
+            // no capture, the file is one response, like the files of a corpus
+            FILE* file = fopen(argv[i], "rb");
+            static uint8_t raw[1024 * 1024];
+            size_t size = (file != NULL) ? fread(raw, 1, sizeof(raw), file) : 0;
+            if (file != NULL) {
+                fclose(file);
+            }
+            fprintf(stdout, "%s: raw response of %zu bytes\n", argv[i], size);
+            checkSeed(raw, size, mutations, &random, &statistics);
+            continue;
+        }
+        size_t responses = 0;
+        for (size_t s = 0; s < capture.count; s++) {
+            pcapData* response = &capture.streams[s].response;
+            if (response->length == 0) {
+                continue;       // refused or unanswered
+            }
+            // the response as on a single connection, framed, and twice framed like pipelined answers
+            char line[32];
+            int lineLength = snprintf(line, sizeof(line), "response=%zu\n", response->length);
+            size_t framedSize = 2 * ((size_t) lineLength + response->length);
+            uint8_t* framed = malloc(framedSize);
+            if (framed == NULL) {
+                fprintf(stderr, "%s: %s\n", argv[0], strerror(errno));
+                return EXIT_FAILURE;
+            }
+            for (int copy = 0; copy < 2; copy++) {
+                uint8_t* frame = framed + copy * (framedSize / 2);
+                memcpy(frame, line, (size_t) lineLength);
+                memcpy(frame + lineLength, response->data, response->length);
+            }
+            if (corpus != NULL) {
+                if ((writeCorpus(corpus, statistics.seeds, response->data, response->length) == -1) ||
+                    (writeCorpus(corpus, statistics.seeds + 1, framed, framedSize / 2) == -1)) {
+                    fprintf(stderr, "%s: %s: %s\n", argv[0], corpus, strerror(errno));
+                    return EXIT_FAILURE;
+                }
+            }
+            parseResult result;
+            parseInput(response->data, response->length, CHUNK_WHOLE, 0, &result);
+            fprintf(stdout, "%s: connection %zu, port %u: %zu bytes, status %d, %zu files%s\n", argv[i], s,
+                    capture.streams[s].clientPort, response->length, result.status, result.files,
+                    (result.last == PARSER_MORE) && result.complete ? "" : ", not a complete response");
+            checkSeed(response->data, response->length, mutations, &random, &statistics);
+            checkSeed(framed, framedSize, mutations, &random, &statistics);
+            free(framed);
+            responses++;
+        }
+        fprintf(stdout, "%s: %zu packets, %zu connections, %zu responses\n", argv[i], capture.packets,
+                capture.count, responses);
+        pcap_free(&capture);
+    }
+    fprintf(stdout, "%zu seeds, %zu inputs: %zu complete, %zu protocol errors, %zu incomplete, no violations\n",
+            statistics.seeds, statistics.inputs, statistics.complete, statistics.errors, statistics.incomplete);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief checks a seed cut at every position (or at many for long seeds), then mutations of it
+ * @param seed const uint8_t*: the seed
+ * @param size size_t: length of the seed
+ * @param mutations size_t: number of mutations
+ * @param random uint64_t*: state of the random numbers
+ * @param statistics fuzzStatistics*: statistics of the run
+ */
+static void checkSeed(const uint8_t* seed, size_t size, size_t mutations, uint64_t* random,
+                      fuzzStatistics* statistics) {
+    parseResult whole, split;
+    parseInput(seed, size, CHUNK_WHOLE, 0, &whole);
+    size_t stride = (size <= FUZZ_ALLSPLITS) ? 1 : size / FUZZ_SPLITS;
+    for (size_t cut = 1; cut < size; cut += stride) {
+        parseInput(seed, size, CHUNK_SPLIT, cut, &split);
+        compareResults(&whole, &split, "split", cut);
+    }
+    statistics->seeds++;
+    size_t capacity = 2 * size + 64;
+    uint8_t* input = malloc(capacity);
+    CHECK(input != NULL);
+    for (size_t i = 0; i <= mutations; i++) {
+        size_t length = size;
+        memcpy(input, seed, size);
+        if (i > 0) {
+            length = mutate(input, size, capacity, random);
+        }
+        LLVMFuzzerTestOneInput(input, length);
+        parseInput(input, length, CHUNK_WHOLE, 0, &whole);
+        statistics->inputs++;
+        if (whole.last == PARSER_ERROR) {
+            statistics->errors++;
+        } else if ((whole.last == PARSER_END) || whole.complete) {
+            statistics->complete++;
+        } else {
+            statistics->incomplete++;
+        }
+    }
+    free(input);
+}
+
+/**
+ * @brief changes an input by one to four random edits, aimed at the header lines
+ * @param input uint8_t*: the input, changed in place
+ * @param size size_t: length of the input
+ * @param capacity size_t: size of the buffer of the input
+ * @param random uint64_t*: state of the random numbers
+ * @return size_t: new length of the input
+ */
+static size_t mutate(uint8_t* input, size_t size, size_t capacity, uint64_t* random) {
+    static const char interesting[] = "\n=/.0123456789";
+    static const char* const tokens[] = {"status=", "file=", "len=", "response=", "\n", "..", "/",
+                                         "18446744073709551616", "9223372036854775807", "-1", "00"};
+    int edits = (int) (nextRandom(random) % 4) + 1;
+    for (int e = 0; e < edits; e++) {
+        size_t position = (size > 0) ? (size_t) (nextRandom(random) % size) : 0;
+        switch (nextRandom(random) % 6) {
+            case 0:         // a random byte
+                if (size > 0) {
+                    input[position] = (uint8_t) nextRandom(random);
+                }
+                break;
+            case 1:         // a byte of the syntax
+                if (size > 0) {
+                    input[position] = (uint8_t) interesting[nextRandom(random) % (sizeof(interesting) - 1)];
+                }
+                break;
+            case 2: {       // remove bytes
+                size_t count = (size_t) (nextRandom(random) % 16) + 1;
+                count = (position + count > size) ? size - position : count;
+                memmove(input + position, input + position + count, size - position - count);
+                size -= count;
+                break;
+            }
+            case 3: {       // insert a token
+                const char* token = tokens[nextRandom(random) % (sizeof(tokens) / sizeof(tokens[0]))];
+                size_t count = strlen(token);
+                if (size + count <= capacity) {
+                    memmove(input + position + count, input + position, size - position);
+                    memcpy(input + position, token, count);
+                    size += count;
+                }
+                break;
+            }
+            case 4: {       // repeat bytes
+                size_t count = (size_t) (nextRandom(random) % 32) + 1;
+                count = (position + count > size) ? size - position : count;
+                if (size + count <= capacity) {
+                    memmove(input + position + count, input + position, size - position);
+                    size += count;
+                }
+                break;
+            }
+            default:        // cut the input off
+                size = position;
+                break;
+        }
+    }
+    return size;
+}
+
+/**
+ * @brief writes a seed into a file of the corpus directory
+ * @param directory const char*: the corpus directory
+ * @param number size_t: number of the seed
+ * @param seed const uint8_t*: the seed
+ * @param size size_t: length of the seed
+ * @return int: 0 in case of success, -1 in case of an error
+ */
+static int writeCorpus(const char* directory, size_t number, const uint8_t* seed, size_t size) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/seed-%04zu", directory, number);
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+    size_t written = fwrite(seed, 1, size, file);
+    if ((fclose(file) != 0) || (written != size)) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief prints the usage and exits
+ * @param programName const char*: name of the program
+ */
+static void usage(const char* programName) {
+    fprintf(stderr, "usage: %s [-n mutations] [-s seed] [-c corpus directory] capture or response...\n"
+            "\t-n <n>\t mutations of every seed [default: %d]\n"
+            "\t-s <n>\t seed of the random numbers\n"
+            "\t-c <dir>\t write the responses of the captures into the directory, as corpus for libFuzzer\n",
+            programName, FUZZ_MUTATIONS);
+    exit(EXIT_FAILURE);
+}
+#endif // FUZZ_LIBFUZZER
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
@@ -0,0 +1,424 @@
+/**
+ * @file client_writer.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 17.12.18
+ *
+ * @brief Writer threads of the client.
+ * The receive loop copies the file contents into buffers of a fixed pool and queues them, the writer threads
+ * create, write and close the files, so the socket is drained while the disk is busy. All jobs of a file go to
+ * one writer in order, the next file goes to the writer with the shortest queue, so the files of a response are
+ * written in parallel. Only when every buffer is queued the receive loop waits for a writer, the memory stays
+ * bounded. The buffers are aligned and every buffer but the last of a file is full, so the files can be written
+ * with O_DIRECT; the last part of a file is written through the page cache.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#define _GNU_SOURCE         // provides O_DIRECT, fallocate()
+#include <stdlib.h>         // provides posix_memalign(), calloc(), free()
+#include <string.h>         // provides memcpy(), memset(), strlen()
+#include <errno.h>          // provides errno
+#include <fcntl.h>          // provides open(), fcntl(), fallocate()
+#include <unistd.h>         // provides pwrite(), fsync(), close()
+#include "client_writer.h"
+
+// ------------------------------------------------------------- functions --
+static void* writeLoop(void* argument);
+static int runJob(const writerPool* pool, const writerBuffer* job, int* fd, int* direct);
+static writerBuffer* acquire(writerPool* pool);
+static int submit(writerPool* pool, writerThread* writer, writerBuffer* buffer);
+static int failed(writerPool* pool);
+
+/**
+ * @brief allocates the buffers and starts the writers
+ * @param pool writerPool*: the pool
+ * @param writers int: number of writers, 1..WRITER_MAXTHREADS
+ * @param policy enum writerPolicy: how the files are written
+ * @return int: 0 in case of success, -1 if the pool could not be started (errno is set)
+ */
+int writer_start(writerPool* pool, int writers, enum writerPolicy policy) {
+    memset(pool, 0, sizeof(*pool));
+    pool->policy = policy;
+    void* memory = NULL;
+    int status = posix_memalign(&memory, WRITER_ALIGNMENT, (size_t) WRITER_BUFFERS * WRITER_BUFFERSIZE);
+    if (status != 0) {
+        errno = status;
+        return -1;
+    }
+    pool->memory = memory;
+    pool->writers = calloc((size_t) writers, sizeof(writerThread));
+    if (pool->writers == NULL) {
+        free(pool->memory);
+        return -1;
+    }
+    for (int i = 0; i < WRITER_BUFFERS; i++) {
+        pool->buffers[i].data = pool->memory + (size_t) i * WRITER_BUFFERSIZE;
+        pool->buffers[i].next = pool->free;
+        pool->free = &pool->buffers[i];
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->released, NULL);
+    for (int i = 0; i < writers; i++) {
+        writerThread* writer = &pool->writers[i];
+        writer->pool = pool;
+        pthread_cond_init(&writer->queued, NULL);
+        status = pthread_create(&writer->thread, NULL, writeLoop, writer);
+        if (status != 0) {
+            pthread_cond_destroy(&writer->queued);
+            writer_stop(pool);
+            errno = status;
+            return -1;
+        }
+        pool->count++;
+    }
+    return 0;
+}
+
+/**
+ * @brief queues the creation of the next file, the contents follow with writer_append() or
+ * writer_space()/writer_commit(), the file ends with writer_close()
+ * @param pool writerPool*: the pool, no file is open
+ * @param name const char*: name of the file, shorter than WRITER_BUFFERSIZE
+ * @param length uint64_t: length announced by the server, the file is allocated before it is written
+ * @return int: 0 in case of success, -1 if a writer failed before (errno is set)
+ */
+int writer_open(writerPool* pool, const char* name, uint64_t length) {
+    writerBuffer* buffer = acquire(pool);
+    if (buffer == NULL) {
+        return -1;
+    }
+    buffer->type = WRITER_OPEN;
+    buffer->length = strlen(name) + 1;
+    memcpy(buffer->data, name, buffer->length);
+    buffer->offset = length;
+    // the file goes to the writer with the least work
+    pthread_mutex_lock(&pool->lock);
+    writerThread* writer = &pool->writers[0];
+    for (int i = 1; i < pool->count; i++) {
+        if (pool->writers[i].jobs < writer->jobs) {
+            writer = &pool->writers[i];
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    pool->current = writer;
+    pool->offset = 0;
+    return submit(pool, writer, buffer);
+}
+
+/**
+ * @brief returns the free space of the buffer being filled, a buffer is taken from the pool if none is filled
+ * @param pool writerPool*: the pool, a file is open
+ * @param room size_t*: free bytes at the returned pointer
+ * @return char*: where the next bytes of the file are received to, NULL if a writer failed (errno is set)
+ */
+char* writer_space(writerPool* pool, size_t* room) {
+    if (pool->filling == NULL) {
+        pool->filling = acquire(pool);
+        if (pool->filling == NULL) {
+            return NULL;
+        }
+        pool->filling->type = WRITER_DATA;
+        pool->filling->length = 0;
+        pool->filling->offset = pool->offset;
+    }
+    *room = WRITER_BUFFERSIZE - pool->filling->length;
+    return pool->filling->data + pool->filling->length;
+}
+
+/**
+ * @brief adds received bytes to the buffer being filled, a full buffer is queued to the writer of the file
+ * @param pool writerPool*: the pool
+ * @param length size_t: bytes received into the space of writer_space()
+ * @return int: 0 in case of success, -1 if a writer failed (errno is set)
+ */
+int writer_commit(writerPool* pool, size_t length) {
+    pool->filling->length += length;
+    if (pool->filling->length < WRITER_BUFFERSIZE) {
+        return failed(pool);
+    }
+    writerBuffer* full = pool->filling;
+    pool->filling = NULL;
+    pool->offset += full->length;
+    return submit(pool, pool->current, full);
+}
+
+/**
+ * @brief adds contents of the open file
+ * @param pool writerPool*: the pool
+ * @param data const char*: the contents
+ * @param length size_t: bytes at data
+ * @return int: 0 in case of success, -1 if a writer failed (errno is set)
+ */
+int writer_append(writerPool* pool, const char* data, size_t length) {
+    while (length > 0) {
+        size_t room;
+        char* space = writer_space(pool, &room);
+        if (space == NULL) {
+            return -1;
+        }
+        size_t part = (length < room) ? length : room;
+        memcpy(space, data, part);
+        data += part;
+        length -= part;
+        if (writer_commit(pool, part) == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief queues the rest of the contents and the closing of the open file
+ * @param pool writerPool*: the pool
+ * @return int: 0 in case of success, -1 if a writer failed (errno is set)
+ */
+int writer_close(writerPool* pool) {
+    if (pool->current == NULL) {
+        return failed(pool);
+    }
+    writerThread* writer = pool->current;
+    pool->current = NULL;
+    if (pool->filling != NULL) {
+        writerBuffer* rest = pool->filling;
+        pool->filling = NULL;
+        if (rest->length > 0) {
+            if (submit(pool, writer, rest) == -1) {
+                return -1;
+            }
+        } else {
+            pthread_mutex_lock(&pool->lock);
+            rest->next = pool->free;
+            pool->free = rest;
+            pthread_mutex_unlock(&pool->lock);
+        }
+    }
+    writerBuffer* buffer = acquire(pool);
+    if (buffer == NULL) {
+        return -1;
+    }
+    buffer->type = WRITER_CLOSE;
+    buffer->length = 0;
+    return submit(pool, writer, buffer);
+}
+
+/**
+ * @brief waits until every queued job is done, stops the writers and releases the pool
+ * @param pool writerPool*: the pool
+ * @return int: 0 if every file was written, -1 if a writer failed (errno is set)
+ */
+int writer_stop(writerPool* pool) {
+    if (pool->current != NULL) {
+        writer_close(pool);
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    for (int i = 0; i < pool->count; i++) {
+        pthread_cond_signal(&pool->writers[i].queued);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->count; i++) {
+        pthread_join(pool->writers[i].thread, NULL);
+        pthread_cond_destroy(&pool->writers[i].queued);
+    }
+    pthread_cond_destroy(&pool->released);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->writers);
+    free(pool->memory);
+    pool->writers = NULL;
+    pool->memory = NULL;
+    pool->count = 0;
+    if (pool->error != 0) {
+        errno = pool->error;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief loop of a writer thread, runs the jobs of its queue until the pool stops and the queue is empty. After
+ * a failure of any writer the jobs are dropped, the client gives up anyway.
+ * @param argument void*: the writerThread
+ * @return void*: NULL
+ */
+static void* writeLoop(void* argument) {
+    writerThread* writer = argument;
+    writerPool* pool = writer->pool;
+    int fd = -1;
+    int direct = 0;
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while ((writer->head == NULL) && (pool->stopping == 0)) {
+            pthread_cond_wait(&writer->queued, &pool->lock);
+        }
+        writerBuffer* job = writer->head;
+        if (job == NULL) {
+            break;
+        }
+        writer->head = job->next;
+        if (writer->head == NULL) {
+            writer->tail = NULL;
+        }
+        int dropped = (pool->error != 0);
+        pthread_mutex_unlock(&pool->lock);
+
+        int error = dropped ? 0 : runJob(pool, job, &fd, &direct);
+
+        pthread_mutex_lock(&pool->lock);
+        if ((error != 0) && (pool->error == 0)) {
+            pool->error = error;
+        }
+        job->next = pool->free;
+        pool->free = job;
+        writer->jobs--;
+        pthread_cond_broadcast(&pool->released);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (fd != -1) {
+        close(fd);
+    }
+    return NULL;
+}
+
+/**
+ * @brief runs a job on the file of the writer
+ * @param pool const writerPool*: the pool
+ * @param job const writerBuffer*: the job
+ * @param fd int*: the open file of the writer, -1 if none
+ * @param direct int*: 1 while the file is written with O_DIRECT
+ * @return int: 0 in case of success, the errno of the failure otherwise
+ */
+static int runJob(const writerPool* pool, const writerBuffer* job, int* fd, int* direct) {
+    switch (job->type) {
+        case WRITER_OPEN:
+            *direct = (pool->policy == WRITER_DIRECT);
+            *fd = open(job->data, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | (*direct ? O_DIRECT : 0), 0666);
+            if ((*fd == -1) && *direct && (errno == EINVAL)) {
+                // the file system does not support O_DIRECT
+                *direct = 0;
+                *fd = open(job->data, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+            }
+            if (*fd == -1) {
+                return errno;
+            }
+            // large files are allocated at once, a full disk fails before the contents are written
+            if ((job->offset >= WRITER_BUFFERSIZE) &&
+                (fallocate(*fd, FALLOC_FL_KEEP_SIZE, 0, (off_t) job->offset) == -1) &&
+                ((errno == ENOSPC) || (errno == EFBIG))) {
+                return errno;
+            }
+            return 0;
+        case WRITER_DATA: {
+            const char* data = job->data;
+            size_t length = job->length;
+            off_t offset = (off_t) job->offset;
+            while (length > 0) {
+                // O_DIRECT needs aligned lengths, the last part of a file is written through the page cache
+                if (*direct && ((length % WRITER_ALIGNMENT) != 0)) {
+                    *direct = 0;
+                    fcntl(*fd, F_SETFL, fcntl(*fd, F_GETFL) & ~O_DIRECT);
+                }
+                ssize_t written = pwrite(*fd, data, length, offset);
+                if (written == -1) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    if (*direct && (errno == EINVAL)) {
+                        *direct = 0;
+                        fcntl(*fd, F_SETFL, fcntl(*fd, F_GETFL) & ~O_DIRECT);
+                        continue;
+                    }
+                    return errno;
+                }
+                data += written;
+                length -= (size_t) written;
+                offset += written;
+            }
+            return 0;
+        }
+        case WRITER_CLOSE: {
+            int error = 0;
+            if ((pool->policy == WRITER_FSYNC) && (fsync(*fd) == -1)) {
+                error = errno;
+            }
+            if ((close(*fd) == -1) && (error == 0)) {
+                error = errno;
+            }
+            *fd = -1;
+            return error;
+        }
+    }
+    return EINVAL;
+}
+
+/**
+ * @brief takes a free buffer, waits for a writer if every buffer is queued
+ * @param pool writerPool*: the pool
+ * @return writerBuffer*: the buffer, NULL if a writer failed (errno is set)
+ */
+static writerBuffer* acquire(writerPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    while ((pool->free == NULL) && (pool->error == 0)) {
+        pthread_cond_wait(&pool->released, &pool->lock);
+    }
+    writerBuffer* buffer = NULL;
+    if (pool->error != 0) {
+        errno = pool->error;
+    } else {
+        buffer = pool->free;
+        pool->free = buffer->next;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return buffer;
+}
+
+/**
+ * @brief queues a job to a writer
+ * @param pool writerPool*: the pool
+ * @param writer writerThread*: the writer of the file
+ * @param buffer writerBuffer*: the job
+ * @return int: 0 in case of success, -1 if a writer failed (errno is set), the job is queued anyway
+ */
+static int submit(writerPool* pool, writerThread* writer, writerBuffer* buffer) {
+    pthread_mutex_lock(&pool->lock);
+    buffer->next = NULL;
+    if (writer->tail == NULL) {
+        writer->head = buffer;
+    } else {
+        writer->tail->next = buffer;
+    }
+    writer->tail = buffer;
+    writer->jobs++;
+    pthread_cond_signal(&writer->queued);
+    int error = pool->error;
+    pthread_mutex_unlock(&pool->lock);
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief checks if a writer failed
+ * @param pool writerPool*: the pool
+ * @return int: 0 if not, -1 if a writer failed (errno is set)
+ */
+static int failed(writerPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    int error = pool->error;
+    pthread_mutex_unlock(&pool->lock);
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
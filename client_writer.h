@@ -0,0 +1,87 @@
+/**
+ * @file client_writer.h
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 17.12.18
+ *
+ * @brief Writer threads of the client, the received files are written to the disk beside the receive loop
+ * TCP/IP Lecture Distributed Systems
+ */
+#ifndef CLIENT_WRITER_H
+#define CLIENT_WRITER_H
+
+#include <stddef.h>         // provides size_t
+#include <stdint.h>         // provides uint64_t
+#include <pthread.h>        // provides pthread_t, pthread_mutex_t
+
+// --------------------------------------------------------------- defines --
+/** @brief maximal number of writer threads */
+#define WRITER_MAXTHREADS 16
+/** @brief buffers of the pool, they bound the memory of the received but not written contents */
+#define WRITER_BUFFERS 32
+/** @brief size of a buffer, a multiple of WRITER_ALIGNMENT */
+#define WRITER_BUFFERSIZE (256 * 1024)
+/** @brief alignment of the buffers and offsets for O_DIRECT */
+#define WRITER_ALIGNMENT 4096
+
+// -------------------------------------------------------------- typedefs --
+/** @brief How the files reach the disk */
+enum writerPolicy {
+    WRITER_BUFFERED,            /**< Through the page cache, written back by the kernel */
+    WRITER_FSYNC,               /**< Through the page cache, fsync() before the file is closed */
+    WRITER_DIRECT               /**< O_DIRECT past the page cache, buffered if the file system refuses it */
+};
+
+/** @brief Kind of a job of a writer */
+enum writerJobType {
+    WRITER_OPEN,                /**< Create the file, the buffer holds the terminated name */
+    WRITER_DATA,                /**< Write the buffer at offset */
+    WRITER_CLOSE                /**< Close the file */
+};
+
+/** @brief A buffer of the pool, queued to a writer as a job */
+typedef struct writerBuffer {
+    struct writerBuffer* next;  /**< Next free buffer or next job of the queue */
+    enum writerJobType type;    /**< The job */
+    char* data;                 /**< WRITER_BUFFERSIZE bytes, aligned */
+    size_t length;              /**< Bytes in data */
+    uint64_t offset;            /**< Position in the file of WRITER_DATA, length of the file for WRITER_OPEN */
+} writerBuffer;
+
+/** @brief One writer thread with its queue, all jobs of a file go to the same writer in order */
+typedef struct writerThread {
+    pthread_t thread;           /**< The thread */
+    pthread_cond_t queued;      /**< Signaled when a job is queued */
+    writerBuffer* head;         /**< First job */
+    writerBuffer* tail;         /**< Last job */
+    int jobs;                   /**< Jobs in the queue and in progress */
+    struct writerPool* pool;    /**< The pool */
+} writerThread;
+
+/** @brief The pool of buffers and writers */
+typedef struct writerPool {
+    pthread_mutex_t lock;       /**< Protects the queues, the free buffers, error and stopping */
+    pthread_cond_t released;    /**< Signaled when a buffer is free or a job is done */
+    writerThread* writers;      /**< The writers */
+    int count;                  /**< Number of writers */
+    enum writerPolicy policy;   /**< How the files are written */
+    char* memory;               /**< Memory of all buffers */
+    writerBuffer buffers[WRITER_BUFFERS];   /**< The buffers */
+    writerBuffer* free;         /**< Free buffers */
+    int error;                  /**< errno of the first failure, 0 if none */
+    int stopping;               /**< 1 when the writers shall end */
+    writerThread* current;      /**< Writer of the file being received, NULL if none */
+    writerBuffer* filling;      /**< Buffer being filled with the received contents, NULL if none */
+    uint64_t offset;            /**< Position in the file of the buffer being filled */
+} writerPool;
+
+// ------------------------------------------------------------- functions --
+int writer_start(writerPool* pool, int writers, enum writerPolicy policy);
+int writer_open(writerPool* pool, const char* name, uint64_t length);
+char* writer_space(writerPool* pool, size_t* room);
+int writer_commit(writerPool* pool, size_t length);
+int writer_append(writerPool* pool, const char* data, size_t length);
+int writer_close(writerPool* pool);
+int writer_stop(writerPool* pool);
+
+#endif // CLIENT_WRITER_H
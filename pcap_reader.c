@@ -0,0 +1,517 @@
+/**
+ * @file pcap_reader.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 15.12.18
+ *
+ * @brief Reads the captured sessions of tcpDump_Protocols and reassembles their TCP streams.
+ * Two formats are read: classic pcap files in either byte order with micro or nano second time stamps, and the
+ * text output of tcpdump -X or -XX, most of the captures in tcpDump_Protocols are stored this way. Both are
+ * reduced to packets with a link layer type, IPv4 and IPv6 TCP segments are sorted into connections and every
+ * direction is put together in sequence order. The side which sends the first SYN is the client, for a
+ * connection captured without its SYN the side with the higher port is taken.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#include <stdlib.h>         // provides malloc(), realloc(), free()
+#include <stdio.h>          // provides fopen(), fread()
+#include <string.h>         // provides memcpy(), memcmp(), memset()
+#include <errno.h>          // provides errno, EINVAL
+#include <ctype.h>          // provides isxdigit(), isdigit()
+#include <sys/socket.h>     // provides AF_INET, AF_INET6
+#include "pcap_reader.h"
+
+// --------------------------------------------------------------- defines --
+/** @brief magic numbers of a pcap file, micro and nano second time stamps */
+#define PCAP_MAGIC_USEC 0xa1b2c3d4u
+#define PCAP_MAGIC_NSEC 0xa1b23c4du
+/** @brief length of the file header and the record header of a pcap file */
+#define PCAP_FILEHEADER 24
+#define PCAP_RECORDHEADER 16
+/** @brief link layer types */
+#define LINK_NULL 0
+#define LINK_ETHERNET 1
+#define LINK_RAW 101
+#define LINK_LOOP 108
+#define LINK_SLL 113
+#define LINK_SLL2 276
+/** @brief flags of the TCP header */
+#define TCP_FIN 0x01
+#define TCP_SYN 0x02
+#define TCP_RST 0x04
+#define TCP_ACK 0x10
+/** @brief maximal length of a packet of a text capture */
+#define TEXT_MAXPACKET 65536
+
+// -------------------------------------------------------------- typedefs --
+/** @brief A TCP segment of a packet */
+typedef struct pcapSegment {
+    int family;                         /**< AF_INET or AF_INET6 */
+    const unsigned char* source;        /**< Source address, 4 or 16 bytes */
+    const unsigned char* destination;   /**< Destination address */
+    uint16_t sourcePort;                /**< Source port */
+    uint16_t destinationPort;           /**< Destination port */
+    uint32_t seq;                       /**< Sequence number */
+    unsigned flags;                     /**< TCP flags */
+    const unsigned char* payload;       /**< Payload of the segment */
+    size_t length;                      /**< Bytes of payload */
+    uint64_t time;                      /**< Capture time in ns */
+} pcapSegment;
+
+// ------------------------------------------------------------- functions --
+static unsigned char* readFile(const char* path, size_t* length);
+static int readBinary(const unsigned char* file, size_t length, pcapCapture* capture);
+static int readText(const unsigned char* file, size_t length, pcapCapture* capture);
+static void addPacket(pcapCapture* capture, int linkType, const unsigned char* frame, size_t length, uint64_t time);
+static int decodeIp(const unsigned char* packet, size_t length, pcapSegment* segment);
+static int addSegment(pcapCapture* capture, const pcapSegment* segment);
+static int appendData(pcapData* data, const unsigned char* bytes, size_t length, uint64_t time);
+static uint32_t read32(const unsigned char* bytes, int swapped);
+static uint16_t big16(const unsigned char* bytes);
+static uint32_t big32(const unsigned char* bytes);
+
+/**
+ * @brief reads a capture and reassembles its TCP connections
+ * @param path const char*: pcap file or text output of tcpdump -X
+ * @param capture pcapCapture*: the connections, released with pcap_free() also in case of an error
+ * @return int: 0 in case of success, -1 in case of an error with errno set, EINVAL for an unknown format
+ */
+int pcap_read(const char* path, pcapCapture* capture) {
+    memset(capture, 0, sizeof(*capture));
+    size_t length;
+    unsigned char* file = readFile(path, &length);
+    if (file == NULL) {
+        return -1;
+    }
+    int result;
+    uint32_t magic = (length >= PCAP_FILEHEADER) ? read32(file, 0) : 0;
+    if ((magic == PCAP_MAGIC_USEC) || (magic == PCAP_MAGIC_NSEC) ||
+        (magic == __builtin_bswap32(PCAP_MAGIC_USEC)) || (magic == __builtin_bswap32(PCAP_MAGIC_NSEC))) {
+        result = readBinary(file, length, capture);
+    } else {
+        result = readText(file, length, capture);
+    }
+    free(file);
+    return result;
+}
+
+/**
+ * @brief releases the connections of a capture
+ * @param capture pcapCapture*: the capture
+ */
+void pcap_free(pcapCapture* capture) {
+    for (size_t i = 0; i < capture->count; i++) {
+        free(capture->streams[i].request.data);
+        free(capture->streams[i].response.data);
+    }
+    free(capture->streams);
+    memset(capture, 0, sizeof(*capture));
+}
+
+/**
+ * @brief reads a whole file into memory
+ * @param path const char*: the file
+ * @param length size_t*: length of the file
+ * @return unsigned char*: the contents terminated with '\0', NULL in case of an error
+ */
+static unsigned char* readFile(const char* path, size_t* length) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    size_t capacity = 64 * 1024;
+    unsigned char* contents = malloc(capacity);
+    *length = 0;
+    while (contents != NULL) {
+        *length += fread(contents + *length, 1, capacity - *length, file);
+        if (*length < capacity) {
+            break;
+        }
+        capacity *= 2;
+        unsigned char* grown = realloc(contents, capacity);
+        if (grown == NULL) {
+            free(contents);
+        }
+        contents = grown;
+    }
+    int failed = ferror(file);
+    fclose(file);
+    if (failed && (contents != NULL)) {
+        free(contents);
+        errno = EIO;
+        return NULL;
+    }
+    if (contents != NULL) {
+        contents[*length] = '\0';     // there is room, fread() stopped before the end of the buffer
+    }
+    return contents;
+}
+
+/**
+ * @brief reads the packets of a classic pcap file
+ * @param file const unsigned char*: contents of the file
+ * @param length size_t: length of the file
+ * @return int: 0 in case of success, -1 in case of an error
+ */
+static int readBinary(const unsigned char* file, size_t length, pcapCapture* capture) {
+    int swapped = (read32(file, 0) != PCAP_MAGIC_USEC) && (read32(file, 0) != PCAP_MAGIC_NSEC);
+    uint64_t fraction = (read32(file, swapped) == PCAP_MAGIC_NSEC) ? 1 : 1000;
+    int linkType = (int) (read32(file + 20, swapped) & 0x0fffffff);
+    size_t position = PCAP_FILEHEADER;
+    while (position + PCAP_RECORDHEADER <= length) {
+        const unsigned char* record = file + position;
+        uint64_t time = (uint64_t) read32(record, swapped) * 1000000000 + read32(record + 4, swapped) * fraction;
+        size_t captured = read32(record + 8, swapped);
+        position += PCAP_RECORDHEADER;
+        if (captured > length - position) {
+            break;      // the capture was cut off inside the packet
+        }
+        addPacket(capture, linkType, file + position, captured, time);
+        position += captured;
+    }
+    return 0;
+}
+
+/**
+ * @brief reads the packets of the text output of tcpdump -X (from the IP header) or -XX (from the link layer):
+ * a line with the time stamp and the description of the packet, followed by lines "0x0010:  4500 003c ...  E..<"
+ * @param file const unsigned char*: contents of the file
+ * @param length size_t: length of the file
+ * @return int: 0 in case of success, -1 in case of an error
+ */
+static int readText(const unsigned char* file, size_t length, pcapCapture* capture) {
+    unsigned char* packet = malloc(TEXT_MAXPACKET);
+    if (packet == NULL) {
+        return -1;
+    }
+    size_t packetLength = 0;
+    uint64_t time = 0;
+    int dumps = 0;
+    const unsigned char* line = file;
+    const unsigned char* end = file + length;
+    while (line < end) {
+        const unsigned char* lineEnd = memchr(line, '\n', (size_t) (end - line));
+        if (lineEnd == NULL) {
+            lineEnd = end;
+        }
+        const unsigned char* p = line;
+        while ((p < lineEnd) && ((*p == ' ') || (*p == '\t'))) {
+            p++;
+        }
+        if ((p == line) && (lineEnd > line)) {
+            // the description of the next packet, it starts with the time stamp HH:MM:SS.fraction
+            if (packetLength > 0) {
+                addPacket(capture, ((packet[0] >> 4) == 4) || ((packet[0] >> 4) == 6) ? LINK_RAW : LINK_ETHERNET,
+                          packet, packetLength, time);
+            }
+            packetLength = 0;
+            unsigned hours, minutes, seconds;
+            int used = 0;
+            time = 0;
+            if (sscanf((const char*) line, "%2u:%2u:%2u%n", &hours, &minutes, &seconds, &used) == 3) {
+                time = ((uint64_t) hours * 3600 + minutes * 60 + seconds) * 1000000000;
+                uint64_t scale = 100000000;
+                for (p = line + used + 1; (line[used] == '.') && (p < lineEnd) && isdigit(*p); p++) {
+                    time += (uint64_t) (*p - '0') * scale;
+                    scale /= 10;
+                }
+            }
+        } else if ((lineEnd - p > 2) && (p[0] == '0') && (p[1] == 'x')) {
+            // a line of the hex dump, groups of up to four digits separated by one blank, the text after two
+            p = memchr(p, ':', (size_t) (lineEnd - p));
+            if (p == NULL) {
+                line = lineEnd + 1;
+                continue;
+            }
+            p++;
+            while ((p < lineEnd) && (*p == ' ')) {
+                p++;
+            }
+            while ((p + 1 < lineEnd) && isxdigit(p[0]) && isxdigit(p[1]) && (packetLength < TEXT_MAXPACKET)) {
+                char hex[3] = {(char) p[0], (char) p[1], '\0'};
+                packet[packetLength++] = (unsigned char) strtoul(hex, NULL, 16);
+                p += 2;
+                if ((p < lineEnd) && (*p == ' ')) {
+                    if ((p + 1 >= lineEnd) || (p[1] == ' ')) {
+                        break;
+                    }
+                    p++;
+                }
+            }
+            dumps = 1;
+        }
+        line = lineEnd + 1;
+    }
+    if (packetLength > 0) {
+        addPacket(capture, ((packet[0] >> 4) == 4) || ((packet[0] >> 4) == 6) ? LINK_RAW : LINK_ETHERNET,
+                  packet, packetLength, time);
+    }
+    free(packet);
+    if (!dumps) {
+        errno = EINVAL;     // neither a pcap file nor a hex dump of tcpdump
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief removes the link layer of a packet and adds its TCP segment to the connections
+ * @param linkType int: link layer type of the capture
+ * @param frame const unsigned char*: the packet
+ * @param length size_t: captured bytes of the packet
+ * @param time uint64_t: capture time in ns
+ */
+static void addPacket(pcapCapture* capture, int linkType, const unsigned char* frame, size_t length, uint64_t time) {
+    size_t header;
+    unsigned protocol = 0;
+    capture->packets++;
+    switch (linkType) {
+        case LINK_ETHERNET:
+            header = 14;
+            if (length >= header) {
+                protocol = big16(frame + 12);
+            }
+            while ((protocol == 0x8100) && (length >= header + 4)) {
+                protocol = big16(frame + header + 2);     // VLAN tag
+                header += 4;
+            }
+            break;
+        case LINK_SLL:
+            header = 16;
+            protocol = (length >= header) ? big16(frame + 14) : 0;
+            break;
+        case LINK_SLL2:
+            header = 20;
+            protocol = (length >= header) ? big16(frame) : 0;
+            break;
+        case LINK_NULL:
+        case LINK_LOOP:
+            header = 4;
+            protocol = 0x0800;  // the address family in the byte order of the capturing host, the IP version decides
+            break;
+        case LINK_RAW:
+        default:
+            header = 0;
+            protocol = 0x0800;
+            break;
+    }
+    pcapSegment segment;
+    if ((length < header) || ((protocol != 0x0800) && (protocol != 0x86dd)) ||
+        (decodeIp(frame + header, length - header, &segment) == -1)) {
+        capture->skipped++;
+        return;
+    }
+    segment.time = time;
+    if (addSegment(capture, &segment) == -1) {
+        capture->skipped++;
+    }
+}
+
+/**
+ * @brief decodes the IP and TCP header of a packet
+ * @param packet const unsigned char*: the packet from the IP header
+ * @param length size_t: captured bytes
+ * @param segment pcapSegment*: the segment, the pointers point into the packet
+ * @return int: 0 for a TCP segment, -1 otherwise
+ */
+static int decodeIp(const unsigned char* packet, size_t length, pcapSegment* segment) {
+    size_t header;
+    if ((length >= 20) && ((packet[0] >> 4) == 4)) {
+        header = (size_t) (packet[0] & 0x0f) * 4;
+        size_t total = big16(packet + 2);
+        if ((header < 20) || (packet[9] != 6) || ((big16(packet + 6) & 0x3fff) != 0) || (total < header)) {
+            return -1;      // no TCP or a fragment
+        }
+        if (total < length) {
+            length = total;     // padding of the link layer
+        }
+        segment->family = AF_INET;
+        segment->source = packet + 12;
+        segment->destination = packet + 16;
+    } else if ((length >= 40) && ((packet[0] >> 4) == 6)) {
+        header = 40;
+        size_t total = header + big16(packet + 4);
+        if (packet[6] != 6) {
+            return -1;      // no TCP or extension headers
+        }
+        if (total < length) {
+            length = total;
+        }
+        segment->family = AF_INET6;
+        segment->source = packet + 8;
+        segment->destination = packet + 24;
+    } else {
+        return -1;
+    }
+    if (length < header + 20) {
+        return -1;
+    }
+    const unsigned char* tcp = packet + header;
+    size_t tcpHeader = (size_t) (tcp[12] >> 4) * 4;
+    if ((tcpHeader < 20) || (header + tcpHeader > length)) {
+        return -1;
+    }
+    segment->sourcePort = big16(tcp);
+    segment->destinationPort = big16(tcp + 2);
+    segment->seq = big32(tcp + 4);
+    segment->flags = tcp[13];
+    segment->payload = tcp + tcpHeader;
+    segment->length = length - header - tcpHeader;
+    return 0;
+}
+
+/**
+ * @brief sorts a segment into its connection, a SYN of a client opens a new one
+ * @param segment const pcapSegment*: the segment
+ * @return int: 0 in case of success, -1 if no memory is left
+ */
+static int addSegment(pcapCapture* capture, const pcapSegment* segment) {
+    size_t addressLength = (segment->family == AF_INET) ? 4 : 16;
+    int connecting = (segment->flags & TCP_SYN) && !(segment->flags & TCP_ACK);
+    pcapStream* stream = NULL;
+    int direction = 0;
+    // the newest connection first, a port may be used again by a later connection
+    for (size_t i = capture->count; i-- > 0;) {
+        pcapStream* candidate = &capture->streams[i];
+        if (candidate->family != segment->family) {
+            continue;
+        }
+        if ((candidate->clientPort == segment->sourcePort) && (candidate->serverPort == segment->destinationPort) &&
+            (memcmp(candidate->client, segment->source, addressLength) == 0) &&
+            (memcmp(candidate->server, segment->destination, addressLength) == 0)) {
+            stream = candidate;
+            direction = 0;
+            break;
+        }
+        if ((candidate->clientPort == segment->destinationPort) && (candidate->serverPort == segment->sourcePort) &&
+            (memcmp(candidate->client, segment->destination, addressLength) == 0) &&
+            (memcmp(candidate->server, segment->source, addressLength) == 0)) {
+            stream = candidate;
+            direction = 1;
+            break;
+        }
+    }
+    if ((stream != NULL) && connecting && (direction == 0) && stream->synced[0] &&
+        (stream->base[0] != segment->seq + 1)) {
+        stream = NULL;      // the same ports for a new connection
+    }
+    if (stream == NULL) {
+        if (capture->count == capture->capacity) {
+            size_t capacity = (capture->capacity == 0) ? 16 : 2 * capture->capacity;
+            pcapStream* grown = realloc(capture->streams, capacity * sizeof(pcapStream));
+            if (grown == NULL) {
+                return -1;
+            }
+            capture->streams = grown;
+            capture->capacity = capacity;
+        }
+        stream = &capture->streams[capture->count++];
+        memset(stream, 0, sizeof(*stream));
+        stream->family = segment->family;
+        stream->start = segment->time;
+        // without the SYN the ephemeral port, the higher one, belongs to the client
+        direction = (!connecting && (segment->sourcePort < segment->destinationPort)) ? 1 : 0;
+        memcpy(stream->client, direction ? segment->destination : segment->source, addressLength);
+        memcpy(stream->server, direction ? segment->source : segment->destination, addressLength);
+        stream->clientPort = direction ? segment->destinationPort : segment->sourcePort;
+        stream->serverPort = direction ? segment->sourcePort : segment->destinationPort;
+    }
+
+    if (segment->flags & TCP_SYN) {
+        stream->base[direction] = segment->seq + 1;
+        stream->synced[direction] = 1;
+    }
+    if ((segment->flags & TCP_RST) && (direction == 1) && !stream->synced[1] && (stream->response.length == 0)) {
+        stream->refused = 1;
+    }
+    if (segment->length == 0) {
+        return 0;
+    }
+    if (!stream->synced[direction]) {
+        stream->base[direction] = segment->seq;
+        stream->synced[direction] = 1;
+    }
+    pcapData* data = direction ? &stream->response : &stream->request;
+    uint32_t offset = segment->seq - stream->base[direction];
+    if ((offset >= 0x80000000u) || data->gap) {
+        return 0;       // a retransmission of bytes before the first one, or behind a gap
+    }
+    if (offset > data->length) {
+        data->gap = 1;
+        return 0;
+    }
+    if (offset + segment->length <= data->length) {
+        return 0;       // a retransmission
+    }
+    size_t known = data->length - offset;
+    return appendData(data, segment->payload + known, segment->length - known, segment->time);
+}
+
+/**
+ * @brief appends bytes to a direction of a connection
+ * @param data pcapData*: the direction
+ * @param bytes const unsigned char*: the new bytes
+ * @param length size_t: number of bytes
+ * @param time uint64_t: capture time in ns
+ * @return int: 0 in case of success, -1 if no memory is left
+ */
+static int appendData(pcapData* data, const unsigned char* bytes, size_t length, uint64_t time) {
+    if (data->length + length > data->capacity) {
+        size_t capacity = (data->capacity == 0) ? 4096 : data->capacity;
+        while (capacity < data->length + length) {
+            capacity *= 2;
+        }
+        unsigned char* grown = realloc(data->data, capacity);
+        if (grown == NULL) {
+            return -1;
+        }
+        data->data = grown;
+        data->capacity = capacity;
+    }
+    memcpy(data->data + data->length, bytes, length);
+    if (data->length == 0) {
+        data->first = time;
+    }
+    data->length += length;
+    data->last = time;
+    return 0;
+}
+
+/**
+ * @brief reads a 32 bit number of the pcap headers
+ * @param bytes const unsigned char*: the number
+ * @param swapped int: 1 if the file was written on a host of the other byte order
+ * @return uint32_t: the number
+ */
+static uint32_t read32(const unsigned char* bytes, int swapped) {
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return swapped ? __builtin_bswap32(value) : value;
+}
+
+/**
+ * @brief reads a 16 bit number in network byte order
+ * @param bytes const unsigned char*: the number
+ * @return uint16_t: the number
+ */
+static uint16_t big16(const unsigned char* bytes) {
+    return (uint16_t) ((bytes[0] << 8) | bytes[1]);
+}
+
+/**
+ * @brief reads a 32 bit number in network byte order
+ * @param bytes const unsigned char*: the number
+ * @return uint32_t: the number
+ */
+static uint32_t big32(const unsigned char* bytes) {
+    return ((uint32_t) bytes[0] << 24) | ((uint32_t) bytes[1] << 16) | ((uint32_t) bytes[2] << 8) | bytes[3];
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
@@ -0,0 +1,55 @@
+/**
+ * @file pcap_reader.h
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 15.12.18
+ *
+ * @brief Reads the captured sessions of tcpDump_Protocols and reassembles their TCP streams
+ * TCP/IP Lecture Distributed Systems
+ */
+#ifndef PCAP_READER_H
+#define PCAP_READER_H
+
+#include <stddef.h>         // provides size_t
+#include <stdint.h>         // provides uint16_t, uint64_t
+
+// -------------------------------------------------------------- typedefs --
+/** @brief One direction of a TCP connection, the bytes in sequence order */
+typedef struct pcapData {
+    unsigned char* data;        /**< The bytes, NULL if none were sent */
+    size_t length;              /**< Number of bytes */
+    size_t capacity;            /**< Allocated size of data */
+    uint64_t first;             /**< Capture time of the first byte in ns, 0 if none were sent */
+    uint64_t last;              /**< Capture time of the last byte in ns */
+    int gap;                    /**< 1 if segments are missing, data ends before the first gap */
+} pcapData;
+
+/** @brief A TCP connection of the capture */
+typedef struct pcapStream {
+    int family;                         /**< AF_INET or AF_INET6 */
+    unsigned char client[16];           /**< Address of the client, 4 bytes for AF_INET */
+    unsigned char server[16];           /**< Address of the server */
+    uint16_t clientPort;                /**< Port of the client */
+    uint16_t serverPort;                /**< Port of the server */
+    uint64_t start;                     /**< Capture time of the first segment in ns */
+    pcapData request;                   /**< Bytes from the client to the server */
+    pcapData response;                  /**< Bytes from the server to the client */
+    uint32_t base[2];                   /**< Sequence number of the first byte, request and response */
+    int synced[2];                      /**< 1 once base is known */
+    int refused;                        /**< 1 if the server answered the SYN with a reset */
+} pcapStream;
+
+/** @brief All connections of a capture */
+typedef struct pcapCapture {
+    pcapStream* streams;        /**< The connections in the order of their first segment */
+    size_t count;               /**< Number of streams */
+    size_t capacity;            /**< Allocated entries of streams */
+    size_t packets;             /**< Packets read */
+    size_t skipped;             /**< Packets which are no TCP segments over IPv4 or IPv6 */
+} pcapCapture;
+
+// ------------------------------------------------------------- functions --
+int pcap_read(const char* path, pcapCapture* capture);
+void pcap_free(pcapCapture* capture);
+
+#endif // PCAP_READER_H
@@ -0,0 +1,479 @@
+/**
+ * @file server_admission.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 18.12.18
+ *
+ * @brief Admission control of the spawning server.
+ * The parent accepts every connection at once, but forks a handler only while fewer than maxHandlers run.
+ * Beyond, the connection waits in a bounded queue until a handler terminates, a connection waiting longer than
+ * pendingTimeout is rejected. A connection which finds the queue full, or whose source address has maxPerSource
+ * handlers and waiting connections already, is rejected at once. A rejected connection is answered with
+ * LOGIC_STATUS_BUSY and closed, so the client learns about the overload instead of waiting in the backlog.
+ * A failed fork() only rejects the connection. The parent waits for the connections and the terminated
+ * handlers (signalfd) in one poll(), so a spike costs latency, not the server.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#define _GNU_SOURCE         // provides accept4()
+#include <stdlib.h>         // provides calloc(), exit()
+#include <stdio.h>          // provides the printf()
+#include <string.h>         // provide strerror(), memcmp()
+#include <errno.h>          // provides errno
+#include <signal.h>         // provides sigprocmask()
+#include <poll.h>           // provides poll()
+#include <fcntl.h>          // provides fcntl(), O_NONBLOCK
+#include <time.h>           // provides clock_gettime(), nanosleep()
+#include <unistd.h>         // provides fork(), close()
+#include <sys/types.h>
+#include <sys/socket.h>     // provides accept4(), send(), shutdown()
+#include <sys/signalfd.h>   // provides signalfd()
+#include <sys/wait.h>       // provides waitpid()
+#include <netinet/in.h>     // provides struct sockaddr_in6
+#include "server_admission.h"
+#include "server_logic.h"   // provides LOGIC_STATUS_BUSY, LOGIC_REQUESTKEY
+#include "server_metrics.h" // provides metrics_add(), metrics_observe()
+#include "trace.h"          // provides TRACE()
+
+// --------------------------------------------------------------- defines --
+/** @brief nanoseconds to wait before the next accept() if the process ran out of file descriptors */
+#define ACCEPT_PAUSE 10000000
+/** @brief ms a rejected connection may take to send the request key, which decides the framing of the answer */
+#define REJECT_WAIT 50
+/** @brief ms the request of a rejected connection is drained after the answer, until the client closed */
+#define REJECT_LINGER 200
+/** @brief nanoseconds to wait for the rest of a request key which arrived in part */
+#define REJECT_PAUSE 1000000
+
+// -------------------------------------------------------------- typedefs --
+/** @brief Why a connection is rejected, the extra value of its TRACE_REJECT event */
+enum admissionReason {
+    ADMISSION_SOURCELIMIT = 1,          /**< The source address has maxPerSource connections */
+    ADMISSION_QUEUEFULL,                /**< maxPending connections are waiting */
+    ADMISSION_NOHANDLER,                /**< The handler could not be started */
+    ADMISSION_EXPIRED                   /**< The connection waited longer than pendingTimeout */
+};
+
+/** @brief A running handler */
+typedef struct admissionHandler {
+    pid_t pid;                          /**< Process of the handler, 0 if the entry is free */
+    struct sockaddr_storage source;     /**< Address of the client */
+    uint64_t started;                   /**< Time of the accept for the metrics */
+} admissionHandler;
+
+/** @brief A connection waiting for a handler */
+typedef struct admissionPending {
+    int fd;                             /**< The accepted connection */
+    struct sockaddr_storage source;     /**< Address of the client */
+    long long accepted;                 /**< Time of the accept in ms */
+    uint64_t started;                   /**< Time of the accept for the metrics */
+    uint32_t connection;                /**< Connection number of the trace */
+} admissionPending;
+
+/** @brief State of the admission control */
+typedef struct admissionState {
+    const admissionConfig* config;      /**< Limits */
+    admissionHandler* handlers;         /**< maxHandlers entries */
+    int running;                        /**< Handlers running */
+    admissionPending* pending;          /**< Ring of maxPending waiting connections */
+    int first;                          /**< Oldest waiting connection */
+    int waiting;                        /**< Number of waiting connections */
+    const listenSet* listeners;         /**< Listening sockets */
+    int fd_signal;                      /**< signalfd of SIGCHLD */
+    sigset_t previous;                  /**< Signal mask before, restored in the handlers */
+    admissionServe serve;               /**< Connection handler of a forked handler */
+    admissionSpawn spawn;               /**< Starts a handler without fork(), NULL forks and calls serve */
+    admissionPrepare prepare;           /**< Called before a handler is forked, NULL if unused */
+    void* context;                      /**< Passed through to serve */
+} admissionState;
+
+// ------------------------------------------------------------- functions --
+static void admit(admissionState* state, int fd_connected, const struct sockaddr_storage* source);
+static int spawnHandler(admissionState* state, int fd_connected, const struct sockaddr_storage* source,
+                        uint64_t started);
+static void reapHandlers(admissionState* state);
+static void servePending(admissionState* state);
+static void reject(int fd_connected, enum admissionReason reason);
+static int fromSource(const admissionState* state, const struct sockaddr_storage* source);
+static int sameAddress(const struct sockaddr_storage* a, const struct sockaddr_storage* b);
+static int waitReadable(int fd, long long deadline);
+static long long nowMs(void);
+
+/**
+ * @brief fills the unset limits with the defaults
+ * @param config admissionConfig*: the limits
+ */
+void admission_configure(admissionConfig* config) {
+    if (config->maxHandlers == 0) {
+        config->maxHandlers = ADMISSION_MAXHANDLERS;
+    }
+    if (config->maxPending == 0) {
+        config->maxPending = ADMISSION_MAXPENDING;
+    }
+    if (config->pendingTimeout == 0) {
+        config->pendingTimeout = ADMISSION_PENDINGTIMEOUT;
+    }
+}
+
+/**
+ * @brief accepts the connections on the listening sockets and serves each by a forked handler within the
+ * limits, does not return unless it could not be set up
+ * @param listeners const listenSet*: bound and listening sockets, are switched to non blocking mode
+ * @param config const admissionConfig*: limits, completed by admission_configure()
+ * @param serve admissionServe: connection handler called in the forked handler process
+ * @param spawn admissionSpawn: starts the handler instead of fork() and serve, NULL if unused
+ * @param prepare admissionPrepare: called in the server before every fork of a handler, NULL if unused
+ * @param context void*: passed through to serve, spawn and prepare
+ * @return int: -1 (errno is set)
+ */
+int admission_run(const listenSet* listeners, const admissionConfig* config, admissionServe serve, admissionSpawn spawn,
+                  admissionPrepare prepare, void* context) {
+    admissionState state;
+    memset(&state, 0, sizeof(state));
+    state.config = config;
+    state.listeners = listeners;
+    state.serve = serve;
+    state.spawn = spawn;
+    state.prepare = prepare;
+    state.context = context;
+    // a connection reset between poll() and accept() must not block the parent
+    for (int i = 0; i < listeners->count; i++) {
+        int flags = fcntl(listeners->fds[i], F_GETFL);
+        if ((flags == -1) || (fcntl(listeners->fds[i], F_SETFL, flags | O_NONBLOCK) == -1)) {
+            return -1;
+        }
+    }
+    state.handlers = calloc((size_t) config->maxHandlers, sizeof(admissionHandler));
+    state.pending = calloc((size_t) config->maxPending, sizeof(admissionPending));
+    if ((state.handlers == NULL) || (state.pending == NULL)) {
+        free(state.handlers);
+        free(state.pending);
+        return -1;
+    }
+    // the terminated handlers are collected synchronously, the count of running handlers is exact
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGCHLD);
+    if ((sigprocmask(SIG_BLOCK, &signals, &state.previous) == -1) ||
+        ((state.fd_signal = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC)) == -1)) {
+        int save_errno = errno;
+        free(state.handlers);
+        free(state.pending);
+        errno = save_errno;
+        return -1;
+    }
+
+    while (1) {
+        // wait until the oldest waiting connection expires at the latest
+        int timeout = -1;
+        if (state.waiting > 0) {
+            long long left = state.pending[state.first].accepted + config->pendingTimeout - nowMs();
+            timeout = (left > 0) ? (int) left : 0;
+        }
+        // the signalfd comes first, the listening sockets follow
+        struct pollfd fds[1 + LISTEN_MAXSOCKETS];
+        fds[0].fd = state.fd_signal;
+        fds[0].events = POLLIN;
+        for (int i = 0; i < listeners->count; i++) {
+            fds[1 + i].fd = listeners->fds[i];
+            fds[1 + i].events = POLLIN;
+        }
+        if ((poll(fds, (nfds_t) (1 + listeners->count), timeout) == -1) && (errno != EINTR)) {
+            break;
+        }
+        if (fds[0].revents != 0) {
+            struct signalfd_siginfo info;
+            while (read(state.fd_signal, &info, sizeof(info)) > 0);
+            reapHandlers(&state);
+        }
+        servePending(&state);
+        int failed = 0;
+        for (int i = 0; (i < listeners->count) && (failed == 0); i++) {
+            if (fds[1 + i].revents == 0) {
+                continue;
+            }
+            struct sockaddr_storage source;
+            socklen_t length = sizeof(source);
+            // close on exec: the business logic must not inherit the waiting connections
+            int fd_connected = accept4(listeners->fds[i], (struct sockaddr*) &source, &length, SOCK_CLOEXEC);
+            if (fd_connected >= 0) {
+                admit(&state, fd_connected, &source);
+            } else if ((errno == EMFILE) || (errno == ENFILE) || (errno == ENOBUFS) || (errno == ENOMEM)) {
+                // temporary shortage, the connection stays in the backlog until handlers have finished
+                fprintf(stderr, "Could not accept socket: %s\n", strerror(errno));
+                struct timespec pause = {0, ACCEPT_PAUSE};
+                nanosleep(&pause, NULL);
+            } else if ((errno != EINTR) && (errno != ECONNABORTED) && (errno != EAGAIN)) {
+                failed = 1;
+            }
+        }
+        if (failed == 1) {
+            break;
+        }
+    }
+    int save_errno = errno;
+    close(state.fd_signal);
+    sigprocmask(SIG_SETMASK, &state.previous, NULL);
+    free(state.handlers);
+    free(state.pending);
+    errno = save_errno;
+    return -1;
+}
+
+/**
+ * @brief decides about an accepted connection: a handler if one is free, the queue if not, otherwise rejected
+ * @param state admissionState*: the admission control
+ * @param fd_connected int: the accepted connection
+ * @param source const struct sockaddr_storage*: address of the client
+ */
+static void admit(admissionState* state, int fd_connected, const struct sockaddr_storage* source) {
+    const admissionConfig* config = state->config;
+    uint64_t started = metrics_now();
+    metrics_add(METRICS_ACCEPTED, 1);
+    metrics_add(METRICS_ACTIVE, 1);
+    // the handler inherits the connection number of the trace with the fork
+    uint32_t connection = trace_connection();
+    TRACE(TRACE_ACCEPT, (uint64_t) fd_connected, (uint32_t) state->running);
+    if ((config->maxPerSource > 0) && (fromSource(state, source) >= config->maxPerSource)) {
+        reject(fd_connected, ADMISSION_SOURCELIMIT);
+        return;
+    }
+    // a connection only overtakes the waiting ones if there are none
+    if ((state->waiting == 0) && (state->running < config->maxHandlers)) {
+        spawnHandler(state, fd_connected, source, started);
+        return;
+    }
+    if (state->waiting == config->maxPending) {
+        reject(fd_connected, ADMISSION_QUEUEFULL);
+        return;
+    }
+    admissionPending* entry = &state->pending[(state->first + state->waiting) % config->maxPending];
+    entry->fd = fd_connected;
+    entry->source = *source;
+    entry->accepted = nowMs();
+    entry->started = started;
+    entry->connection = connection;
+    state->waiting++;
+}
+
+/**
+ * @brief starts the handler of a connection, by spawn or by fork(), the connection is rejected if this fails
+ * @param state admissionState*: the admission control, a handler entry is free
+ * @param fd_connected int: the connection, closed in the parent
+ * @param source const struct sockaddr_storage*: address of the client
+ * @param started uint64_t: time of the accept for the metrics
+ * @return int: 0 in case of success, -1 if the handler could not be started
+ */
+static int spawnHandler(admissionState* state, int fd_connected, const struct sockaddr_storage* source,
+                        uint64_t started) {
+    fflush(stdout);     // do not duplicate buffered output in the handler
+    if ((state->spawn == NULL) && (state->prepare != NULL)) {
+        state->prepare(state->context);
+    }
+    uint64_t forking = metrics_now();
+    pid_t pid = (state->spawn != NULL) ? state->spawn(fd_connected, state->context) : fork();
+    if (pid == -1) {
+        fprintf(stderr, "Could not start a handler! %s\n", strerror(errno));
+        reject(fd_connected, ADMISSION_NOHANDLER);
+        return -1;
+    }
+    if ((pid == 0) && (state->spawn == NULL)) {
+        // the handler keeps only its own connection, a handler which outlives the server must not keep
+        // the ports bound or connections waiting in the backlogs
+        close(state->fd_signal);
+        listen_closeSockets(state->listeners);
+        for (int i = 0; i < state->waiting; i++) {
+            close(state->pending[(state->first + i) % state->config->maxPending].fd);
+        }
+        sigprocmask(SIG_SETMASK, &state->previous, NULL);
+        state->serve(-1, fd_connected, state->context);
+        exit(EXIT_SUCCESS);
+    }
+    metrics_observe(METRICS_SPAWN, metrics_now() - forking);
+    TRACE(TRACE_SPAWN, (uint64_t) pid, 0);
+    close(fd_connected);
+    for (int i = 0; i < state->config->maxHandlers; i++) {
+        if (state->handlers[i].pid == 0) {
+            state->handlers[i].pid = pid;
+            state->handlers[i].source = *source;
+            state->handlers[i].started = started;
+            break;
+        }
+    }
+    state->running++;
+    return 0;
+}
+
+/**
+ * @brief collects the terminated handlers and frees their entries
+ * @param state admissionState*: the admission control
+ */
+static void reapHandlers(admissionState* state) {
+    pid_t pid;
+    while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+        for (int i = 0; i < state->config->maxHandlers; i++) {
+            if (state->handlers[i].pid == pid) {
+                state->handlers[i].pid = 0;
+                state->running--;
+                metrics_add(METRICS_ACTIVE, -1);
+                metrics_observe(METRICS_HANDLER, metrics_now() - state->handlers[i].started);
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief rejects the expired waiting connections and hands the others to the free handlers, oldest first
+ * @param state admissionState*: the admission control
+ */
+static void servePending(admissionState* state) {
+    const admissionConfig* config = state->config;
+    long long now = nowMs();
+    while (state->waiting > 0) {
+        admissionPending* entry = &state->pending[state->first];
+        int expired = (now - entry->accepted >= config->pendingTimeout);
+        if (!expired && (state->running >= config->maxHandlers)) {
+            break;
+        }
+        state->first = (state->first + 1) % config->maxPending;
+        state->waiting--;
+        trace_setConnection(entry->connection);
+        if (expired) {
+            reject(entry->fd, ADMISSION_EXPIRED);
+        } else if (spawnHandler(state, entry->fd, &entry->source, entry->started) == -1) {
+            break;      // the others wait for the next terminated handler
+        }
+    }
+}
+
+/**
+ * @brief answers a connection with LOGIC_STATUS_BUSY and closes it. A framed request gets a framed response, the
+ * request key is waited for at most REJECT_WAIT ms: a client which has not sent it yet gets the legacy answer.
+ * The request is drained for at most REJECT_LINGER ms, so the close does not reset the answer away.
+ * @param fd_connected int: the connection
+ * @param reason enum admissionReason: why the connection is rejected, traced
+ */
+static void reject(int fd_connected, enum admissionReason reason) {
+    metrics_add(METRICS_REJECTED, 1);
+    metrics_add(METRICS_ACTIVE, -1);
+    TRACE(TRACE_REJECT, (uint64_t) fd_connected, (uint32_t) reason);
+    size_t keyLength = strlen(LOGIC_REQUESTKEY);
+    char request[sizeof(LOGIC_REQUESTKEY)];
+    long long deadline = nowMs() + REJECT_WAIT;
+    ssize_t received;
+    while ((received = recv(fd_connected, request, keyLength, MSG_PEEK | MSG_DONTWAIT)) != (ssize_t) keyLength) {
+        if ((received == 0) || ((received == -1) && (errno != EAGAIN) && (errno != EWOULDBLOCK)) ||
+            ((received > 0) && (memcmp(request, LOGIC_REQUESTKEY, (size_t) received) != 0))) {
+            break;      // closed, failed or a legacy request, no more bytes are needed to decide
+        }
+        if (received > 0) {
+            // a part of the key is buffered, poll() would return at once until the rest arrived
+            if (nowMs() >= deadline) {
+                break;
+            }
+            struct timespec pause = {0, REJECT_PAUSE};
+            nanosleep(&pause, NULL);
+        } else if (waitReadable(fd_connected, deadline) <= 0) {
+            break;
+        }
+    }
+    char status[32];
+    int statusLength = snprintf(status, sizeof(status), "status=%d\n", LOGIC_STATUS_BUSY);
+    char response[64];
+    int length;
+    if ((received == (ssize_t) keyLength) && (memcmp(request, LOGIC_REQUESTKEY, keyLength) == 0)) {
+        length = snprintf(response, sizeof(response), "%s%d\n%s", LOGIC_RESPONSEKEY, statusLength, status);
+    } else {
+        length = snprintf(response, sizeof(response), "%s", status);
+    }
+    send(fd_connected, response, (size_t) length, MSG_NOSIGNAL | MSG_DONTWAIT);
+    shutdown(fd_connected, SHUT_WR);
+    // unread request bytes would turn the close into a reset, which may discard the answer at the client
+    deadline = nowMs() + REJECT_LINGER;
+    char drain[4096];
+    for (;;) {
+        received = recv(fd_connected, drain, sizeof(drain), MSG_DONTWAIT);
+        if ((received == 0) || ((received == -1) && (errno != EAGAIN) && (errno != EWOULDBLOCK))) {
+            break;
+        }
+        if ((received == -1) && (waitReadable(fd_connected, deadline) <= 0)) {
+            break;
+        }
+    }
+    close(fd_connected);
+}
+
+/**
+ * @brief counts the running handlers and waiting connections of a source address
+ * @param state const admissionState*: the admission control
+ * @param source const struct sockaddr_storage*: the address
+ * @return int: number of handlers and connections
+ */
+static int fromSource(const admissionState* state, const struct sockaddr_storage* source) {
+    int count = 0;
+    for (int i = 0; i < state->config->maxHandlers; i++) {
+        count += (state->handlers[i].pid != 0) && sameAddress(&state->handlers[i].source, source);
+    }
+    for (int i = 0; i < state->waiting; i++) {
+        count += sameAddress(&state->pending[(state->first + i) % state->config->maxPending].source, source);
+    }
+    return count;
+}
+
+/**
+ * @brief compares the host part of two addresses, the ports are ignored
+ * @param a const struct sockaddr_storage*: first address
+ * @param b const struct sockaddr_storage*: second address
+ * @return int: 1 if the hosts are the same, 0 if not
+ */
+static int sameAddress(const struct sockaddr_storage* a, const struct sockaddr_storage* b) {
+    if (a->ss_family != b->ss_family) {
+        return 0;
+    }
+    if (a->ss_family == AF_INET) {
+        return ((const struct sockaddr_in*) a)->sin_addr.s_addr == ((const struct sockaddr_in*) b)->sin_addr.s_addr;
+    }
+    if (a->ss_family == AF_INET6) {
+        return memcmp(&((const struct sockaddr_in6*) a)->sin6_addr, &((const struct sockaddr_in6*) b)->sin6_addr,
+                      sizeof(struct in6_addr)) == 0;
+    }
+    return 1;   // a unix socket has no source address, all its clients are one source
+}
+
+/**
+ * @brief waits until a socket is readable or the deadline has passed
+ * @param fd int: the socket
+ * @param deadline long long: end of the wait on the clock of nowMs()
+ * @return int: 1 if the socket is readable, 0 at the deadline, -1 on failure
+ */
+static int waitReadable(int fd, long long deadline) {
+    struct pollfd entry = {fd, POLLIN, 0};
+    long long left;
+    while ((left = deadline - nowMs()) > 0) {
+        int ready = poll(&entry, 1, (int) left);
+        if ((ready != -1) || (errno != EINTR)) {
+            return ready;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief reads the monotonic clock
+ * @return long long: time in ms
+ */
+static long long nowMs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
@@ -0,0 +1,63 @@
+/**
+ * @file server_admission.h
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 18.12.18
+ *
+ * @brief Admission control of the spawning server, bounds the forked handlers and sheds the overload
+ * TCP/IP Lecture Distributed Systems
+ */
+#ifndef SERVER_ADMISSION_H
+#define SERVER_ADMISSION_H
+
+#include <sys/types.h>      // provides pid_t
+#include "server_listen.h"  // provides listenSet
+
+// --------------------------------------------------------------- defines --
+/** @brief default limit of handlers running at the same time */
+#define ADMISSION_MAXHANDLERS 256
+/** @brief default limit of accepted connections waiting for a handler */
+#define ADMISSION_MAXPENDING 128
+/** @brief default time in ms a connection may wait for a handler */
+#define ADMISSION_PENDINGTIMEOUT 2000
+
+// -------------------------------------------------------------- typedefs --
+/**
+ * @brief Connection handler called in the forked handler process, the process exits when it returns.
+ * The handler owns fd_connected and must close it.
+ * @param fd_listen int: -1, the listening sockets are closed in the handler, only the connection is open
+ * @param fd_connected int: accepted connection
+ * @param context void*: context pointer given to admission_run()
+ * @return int: ignored, the handler process exits
+ */
+typedef int (*admissionServe)(int fd_listen, int fd_connected, void* context);
+
+/**
+ * @brief Starts the handler of a connection without fork(), e.g. with posix_spawn(). Called in the server
+ * process, which closes fd_connected afterwards.
+ * @param fd_connected int: accepted connection
+ * @param context void*: context pointer given to admission_run()
+ * @return pid_t: process of the handler, -1 on failure (errno is set)
+ */
+typedef pid_t (*admissionSpawn)(int fd_connected, void* context);
+
+/**
+ * @brief Prepares the server before a handler is forked, the handler inherits what was prepared
+ * @param context void*: context pointer given to admission_run()
+ */
+typedef void (*admissionPrepare)(void* context);
+
+/** @brief Limits of the admission control, 0 selects the default */
+typedef struct admissionConfig {
+    int maxHandlers;            /**< Handlers running at the same time */
+    int maxPending;             /**< Connections waiting for a handler, beyond they are rejected */
+    int pendingTimeout;         /**< ms a connection may wait before it is rejected */
+    int maxPerSource;           /**< Handlers and waiting connections of one source address, 0 is no limit */
+} admissionConfig;
+
+// ------------------------------------------------------------- functions --
+void admission_configure(admissionConfig* config);
+int admission_run(const listenSet* listeners, const admissionConfig* config, admissionServe serve, admissionSpawn spawn,
+                  admissionPrepare prepare, void* context);
+
+#endif // SERVER_ADMISSION_H
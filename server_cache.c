@@ -0,0 +1,248 @@
+/**
+ * @file server_cache.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 12.12.18
+ *
+ * @brief In-memory cache of rendered response records.
+ * An entry is a complete record (file=, len=, content) under a name and a version, e.g. the rendered bulletin
+ * board under the number of messages it was rendered from. A lookup with a newer version removes the
+ * outdated entry. The entries are kept in least recently used order, the oldest ones are evicted when the
+ * memory limit is reached. The cache is shared by all threads of a process.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#include <stdlib.h>         // provides malloc(), free()
+#include <string.h>         // provides memcpy(), strcmp()
+#include <stdatomic.h>      // provides atomic_ulong for the counters
+#include <pthread.h>        // provides pthread_mutex_lock()
+#include <unistd.h>         // provides write()
+#include "server_cache.h"
+
+// -------------------------------------------------------------- typedefs --
+/** @brief One cached record, element of the LRU list */
+typedef struct cacheEntry {
+    struct cacheEntry* newer;   /**< Next more recently used entry, NULL for the newest */
+    struct cacheEntry* older;   /**< Next less recently used entry, NULL for the oldest */
+    char* name;                 /**< Name of the record */
+    size_t version;             /**< Version of the content */
+    char* data;                 /**< The record */
+    size_t length;              /**< Length of data */
+} cacheEntry;
+
+// --------------------------------------------------------------- globals --
+/** @brief protects the list, the counters are read without it */
+static pthread_mutex_t cacheLock = PTHREAD_MUTEX_INITIALIZER;
+/** @brief most recently used entry */
+static cacheEntry* newest = NULL;
+/** @brief least recently used entry, evicted first */
+static cacheEntry* oldest = NULL;
+/** @brief memory limit of all entries, 0 disables the cache */
+static size_t limit = CACHE_DEFAULTLIMIT;
+
+static atomic_ulong hits;
+static atomic_ulong misses;
+static atomic_ulong evictions;
+static atomic_ulong invalidations;
+static atomic_ulong entries;
+static atomic_ulong bytes;
+
+// ------------------------------------------------------------- functions --
+static cacheEntry* findEntry(const char* name);
+static void unlinkEntry(cacheEntry* entry);
+static void linkNewest(cacheEntry* entry);
+static void removeEntry(cacheEntry* entry);
+static size_t formatCounter(char* out, const char* label, unsigned long value);
+
+/**
+ * @brief sets the memory limit of the cache, call before the first request
+ * @param size size_t: limit in bytes, 0 disables the cache
+ */
+void cache_setLimit(size_t size) {
+    limit = size;
+}
+
+/**
+ * @brief appends the cached record to the buffer if it is cached in the given version
+ * @param name const char*: name of the record
+ * @param version size_t: current version of the content
+ * @param buffer logicBuffer*: the response
+ * @return int: 1 if the record was appended, 0 if it is not cached, -1 if out of memory
+ */
+int cache_lookup(const char* name, size_t version, logicBuffer* buffer) {
+    int result = 0;
+    pthread_mutex_lock(&cacheLock);
+    cacheEntry* entry = findEntry(name);
+    if ((entry != NULL) && (entry->version != version)) {
+        removeEntry(entry);
+        atomic_fetch_add(&invalidations, 1);
+        entry = NULL;
+    }
+    if (entry != NULL) {
+        unlinkEntry(entry);
+        linkNewest(entry);
+        // copied under the lock, the entry may be evicted right after
+        result = (logic_append(buffer, entry->data, entry->length) == 0) ? 1 : -1;
+    }
+    pthread_mutex_unlock(&cacheLock);
+    atomic_fetch_add((result == 1) ? &hits : &misses, 1);
+    return result;
+}
+
+/**
+ * @brief stores a record, replaces the cached record of the same name. Records larger than the limit and
+ * failed allocations are not cached, the cache is an optimization only.
+ * @param name const char*: name of the record
+ * @param version size_t: version of the content
+ * @param data const char*: the record
+ * @param length size_t: length of the record
+ */
+void cache_store(const char* name, size_t version, const char* data, size_t length) {
+    if (length > limit) {
+        return;
+    }
+    cacheEntry* entry = malloc(sizeof(cacheEntry));
+    if (entry == NULL) {
+        return;
+    }
+    entry->name = strdup(name);
+    entry->data = malloc(length);
+    if ((entry->name == NULL) || (entry->data == NULL)) {
+        free(entry->name);
+        free(entry->data);
+        free(entry);
+        return;
+    }
+    memcpy(entry->data, data, length);
+    entry->version = version;
+    entry->length = length;
+
+    pthread_mutex_lock(&cacheLock);
+    cacheEntry* previous = findEntry(name);
+    if (previous != NULL) {
+        removeEntry(previous);
+    }
+    while ((oldest != NULL) && (atomic_load(&bytes) + length > limit)) {
+        removeEntry(oldest);
+        atomic_fetch_add(&evictions, 1);
+    }
+    linkNewest(entry);
+    atomic_fetch_add(&entries, 1);
+    atomic_fetch_add(&bytes, length);
+    pthread_mutex_unlock(&cacheLock);
+}
+
+/**
+ * @brief reads the counters of the cache
+ * @param stats cacheStats*: receives the counters
+ */
+void cache_stats(cacheStats* stats) {
+    stats->hits = atomic_load(&hits);
+    stats->misses = atomic_load(&misses);
+    stats->evictions = atomic_load(&evictions);
+    stats->invalidations = atomic_load(&invalidations);
+    stats->entries = atomic_load(&entries);
+    stats->bytes = atomic_load(&bytes);
+}
+
+/**
+ * @brief writes the counters as one line, async-signal-safe so it can be called from a signal handler
+ * @param fd int: destination, e.g. STDERR_FILENO
+ */
+void cache_report(int fd) {
+    char line[256];
+    size_t length = 0;
+    length += formatCounter(line + length, "cache: hits ", atomic_load(&hits));
+    length += formatCounter(line + length, " misses ", atomic_load(&misses));
+    length += formatCounter(line + length, " evictions ", atomic_load(&evictions));
+    length += formatCounter(line + length, " invalidations ", atomic_load(&invalidations));
+    length += formatCounter(line + length, " entries ", atomic_load(&entries));
+    length += formatCounter(line + length, " bytes ", atomic_load(&bytes));
+    line[length++] = '\n';
+    ssize_t written = write(fd, line, length);
+    (void) written;     // nothing to do about a failed report
+}
+
+/**
+ * @brief searches the entry of the given name, the lock must be held
+ * @return cacheEntry*: the entry, NULL if there is none
+ */
+static cacheEntry* findEntry(const char* name) {
+    for (cacheEntry* entry = newest; entry != NULL; entry = entry->older) {
+        if (strcmp(entry->name, name) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief removes the entry from the LRU list, the lock must be held
+ */
+static void unlinkEntry(cacheEntry* entry) {
+    if (entry->newer != NULL) {
+        entry->newer->older = entry->older;
+    } else {
+        newest = entry->older;
+    }
+    if (entry->older != NULL) {
+        entry->older->newer = entry->newer;
+    } else {
+        oldest = entry->newer;
+    }
+}
+
+/**
+ * @brief inserts the entry as the most recently used one, the lock must be held
+ */
+static void linkNewest(cacheEntry* entry) {
+    entry->newer = NULL;
+    entry->older = newest;
+    if (newest != NULL) {
+        newest->newer = entry;
+    } else {
+        oldest = entry;
+    }
+    newest = entry;
+}
+
+/**
+ * @brief unlinks and frees the entry, the lock must be held
+ */
+static void removeEntry(cacheEntry* entry) {
+    unlinkEntry(entry);
+    atomic_fetch_sub(&entries, 1);
+    atomic_fetch_sub(&bytes, entry->length);
+    free(entry->name);
+    free(entry->data);
+    free(entry);
+}
+
+/**
+ * @brief formats label and value without stdio, which is not async-signal-safe
+ * @param out char*: destination, large enough for the label and 20 digits
+ * @return size_t: characters written, not terminated
+ */
+static size_t formatCounter(char* out, const char* label, unsigned long value) {
+    size_t length = strlen(label);
+    memcpy(out, label, length);
+    char digits[24];
+    size_t count = 0;
+    do {
+        digits[count++] = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (count > 0) {
+        out[length++] = digits[--count];
+    }
+    return length;
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
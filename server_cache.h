@@ -0,0 +1,38 @@
+/**
+ * @file server_cache.h
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 12.12.18
+ *
+ * @brief In-memory cache of rendered response records
+ * TCP/IP Lecture Distributed Systems
+ */
+#ifndef SERVER_CACHE_H
+#define SERVER_CACHE_H
+
+#include <stddef.h>         // provides size_t
+#include "server_logic.h"   // provides logicBuffer
+
+// --------------------------------------------------------------- defines --
+/** @brief default memory limit of the cache in bytes */
+#define CACHE_DEFAULTLIMIT (16 * 1024 * 1024)
+
+// -------------------------------------------------------------- typedefs --
+/** @brief Counters of the cache */
+typedef struct cacheStats {
+    unsigned long hits;         /**< Lookups answered from the cache */
+    unsigned long misses;       /**< Lookups which had to render */
+    unsigned long evictions;    /**< Entries removed to stay below the limit */
+    unsigned long invalidations;/**< Entries removed because their version was outdated */
+    unsigned long entries;      /**< Entries in the cache */
+    unsigned long bytes;        /**< Bytes of all entries */
+} cacheStats;
+
+// ------------------------------------------------------------- functions --
+void cache_setLimit(size_t size);
+int cache_lookup(const char* name, size_t version, logicBuffer* buffer);
+void cache_store(const char* name, size_t version, const char* data, size_t length);
+void cache_stats(cacheStats* stats);
+void cache_report(int fd);
+
+#endif // SERVER_CACHE_H
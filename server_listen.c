@@ -0,0 +1,343 @@
+/**
+ * @file server_listen.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 08.12.18
+ *
+ * @brief Creation of the listening sockets of the simple message server.
+ * The server listens on a set of addresses: IPv4, IPv6 and unix sockets. The wildcard address is
+ * the IPv6 wildcard with IPV6_V6ONLY off, which takes the IPv4 clients as mapped addresses (dual-stack), and
+ * on the IPv4 wildcard if the kernel has no IPv6. An IPv6 wildcard is made IPv6 only if an IPv4 address with
+ * the same port is in the set, otherwise both binds would collide.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#include <stdlib.h>         // provides strtol()
+#include <stdio.h>          // provides snprintf()
+#include <string.h>         // provides memset(), strchr(), strncmp()
+#include <errno.h>          // provides errno
+#include <unistd.h>         // provides close(), unlink()
+#include <netdb.h>          // provides getaddrinfo()
+#include <sys/types.h>
+#include <sys/socket.h>     // provides socket(), bind(), listen()
+#include <sys/un.h>         // provides struct sockaddr_un
+#include <netinet/in.h>     // provides struct sockaddr_in, struct sockaddr_in6, IPV6_V6ONLY
+#include <arpa/inet.h>      // provides inet_ntop()
+#include "server_listen.h"
+
+// --------------------------------------------------------------- defines --
+/** @brief longest host part of a --listen address */
+#define LISTEN_MAXHOST 256
+
+// ------------------------------------------------------------- functions --
+static int openSocket(const listenAddress* address, int backlog, int reusePort);
+static int addWildcard(listenSet* set, uint16_t port);
+static uint16_t portOf(const listenAddress* address);
+
+/**
+ * @brief creates a listening socket: socket(), SO_REUSEADDR, bind(), listen()
+ * @param address const struct sockaddr*: address to bind to
+ * @param length socklen_t: length of address
+ * @param backlog int: maximal amount of pending connections
+ * @param reusePort int: 1 sets SO_REUSEPORT, several sockets bound to the same port share the connections
+ * @return int: file descriptor of the listening socket, -1 on failure (errno is set)
+ */
+int listen_open(const struct sockaddr* address, socklen_t length, int backlog, int reusePort) {
+    listenAddress plain;
+    memset(&plain, 0, sizeof(plain));
+    memcpy(&plain.address, address, length);
+    plain.length = length;
+    plain.v6only = -1;  // kernel default
+    return openSocket(&plain, backlog, reusePort);
+}
+
+/**
+ * @brief appends an address to the set. The forms are unix:<path>, <host>, <host>:<port>, [<IPv6>] and
+ * [<IPv6>]:<port>, the host is a name or a numeric address. An empty host or * is the dual-stack wildcard.
+ * @param set listenSet*: the set
+ * @param spec const char*: the address
+ * @param port uint16_t: port if the address has none
+ * @return int: 0 in case of success, -1 if the address is invalid or the set is full (errno is set)
+ */
+int listen_add(listenSet* set, const char* spec, uint16_t port) {
+    if (set->count == LISTEN_MAXSOCKETS) {
+        errno = ENOSPC;
+        return -1;
+    }
+    listenAddress* address = &set->addresses[set->count];
+    memset(address, 0, sizeof(listenAddress));
+    if (strncmp(spec, LISTEN_UNIXPREFIX, strlen(LISTEN_UNIXPREFIX)) == 0) {
+        struct sockaddr_un* local = (struct sockaddr_un*) &address->address;
+        const char* path = spec + strlen(LISTEN_UNIXPREFIX);
+        if ((strlen(path) == 0) || (strlen(path) >= sizeof(local->sun_path))) {
+            errno = EINVAL;
+            return -1;
+        }
+        local->sun_family = AF_UNIX;
+        strcpy(local->sun_path, path);
+        address->length = sizeof(struct sockaddr_un);
+        set->fds[set->count++] = -1;
+        return 0;
+    }
+    // split host and port, an IPv6 address has colons itself and a port only within brackets
+    char host[LISTEN_MAXHOST];
+    const char* portPart = NULL;
+    const char* colon = strchr(spec, ':');
+    size_t hostLength = strlen(spec);
+    if (spec[0] == '[') {
+        const char* close = strchr(spec, ']');
+        if ((close == NULL) || ((close[1] != '\0') && (close[1] != ':'))) {
+            errno = EINVAL;
+            return -1;
+        }
+        spec++;
+        hostLength = (size_t) (close - spec);
+        portPart = (close[1] == ':') ? close + 2 : NULL;
+    } else if ((colon != NULL) && (strchr(colon + 1, ':') == NULL)) {
+        hostLength = (size_t) (colon - spec);
+        portPart = colon + 1;
+    }
+    if (hostLength >= sizeof(host)) {
+        errno = EINVAL;
+        return -1;
+    }
+    memcpy(host, spec, hostLength);
+    host[hostLength] = '\0';
+    if (portPart != NULL) {
+        char* end = NULL;
+        long value = strtol(portPart, &end, 10);
+        if ((*portPart == '\0') || (*end != '\0') || (value < 0) || (value > 65535)) {
+            errno = EINVAL;
+            return -1;
+        }
+        port = (uint16_t) value;
+    }
+    if ((host[0] == '\0') || (strcmp(host, LISTEN_WILDCARD) == 0)) {
+        return addWildcard(set, port);
+    }
+    struct addrinfo hints, * result;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    if (getaddrinfo(host, NULL, &hints, &result) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    // a name with several addresses is bound to the first one, like the client connects to the first one
+    memcpy(&address->address, result->ai_addr, result->ai_addrlen);
+    address->length = result->ai_addrlen;
+    freeaddrinfo(result);
+    if (address->address.ss_family == AF_INET) {
+        ((struct sockaddr_in*) &address->address)->sin_port = htons(port);
+    } else if (address->address.ss_family == AF_INET6) {
+        ((struct sockaddr_in6*) &address->address)->sin6_port = htons(port);
+        address->v6only = 1;
+    } else {
+        errno = EAFNOSUPPORT;
+        return -1;
+    }
+    set->fds[set->count++] = -1;
+    return 0;
+}
+
+/**
+ * @brief opens the sockets of all addresses of the set. A stale unix socket of an earlier run is removed first.
+ * @param set listenSet*: the set, receives the sockets
+ * @param backlog int: maximal amount of pending connections per socket
+ * @param reusePort int: 1 sets SO_REUSEPORT on the IPv4 and IPv6 sockets
+ * @return int: 0 in case of success, -1 on failure (errno is set). The sockets opened before stay open,
+ * the fd of the failed address is -1.
+ */
+int listen_openSet(listenSet* set, int backlog, int reusePort) {
+    for (int i = 0; i < set->count; i++) {
+        listenAddress* address = &set->addresses[i];
+        if ((address->address.ss_family == AF_INET6) && (address->v6only == 0)) {
+            for (int j = 0; j < set->count; j++) {
+                if ((set->addresses[j].address.ss_family == AF_INET) && (portOf(&set->addresses[j]) == portOf(address))) {
+                    address->v6only = 1;
+                }
+            }
+        }
+    }
+    for (int i = 0; i < set->count; i++) {
+        listenAddress* address = &set->addresses[i];
+        if (address->address.ss_family == AF_UNIX) {
+            unlink(((struct sockaddr_un*) &address->address)->sun_path);   // left over by an earlier run
+        }
+        set->fds[i] = openSocket(address, backlog, reusePort);
+        if ((set->fds[i] == -1) && (errno == EAFNOSUPPORT) && (address->address.ss_family == AF_INET6) &&
+            (address->v6only == 0)) {
+            // a kernel without IPv6 gets the IPv4 wildcard instead of the dual-stack socket
+            struct sockaddr_in* any = (struct sockaddr_in*) &address->address;
+            uint16_t port = portOf(address);
+            memset(address, 0, sizeof(listenAddress));
+            any->sin_family = AF_INET;
+            any->sin_port = htons(port);
+            any->sin_addr.s_addr = htonl(INADDR_ANY);
+            address->length = sizeof(struct sockaddr_in);
+            set->fds[i] = openSocket(address, backlog, reusePort);
+        }
+        if (set->fds[i] == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief opens a second set of sockets on the addresses of an opened set, for a listener thread. The IPv4 and
+ * IPv6 sockets are new ones with SO_REUSEPORT, the set must have been opened with it too. A unix socket can
+ * not be bound twice, the copy shares it with the set.
+ * @param set const listenSet*: the opened set
+ * @param copy listenSet*: receives the copy, it must not be closed with listen_closeSet()
+ * @param backlog int: maximal amount of pending connections per socket
+ * @return int: 0 in case of success, -1 on failure (errno is set), the new sockets are closed again
+ */
+int listen_copySet(const listenSet* set, listenSet* copy, int backlog) {
+    *copy = *set;
+    for (int i = 0; i < set->count; i++) {
+        if (set->addresses[i].address.ss_family == AF_UNIX) {
+            continue;
+        }
+        copy->fds[i] = openSocket(&set->addresses[i], backlog, 1);
+        if (copy->fds[i] == -1) {
+            int save_errno = errno;
+            for (int j = 0; j < i; j++) {
+                if (copy->fds[j] != set->fds[j]) {
+                    close(copy->fds[j]);
+                }
+            }
+            errno = save_errno;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief closes the sockets of the set in a child process of the server. The set stays unchanged and the
+ * unix sockets stay in the file system, they belong to the server.
+ * @param set const listenSet*: the set
+ */
+void listen_closeSockets(const listenSet* set) {
+    for (int i = 0; i < set->count; i++) {
+        if (set->fds[i] != -1) {
+            close(set->fds[i]);
+        }
+    }
+}
+
+/**
+ * @brief closes the sockets of the set and removes its unix sockets from the file system
+ * @param set listenSet*: the set
+ */
+void listen_closeSet(listenSet* set) {
+    for (int i = 0; i < set->count; i++) {
+        if (set->fds[i] == -1) {
+            continue;
+        }
+        close(set->fds[i]);
+        set->fds[i] = -1;
+        if (set->addresses[i].address.ss_family == AF_UNIX) {
+            unlink(((struct sockaddr_un*) &set->addresses[i].address)->sun_path);
+        }
+    }
+}
+
+/**
+ * @brief formats an address for the output: 0.0.0.0:port, [::]:port or unix:path
+ * @param address const listenAddress*: the address
+ * @param buffer char*: receives the text
+ * @param size size_t: size of buffer
+ */
+void listen_format(const listenAddress* address, char* buffer, size_t size) {
+    char host[INET6_ADDRSTRLEN];
+    if (address->address.ss_family == AF_UNIX) {
+        snprintf(buffer, size, "%s%s", LISTEN_UNIXPREFIX, ((const struct sockaddr_un*) &address->address)->sun_path);
+    } else if (address->address.ss_family == AF_INET6) {
+        inet_ntop(AF_INET6, &((const struct sockaddr_in6*) &address->address)->sin6_addr, host, sizeof(host));
+        snprintf(buffer, size, "[%s]:%u%s", host, portOf(address), (address->v6only == 0) ? " (dual-stack)" : "");
+    } else {
+        inet_ntop(AF_INET, &((const struct sockaddr_in*) &address->address)->sin_addr, host, sizeof(host));
+        snprintf(buffer, size, "%s:%u", host, portOf(address));
+    }
+}
+
+/**
+ * @brief creates a listening socket of an address, see listen_open()
+ * @param address const listenAddress*: the address, v6only -1 keeps the default of the kernel
+ * @param backlog int: maximal amount of pending connections
+ * @param reusePort int: 1 sets SO_REUSEPORT, ignored for a unix socket
+ * @return int: file descriptor of the listening socket, -1 on failure (errno is set)
+ */
+static int openSocket(const listenAddress* address, int backlog, int reusePort) {
+    int family = address->address.ss_family;
+    // close on exec: the business logic must not inherit the listening sockets
+    int fd_listen = socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_listen < 0) {
+        return -1;
+    }
+    int optval = 1;     // set reuse adress to 1;
+    int v6only = address->v6only;
+    if ((setsockopt(fd_listen, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) == -1) ||
+        ((reusePort == 1) && (family != AF_UNIX) &&
+         (setsockopt(fd_listen, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval)) == -1)) ||
+        ((family == AF_INET6) && (v6only != -1) &&
+         (setsockopt(fd_listen, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only)) == -1)) ||
+        (bind(fd_listen, (const struct sockaddr*) &address->address, address->length) == -1) ||
+        (listen(fd_listen, backlog) == -1)) {
+        int save_errno = errno;
+        close(fd_listen);
+        errno = save_errno;
+        return -1;
+    }
+    return fd_listen;
+}
+
+/**
+ * @brief appends the IPv6 wildcard with IPV6_V6ONLY off
+ * @param set listenSet*: the set, not full
+ * @param port uint16_t: the port
+ * @return int: 0 in case of success, -1 if the set is full (errno is set)
+ */
+static int addWildcard(listenSet* set, uint16_t port) {
+    if (set->count == LISTEN_MAXSOCKETS) {
+        errno = ENOSPC;
+        return -1;
+    }
+    listenAddress* address = &set->addresses[set->count];
+    memset(address, 0, sizeof(listenAddress));
+    struct sockaddr_in6* any = (struct sockaddr_in6*) &address->address;
+    any->sin6_family = AF_INET6;
+    any->sin6_port = htons(port);
+    any->sin6_addr = in6addr_any;
+    address->length = sizeof(struct sockaddr_in6);
+    address->v6only = 0;
+    set->fds[set->count++] = -1;
+    return 0;
+}
+
+/**
+ * @brief port of an IPv4 or IPv6 address
+ * @param address const listenAddress*: the address
+ * @return uint16_t: the port, 0 for a unix socket
+ */
+static uint16_t portOf(const listenAddress* address) {
+    if (address->address.ss_family == AF_INET) {
+        return ntohs(((const struct sockaddr_in*) &address->address)->sin_port);
+    }
+    if (address->address.ss_family == AF_INET6) {
+        return ntohs(((const struct sockaddr_in6*) &address->address)->sin6_port);
+    }
+    return 0;
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
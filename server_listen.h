@@ -0,0 +1,51 @@
+/**
+ * @file server_listen.h
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 08.12.18
+ *
+ * @brief Creation of the listening sockets of the simple message server
+ * TCP/IP Lecture Distributed Systems
+ */
+#ifndef SERVER_LISTEN_H
+#define SERVER_LISTEN_H
+
+#include <stddef.h>         // provides size_t
+#include <stdint.h>         // provides uint16_t
+#include <sys/socket.h>     // provides struct sockaddr, struct sockaddr_storage, socklen_t
+
+// --------------------------------------------------------------- defines --
+/** @brief maximal number of listening sockets of the server */
+#define LISTEN_MAXSOCKETS 16
+/** @brief prefix of a --listen address which is a unix socket */
+#define LISTEN_UNIXPREFIX "unix:"
+/** @brief --listen address of all interfaces, IPv4 and IPv6 */
+#define LISTEN_WILDCARD "*"
+/** @brief size of the text of an address formatted by listen_format() */
+#define LISTEN_MAXTEXT 128
+
+// -------------------------------------------------------------- typedefs --
+/** @brief An address the server listens on */
+typedef struct listenAddress {
+    struct sockaddr_storage address;    /**< IPv4, IPv6 or unix socket address */
+    socklen_t length;                   /**< Length of address */
+    int v6only;                         /**< IPV6_V6ONLY of an IPv6 socket, 0 accepts IPv4 too (dual-stack) */
+} listenAddress;
+
+/** @brief All listening sockets of the server, every engine accepts on all of them */
+typedef struct listenSet {
+    listenAddress addresses[LISTEN_MAXSOCKETS]; /**< The addresses */
+    int fds[LISTEN_MAXSOCKETS];                 /**< Listening socket per address, -1 if not open */
+    int count;                                  /**< Number of addresses */
+} listenSet;
+
+// ------------------------------------------------------------- functions --
+int listen_open(const struct sockaddr* address, socklen_t length, int backlog, int reusePort);
+int listen_add(listenSet* set, const char* spec, uint16_t port);
+int listen_openSet(listenSet* set, int backlog, int reusePort);
+int listen_copySet(const listenSet* set, listenSet* copy, int backlog);
+void listen_closeSet(listenSet* set);
+void listen_closeSockets(const listenSet* set);
+void listen_format(const listenAddress* address, char* buffer, size_t size);
+
+#endif // SERVER_LISTEN_H
@@ -0,0 +1,1199 @@
+/**
+ * @file server_logic.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 04.12.18
+ *
+ * @brief In-process business logic of the simple message server.
+ * The local handler appends the posted message to the message store of the bulletin board (server_store.c)
+ * and answers with the response page and the rendered bulletin board, the same framing as
+ * simple_message_server_logic. Every message is rendered once into a table row (fragment) which is kept for
+ * the life of the process, a post renders its own row only. A server which forks a process per connection
+ * renders the new rows before every fork, so the forked processes inherit them. The board page is sent as
+ * references to the fragments with writev(), compressed pages are cached in the in-memory cache of the process
+ * (server_cache.c).
+ * A framed request may offer codecs behind its length ("request=<length> deflate"), the pages are sent
+ * compressed then. A page is compressed once per version, the compressed record is cached beside the plain one.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#define _GNU_SOURCE         // provides MSG_MORE
+#include <stdlib.h>         // provides malloc(), realloc(), free()
+#include <stdio.h>          // provides snprintf()
+#include <string.h>         // provides memcpy(), strcmp(), memchr()
+#include <errno.h>          // provides errno
+#include <time.h>           // provides time(), strftime()
+#include <unistd.h>         // provides read(), write(), close()
+#include <sys/types.h>
+#include <sys/socket.h>     // provides send(), sendmsg(), MSG_NOSIGNAL
+#include <sys/uio.h>        // provides writev(), struct iovec
+#include <sys/sendfile.h>   // provides sendfile()
+#include <limits.h>         // provides IOV_MAX
+#include <pthread.h>        // provides pthread_mutex_lock()
+#include <zlib.h>           // provides compress2(), compressBound()
+#include "server_logic.h"
+#include "server_cache.h"   // provides cache_lookup()
+#include "server_store.h"   // provides store_append(), store_message()
+#include "server_metrics.h" // provides metrics_add(), metrics_observe()
+#include "trace.h"          // provides TRACE()
+
+// --------------------------------------------------------------- defines --
+/** @brief default file the bulletin board is stored in */
+#define LOGIC_BOARDFILE "simple_message_board.txt"
+/** @brief name of the response page in the response */
+#define LOGIC_RESPONSEFILE "vcs_tcpip_bulletin_board_response.html"
+/** @brief name of the bulletin board page in the response */
+#define LOGIC_BOARDPAGE "vcs_tcpip_bulletin_board.html"
+/** @brief size of the first allocation of a buffer */
+#define LOGIC_BUFFERSIZE 4096
+/** @brief key of the user field in the request */
+#define USER_KEY "user="
+/** @brief key of the optional image field in the request */
+#define IMG_KEY "img="
+/** @brief FIELD_DELIMITER defines the delimiter between the fields defined in the protocol */
+#define FIELD_DELIMITER '\n'
+
+/** @brief maximal length of the length line of a framed request or response */
+#define FRAME_HEADERLENGTH 32
+/** @brief suffix of the cache name of a record compressed with deflate */
+#define CACHE_DEFLATED ":" LOGIC_DEFLATENAME
+/** @brief first allocation of the fragments */
+#define FRAGMENT_INITIAL 64
+
+// -------------------------------------------------------------- typedefs --
+/** @brief One message rendered as a table row of the bulletin board page */
+typedef struct boardFragment {
+    char* data;                 /**< The rendered row */
+    size_t length;              /**< Length of data */
+    size_t before;              /**< Sum of the lengths of all fragments in front of this one */
+} boardFragment;
+
+// --------------------------------------------------------------- globals --
+/** @brief path of the message store of the bulletin board */
+static const char* boardPath = LOGIC_BOARDFILE;
+/** @brief protects the fragments */
+static pthread_mutex_t fragmentLock = PTHREAD_MUTEX_INITIALIZER;
+/** @brief the messages of the store rendered once each, in the order of the store, never freed */
+static boardFragment* fragments = NULL;
+/** @brief number of rendered fragments */
+static size_t fragmentCount = 0;
+/** @brief allocated elements of fragments */
+static size_t fragmentCapacity = 0;
+
+/** @brief html tags which may be used in a message, all other markup is escaped */
+static const char* const allowedTags[] = {"<strong>", "</strong>", "<em>", "</em>", "<br/>"};
+
+/** @brief head of both pages, the title is inserted between */
+static const char pageHead[] =
+        "<?xml version=\"1.0\" encoding=\"ISO-8859-15\"?>\n"
+        "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.0 Transitional//EN\"\n"
+        "\"http://www.w3.org/TR/xhtml1/DTD/xhtml1-transitional.dtd\">\n"
+        "<html>\n"
+        "  <head>\n"
+        "    <meta http-equiv=\"Content-Type\" content=\"text/html;\n"
+        "charset=ISO-8859-15\" />\n"
+        "    <link rel=\"stylesheet\" type=\"text/css\" href=\"tcpip.css\" />\n"
+        "    <title>Verteilte Computersysteme - TCP/IP -\n";
+
+/** @brief body of the response page after the title */
+static const char responseBody[] =
+        "Response</title>\n"
+        "  </head>\n"
+        "  <body>\n"
+        "    <hr/>\n"
+        "    <center>\n"
+        "       <h1>Verteilte Computersysteme - TCP/IP - Response</h1>\n"
+        "    </center>\n"
+        "    <hr/>\n"
+        "    <p align=left>\n"
+        "       Ihre Nachricht wurde erfolgreich dem VCS TCP/IP\n"
+        "       Bulletin Board hinzugef&uuml;gt. Sie finden das\n"
+        "       Bulletin Board unter <a href=\"" LOGIC_BOARDPAGE "\">" LOGIC_BOARDPAGE "</a>.\n"
+        "    </p>\n"
+        "    <hr/>\n"
+        "  </body>\n"
+        "</html>\n";
+
+/** @brief body of the bulletin board page after the title, before the messages */
+static const char boardBody[] =
+        "Bulletin Board</title>\n"
+        "  </head>\n"
+        "  <body>\n"
+        "    <hr/>\n"
+        "    <center>\n"
+        "       <h1>Verteilte Computersysteme - TCP/IP - Bulletin Board</h1>\n"
+        "    </center>\n"
+        "    <hr/>\n"
+        "    <table>\n";
+
+/** @brief end of the bulletin board page after the messages */
+static const char boardTail[] =
+        "    </table>\n"
+        "    <hr/>\n"
+        "  </body>\n"
+        "</html>\n";
+
+// ------------------------------------------------------------- functions --
+static int localHandle(const logicRequest* request, logicBuffer* response);
+static void localPrepare(void);
+static int boardAppend(const logicRequest* request);
+static int boardVersion(size_t* version);
+static int boardRender(logicBuffer* page, size_t* rendered);
+static int boardAppendPage(logicBuffer* response);
+static int boardAppendEncoded(logicBuffer* response, size_t version, unsigned encodings);
+static int renderFragments(size_t count);
+static size_t fragmentsLength(size_t count);
+static int renderMessage(logicBuffer* page, const storeMessage* record);
+static int appendFileHeader(logicBuffer* buffer, const char* name, size_t length);
+static int parseFrameLength(const char* frame, const char* newline, size_t* length, const char** end);
+static unsigned parseEncodings(const char* list, const char* end);
+static int appendMoved(logicBuffer* destination, logicBuffer* source);
+static int reserveFiles(logicBuffer* buffer, size_t additional);
+static int gatherPiece(struct iovec* vector, int count, const char* data, size_t length, size_t position,
+                       size_t sent);
+
+/** @brief table of all in-process handlers, searched by logic_find() */
+static const logicHandler handlers[] = {
+        {"local", localHandle, localPrepare},
+};
+
+/**
+ * @brief searches an in-process handler by its name
+ * @param name const char*: name of the handler
+ * @return const logicHandler*: the handler or NULL if there is none with this name
+ */
+const logicHandler* logic_find(const char* name) {
+    for (size_t i = 0; i < sizeof(handlers) / sizeof(handlers[0]); i++) {
+        if (strcmp(handlers[i].name, name) == 0) {
+            return &handlers[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief sets the file the local handler stores the bulletin board in
+ * @param path const char*: path of the file, must stay valid
+ */
+void logic_setBoardPath(const char* path) {
+    boardPath = path;
+}
+
+/**
+ * @brief parses a complete request: "user=<user>\n" ["img=<url>\n"] <message>
+ * @param raw const char*: received bytes
+ * @param length size_t: number of received bytes
+ * @param request logicRequest*: receives the fields, they point into raw
+ * @return int: 0 if the request is valid, -1 if not
+ */
+int logic_parseRequest(const char* raw, size_t length, logicRequest* request) {
+    size_t userKeyLength = strlen(USER_KEY), imgKeyLength = strlen(IMG_KEY);
+    const char* end = raw + length;
+
+    if ((length < userKeyLength) || (memcmp(raw, USER_KEY, userKeyLength) != 0)) {
+        return -1;
+    }
+    const char* user = raw + userKeyLength;
+    const char* delimiter = memchr(user, FIELD_DELIMITER, (size_t) (end - user));
+    if ((delimiter == NULL) || (delimiter == user)) {
+        return -1;  // user missing or empty
+    }
+    request->user = user;
+    request->userLength = (size_t) (delimiter - user);
+    request->img = NULL;
+    request->imgLength = 0;
+    request->encodings = 0;
+
+    const char* next = delimiter + 1;
+    if (((size_t) (end - next) >= imgKeyLength) && (memcmp(next, IMG_KEY, imgKeyLength) == 0)) {
+        const char* img = next + imgKeyLength;
+        delimiter = memchr(img, FIELD_DELIMITER, (size_t) (end - img));
+        if (delimiter == NULL) {
+            return -1;
+        }
+        request->img = img;
+        request->imgLength = (size_t) (delimiter - img);
+        next = delimiter + 1;
+    }
+    request->message = next;
+    request->messageLength = (size_t) (end - next);
+    return 0;
+}
+
+/**
+ * @brief parses the request and lets the handler build the response
+ * @param handler const logicHandler*: the business logic
+ * @param raw const char*: received bytes
+ * @param length size_t: number of received bytes
+ * @param encodings unsigned: LOGIC_ENCODING_* the client accepts
+ * @param response logicBuffer*: receives the complete response
+ * @return int: 0 in case of success, -1 if no response could be built
+ */
+int logic_process(const logicHandler* handler, const char* raw, size_t length, unsigned encodings,
+                  logicBuffer* response) {
+    uint64_t started = metrics_now();
+    size_t before = logic_responseLength(response);
+    logicRequest request;
+    int result;
+    if ((length > LOGIC_MAXREQUEST) || (logic_parseRequest(raw, length, &request) == -1)) {
+        result = handler->handle(NULL, response);
+    } else {
+        request.encodings = encodings;
+        result = handler->handle(&request, response);
+    }
+    size_t built = logic_responseLength(response) - before;
+    metrics_add(METRICS_REQUESTS, 1);
+    metrics_add(METRICS_REQUESTBYTES, (int64_t) length);
+    metrics_add(METRICS_RESPONSEBYTES, (int64_t) built);
+    TRACE(TRACE_REQUEST, length, 0);
+    TRACE(TRACE_RESPONSE, built, (uint32_t) result);
+    metrics_observe(METRICS_PROCESS, metrics_now() - started);
+    return result;
+}
+
+/**
+ * @brief serves a connection completely: reads the requests until the client shuts down its write
+ * direction, processes them and sends the responses. Does not close fd_connected.
+ * @param handler const logicHandler*: the business logic
+ * @param fd_connected int: the connected socket
+ * @return int: 0 in case of success, -1 on failure (errno is set)
+ */
+int logic_serveConnection(const logicHandler* handler, int fd_connected) {
+    return logic_serveStreams(handler, fd_connected, fd_connected);
+}
+
+/**
+ * @brief serves the requests read from one descriptor with the responses written to another, like
+ * logic_serveConnection(). The standalone logic is started with the connection as stdin and stdout,
+ * which may also be pipes. Does not close the descriptors.
+ * @param handler const logicHandler*: the business logic
+ * @param fd_in int: the requests are read from it until the end of file
+ * @param fd_out int: the responses are written to it
+ * @return int: 0 in case of success, -1 on failure (errno is set)
+ */
+int logic_serveStreams(const logicHandler* handler, int fd_in, int fd_out) {
+    logicSession session;
+    memset(&session, 0, sizeof(session));
+    int result = -1;
+
+    while (1) {
+        // pipelined requests received together are answered with one send
+        if (logic_sessionPending(&session)) {
+            if (logic_sendResponse(fd_out, &session.response, &session.send) != 1) {
+                break;
+            }
+            logic_sessionSent(&session);
+        }
+        if (logic_sessionFinished(&session)) {
+            result = 0;
+            break;
+        }
+        if (logic_reserve(&session.request, LOGIC_BUFFERSIZE) == -1) {
+            break;
+        }
+        ssize_t received = read(fd_in, session.request.data + session.request.length,
+                                session.request.capacity - session.request.length);
+        if (received == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (received == 0) {
+            session.eof = 1;    // client has sent everything
+        }
+        session.request.length += (size_t) received;
+        if (logic_sessionReceived(handler, &session) == -1) {
+            break;
+        }
+    }
+    logic_freeSession(&session);
+    return result;
+}
+
+/**
+ * @brief processes everything received so far. The first bytes decide the framing: a legacy request is
+ * processed once the client shut down its write direction (or the request is too long), framed requests
+ * ("request=<length>\n" followed by the request) are processed as soon as they are complete and answered
+ * with "response=<length>\n" followed by the response. The codecs the client accepts may follow the length,
+ * separated by spaces, unknown codecs are ignored. The responses are appended to session->response.
+ * @param handler const logicHandler*: the business logic
+ * @param session logicSession*: the session, request.length and eof updated by the caller
+ * @return int: 0 in case of success, -1 if the connection must be closed (broken frame, out of memory)
+ */
+int logic_sessionReceived(const logicHandler* handler, logicSession* session) {
+    logicBuffer* request = &session->request;
+    if (session->framing == LOGIC_FRAMING_UNKNOWN) {
+        size_t keyLength = strlen(LOGIC_REQUESTKEY);
+        size_t compared = (request->length < keyLength) ? request->length : keyLength;
+        if (memcmp(request->data, LOGIC_REQUESTKEY, compared) != 0) {
+            session->framing = LOGIC_FRAMING_LEGACY;
+        } else if (compared == keyLength) {
+            session->framing = LOGIC_FRAMING_FRAMED;
+        } else if (session->eof) {
+            session->framing = LOGIC_FRAMING_LEGACY;    // too short for a frame, e.g. an empty request
+        } else {
+            return 0;
+        }
+    }
+
+    if (session->framing == LOGIC_FRAMING_LEGACY) {
+        // read one byte more than allowed, the request is rejected as too long then
+        if (!session->done && (session->eof || (request->length > LOGIC_MAXREQUEST))) {
+            session->done = 1;
+            return logic_process(handler, request->data, request->length, 0, &session->response);
+        }
+        return 0;
+    }
+
+    size_t consumed = 0;
+    while (consumed < request->length) {
+        const char* frame = request->data + consumed;
+        size_t available = request->length - consumed;
+        const char* newline = memchr(frame, FIELD_DELIMITER, available < FRAME_HEADERLENGTH ? available
+                                                                                         : FRAME_HEADERLENGTH);
+        if (newline == NULL) {
+            if (available >= FRAME_HEADERLENGTH) {
+                errno = EPROTO;
+                return -1;
+            }
+            break;  // length line not complete
+        }
+        const char* end = NULL;
+        size_t length = 0;
+        if (parseFrameLength(frame, newline, &length, &end) == -1) {
+            errno = EPROTO;
+            return -1;
+        }
+        unsigned encodings = parseEncodings(end, newline);
+        size_t headerLength = (size_t) (newline - frame) + 1;
+        if (available - headerLength < length) {
+            break;  // request not complete
+        }
+        logicBuffer inner = {NULL, 0, 0, NULL, 0, 0};
+        char header[FRAME_HEADERLENGTH];
+        int result = logic_process(handler, frame + headerLength, length, encodings, &inner);
+        if (result == 0) {
+            int fieldLength = snprintf(header, sizeof(header), LOGIC_RESPONSEKEY "%zu\n",
+                                       logic_responseLength(&inner));
+            result = logic_append(&session->response, header, (size_t) fieldLength);
+        }
+        if ((result == -1) || (appendMoved(&session->response, &inner) == -1)) {
+            logic_freeBuffer(&inner);
+            return -1;
+        }
+        consumed += headerLength + length;
+    }
+    // keep the incomplete rest at the start of the buffer
+    memmove(request->data, request->data + consumed, request->length - consumed);
+    request->length -= consumed;
+    return 0;
+}
+
+/**
+ * @brief checks for responses which are not sent yet
+ * @param session const logicSession*: the session
+ * @return int: 1 if there is something to send, 0 if not
+ */
+int logic_sessionPending(const logicSession* session) {
+    return (logic_responseLength(&session->response) > 0) ? 1 : 0;
+}
+
+/**
+ * @brief releases the responses after they were sent completely
+ * @param session logicSession*: the session
+ */
+void logic_sessionSent(logicSession* session) {
+    logic_freeBuffer(&session->response);
+    memset(&session->send, 0, sizeof(session->send));
+}
+
+/**
+ * @brief checks if the connection can be closed, all responses must have been sent
+ * @param session const logicSession*: the session
+ * @return int: 1 if no further request will be answered, 0 if not
+ */
+int logic_sessionFinished(const logicSession* session) {
+    if (session->framing == LOGIC_FRAMING_LEGACY) {
+        return session->done;
+    }
+    // an incomplete frame at the end of a framed connection is dropped
+    return session->eof;
+}
+
+/**
+ * @brief frees the buffers of the session
+ * @param session logicSession*: the session
+ */
+void logic_freeSession(logicSession* session) {
+    logic_freeBuffer(&session->request);
+    logic_freeBuffer(&session->response);
+    memset(&session->send, 0, sizeof(session->send));
+}
+
+/**
+ * @brief appends the status field to the response
+ * @param buffer logicBuffer*: the response
+ * @param status int: status code
+ * @return int: 0 in case of success, -1 if out of memory
+ */
+int logic_appendStatus(logicBuffer* buffer, int status) {
+    char field[32];
+    int length = snprintf(field, sizeof(field), "status=%d\n", status);
+    return logic_append(buffer, field, (size_t) length);
+}
+
+/**
+ * @brief appends a file record (file=, len=, content) to the response
+ * @param buffer logicBuffer*: the response
+ * @param name const char*: filename the client stores the content in
+ * @param content const char*: content of the file
+ * @param length size_t: length of the content
+ * @return int: 0 in case of success, -1 if out of memory
+ */
+int logic_appendFile(logicBuffer* buffer, const char* name, const char* content, size_t length) {
+    if (appendFileHeader(buffer, name, length) == -1) {
+        return -1;
+    }
+    return logic_append(buffer, content, length);
+}
+
+/**
+ * @brief appends a file record to the response, compressed with a codec the client accepts (file=, enc=, len=,
+ * compressed content) if this saves bytes, otherwise the plain record
+ * @param buffer logicBuffer*: the response
+ * @param name const char*: filename the client stores the content in
+ * @param content const char*: content of the file
+ * @param length size_t: length of the content
+ * @param encodings unsigned: LOGIC_ENCODING_* the client accepts
+ * @return int: 0 in case of success, -1 if out of memory
+ */
+int logic_appendFileEncoded(logicBuffer* buffer, const char* name, const char* content, size_t length,
+                            unsigned encodings) {
+    if (!(encodings & LOGIC_ENCODING_DEFLATE) || (length < LOGIC_COMPRESSMINIMUM)) {
+        return logic_appendFile(buffer, name, content, length);
+    }
+    uLongf compressedLength = compressBound((uLong) length);
+    char* compressed = malloc(compressedLength);
+    if (compressed == NULL) {
+        return -1;
+    }
+    int result;
+    if ((compress2((Bytef*) compressed, &compressedLength, (const Bytef*) content, (uLong) length,
+                   Z_DEFAULT_COMPRESSION) != Z_OK) || (compressedLength >= length)) {
+        result = logic_appendFile(buffer, name, content, length);
+    } else {
+        char field[64];
+        int fieldLength = snprintf(field, sizeof(field), "\n" LOGIC_ENCODINGKEY LOGIC_DEFLATENAME "\nlen=%zu\n",
+                                   (size_t) compressedLength);
+        result = ((logic_append(buffer, "file=", 5) == 0) && (logic_append(buffer, name, strlen(name)) == 0) &&
+                  (logic_append(buffer, field, (size_t) fieldLength) == 0) &&
+                  (logic_append(buffer, compressed, compressedLength) == 0)) ? 0 : -1;
+    }
+    free(compressed);
+    return result;
+}
+
+/**
+ * @brief appends a file record (file=, len=) to the response whose content is sent from an open file
+ * @param buffer logicBuffer*: the response
+ * @param name const char*: filename the client stores the content in
+ * @param fd int: the open file, owned by the response afterwards, closed on failure as well
+ * @param offset off_t: start of the content in the file
+ * @param length size_t: length of the content
+ * @return int: 0 in case of success, -1 if out of memory
+ */
+int logic_appendFileDescriptor(logicBuffer* buffer, const char* name, int fd, off_t offset, size_t length) {
+    if ((reserveFiles(buffer, 1) == -1) || (appendFileHeader(buffer, name, length) == -1)) {
+        close(fd);
+        return -1;
+    }
+    logicFile* file = &buffer->files[buffer->fileCount++];
+    file->position = buffer->length;
+    file->fd = fd;
+    file->offset = offset;
+    file->length = length;
+    file->memory = NULL;
+    return 0;
+}
+
+/**
+ * @brief appends content by reference, it is sent from memory without being copied into the buffer
+ * @param buffer logicBuffer*: the buffer
+ * @param content const char*: the content, must stay unchanged until the buffer is freed
+ * @param length size_t: length of the content
+ * @return int: 0 in case of success, -1 if out of memory
+ */
+int logic_appendReference(logicBuffer* buffer, const char* content, size_t length) {
+    if (reserveFiles(buffer, 1) == -1) {
+        return -1;
+    }
+    logicFile* file = &buffer->files[buffer->fileCount++];
+    file->position = buffer->length;
+    file->fd = -1;
+    file->offset = 0;
+    file->length = length;
+    file->memory = content;
+    return 0;
+}
+
+/**
+ * @brief appends raw bytes to the buffer
+ * @return int: 0 in case of success, -1 if out of memory
+ */
+int logic_append(logicBuffer* buffer, const char* content, size_t length) {
+    if (length == 0) {
+        return 0;
+    }
+    if (logic_reserve(buffer, length) == -1) {
+        return -1;
+    }
+    memcpy(buffer->data + buffer->length, content, length);
+    buffer->length += length;
+    return 0;
+}
+
+/**
+ * @brief appends text html escaped, the allowed tags of a message are kept
+ * @param buffer logicBuffer*: the page
+ * @param text const char*: text to escape, not terminated
+ * @param length size_t: length of text
+ * @return int: 0 in case of success, -1 if out of memory
+ */
+int logic_appendEscaped(logicBuffer* buffer, const char* text, size_t length) {
+    size_t i = 0;
+    while (i < length) {
+        const char* replacement = NULL;
+        size_t consumed = 1;
+        switch (text[i]) {
+            case '<':
+                replacement = "&lt;";
+                for (size_t t = 0; t < sizeof(allowedTags) / sizeof(allowedTags[0]); t++) {
+                    size_t tagLength = strlen(allowedTags[t]);
+                    if ((length - i >= tagLength) && (memcmp(text + i, allowedTags[t], tagLength) == 0)) {
+                        replacement = allowedTags[t];
+                        consumed = tagLength;
+                        break;
+                    }
+                }
+                break;
+            case '>':
+                replacement = "&gt;";
+                break;
+            case '&':
+                replacement = "&amp;";
+                break;
+            case '"':
+                replacement = "&quot;";
+                break;
+            default:
+                break;
+        }
+        int status = (replacement == NULL) ? logic_append(buffer, text + i, 1)
+                                           : logic_append(buffer, replacement, strlen(replacement));
+        if (status == -1) {
+            return -1;
+        }
+        i += consumed;
+    }
+    return 0;
+}
+
+/**
+ * @brief frees the content of the buffer
+ * @param buffer logicBuffer*: the buffer, is empty afterwards
+ */
+void logic_freeBuffer(logicBuffer* buffer) {
+    for (size_t i = 0; i < buffer->fileCount; i++) {
+        if (buffer->files[i].fd != -1) {
+            close(buffer->files[i].fd);
+        }
+    }
+    free(buffer->files);
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+    buffer->files = NULL;
+    buffer->fileCount = 0;
+    buffer->fileCapacity = 0;
+}
+
+/**
+ * @brief length of the complete response including the contents sent from files
+ * @param response const logicBuffer*: the response
+ * @return size_t: bytes to send
+ */
+size_t logic_responseLength(const logicBuffer* response) {
+    size_t length = response->length;
+    for (size_t i = 0; i < response->fileCount; i++) {
+        length += response->files[i].length;
+    }
+    return length;
+}
+
+/**
+ * @brief sends the response from the given position on. The buffer and the contents referenced in memory are
+ * gathered into one sendmsg() (writev() on a pipe), MSG_MORE while more follows so the pieces share segments,
+ * the file contents are sent with sendfile() without a copy to user space. Works on blocking and non blocking
+ * sockets. The gathering starts at the file reached before, not at the first one.
+ * @param fd_connected int: the connected socket
+ * @param response const logicBuffer*: the response, may grow at its end between the calls
+ * @param state logicSendState*: progress of the response, advanced
+ * @return int: 1 if the response is sent completely, 0 if the socket is full, -1 on failure (errno is set)
+ */
+int logic_sendResponse(int fd_connected, const logicBuffer* response, logicSendState* state) {
+    size_t total = logic_responseLength(response);
+    while (1) {
+        // the buffer and the contents in memory up to the next file are gathered for one writev()
+        struct iovec vector[IOV_MAX];
+        int count = 0;
+        size_t gathered = state->sent;
+        const logicFile* pending = NULL;
+        size_t pendingPosition = 0;
+        // start of the current piece in the response and in data
+        size_t streamPosition = state->position;
+        size_t bufferPosition = (state->piece > 0) ? response->files[state->piece - 1].position : 0;
+        for (size_t index = state->piece; (index <= response->fileCount) && (count < IOV_MAX); index++) {
+            const logicFile* file = (index < response->fileCount) ? &response->files[index] : NULL;
+            size_t bufferEnd = (file != NULL) ? file->position : response->length;
+            count = gatherPiece(vector, count, response->data + bufferPosition, bufferEnd - bufferPosition,
+                                streamPosition, state->sent);
+            streamPosition += bufferEnd - bufferPosition;
+            bufferPosition = bufferEnd;
+            if ((file == NULL) || (count == IOV_MAX)) {
+                break;
+            }
+            if (file->memory != NULL) {
+                count = gatherPiece(vector, count, file->memory, file->length, streamPosition, state->sent);
+            } else if (state->sent < streamPosition + file->length) {
+                // a file is sent with sendfile() once the contents in front of it are sent
+                if (count == 0) {
+                    pending = file;
+                    pendingPosition = streamPosition;
+                }
+                break;
+            }
+            streamPosition += file->length;
+        }
+        for (int i = 0; i < count; i++) {
+            gathered += vector[i].iov_len;
+        }
+
+        ssize_t written;
+        if (count > 0) {
+            struct msghdr message = {.msg_iov = vector, .msg_iovlen = (size_t) count};
+            written = sendmsg(fd_connected, &message, MSG_NOSIGNAL | ((gathered < total) ? MSG_MORE : 0));
+            if ((written == -1) && (errno == ENOTSOCK)) {
+                written = writev(fd_connected, vector, count);
+            }
+        } else if (pending != NULL) {
+            off_t offset = pending->offset + (off_t) (state->sent - pendingPosition);
+            written = sendfile(fd_connected, pending->fd, &offset, pendingPosition + pending->length - state->sent);
+            if (written == 0) {
+                errno = EIO;    // the file is shorter than announced
+                return -1;
+            }
+        } else {
+            return 1;
+        }
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? 0 : -1;
+        }
+        state->sent += (size_t) written;
+        // skip the files sent completely together with the buffer part in front of them
+        while (state->piece < response->fileCount) {
+            const logicFile* file = &response->files[state->piece];
+            size_t pieceStart = (state->piece > 0) ? response->files[state->piece - 1].position : 0;
+            size_t pieceEnd = state->position + (file->position - pieceStart) + file->length;
+            if (pieceEnd > state->sent) {
+                break;
+            }
+            state->position = pieceEnd;
+            state->piece++;
+        }
+    }
+}
+
+/**
+ * @brief reads the contents of the files into the buffer, for transports without sendfile()
+ * @param response logicBuffer*: the response, has no files afterwards
+ * @return int: 0 in case of success, -1 on failure (errno is set)
+ */
+int logic_inlineFiles(logicBuffer* response) {
+    if (response->fileCount == 0) {
+        return 0;
+    }
+    logicBuffer inlined = {NULL, 0, 0, NULL, 0, 0};
+    size_t bufferPosition = 0;
+    for (size_t i = 0; i < response->fileCount; i++) {
+        const logicFile* file = &response->files[i];
+        if ((logic_append(&inlined, response->data + bufferPosition, file->position - bufferPosition) == -1) ||
+            (logic_reserve(&inlined, file->length) == -1)) {
+            logic_freeBuffer(&inlined);
+            return -1;
+        }
+        if (file->memory != NULL) {
+            memcpy(inlined.data + inlined.length, file->memory, file->length);
+        }
+        size_t done = (file->memory != NULL) ? file->length : 0;
+        while (done < file->length) {
+            ssize_t received = pread(file->fd, inlined.data + inlined.length + done, file->length - done,
+                                     file->offset + (off_t) done);
+            if ((received == -1) && (errno == EINTR)) {
+                continue;
+            }
+            if (received <= 0) {
+                if (received == 0) {
+                    errno = EIO;
+                }
+                logic_freeBuffer(&inlined);
+                return -1;
+            }
+            done += (size_t) received;
+        }
+        inlined.length += file->length;
+        bufferPosition = file->position;
+    }
+    if (logic_append(&inlined, response->data + bufferPosition, response->length - bufferPosition) == -1) {
+        logic_freeBuffer(&inlined);
+        return -1;
+    }
+    logic_freeBuffer(response);
+    *response = inlined;
+    return 0;
+}
+
+/**
+ * @brief local bulletin board handler: stores the message and answers with the response page and the board
+ * @param request const logicRequest*: the parsed request, NULL if it was invalid
+ * @param response logicBuffer*: receives the response
+ * @return int: 0 in case of success, -1 if out of memory
+ */
+static int localHandle(const logicRequest* request, logicBuffer* response) {
+    if ((request == NULL) || (boardAppend(request) == -1)) {
+        return logic_appendStatus(response, LOGIC_STATUS_ERROR);
+    }
+    if (logic_appendStatus(response, LOGIC_STATUS_OK) == -1) {
+        return -1;
+    }
+    // the response page never changes, it is cached in version 0
+    unsigned encodings = request->encodings & LOGIC_ENCODING_DEFLATE;
+    const char* responseKey = encodings ? LOGIC_RESPONSEFILE CACHE_DEFLATED : LOGIC_RESPONSEFILE;
+    int cached = cache_lookup(responseKey, 0, response);
+    if (cached == -1) {
+        return -1;
+    }
+    if (cached == 0) {
+        logicBuffer page = {NULL, 0, 0, NULL, 0, 0};
+        int result = -1;
+        if ((logic_append(&page, pageHead, sizeof(pageHead) - 1) == 0) &&
+            (logic_append(&page, responseBody, sizeof(responseBody) - 1) == 0)) {
+            size_t recordStart = response->length;
+            result = logic_appendFileEncoded(response, LOGIC_RESPONSEFILE, page.data, page.length, encodings);
+            if (result == 0) {
+                cache_store(responseKey, 0, response->data + recordStart, response->length - recordStart);
+            }
+        }
+        logic_freeBuffer(&page);
+        if (result == -1) {
+            return -1;
+        }
+    }
+    if (encodings) {
+        size_t version;
+        if (boardVersion(&version) == -1) {
+            return -1;
+        }
+        return boardAppendEncoded(response, version, encodings);
+    }
+    return boardAppendPage(response);
+}
+
+/**
+ * @brief renders the rows of the messages posted since the last call, in the server before it forks the process
+ * of a connection. Otherwise every forked process would render all rows again and throw them away. A failure
+ * only leaves the rows to the forked process.
+ */
+static void localPrepare(void) {
+    size_t count;
+    if (boardVersion(&count) == -1) {
+        return;
+    }
+    pthread_mutex_lock(&fragmentLock);
+    renderFragments(count);
+    pthread_mutex_unlock(&fragmentLock);
+}
+
+/**
+ * @brief appends the bulletin board page to the response. The rows of messages not rendered before are
+ * rendered, the page is appended as references to its parts: head, the rows newest first and tail.
+ * @param response logicBuffer*: the response
+ * @return int: 0 in case of success, -1 on failure
+ */
+static int boardAppendPage(logicBuffer* response) {
+    size_t count;
+    if (boardVersion(&count) == -1) {
+        return -1;
+    }
+    pthread_mutex_lock(&fragmentLock);
+    size_t length = sizeof(pageHead) - 1 + sizeof(boardBody) - 1 + sizeof(boardTail) - 1;
+    int result = -1;
+    if ((renderFragments(count) == 0) && (reserveFiles(response, count + 3) == 0) &&
+        (appendFileHeader(response, LOGIC_BOARDPAGE, length + fragmentsLength(count)) == 0)) {
+        // the references cannot fail any more, the files are reserved
+        logic_appendReference(response, pageHead, sizeof(pageHead) - 1);
+        logic_appendReference(response, boardBody, sizeof(boardBody) - 1);
+        for (size_t i = count; i > 0; i--) {
+            logic_appendReference(response, fragments[i - 1].data, fragments[i - 1].length);
+        }
+        logic_appendReference(response, boardTail, sizeof(boardTail) - 1);
+        result = 0;
+    }
+    pthread_mutex_unlock(&fragmentLock);
+    return result;
+}
+
+/**
+ * @brief appends the bulletin board compressed. The compressed record is taken from the cache if it was built
+ * from the current number of messages, otherwise the page is assembled, compressed and the record is cached,
+ * so the page of a version is compressed once.
+ * @param response logicBuffer*: the response
+ * @param version size_t: current number of messages
+ * @param encodings unsigned: LOGIC_ENCODING_* the client accepts, not 0
+ * @return int: 0 in case of success, -1 on failure
+ */
+static int boardAppendEncoded(logicBuffer* response, size_t version, unsigned encodings) {
+    int cached = cache_lookup(LOGIC_BOARDPAGE CACHE_DEFLATED, version, response);
+    if (cached != 0) {
+        return (cached == 1) ? 0 : -1;
+    }
+    logicBuffer page = {NULL, 0, 0, NULL, 0, 0};
+    if (boardRender(&page, &version) == -1) {
+        logic_freeBuffer(&page);
+        return -1;
+    }
+    size_t recordStart = response->length;
+    int result = logic_appendFileEncoded(response, LOGIC_BOARDPAGE, page.data, page.length, encodings);
+    if (result == 0) {
+        cache_store(LOGIC_BOARDPAGE CACHE_DEFLATED, version, response->data + recordStart,
+                    response->length - recordStart);
+    }
+    logic_freeBuffer(&page);
+    return result;
+}
+
+/**
+ * @brief appends the message to the message store
+ * @param request const logicRequest*: the parsed request
+ * @return int: 0 in case of success, -1 on failure
+ */
+static int boardAppend(const logicRequest* request) {
+    storeMessage message = {(long) time(NULL), request->user, request->userLength, request->img,
+                            request->imgLength, request->message, request->messageLength};
+    if (store_attach(boardPath) == -1) {
+        return -1;
+    }
+    return store_append(&message);
+}
+
+/**
+ * @brief determines the version of the bulletin board, the number of messages grows with every post
+ * @param version size_t*: receives the number of committed messages
+ * @return int: 0 in case of success, -1 on failure
+ */
+static int boardVersion(size_t* version) {
+    if (store_attach(boardPath) == -1) {
+        return -1;
+    }
+    return store_count(version);
+}
+
+/**
+ * @brief assembles the bulletin board page in one piece from the rendered rows, newest message first
+ * @param page logicBuffer*: receives the page
+ * @param rendered size_t*: receives the number of messages on the page
+ * @return int: 0 in case of success, -1 on failure
+ */
+static int boardRender(logicBuffer* page, size_t* rendered) {
+    size_t count;
+    if (boardVersion(&count) == -1) {
+        return -1;
+    }
+    pthread_mutex_lock(&fragmentLock);
+    size_t length = sizeof(pageHead) - 1 + sizeof(boardBody) - 1 + sizeof(boardTail) - 1;
+    int result = -1;
+    if ((renderFragments(count) == 0) && (logic_reserve(page, length + fragmentsLength(count)) == 0)) {
+        logic_append(page, pageHead, sizeof(pageHead) - 1);
+        logic_append(page, boardBody, sizeof(boardBody) - 1);
+        for (size_t i = count; i > 0; i--) {
+            logic_append(page, fragments[i - 1].data, fragments[i - 1].length);
+        }
+        logic_append(page, boardTail, sizeof(boardTail) - 1);
+        result = 0;
+    }
+    pthread_mutex_unlock(&fragmentLock);
+    *rendered = count;
+    return result;
+}
+
+/**
+ * @brief renders the messages of the store which have no fragment yet, called with fragmentLock held. A
+ * message never changes, so its row is rendered once, escaped and with its date, and kept.
+ * @param count size_t: number of messages which need a fragment
+ * @return int: 0 in case of success, -1 on failure
+ */
+static int renderFragments(size_t count) {
+    logicBuffer row = {NULL, 0, 0, NULL, 0, 0};
+    int result = 0;
+    while ((result == 0) && (fragmentCount < count)) {
+        if (fragmentCount == fragmentCapacity) {
+            size_t capacity = (fragmentCapacity == 0) ? FRAGMENT_INITIAL : 2 * fragmentCapacity;
+            boardFragment* grown = realloc(fragments, capacity * sizeof(boardFragment));
+            if (grown == NULL) {
+                result = -1;
+                break;
+            }
+            fragments = grown;
+            fragmentCapacity = capacity;
+        }
+        storeMessage message;
+        row.length = 0;
+        if ((store_message(fragmentCount, &message) == -1) || (renderMessage(&row, &message) == -1)) {
+            result = -1;
+            break;
+        }
+        boardFragment* fragment = &fragments[fragmentCount];
+        fragment->data = malloc(row.length);
+        if (fragment->data == NULL) {
+            result = -1;
+            break;
+        }
+        memcpy(fragment->data, row.data, row.length);
+        fragment->length = row.length;
+        fragment->before = fragmentsLength(fragmentCount);
+        fragmentCount++;
+    }
+    logic_freeBuffer(&row);
+    return result;
+}
+
+/**
+ * @brief sums the lengths of the first fragments without walking them
+ * @param count size_t: number of fragments, all of them rendered
+ * @return size_t: their total length
+ */
+static size_t fragmentsLength(size_t count) {
+    return (count == 0) ? 0 : fragments[count - 1].before + fragments[count - 1].length;
+}
+
+/**
+ * @brief renders one message as a table row of the bulletin board
+ * @param page logicBuffer*: the page
+ * @param record const storeMessage*: the message
+ * @return int: 0 in case of success, -1 if out of memory
+ */
+static int renderMessage(logicBuffer* page, const storeMessage* record) {
+    char date[64];
+    time_t posted = (time_t) record->timestamp;
+    struct tm postedTm;
+    size_t dateLength = strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime_r(&posted, &postedTm));
+
+    if (logic_append(page, "      <tr>\n        <td>", 23) == -1) {
+        return -1;
+    }
+    if (record->imgLength > 0) {
+        if ((logic_append(page, "<img src=\"", 10) == -1) ||
+            (logic_appendEscaped(page, record->img, record->imgLength) == -1) ||
+            (logic_append(page, "\" alt=\"User Image\" width=\"64\"/>", 31) == -1)) {
+            return -1;
+        }
+    }
+    if ((logic_append(page, "</td>\n        <td><strong>", 26) == -1) ||
+        (logic_appendEscaped(page, record->user, record->userLength) == -1) ||
+        (logic_append(page, "</strong><br/>", 14) == -1) ||
+        (logic_append(page, date, dateLength) == -1) ||
+        (logic_append(page, "</td>\n        <td>", 18) == -1) ||
+        (logic_appendEscaped(page, record->message, record->messageLength) == -1) ||
+        (logic_append(page, "</td>\n      </tr>\n", 18) == -1)) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief makes sure the buffer has room for additional bytes, grows by doubling
+ * @param buffer logicBuffer*: the buffer
+ * @param additional size_t: bytes needed after the used part
+ * @return int: 0 in case of success, -1 if out of memory
+ */
+int logic_reserve(logicBuffer* buffer, size_t additional) {
+    if (buffer->capacity - buffer->length >= additional) {
+        return 0;
+    }
+    size_t capacity = (buffer->capacity == 0) ? LOGIC_BUFFERSIZE : buffer->capacity;
+    while (capacity - buffer->length < additional) {
+        capacity *= 2;
+    }
+    char* grown = realloc(buffer->data, capacity);
+    if (grown == NULL) {
+        return -1;
+    }
+    buffer->data = grown;
+    buffer->capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief appends the header of a file record (file=, len=) to the response
+ * @return int: 0 in case of success, -1 if out of memory
+ */
+static int appendFileHeader(logicBuffer* buffer, const char* name, size_t length) {
+    char field[64];
+    int fieldLength = snprintf(field, sizeof(field), "\nlen=%zu\n", length);
+    if ((logic_append(buffer, "file=", 5) == -1) || (logic_append(buffer, name, strlen(name)) == -1) ||
+        (logic_append(buffer, field, (size_t) fieldLength) == -1)) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief parses the length line of a framed request: the request key, at least one digit and optionally the
+ * codecs after a space
+ * @param frame const char*: start of the length line
+ * @param newline const char*: end of the length line
+ * @param length size_t*: receives the length, at most LOGIC_MAXREQUEST
+ * @param end const char*: receives the end of the digits, the newline or the space in front of the codecs
+ * @return int: 0 in case of success, -1 if the line is invalid
+ */
+static int parseFrameLength(const char* frame, const char* newline, size_t* length, const char** end) {
+    size_t keyLength = strlen(LOGIC_REQUESTKEY);
+    if (((size_t) (newline - frame) <= keyLength) || (memcmp(frame, LOGIC_REQUESTKEY, keyLength) != 0)) {
+        return -1;
+    }
+    const char* digits = frame + keyLength;
+    const char* position = digits;
+    size_t result = 0;
+    while ((position < newline) && (*position != ' ')) {
+        unsigned digit = (unsigned) (*position - '0');
+        if ((digit > 9) || (result > (LOGIC_MAXREQUEST - digit) / 10)) {
+            return -1;
+        }
+        result = result * 10 + digit;
+        position++;
+    }
+    if (position == digits) {
+        return -1;
+    }
+    *length = result;
+    *end = position;
+    return 0;
+}
+
+/**
+ * @brief parses the codecs behind the length of a framed request
+ * @param list const char*: behind the length, a space in front of every codec
+ * @param end const char*: end of the length line
+ * @return unsigned: LOGIC_ENCODING_* of the known codecs
+ */
+static unsigned parseEncodings(const char* list, const char* end) {
+    unsigned encodings = 0;
+    size_t nameLength = strlen(LOGIC_DEFLATENAME);
+    while (list < end) {
+        const char* name = list + 1;
+        const char* next = memchr(name, ' ', (size_t) (end - name));
+        if (next == NULL) {
+            next = end;
+        }
+        if (((size_t) (next - name) == nameLength) && (memcmp(name, LOGIC_DEFLATENAME, nameLength) == 0)) {
+            encodings |= LOGIC_ENCODING_DEFLATE;
+        }
+        list = next;
+    }
+    return encodings;
+}
+
+/**
+ * @brief moves the content and the files of source to the end of destination
+ * @param destination logicBuffer*: the buffer appended to
+ * @param source logicBuffer*: the buffer moved, empty afterwards, also on failure
+ * @return int: 0 in case of success, -1 if out of memory
+ */
+static int appendMoved(logicBuffer* destination, logicBuffer* source) {
+    size_t base = destination->length;
+    if (logic_append(destination, source->data, source->length) == -1) {
+        logic_freeBuffer(source);
+        return -1;
+    }
+    if (source->fileCount > 0) {
+        if (reserveFiles(destination, source->fileCount) == -1) {
+            logic_freeBuffer(source);
+            return -1;
+        }
+        for (size_t i = 0; i < source->fileCount; i++) {
+            destination->files[destination->fileCount] = source->files[i];
+            destination->files[destination->fileCount++].position += base;
+        }
+        // the files belong to destination now
+        source->fileCount = 0;
+    }
+    logic_freeBuffer(source);
+    return 0;
+}
+
+/**
+ * @brief makes sure the buffer has room for additional files, grows by doubling
+ * @param buffer logicBuffer*: the buffer
+ * @param additional size_t: files needed after the used ones
+ * @return int: 0 in case of success, -1 if out of memory
+ */
+static int reserveFiles(logicBuffer* buffer, size_t additional) {
+    if (buffer->fileCapacity - buffer->fileCount >= additional) {
+        return 0;
+    }
+    size_t capacity = (buffer->fileCapacity == 0) ? 4 : buffer->fileCapacity;
+    while (capacity - buffer->fileCount < additional) {
+        capacity *= 2;
+    }
+    logicFile* grown = realloc(buffer->files, capacity * sizeof(logicFile));
+    if (grown == NULL) {
+        return -1;
+    }
+    buffer->files = grown;
+    buffer->fileCapacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief adds the part of a piece of the response which is not sent yet to the vector
+ * @param vector struct iovec*: the vector, room for one more element
+ * @param count int: elements in the vector
+ * @param data const char*: the piece
+ * @param length size_t: length of the piece
+ * @param position size_t: position of the piece in the response
+ * @param sent size_t: bytes of the response already sent
+ * @return int: elements in the vector afterwards
+ */
+static int gatherPiece(struct iovec* vector, int count, const char* data, size_t length, size_t position,
+                       size_t sent) {
+    if ((length == 0) || (position + length <= sent)) {
+        return count;
+    }
+    size_t skip = (sent > position) ? sent - position : 0;
+    vector[count].iov_base = (void*) (data + skip);
+    vector[count].iov_len = length - skip;
+    return count + 1;
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
@@ -0,0 +1,138 @@
+/**
+ * @file server_logic.h
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 04.12.18
+ *
+ * @brief In-process business logic of the simple message server.
+ * Parses the request (user=, optional img=, message) and frames the response (status=, file=, optional enc=, len=).
+ * TCP/IP Lecture Distributed Systems
+ */
+#ifndef SERVER_LOGIC_H
+#define SERVER_LOGIC_H
+
+#include <stddef.h>         // provides size_t
+#include <sys/types.h>      // provides off_t
+
+// --------------------------------------------------------------- defines --
+/** @brief upper limit of a request, longer requests are answered with LOGIC_STATUS_ERROR */
+#define LOGIC_MAXREQUEST (1024 * 1024)
+/** @brief status of a successful request */
+#define LOGIC_STATUS_OK 0
+/** @brief status of a request which could not be parsed or processed */
+#define LOGIC_STATUS_ERROR 1
+/** @brief status of a request which was not served because the server is overloaded, it may be sent again later */
+#define LOGIC_STATUS_BUSY 2
+/** @brief key of the length line in front of a framed request, a connection starting with it stays open */
+#define LOGIC_REQUESTKEY "request="
+/** @brief key of the length line in front of the response to a framed request */
+#define LOGIC_RESPONSEKEY "response="
+/** @brief key of the line of a file record which names the codec of the content, between file= and len= */
+#define LOGIC_ENCODINGKEY "enc="
+/** @brief name of the deflate codec: a zlib stream (RFC 1950), offered behind the length of a framed request */
+#define LOGIC_DEFLATENAME "deflate"
+/** @brief the client accepts file contents compressed with deflate */
+#define LOGIC_ENCODING_DEFLATE 1u
+/** @brief contents shorter than this are never compressed */
+#define LOGIC_COMPRESSMINIMUM 256
+
+// -------------------------------------------------------------- typedefs --
+/** @brief A parsed request, all fields point into the received buffer and are not terminated */
+typedef struct logicRequest {
+    const char* user;           /**< Name of the posting user */
+    size_t userLength;          /**< Length of user */
+    const char* img;            /**< URL of the user image, NULL if not given */
+    size_t imgLength;           /**< Length of img */
+    const char* message;        /**< Message to post, may contain the allowed html tags */
+    size_t messageLength;       /**< Length of message */
+    unsigned encodings;         /**< LOGIC_ENCODING_* the client accepts, 0 for plain contents only */
+} logicRequest;
+
+/** @brief Content of a response which is sent from a file on disk or from memory outliving the buffer */
+typedef struct logicFile {
+    size_t position;            /**< Offset in the buffer data the content is sent at */
+    int fd;                     /**< Open file, closed by logic_freeBuffer(), -1 for content in memory */
+    off_t offset;               /**< Start of the content in the file */
+    size_t length;              /**< Length of the content */
+    const char* memory;         /**< Content in memory, sent with writev(), NULL for a file */
+} logicFile;
+
+/** @brief Growing buffer for a complete response, file contents are only referenced */
+typedef struct logicBuffer {
+    char* data;                 /**< Content, not terminated */
+    size_t length;              /**< Used bytes */
+    size_t capacity;            /**< Allocated bytes */
+    logicFile* files;           /**< Contents only referenced, in order of their position, NULL if none */
+    size_t fileCount;           /**< Number of files */
+    size_t fileCapacity;        /**< Allocated elements of files */
+} logicBuffer;
+
+/**
+ * @brief Pluggable business logic. A handler builds the complete response of a request,
+ * the framing functions below are used to create it.
+ */
+typedef struct logicHandler {
+    const char* name;           /**< Name of the handler used on the command line */
+    /** @brief processes a parsed request, request is NULL if the request could not be parsed.
+     * Returns 0 if a response was built, -1 on failure (errno is set) */
+    int (*handle)(const logicRequest* request, logicBuffer* response);
+    /** @brief does work ahead in a server which forks a process per connection, called before every fork so
+     * the forked process inherits the result. NULL if the handler has nothing to prepare */
+    void (*prepare)(void);
+} logicHandler;
+
+/** @brief Progress of sending a response, kept between the calls of logic_sendResponse(), zeroed for a new one */
+typedef struct logicSendState {
+    size_t sent;                /**< Bytes of the response already sent */
+    size_t piece;               /**< First file not sent completely, fileCount once all files are sent */
+    size_t position;            /**< Position in the response of the buffer part in front of the file piece */
+} logicSendState;
+
+/** @brief Framing of the requests on a connection, decided by its first bytes */
+enum logicFraming {
+    LOGIC_FRAMING_UNKNOWN = 0,  /**< Not enough bytes received to decide */
+    LOGIC_FRAMING_LEGACY,       /**< One request ended by the shutdown of the client, one response, close */
+    LOGIC_FRAMING_FRAMED        /**< Length framed requests and responses until the client shuts down */
+};
+
+/** @brief Requests and responses of one connection, independent of the way the socket is driven */
+typedef struct logicSession {
+    logicBuffer request;        /**< Received bytes not processed yet */
+    logicBuffer response;       /**< Responses not sent yet, pipelined responses are collected */
+    logicSendState send;        /**< Progress of sending the responses */
+    enum logicFraming framing;  /**< Framing of the connection */
+    int eof;                    /**< 1 after the client shut down its write direction */
+    int done;                   /**< 1 after the legacy request was processed */
+} logicSession;
+
+// ------------------------------------------------------------- functions --
+const logicHandler* logic_find(const char* name);
+void logic_setBoardPath(const char* path);
+int logic_parseRequest(const char* raw, size_t length, logicRequest* request);
+int logic_process(const logicHandler* handler, const char* raw, size_t length, unsigned encodings,
+                  logicBuffer* response);
+int logic_serveConnection(const logicHandler* handler, int fd_connected);
+int logic_serveStreams(const logicHandler* handler, int fd_in, int fd_out);
+
+int logic_sessionReceived(const logicHandler* handler, logicSession* session);
+int logic_sessionPending(const logicSession* session);
+void logic_sessionSent(logicSession* session);
+int logic_sessionFinished(const logicSession* session);
+void logic_freeSession(logicSession* session);
+
+int logic_appendStatus(logicBuffer* buffer, int status);
+int logic_appendFile(logicBuffer* buffer, const char* name, const char* content, size_t length);
+int logic_appendFileEncoded(logicBuffer* buffer, const char* name, const char* content, size_t length,
+                            unsigned encodings);
+int logic_appendFileDescriptor(logicBuffer* buffer, const char* name, int fd, off_t offset, size_t length);
+int logic_appendReference(logicBuffer* buffer, const char* content, size_t length);
+int logic_append(logicBuffer* buffer, const char* content, size_t length);
+int logic_reserve(logicBuffer* buffer, size_t additional);
+int logic_appendEscaped(logicBuffer* buffer, const char* text, size_t length);
+void logic_freeBuffer(logicBuffer* buffer);
+
+size_t logic_responseLength(const logicBuffer* response);
+int logic_sendResponse(int fd_connected, const logicBuffer* response, logicSendState* state);
+int logic_inlineFiles(logicBuffer* response);
+
+#endif // SERVER_LOGIC_H
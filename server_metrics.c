@@ -0,0 +1,366 @@
+/**
+ * @file server_metrics.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 19.12.18
+ *
+ * @brief Metrics of the server.
+ * The counters and histograms live in shards of a shared anonymous mapping, created before the first fork, so
+ * the forked handlers, the pre-forked workers and the threads all count into the same metrics. Every thread
+ * or process takes its own shard on its first update and adds to it with relaxed atomic operations: no lock,
+ * and no cache line shared with other threads as long as there are not more than METRICS_SHARDS of them. A
+ * scrape sums the shards. The metrics are served by a thread of the server process, on a port of 127.0.0.1
+ * or a unix socket, in the Prometheus text format. Without --metrics every update is a single branch.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#include <stdlib.h>         // provides strtol()
+#include <stdio.h>          // provides snprintf()
+#include <string.h>         // provide strlen(), strncmp()
+#include <errno.h>          // provides errno
+#include <signal.h>         // provides sigfillset(), pthread_sigmask()
+#include <stdatomic.h>      // provides atomic_fetch_add_explicit()
+#include <pthread.h>        // provides pthread_create(), pthread_atfork()
+#include <poll.h>           // provides poll()
+#include <time.h>           // provides clock_gettime(), nanosleep()
+#include <unistd.h>         // provides close(), unlink()
+#include <sys/types.h>
+#include <sys/mman.h>       // provides mmap()
+#include <sys/socket.h>     // provides accept(), recv(), send()
+#include <sys/un.h>         // provides struct sockaddr_un
+#include <netinet/in.h>     // provides struct sockaddr_in
+#include <arpa/inet.h>      // provides htonl()
+#include "server_metrics.h"
+#include "server_listen.h"  // provides listen_open()
+
+// --------------------------------------------------------------- defines --
+/** @brief number of shards, threads and processes beyond share them */
+#define METRICS_SHARDS 64
+/** @brief number of finite buckets of a histogram */
+#define METRICS_BUCKETS 22
+/** @brief size of the scrape page */
+#define METRICS_PAGESIZE 16384
+/** @brief ms a scrape may take from the accept to the last byte of the page, a slow scraper is dropped */
+#define METRICS_SCRAPETIMEOUT 500
+/** @brief nanoseconds to wait before the next accept() if it failed, e.g. out of file descriptors */
+#define METRICS_ACCEPTPAUSE 10000000
+/** @brief backlog of the metrics socket */
+#define METRICS_BACKLOG 16
+
+// -------------------------------------------------------------- typedefs --
+/** @brief The metrics of one thread or process, aligned to its own cache lines */
+typedef struct metricsShard {
+    _Alignas(64) atomic_ullong counters[METRICS_COUNTERS];                  /**< Counters, the gauge wraps */
+    atomic_ullong buckets[METRICS_HISTOGRAMS][METRICS_BUCKETS + 1];         /**< Observations per bucket, +Inf last */
+    atomic_ullong sums[METRICS_HISTOGRAMS];                                 /**< Sum of the observations in ns */
+} metricsShard;
+
+/** @brief The shared mapping */
+typedef struct metricsArea {
+    atomic_int nextShard;                   /**< Shard of the next thread or process */
+    metricsShard shards[METRICS_SHARDS];    /**< The shards */
+} metricsArea;
+
+/** @brief Description of a metric in the scrape page */
+typedef struct metricsName {
+    const char* name;           /**< Name of the metric */
+    const char* type;           /**< counter, gauge or histogram */
+    const char* help;           /**< Description */
+} metricsName;
+
+// --------------------------------------------------------------- globals --
+/** @brief the shared metrics, NULL while the metrics are disabled */
+static metricsArea* area = NULL;
+/** @brief shard of this thread, -1 until its first update, reset in a forked child */
+static __thread int shardIndex = -1;
+/** @brief listening socket of the metrics thread */
+static int fd_metrics = -1;
+/** @brief upper bounds of the buckets in ns, 1-2.5-5 steps from 1 us to 10 s */
+static const uint64_t bucketBounds[METRICS_BUCKETS] = {
+        1000ull, 2500ull, 5000ull, 10000ull, 25000ull, 50000ull, 100000ull, 250000ull, 500000ull,
+        1000000ull, 2500000ull, 5000000ull, 10000000ull, 25000000ull, 50000000ull, 100000000ull,
+        250000000ull, 500000000ull, 1000000000ull, 2500000000ull, 5000000000ull, 10000000000ull
+};
+static const metricsName counterNames[METRICS_COUNTERS] = {
+        {"simple_message_connections_accepted_total", "counter", "Connections accepted"},
+        {"simple_message_connections_rejected_total", "counter", "Connections rejected as busy"},
+        {"simple_message_connections_active", "gauge", "Connections accepted and not closed yet"},
+        {"simple_message_requests_total", "counter", "Requests processed by the in-process logic"},
+        {"simple_message_request_bytes_total", "counter", "Bytes of the processed requests"},
+        {"simple_message_response_bytes_total", "counter", "Bytes of the built responses"}
+};
+static const metricsName histogramNames[METRICS_HISTOGRAMS] = {
+        {"simple_message_handler_spawn_seconds", "histogram", "Time of the fork of a handler or worker"},
+        {"simple_message_handler_duration_seconds", "histogram", "Time from the accept to the end of a connection"},
+        {"simple_message_request_processing_seconds", "histogram", "Time the in-process logic takes for a request"}
+};
+
+// ------------------------------------------------------------- functions --
+static metricsShard* ownShard(void);
+static void resetShard(void);
+static void* serveLoop(void* argument);
+static int waitScrape(int fd, short events, uint64_t deadline);
+static int renderPage(char* page, size_t size);
+
+/**
+ * @brief enables the metrics, must be called before the first fork and thread
+ * @return int: 0 in case of success, -1 if the mapping failed (errno is set)
+ */
+int metrics_init(void) {
+    void* mapping = mmap(NULL, sizeof(metricsArea), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        return -1;
+    }
+    // a forked child takes a shard of its own, anonymous mappings are zeroed
+    int status = pthread_atfork(NULL, NULL, resetShard);
+    if (status != 0) {
+        munmap(mapping, sizeof(metricsArea));
+        errno = status;
+        return -1;
+    }
+    area = mapping;
+    return 0;
+}
+
+/**
+ * @brief opens the metrics socket and starts the thread serving the scrapes
+ * @param endpoint const char*: port on 127.0.0.1, or METRICS_UNIXPREFIX followed by the path of a unix socket
+ * @return int: 0 in case of success, -1 on failure (errno is set)
+ */
+int metrics_serve(const char* endpoint) {
+    if (strncmp(endpoint, METRICS_UNIXPREFIX, strlen(METRICS_UNIXPREFIX)) == 0) {
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        const char* path = endpoint + strlen(METRICS_UNIXPREFIX);
+        if ((strlen(path) == 0) || (strlen(path) >= sizeof(address.sun_path))) {
+            errno = EINVAL;
+            return -1;
+        }
+        strcpy(address.sun_path, path);
+        unlink(path);   // left over by an earlier run
+        fd_metrics = listen_open((struct sockaddr*) &address, sizeof(address), METRICS_BACKLOG, 0);
+    } else {
+        char* end = NULL;
+        long port = strtol(endpoint, &end, 10);
+        if ((*end != '\0') || (port < 1) || (port > 65535)) {
+            errno = EINVAL;
+            return -1;
+        }
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons((uint16_t) port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd_metrics = listen_open((struct sockaddr*) &address, sizeof(address), METRICS_BACKLOG, 0);
+    }
+    if (fd_metrics == -1) {
+        return -1;
+    }
+    // the thread must not take the signals of the server, e.g. the SIGCHLD of a terminated handler
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    pthread_t thread;
+    int status = pthread_create(&thread, NULL, serveLoop, NULL);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (status != 0) {
+        close(fd_metrics);
+        fd_metrics = -1;
+        errno = status;
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
+
+/**
+ * @brief adds to a counter, a negative value decreases the gauge
+ * @param counter enum metricsCounter: the counter
+ * @param value int64_t: the value to add
+ */
+void metrics_add(enum metricsCounter counter, int64_t value) {
+    if (area == NULL) {
+        return;
+    }
+    atomic_fetch_add_explicit(&ownShard()->counters[counter], (unsigned long long) value, memory_order_relaxed);
+}
+
+/**
+ * @brief adds an observation to a histogram
+ * @param histogram enum metricsHistogram: the histogram
+ * @param nanoseconds uint64_t: the observed duration
+ */
+void metrics_observe(enum metricsHistogram histogram, uint64_t nanoseconds) {
+    if (area == NULL) {
+        return;
+    }
+    int bucket = 0;
+    while ((bucket < METRICS_BUCKETS) && (nanoseconds > bucketBounds[bucket])) {
+        bucket++;
+    }
+    metricsShard* shard = ownShard();
+    atomic_fetch_add_explicit(&shard->buckets[histogram][bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&shard->sums[histogram], nanoseconds, memory_order_relaxed);
+}
+
+/**
+ * @brief reads the monotonic clock for a duration
+ * @return uint64_t: time in ns, 0 while the metrics are disabled
+ */
+uint64_t metrics_now(void) {
+    if (area == NULL) {
+        return 0;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+}
+
+/**
+ * @brief returns the shard of the calling thread, taking the next one on the first call
+ * @return metricsShard*: the shard
+ */
+static metricsShard* ownShard(void) {
+    if (shardIndex == -1) {
+        shardIndex = atomic_fetch_add_explicit(&area->nextShard, 1, memory_order_relaxed) % METRICS_SHARDS;
+    }
+    return &area->shards[shardIndex];
+}
+
+/**
+ * @brief child handler of fork(), the child takes a shard of its own on its first update
+ */
+static void resetShard(void) {
+    shardIndex = -1;
+}
+
+/**
+ * @brief loop of the metrics thread, answers every connection with the current page
+ * @param argument void*: unused
+ * @return void*: NULL, the thread runs as long as the server
+ */
+static void* serveLoop(void* argument) {
+    (void) argument;
+    static char page[METRICS_PAGESIZE];
+    static char response[METRICS_PAGESIZE + 256];
+    while (1) {
+        int fd_scrape = accept(fd_metrics, NULL, NULL);
+        if (fd_scrape == -1) {
+            if ((errno != EINTR) && (errno != ECONNABORTED)) {
+                struct timespec pause = {0, METRICS_ACCEPTPAUSE};
+                nanosleep(&pause, NULL);
+            }
+            continue;
+        }
+        // the request is read, but every path gets the metrics. The whole scrape has one deadline, a slow
+        // scraper must not hold back the others
+        uint64_t deadline = metrics_now() + (uint64_t) METRICS_SCRAPETIMEOUT * 1000000;
+        char request[1024];
+        size_t received = 0;
+        while (received < sizeof(request) - 1) {
+            ssize_t part = recv(fd_scrape, request + received, sizeof(request) - 1 - received, MSG_DONTWAIT);
+            if ((part == -1) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)) &&
+                (waitScrape(fd_scrape, POLLIN, deadline) > 0)) {
+                continue;
+            }
+            if (part <= 0) {
+                break;
+            }
+            received += (size_t) part;
+            request[received] = '\0';
+            if (strstr(request, "\r\n\r\n") != NULL) {
+                break;
+            }
+        }
+        int pageLength = renderPage(page, sizeof(page));
+        int length = snprintf(response, sizeof(response),
+                              "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                              "Content-Length: %d\r\nConnection: close\r\n\r\n%s", pageLength, page);
+        for (int sent = 0; sent < length;) {
+            ssize_t part = send(fd_scrape, response + sent, (size_t) (length - sent), MSG_NOSIGNAL | MSG_DONTWAIT);
+            if ((part == -1) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)) &&
+                (waitScrape(fd_scrape, POLLOUT, deadline) > 0)) {
+                continue;
+            }
+            if (part <= 0) {
+                break;
+            }
+            sent += (int) part;
+        }
+        close(fd_scrape);
+    }
+    return NULL;
+}
+
+/**
+ * @brief waits until a scrape connection is ready or its deadline has passed
+ * @param fd int: the connection
+ * @param events short: POLLIN or POLLOUT
+ * @param deadline uint64_t: end of the scrape on the clock of metrics_now()
+ * @return int: 1 if the connection is ready, 0 at the deadline, -1 on failure
+ */
+static int waitScrape(int fd, short events, uint64_t deadline) {
+    struct pollfd entry = {fd, events, 0};
+    uint64_t now;
+    while ((now = metrics_now()) < deadline) {
+        // rounded up, poll() must not return before the deadline with 0 ms left
+        int ready = poll(&entry, 1, (int) ((deadline - now + 999999) / 1000000));
+        if ((ready != -1) || (errno != EINTR)) {
+            return ready;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief sums the shards and writes the metrics in the Prometheus text format
+ * @param page char*: the page
+ * @param size size_t: size of the page
+ * @return int: length of the page
+ */
+static int renderPage(char* page, size_t size) {
+    size_t length = 0;
+#define PAGEPRINTF(...) \
+    length += (size_t) snprintf(page + length, (length < size) ? size - length : 0, __VA_ARGS__)
+    for (int c = 0; c < METRICS_COUNTERS; c++) {
+        unsigned long long sum = 0;
+        for (int s = 0; s < METRICS_SHARDS; s++) {
+            sum += atomic_load_explicit(&area->shards[s].counters[c], memory_order_relaxed);
+        }
+        PAGEPRINTF("# HELP %s %s\n# TYPE %s %s\n", counterNames[c].name, counterNames[c].help, counterNames[c].name,
+                   counterNames[c].type);
+        // the gauge is the sum of increments and decrements of different shards, it wraps around
+        PAGEPRINTF("%s %lld\n", counterNames[c].name, (long long) sum);
+    }
+    for (int h = 0; h < METRICS_HISTOGRAMS; h++) {
+        const char* name = histogramNames[h].name;
+        PAGEPRINTF("# HELP %s %s\n# TYPE %s %s\n", name, histogramNames[h].help, name, histogramNames[h].type);
+        unsigned long long cumulated = 0, sum = 0;
+        for (int b = 0; b <= METRICS_BUCKETS; b++) {
+            for (int s = 0; s < METRICS_SHARDS; s++) {
+                cumulated += atomic_load_explicit(&area->shards[s].buckets[h][b], memory_order_relaxed);
+            }
+            if (b < METRICS_BUCKETS) {
+                PAGEPRINTF("%s_bucket{le=\"%g\"} %llu\n", name, (double) bucketBounds[b] / 1e9, cumulated);
+            } else {
+                PAGEPRINTF("%s_bucket{le=\"+Inf\"} %llu\n", name, cumulated);
+            }
+        }
+        for (int s = 0; s < METRICS_SHARDS; s++) {
+            sum += atomic_load_explicit(&area->shards[s].sums[h], memory_order_relaxed);
+        }
+        PAGEPRINTF("%s_sum %.9f\n%s_count %llu\n", name, (double) sum / 1e9, name, cumulated);
+    }
+#undef PAGEPRINTF
+    return (length < size) ? (int) length : (int) size - 1;
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
@@ -0,0 +1,46 @@
+/**
+ * @file server_metrics.h
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 19.12.18
+ *
+ * @brief Metrics of the server, counters and latency histograms exposed in the Prometheus text format
+ * TCP/IP Lecture Distributed Systems
+ */
+#ifndef SERVER_METRICS_H
+#define SERVER_METRICS_H
+
+#include <stdint.h>         // provides uint64_t
+
+// --------------------------------------------------------------- defines --
+/** @brief prefix of a --metrics endpoint which is a unix socket, otherwise it is a port on 127.0.0.1 */
+#define METRICS_UNIXPREFIX "unix:"
+
+// -------------------------------------------------------------- typedefs --
+/** @brief Counters, the active connections are a gauge */
+enum metricsCounter {
+    METRICS_ACCEPTED,           /**< Connections accepted */
+    METRICS_REJECTED,           /**< Connections rejected by the admission control */
+    METRICS_ACTIVE,             /**< Connections accepted and not closed yet, gauge */
+    METRICS_REQUESTS,           /**< Requests processed by the in-process logic */
+    METRICS_REQUESTBYTES,       /**< Bytes of the processed requests */
+    METRICS_RESPONSEBYTES,      /**< Bytes of the built responses */
+    METRICS_COUNTERS            /**< Number of counters */
+};
+
+/** @brief Latency histograms */
+enum metricsHistogram {
+    METRICS_SPAWN,              /**< fork() of a handler or worker */
+    METRICS_HANDLER,            /**< From the accept to the end of the connection */
+    METRICS_PROCESS,            /**< Processing of a request by the in-process logic */
+    METRICS_HISTOGRAMS          /**< Number of histograms */
+};
+
+// ------------------------------------------------------------- functions --
+int metrics_init(void);
+int metrics_serve(const char* endpoint);
+void metrics_add(enum metricsCounter counter, int64_t value);
+void metrics_observe(enum metricsHistogram histogram, uint64_t nanoseconds);
+uint64_t metrics_now(void);
+
+#endif // SERVER_METRICS_H
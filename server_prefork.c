@@ -0,0 +1,409 @@
+/**
+ * @file server_prefork.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 02.12.18
+ *
+ * @brief Pre-forked worker pool for the simple message server.
+ * The parent forks a number of workers in advance. Every worker waits on the shared listening sockets
+ * and serves the accepted connection. The state of every worker is kept in a scoreboard in shared memory,
+ * the parent uses it to keep the number of idle workers between the spare limits and replaces dead workers.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#define _GNU_SOURCE         // provides ppoll()
+#include <stdlib.h>         // provides exit(), EXIT_FAILURE
+#include <stdio.h>          // provides the printf()
+#include <string.h>         // provide strerror()
+#include <errno.h>          // provides errno
+#include <signal.h>         // provides sigaction(), sigtimedwait()
+#include <stdatomic.h>      // provides atomic_int for the scoreboard
+#include <poll.h>           // provides ppoll()
+#include <fcntl.h>          // provides fcntl(), O_NONBLOCK
+#include <time.h>           // provides struct timespec, nanosleep()
+#include <sys/types.h>
+#include <sys/socket.h>     // provides accept()
+#include <sys/mman.h>       // provides mmap()
+#include <sys/wait.h>       // provides waitpid()
+#include <unistd.h>         // provides fork(), close()
+#include "server_prefork.h"
+#include "server_metrics.h" // provides metrics_add(), metrics_observe()
+#include "trace.h"          // provides TRACE()
+
+// --------------------------------------------------------------- defines --
+/** @brief Line output. prints filename, functionname and linenumber from caller */
+#define LINEOUTPUT fprintf(stdout, "[%s, %s, %d]: ",  __FILE__, __func__, __LINE__)
+/** @brief seconds between two maintenance runs of the pool, dead workers are replaced immediately */
+#define MAINTENANCE_INTERVAL 1
+/** @brief default hard limit of workers per started worker */
+#define MAXWORKERS_FACTOR 16
+/** @brief seconds the workers get at shutdown to finish their connections, afterwards they are killed */
+#define SHUTDOWN_TIMEOUT 5
+/** @brief nanoseconds to wait before the next accept() if the worker ran out of file descriptors */
+#define ACCEPT_PAUSE 10000000
+
+// -------------------------------------------------------------- typedefs --
+/** @brief State of a scoreboard slot */
+enum workerState {
+    WORKER_EMPTY = 0,           /**< Slot is unused */
+    WORKER_IDLE,                /**< Worker waits for a connection */
+    WORKER_BUSY                 /**< Worker serves a connection */
+};
+
+/** @brief Scoreboard entry of one worker, lives in memory shared between parent and workers */
+typedef struct workerSlot {
+    pid_t pid;                  /**< Process id of the worker, written by the parent only */
+    atomic_int state;           /**< enum workerState, written by the worker */
+    uint64_t started;           /**< Accept of the served connection for the metrics, written by the worker */
+} workerSlot;
+
+// --------------------------------------------------------------- globals --
+/** @brief set in the worker by SIGTERM, the worker finishes the current connection and terminates */
+static volatile sig_atomic_t workerRetire = 0;
+
+// ------------------------------------------------------------- functions --
+static int spawnWorker(workerSlot* slot, const listenSet* listeners, preforkServe serve, void* context,
+                       int verbose);
+static void workerLoop(workerSlot* slot, const listenSet* listeners, preforkServe serve, void* context);
+static void reapWorkers(workerSlot* board, int size, int verbose);
+static void retire_handler(int s);
+static void terminateWorkers(workerSlot* board, int size, const sigset_t* signals, int verbose);
+
+/**
+ * @brief fills the unset limits of the configuration with defaults and checks them for consistency
+ * @param config preforkConfig*: configuration, startWorkers must be set
+ * @return int: 0 if the configuration is usable, -1 if not
+ */
+int prefork_configure(preforkConfig* config) {
+    if (config->startWorkers < 1) {
+        return -1;
+    }
+    if (config->minSpare == 0) {
+        config->minSpare = config->startWorkers;
+    }
+    if (config->maxSpare == 0) {
+        config->maxSpare = 2 * config->minSpare;
+    }
+    if (config->maxWorkers == 0) {
+        config->maxWorkers = MAXWORKERS_FACTOR * config->startWorkers;
+        if (config->maxWorkers < config->maxSpare) {
+            config->maxWorkers = config->maxSpare;
+        }
+    }
+    if ((config->minSpare < 1) || (config->maxSpare < config->minSpare) ||
+        (config->maxWorkers < config->maxSpare) || (config->maxWorkers < config->startWorkers)) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief runs the worker pool on the given listening sockets. Returns after SIGTERM or SIGINT,
+ * all workers are terminated before.
+ * @param listeners const listenSet*: bound and listening sockets, are switched to non blocking mode
+ * @param config preforkConfig*: configuration, checked by prefork_configure()
+ * @param serve preforkServe: connection handler called in the workers
+ * @param context void*: passed through to serve
+ * @param verbose int: 1 prints the pool activities to stdout
+ * @return int: 0 on regular shutdown, -1 if the pool could not be set up (errno is set)
+ */
+int prefork_run(const listenSet* listeners, const preforkConfig* config, preforkServe serve, void* context,
+                int verbose) {
+    // all workers wait in poll(), only one of them gets the connection, the others must not block in accept()
+    for (int i = 0; i < listeners->count; i++) {
+        int flags = fcntl(listeners->fds[i], F_GETFL);
+        if ((flags == -1) || (fcntl(listeners->fds[i], F_SETFL, flags | O_NONBLOCK) == -1)) {
+            return -1;
+        }
+    }
+    // the scoreboard must be shared with the workers, anonymous mappings are zeroed -> all slots WORKER_EMPTY
+    size_t boardSize = (size_t) config->maxWorkers * sizeof(workerSlot);
+    workerSlot* board = mmap(NULL, boardSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (board == MAP_FAILED) {
+        return -1;
+    }
+    // the parent receives its signals synchronously via sigtimedwait()
+    sigset_t signals, previous;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGCHLD);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGINT);
+    if (sigprocmask(SIG_BLOCK, &signals, &previous) == -1) {
+        int save_errno = errno;
+        munmap(board, boardSize);
+        errno = save_errno;
+        return -1;
+    }
+    for (int i = 0; i < config->startWorkers; i++) {
+        spawnWorker(&board[i], listeners, serve, context, verbose);
+    }
+
+    //---------------------------------------------------------------------------------------------------
+    //----------------------- maintenance loop of the parent process ------------------------------------
+    //---------------------------------------------------------------------------------------------------
+    while (1) {
+        struct timespec timeout = {MAINTENANCE_INTERVAL, 0};
+        int sig = sigtimedwait(&signals, NULL, &timeout);
+        if ((sig == SIGTERM) || (sig == SIGINT)) {
+            break;
+        }
+        reapWorkers(board, config->maxWorkers, verbose);
+
+        int idle = 0, total = 0, retireSlot = -1;
+        for (int i = 0; i < config->maxWorkers; i++) {
+            int state = atomic_load(&board[i].state);
+            if (state != WORKER_EMPTY) {
+                total++;
+            }
+            if (state == WORKER_IDLE) {
+                idle++;
+                retireSlot = i;
+            }
+        }
+        if (idle < config->minSpare) {
+            // fork the missing spares at once, the hard limit protects against a fork storm
+            int missing = config->minSpare - idle;
+            for (int i = 0; (i < config->maxWorkers) && (missing > 0); i++) {
+                if (atomic_load(&board[i].state) == WORKER_EMPTY && board[i].pid == 0) {
+                    if (spawnWorker(&board[i], listeners, serve, context, verbose) == -1) {
+                        break;  // try again with the next maintenance run
+                    }
+                    missing--;
+                }
+            }
+            if ((missing > 0) && (total >= config->maxWorkers) && (verbose == 1)) {
+                LINEOUTPUT;
+                fprintf(stdout, "Worker limit of %d reached\n", config->maxWorkers);
+            }
+        } else if ((idle > config->maxSpare) && (retireSlot != -1)) {
+            // retire one idle worker per run, like the classic prefork daemons
+            if (verbose == 1) {
+                LINEOUTPUT;
+                fprintf(stdout, "Retire idle worker %d\n", board[retireSlot].pid);
+            }
+            kill(board[retireSlot].pid, SIGTERM);
+        }
+    }
+
+    //---------------------------------------------------------------------------------------------------
+    //----------------------- shutdown, terminate all workers -------------------------------------------
+    //---------------------------------------------------------------------------------------------------
+    terminateWorkers(board, config->maxWorkers, &signals, verbose);
+    munmap(board, boardSize);
+    sigprocmask(SIG_SETMASK, &previous, NULL);
+    return 0;
+}
+
+/**
+ * @brief terminates all workers of the pool. The workers get SIGTERM and SHUTDOWN_TIMEOUT seconds to finish
+ * their connections, a worker which hangs on a stalled client is killed afterwards.
+ * @param board workerSlot*: the scoreboard
+ * @param size int: number of slots in the scoreboard
+ * @param signals const sigset_t*: blocked signals of the parent, contains SIGCHLD
+ * @param verbose int: 1 prints the killed workers to stdout
+ */
+static void terminateWorkers(workerSlot* board, int size, const sigset_t* signals, int verbose) {
+    int running = 0;
+    for (int i = 0; i < size; i++) {
+        if (board[i].pid > 0) {
+            kill(board[i].pid, SIGTERM);
+            running++;
+        }
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += SHUTDOWN_TIMEOUT;
+    while (running > 0) {
+        pid_t pid;
+        while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+            for (int i = 0; i < size; i++) {
+                if (board[i].pid == pid) {
+                    board[i].pid = 0;
+                    running--;
+                }
+            }
+        }
+        if ((pid == -1) && (errno == ECHILD)) {
+            return;
+        }
+        if (running == 0) {
+            break;
+        }
+        struct timespec now, timeout;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        timeout.tv_sec = deadline.tv_sec - now.tv_sec;
+        timeout.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+        if (timeout.tv_nsec < 0) {
+            timeout.tv_sec--;
+            timeout.tv_nsec += 1000000000L;
+        }
+        if (timeout.tv_sec < 0) {
+            break;
+        }
+        // SIGCHLD is blocked in the parent, a further SIGTERM during the shutdown is swallowed here
+        sigtimedwait(signals, NULL, &timeout);
+    }
+    for (int i = 0; i < size; i++) {
+        if (board[i].pid > 0) {
+            if (verbose == 1) {
+                LINEOUTPUT;
+                fprintf(stdout, "Kill worker %d, it did not terminate in %d s\n", board[i].pid, SHUTDOWN_TIMEOUT);
+            }
+            kill(board[i].pid, SIGKILL);
+        }
+    }
+    // SIGKILL can not be ignored, the remaining workers are gone soon
+    while (waitpid(-1, NULL, 0) > 0);
+}
+
+/**
+ * @brief forks a new worker into the given scoreboard slot
+ * @param slot workerSlot*: empty slot of the scoreboard
+ * @return int: 0 in case of success, -1 if fork failed
+ */
+static int spawnWorker(workerSlot* slot, const listenSet* listeners, preforkServe serve, void* context,
+                       int verbose) {
+    // the new worker counts as idle immediately, so the next maintenance run does not fork it twice
+    atomic_store(&slot->state, WORKER_IDLE);
+    fflush(stdout);     // do not duplicate buffered output in the worker
+    uint64_t forking = metrics_now();
+    pid_t pid = fork();
+    if (pid == -1) {
+        atomic_store(&slot->state, WORKER_EMPTY);
+        fprintf(stderr, "Could not fork a worker: %s\n", strerror(errno));
+        return -1;
+    }
+    if (pid == 0) {
+        workerLoop(slot, listeners, serve, context);  // does not return
+    }
+    metrics_observe(METRICS_SPAWN, metrics_now() - forking);
+    TRACE(TRACE_SPAWN, (uint64_t) pid, 0);
+    slot->pid = pid;
+    if (verbose == 1) {
+        LINEOUTPUT;
+        fprintf(stdout, "Worker %d started\n", pid);
+    }
+    return 0;
+}
+
+/**
+ * @brief main loop of a worker, accepts connections and calls the handler until it is retired
+ * @param slot workerSlot*: own scoreboard slot
+ */
+static void workerLoop(workerSlot* slot, const listenSet* listeners, preforkServe serve, void* context) {
+    struct sigaction retire;
+    retire.sa_handler = retire_handler;
+    sigemptyset(&retire.sa_mask);
+    retire.sa_flags = 0;
+    sigaction(SIGTERM, &retire, NULL);
+    signal(SIGCHLD, SIG_DFL);
+
+    // SIGTERM is only delivered while waiting for a connection, a running connection is never aborted
+    sigset_t blocked, waiting;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGTERM);
+    sigemptyset(&waiting);
+    sigprocmask(SIG_SETMASK, &blocked, NULL);
+
+    int next = 0;
+    while (workerRetire == 0) {
+        atomic_store(&slot->state, WORKER_IDLE);
+        struct pollfd pollListen[LISTEN_MAXSOCKETS];
+        for (int i = 0; i < listeners->count; i++) {
+            pollListen[i].fd = listeners->fds[i];
+            pollListen[i].events = POLLIN;
+        }
+        if (ppoll(pollListen, (nfds_t) listeners->count, NULL, &waiting) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "Worker could not poll the listen socket: %s\n", strerror(errno));
+            break;
+        }
+        // one connection per round, the search starts behind the last socket served, so none starves
+        int fd_listen = -1;
+        for (int i = 0; (i < listeners->count) && (fd_listen == -1); i++) {
+            next = (next + 1) % listeners->count;
+            if (pollListen[next].revents != 0) {
+                fd_listen = listeners->fds[next];
+            }
+        }
+        if (fd_listen == -1) {
+            continue;
+        }
+        int fd_connected = accept(fd_listen, NULL, NULL);
+        if (fd_connected < 0) {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR) || (errno == ECONNABORTED)) {
+                continue;   // another worker was faster
+            }
+            fprintf(stderr, "Worker could not accept socket: %s\n", strerror(errno));
+            if ((errno == EMFILE) || (errno == ENFILE) || (errno == ENOBUFS) || (errno == ENOMEM)) {
+                // temporary shortage, the connection stays in the backlog until connections have finished
+                struct timespec pause = {0, ACCEPT_PAUSE};
+                nanosleep(&pause, NULL);
+                continue;
+            }
+            break;
+        }
+        slot->started = metrics_now();
+        metrics_add(METRICS_ACCEPTED, 1);
+        metrics_add(METRICS_ACTIVE, 1);
+        trace_connection();
+        TRACE(TRACE_ACCEPT, (uint64_t) fd_connected, 0);
+        atomic_store(&slot->state, WORKER_BUSY);
+        // a worker which executes the business logic does not return, the parent ends its connection
+        if (serve(fd_listen, fd_connected, context) != 0) {
+            break;
+        }
+        metrics_add(METRICS_ACTIVE, -1);
+        metrics_observe(METRICS_HANDLER, metrics_now() - slot->started);
+    }
+    for (int i = 0; i < listeners->count; i++) {
+        close(listeners->fds[i]);
+    }
+    exit(EXIT_SUCCESS);
+}
+
+/**
+ * @brief collects all terminated workers and frees their scoreboard slots
+ * @param board workerSlot*: the scoreboard
+ * @param size int: number of slots
+ */
+static void reapWorkers(workerSlot* board, int size, int verbose) {
+    pid_t pid;
+    while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+        for (int i = 0; i < size; i++) {
+            if (board[i].pid == pid) {
+                if (atomic_load(&board[i].state) == WORKER_BUSY) {
+                    metrics_add(METRICS_ACTIVE, -1);
+                    metrics_observe(METRICS_HANDLER, metrics_now() - board[i].started);
+                }
+                board[i].pid = 0;
+                atomic_store(&board[i].state, WORKER_EMPTY);
+                break;
+            }
+        }
+        if (verbose == 1) {
+            LINEOUTPUT;
+            fprintf(stdout, "Worker %d terminated\n", pid);
+        }
+    }
+}
+
+/**
+ * @brief signal handler of the workers, marks the worker for retirement
+ * @param s int: signal
+ */
+static void retire_handler(int s) {
+    (void) s;
+    workerRetire = 1;
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
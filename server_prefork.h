@@ -0,0 +1,40 @@
+/**
+ * @file server_prefork.h
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 02.12.18
+ *
+ * @brief Pre-forked worker pool for the simple message server
+ * TCP/IP Lecture Distributed Systems
+ */
+#ifndef SERVER_PREFORK_H
+#define SERVER_PREFORK_H
+
+#include "server_listen.h"  // provides listenSet
+
+// -------------------------------------------------------------- typedefs --
+/** @brief Configuration of the worker pool, all values are numbers of processes */
+typedef struct preforkConfig {
+    int startWorkers;           /**< Workers forked at startup, 0 disables the prefork mode */
+    int minSpare;               /**< Lower limit of idle workers, below more workers are forked, 0 = default */
+    int maxSpare;               /**< Upper limit of idle workers, above idle workers are retired, 0 = default */
+    int maxWorkers;             /**< Hard limit of workers alive at the same time, 0 = default */
+} preforkConfig;
+
+/**
+ * @brief Connection handler called in the worker process for every accepted connection.
+ * The handler owns fd_connected and must close it. If the handler does not return (e.g. exec),
+ * the worker is replaced by the pool.
+ * @param fd_listen int: listening socket of the connection, all are still open in the worker
+ * @param fd_connected int: accepted connection
+ * @param context void*: context pointer given to prefork_run()
+ * @return int: 0 to keep the worker alive, -1 to terminate the worker
+ */
+typedef int (*preforkServe)(int fd_listen, int fd_connected, void* context);
+
+// ------------------------------------------------------------- functions --
+int prefork_configure(preforkConfig* config);
+int prefork_run(const listenSet* listeners, const preforkConfig* config, preforkServe serve, void* context,
+                int verbose);
+
+#endif // SERVER_PREFORK_H
@@ -0,0 +1,394 @@
+/**
+ * @file server_reactor.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 06.12.18
+ *
+ * @brief Event driven server core based on epoll.
+ * Every event loop thread has its own epoll instance. The listening sockets are registered exclusively in
+ * all of them, so a new connection wakes only one thread, which then owns the connection until it is closed.
+ * Connections are non blocking and edge triggered: the request is read incrementally until the client
+ * shuts down its write direction (or, on a persistent connection, until a request frame is complete), the
+ * in-process business logic builds the response and the response is sent whenever the socket is writable again.
+ * Every loop keeps its connections in the order of their last activity, a connection idle for
+ * REACTOR_IDLETIMEOUT is closed, so stalled clients can not pile up.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#define _GNU_SOURCE         // provides accept4()
+#include <stdlib.h>         // provides malloc(), free()
+#include <stdio.h>          // provides the printf()
+#include <time.h>           // provides clock_gettime()
+#include <string.h>         // provide strerror()
+#include <errno.h>          // provides errno
+#include <fcntl.h>          // provides fcntl(), O_NONBLOCK
+#include <pthread.h>        // provides pthread_create()
+#include <unistd.h>         // provides read(), close()
+#include <sys/types.h>
+#include <sys/socket.h>     // provides accept4()
+#include <sys/epoll.h>      // provides epoll_create1(), epoll_wait()
+#include "server_reactor.h"
+#include "server_metrics.h" // provides metrics_add(), metrics_observe()
+#include "trace.h"          // provides TRACE()
+
+// --------------------------------------------------------------- defines --
+/** @brief maximal number of events handled per epoll_wait() */
+#define REACTOR_EVENTS 256
+/** @brief minimal free space in the request buffer before a read */
+#define REACTOR_READCHUNK 2048
+/** @brief tag of the epoll data of a listening socket, the index of the socket follows in the higher bits,
+ * a connection pointer never has the low bit set */
+#define REACTOR_LISTENTAG 1u
+/** @brief ms a connection may be idle before it is closed */
+#define REACTOR_IDLETIMEOUT 30000
+
+// -------------------------------------------------------------- typedefs --
+/** @brief A connection owned by one event loop, memory per connection is this struct and its buffers */
+typedef struct reactorConnection {
+    int fd;                     /**< Connected non blocking socket */
+    logicSession session;       /**< Requests received and responses to send */
+    uint64_t started;           /**< Time of the accept for the metrics */
+    uint32_t trace;             /**< Connection number of the trace */
+    int draining;               /**< 1 after the response was sent, the rest of the request is discarded */
+    long long deadline;         /**< ms, the connection is closed when nothing happens until then */
+    struct reactorConnection* previous; /**< Connection with the next older activity, NULL for the oldest */
+    struct reactorConnection* next;     /**< Connection with the next newer activity, NULL for the newest */
+} reactorConnection;
+
+/** @brief One event loop thread */
+typedef struct reactorLoop {
+    pthread_t thread;           /**< The thread running the loop */
+    int fd_epoll;               /**< Own epoll instance */
+    const listenSet* listeners; /**< Shared listening sockets */
+    const reactorConfig* config;/**< Configuration of the reactor */
+    reactorConnection* oldest;  /**< Connection with the oldest activity, expires first */
+    reactorConnection* newest;  /**< Connection with the newest activity */
+} reactorLoop;
+
+// ------------------------------------------------------------- functions --
+static void* eventLoop(void* argument);
+static void acceptConnections(reactorLoop* loop, int fd_listen);
+static int readRequest(reactorConnection* connection, const reactorConfig* config);
+static int writeResponse(reactorConnection* connection);
+static int drainRequest(reactorConnection* connection);
+static void touchConnection(reactorLoop* loop, reactorConnection* connection);
+static void expireConnections(reactorLoop* loop);
+static void closeConnection(reactorLoop* loop, reactorConnection* connection);
+static long long nowMs(void);
+
+/**
+ * @brief runs the reactor on the given listening sockets, the calling thread is one of the event loops.
+ * Does not return unless the event loops could not be started.
+ * @param listeners const listenSet*: bound and listening sockets, are switched to non blocking mode
+ * @param config const reactorConfig*: configuration, threads > 0 and logic set
+ * @return int: -1 if the reactor could not be set up (errno is set)
+ */
+int reactor_run(const listenSet* listeners, const reactorConfig* config) {
+    for (int i = 0; i < listeners->count; i++) {
+        int flags = fcntl(listeners->fds[i], F_GETFL);
+        if ((flags == -1) || (fcntl(listeners->fds[i], F_SETFL, flags | O_NONBLOCK) == -1)) {
+            return -1;
+        }
+    }
+    reactorLoop* loops = calloc((size_t) config->threads, sizeof(reactorLoop));
+    if (loops == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < config->threads; i++) {
+        loops[i].listeners = listeners;
+        loops[i].config = config;
+        loops[i].fd_epoll = epoll_create1(EPOLL_CLOEXEC);
+        if (loops[i].fd_epoll == -1) {
+            return -1;
+        }
+        // exclusive: a new connection wakes one loop only, no thundering herd
+        for (int j = 0; j < listeners->count; j++) {
+            struct epoll_event listenEvent;
+            listenEvent.events = EPOLLIN | EPOLLEXCLUSIVE;
+            listenEvent.data.u64 = ((uint64_t) j << 1) | REACTOR_LISTENTAG;
+            if (epoll_ctl(loops[i].fd_epoll, EPOLL_CTL_ADD, listeners->fds[j], &listenEvent) == -1) {
+                return -1;
+            }
+        }
+    }
+    for (int i = 1; i < config->threads; i++) {
+        int status = pthread_create(&loops[i].thread, NULL, eventLoop, &loops[i]);
+        if (status != 0) {
+            errno = status;
+            return -1;
+        }
+    }
+    eventLoop(&loops[0]);
+    return -1;
+}
+
+/**
+ * @brief event loop of one thread
+ * @param argument void*: the reactorLoop of this thread
+ * @return void*: does not return
+ */
+static void* eventLoop(void* argument) {
+    reactorLoop* loop = argument;
+    struct epoll_event events[REACTOR_EVENTS];
+
+    while (1) {
+        // the oldest connection expires first, the list is ordered by the deadlines
+        int timeout = -1;
+        if (loop->oldest != NULL) {
+            long long left = loop->oldest->deadline - nowMs();
+            timeout = (left > 0) ? (int) left : 0;
+        }
+        int ready = epoll_wait(loop->fd_epoll, events, REACTOR_EVENTS, timeout);
+        if (ready == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "Event loop could not wait: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < ready; i++) {
+            if (events[i].data.u64 & REACTOR_LISTENTAG) {
+                acceptConnections(loop, loop->listeners->fds[events[i].data.u64 >> 1]);
+                continue;
+            }
+            reactorConnection* connection = events[i].data.ptr;
+            trace_setConnection(connection->trace);
+            int status = 0;
+            if (connection->draining) {
+                status = drainRequest(connection);
+                if (status != 0) {
+                    closeConnection(loop, connection);  // client finished (1) or failed (-1)
+                }
+                continue;
+            }
+            touchConnection(loop, connection);
+            // responses are tried right after a request is complete, afterwards on every EPOLLOUT edge
+            while (status == 0) {
+                if (logic_sessionPending(&connection->session)) {
+                    status = writeResponse(connection);
+                    if (status != 1) {
+                        break;      // socket full (0) or failed (-1)
+                    }
+                    logic_sessionSent(&connection->session);
+                }
+                if (logic_sessionFinished(&connection->session)) {
+                    status = 1;
+                    break;
+                }
+                status = readRequest(connection, loop->config);
+                if (status == 1) {
+                    status = 0;     // something new was processed, it may have produced responses
+                } else {
+                    break;          // nothing to read (0) or failed (-1)
+                }
+            }
+            if ((status == 1) && !connection->session.eof) {
+                // a rejected request is not read completely: closing with unread data would reset the
+                // connection and may discard the response at the client, the rest is discarded first
+                // the rest is no activity, the client gets REACTOR_IDLETIMEOUT from now on to finish
+                shutdown(connection->fd, SHUT_WR);
+                connection->draining = 1;
+                status = drainRequest(connection);
+            }
+            if (status != 0) {
+                closeConnection(loop, connection);  // finished (1) or failed (-1)
+            }
+        }
+        expireConnections(loop);
+    }
+    return NULL;
+}
+
+/**
+ * @brief accepts all pending connections and registers them edge triggered in the own epoll instance
+ * @param loop reactorLoop*: the accepting loop
+ * @param fd_listen int: the ready listening socket
+ */
+static void acceptConnections(reactorLoop* loop, int fd_listen) {
+    while (1) {
+        int fd_connected = accept4(fd_listen, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd_connected == -1) {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR) && (errno != ECONNABORTED)) {
+                fprintf(stderr, "Could not accept socket: %s\n", strerror(errno));
+            }
+            return;
+        }
+        reactorConnection* connection = calloc(1, sizeof(reactorConnection));
+        if (connection == NULL) {
+            close(fd_connected);
+            continue;
+        }
+        connection->fd = fd_connected;
+        connection->started = metrics_now();
+        metrics_add(METRICS_ACCEPTED, 1);
+        metrics_add(METRICS_ACTIVE, 1);
+        connection->trace = trace_connection();
+        TRACE(TRACE_ACCEPT, (uint64_t) fd_connected, 0);
+        touchConnection(loop, connection);
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.ptr = connection;
+        if (epoll_ctl(loop->fd_epoll, EPOLL_CTL_ADD, fd_connected, &event) == -1) {
+            closeConnection(loop, connection);
+            continue;
+        }
+    }
+}
+
+/**
+ * @brief reads everything available, edge triggered readiness requires reading until EAGAIN.
+ * Hands the received bytes to the session, which processes the complete requests.
+ * @param connection reactorConnection*: the connection
+ * @param config const reactorConfig*: configuration with the business logic
+ * @return int: 1 if something was received, 0 if nothing was available, -1 on failure
+ */
+static int readRequest(reactorConnection* connection, const reactorConfig* config) {
+    logicBuffer* request = &connection->session.request;
+    size_t before = request->length;
+    while (1) {
+        if (logic_reserve(request, REACTOR_READCHUNK) == -1) {
+            return -1;
+        }
+        ssize_t received = read(connection->fd, request->data + request->length,
+                                request->capacity - request->length);
+        if (received == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+                return -1;
+            }
+            if (request->length == before) {
+                return 0;
+            }
+            break;
+        }
+        if (received == 0) {
+            connection->session.eof = 1;
+            break;
+        }
+        request->length += (size_t) received;
+        // longer than allowed: processed now, a legacy request is answered with an error status then
+        if (request->length > LOGIC_MAXREQUEST) {
+            break;
+        }
+    }
+    if (logic_sessionReceived(config->logic, &connection->session) == -1) {
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief sends as much of the pending responses as the socket takes, file contents with sendfile()
+ * @param connection reactorConnection*: connection with pending responses
+ * @return int: 0 if the socket is full, 1 if the response is sent completely, -1 on failure
+ */
+static int writeResponse(reactorConnection* connection) {
+    return logic_sendResponse(connection->fd, &connection->session.response, &connection->session.send);
+}
+
+/**
+ * @brief discards everything the client still sends after the response, until it shuts down its write direction
+ * @param connection reactorConnection*: draining connection, the own write direction is shut down
+ * @return int: 0 if the client may send more, 1 if it finished, -1 on failure
+ */
+static int drainRequest(reactorConnection* connection) {
+    char drain[REACTOR_READCHUNK];
+    while (1) {
+        ssize_t received = read(connection->fd, drain, sizeof(drain));
+        if (received == 0) {
+            return 1;
+        }
+        if (received == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? 0 : -1;
+        }
+    }
+}
+
+/**
+ * @brief sets the deadline of a connection and moves it to the newest end of the list of the loop
+ * @param loop reactorLoop*: the owning loop
+ * @param connection reactorConnection*: the connection, already in the list or new
+ */
+static void touchConnection(reactorLoop* loop, reactorConnection* connection) {
+    // all connections get the same timeout, so the newest end of the list always has the latest deadline
+    connection->deadline = nowMs() + REACTOR_IDLETIMEOUT;
+    if (loop->newest == connection) {
+        return;
+    }
+    if (connection->previous != NULL) {
+        connection->previous->next = connection->next;
+    } else if (loop->oldest == connection) {
+        loop->oldest = connection->next;
+    }
+    if (connection->next != NULL) {
+        connection->next->previous = connection->previous;
+    }
+    connection->previous = loop->newest;
+    connection->next = NULL;
+    if (loop->newest != NULL) {
+        loop->newest->next = connection;
+    } else {
+        loop->oldest = connection;
+    }
+    loop->newest = connection;
+}
+
+/**
+ * @brief closes the connections whose deadline has passed
+ * @param loop reactorLoop*: the loop
+ */
+static void expireConnections(reactorLoop* loop) {
+    long long now = nowMs();
+    while ((loop->oldest != NULL) && (loop->oldest->deadline <= now)) {
+        trace_setConnection(loop->oldest->trace);
+        closeConnection(loop, loop->oldest);
+    }
+}
+
+/**
+ * @brief closes the socket, this also removes it from the epoll instance, and frees the connection
+ * @param loop reactorLoop*: the owning loop, the connection is removed from its list
+ * @param connection reactorConnection*: the connection
+ */
+static void closeConnection(reactorLoop* loop, reactorConnection* connection) {
+    if (connection->previous != NULL) {
+        connection->previous->next = connection->next;
+    } else if (loop->oldest == connection) {
+        loop->oldest = connection->next;
+    }
+    if (connection->next != NULL) {
+        connection->next->previous = connection->previous;
+    } else if (loop->newest == connection) {
+        loop->newest = connection->previous;
+    }
+    metrics_add(METRICS_ACTIVE, -1);
+    metrics_observe(METRICS_HANDLER, metrics_now() - connection->started);
+    TRACE(TRACE_CLOSE, (uint64_t) connection->fd, 0);
+    close(connection->fd);
+    logic_freeSession(&connection->session);
+    free(connection);
+}
+
+/**
+ * @brief reads the monotonic clock for the deadlines
+ * @return long long: time in ms
+ */
+static long long nowMs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
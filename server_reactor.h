@@ -0,0 +1,27 @@
+/**
+ * @file server_reactor.h
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 06.12.18
+ *
+ * @brief Event driven server core based on epoll
+ * TCP/IP Lecture Distributed Systems
+ */
+#ifndef SERVER_REACTOR_H
+#define SERVER_REACTOR_H
+
+#include "server_logic.h"   // provides logicHandler
+#include "server_listen.h"  // provides listenSet
+
+// -------------------------------------------------------------- typedefs --
+/** @brief Configuration of the reactor */
+typedef struct reactorConfig {
+    int threads;                /**< Number of event loop threads, 0 disables the reactor mode */
+    const logicHandler* logic;  /**< In-process business logic, required */
+    int verbose;                /**< Output in verbose mode 0 off, 1 on */
+} reactorConfig;
+
+// ------------------------------------------------------------- functions --
+int reactor_run(const listenSet* listeners, const reactorConfig* config);
+
+#endif // SERVER_REACTOR_H
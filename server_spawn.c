@@ -0,0 +1,101 @@
+/**
+ * @file server_spawn.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 21.12.18
+ *
+ * @brief Start of the external business logic without fork().
+ * posix_spawn() runs the child in the memory of the server until the exec (clone with CLONE_VM and
+ * CLONE_VFORK in glibc), so the page tables of the server are not copied for every connection, however
+ * large the server has grown. The connection becomes stdin and stdout by file actions, the signal mask and
+ * the signal handlers are reset by the attributes. The binary is opened once at the start and executed
+ * through /proc/self/fd, so it is neither looked up again nor replaced under a running server.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#define _GNU_SOURCE         // provides O_PATH, environ
+#include <stdio.h>          // provides snprintf()
+#include <errno.h>          // provides errno
+#include <signal.h>         // provides sigemptyset(), sigfillset()
+#include <spawn.h>          // provides posix_spawn()
+#include <fcntl.h>          // provides open(), O_PATH
+#include <unistd.h>         // provides environ, STDIN_FILENO
+#include <sys/types.h>
+#include "server_spawn.h"
+
+// --------------------------------------------------------------- defines --
+/** @brief directory of the file descriptors of the process */
+#define SPAWN_FDDIRECTORY "/proc/self/fd/"
+
+/**
+ * @brief opens the binary of the business logic for spawn_logic() and fexecve(). The descriptor is not
+ * closed on exec: a logic which is a script is read by its interpreter through this descriptor.
+ * @param path const char*: path of the binary
+ * @return int: the descriptor, -1 on failure (errno is set)
+ */
+int spawn_openLogic(const char* path) {
+    return open(path, O_PATH);
+}
+
+/**
+ * @brief starts the business logic on a connection, stdin and stdout of the logic are the connection
+ * @param fd_logic int: descriptor of spawn_openLogic(), -1 executes path
+ * @param path const char*: path of the binary, used if fd_logic is -1 or /proc is not mounted
+ * @param name const char*: argv[0] of the logic
+ * @param fd_connected int: the connection, still open in the caller
+ * @return pid_t: process of the logic, -1 on failure (errno is set)
+ */
+pid_t spawn_logic(int fd_logic, const char* path, const char* name, int fd_connected) {
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attributes;
+    int status = posix_spawn_file_actions_init(&actions);
+    if (status != 0) {
+        errno = status;
+        return -1;
+    }
+    status = posix_spawnattr_init(&attributes);
+    if (status != 0) {
+        posix_spawn_file_actions_destroy(&actions);
+        errno = status;
+        return -1;
+    }
+    // the logic starts without blocked signals and with the default handlers, e.g. of SIGPIPE
+    sigset_t noSignals, allSignals;
+    sigemptyset(&noSignals);
+    sigfillset(&allSignals);
+    if (((status = posix_spawn_file_actions_adddup2(&actions, fd_connected, STDIN_FILENO)) == 0) &&
+        ((status = posix_spawn_file_actions_adddup2(&actions, fd_connected, STDOUT_FILENO)) == 0) &&
+        ((status = posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF)) == 0) &&
+        ((status = posix_spawnattr_setsigmask(&attributes, &noSignals)) == 0) &&
+        ((status = posix_spawnattr_setsigdefault(&attributes, &allSignals)) == 0)) {
+        char* const argv[] = {(char*) name, NULL};
+        pid_t pid = -1;
+        status = ENOENT;
+        if (fd_logic != -1) {
+            char program[sizeof(SPAWN_FDDIRECTORY) + 16];
+            snprintf(program, sizeof(program), "%s%d", SPAWN_FDDIRECTORY, fd_logic);
+            status = posix_spawn(&pid, program, &actions, &attributes, argv, environ);
+        }
+        if (status == ENOENT) {
+            status = posix_spawn(&pid, path, &actions, &attributes, argv, environ);
+        }
+        if (status == 0) {
+            posix_spawnattr_destroy(&attributes);
+            posix_spawn_file_actions_destroy(&actions);
+            return pid;
+        }
+    }
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+    errno = status;
+    return -1;
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
@@ -0,0 +1,19 @@
+/**
+ * @file server_spawn.h
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 21.12.18
+ *
+ * @brief Start of the external business logic with posix_spawn() from a pre-opened binary
+ * TCP/IP Lecture Distributed Systems
+ */
+#ifndef SERVER_SPAWN_H
+#define SERVER_SPAWN_H
+
+#include <sys/types.h>      // provides pid_t
+
+// ------------------------------------------------------------- functions --
+int spawn_openLogic(const char* path);
+pid_t spawn_logic(int fd_logic, const char* path, const char* name, int fd_connected);
+
+#endif // SERVER_SPAWN_H
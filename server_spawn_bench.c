@@ -0,0 +1,215 @@
+/**
+ * @file server_spawn_bench.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 21.12.18
+ *
+ * @brief Benchmark of the start of the business logic: fork() and execl() as the spawning server did it,
+ * against spawn_logic() (posix_spawn() of the pre-opened binary). The parent is grown to different sizes
+ * first, because fork() copies the page tables of the parent and gets slower with its size, the spawn
+ * does not. Reported are the time the parent is blocked by the start, and the time until the logic has
+ * terminated, per start.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#include <stdlib.h>         // provides malloc(), qsort(), strtol()
+#include <stdio.h>          // provides the printf()
+#include <string.h>         // provide strerror(), memset()
+#include <errno.h>          // provides errno
+#include <stdint.h>         // provides uint64_t
+#include <time.h>           // provides clock_gettime()
+#include <fcntl.h>          // provides open()
+#include <unistd.h>         // provides fork(), execl(), getopt()
+#include <sys/types.h>
+#include <sys/wait.h>       // provides waitpid()
+#include "server_spawn.h"
+
+// --------------------------------------------------------------- defines --
+/** @brief default binary started, a real logic may be given with -b */
+#define SPAWNBENCH_BINARY "/bin/true"
+/** @brief default starts per method and parent size */
+#define SPAWNBENCH_STARTS 200
+/** @brief default sizes of the parent in MiB */
+#define SPAWNBENCH_SIZES "0,64,512"
+/** @brief largest number of parent sizes */
+#define SPAWNBENCH_MAXSIZES 16
+
+// -------------------------------------------------------------- typedefs --
+/** @brief Ways to start the logic */
+enum spawnMethod {
+    METHOD_FORK,                /**< fork(), dup2() and execl() in the child */
+    METHOD_SPAWN,               /**< spawn_logic() */
+    METHOD_COUNT                /**< Number of methods */
+};
+
+// --------------------------------------------------------------- globals --
+static const char* const methodNames[METHOD_COUNT] = {"fork+execl", "posix_spawn"};
+
+// ------------------------------------------------------------- functions --
+static pid_t start(enum spawnMethod method, const char* binary, int fd_logic, int fd_null);
+static int compareTimes(const void* a, const void* b);
+static uint64_t now(void);
+static void usage(FILE* stream, const char* cmnd, int exitcode);
+
+// ------------------------------------------------------------------- main --
+/**
+ * @brief runs every method for every parent size and prints the latencies
+ * @param argc int: number of arguments
+ * @param argv char**: the arguments
+ * @return int: EXIT_SUCCESS, EXIT_FAILURE if the logic could not be started
+ */
+int main(int argc, char** argv) {
+    const char* binary = SPAWNBENCH_BINARY;
+    const char* sizeList = SPAWNBENCH_SIZES;
+    long starts = SPAWNBENCH_STARTS;
+    int option;
+    while ((option = getopt(argc, argv, "b:n:m:h")) != -1) {
+        switch (option) {
+            case 'b':
+                binary = optarg;
+                break;
+            case 'n':
+                starts = strtol(optarg, NULL, 10);
+                break;
+            case 'm':
+                sizeList = optarg;
+                break;
+            case 'h':
+                usage(stdout, argv[0], EXIT_SUCCESS);
+                break;
+            default:
+                usage(stderr, argv[0], EXIT_FAILURE);
+        }
+    }
+    long sizes[SPAWNBENCH_MAXSIZES];
+    int sizeCount = 0;
+    for (const char* next = sizeList; (*next != '\0') && (sizeCount < SPAWNBENCH_MAXSIZES); sizeCount++) {
+        char* end = NULL;
+        sizes[sizeCount] = strtol(next, &end, 10);
+        if ((end == next) || (sizes[sizeCount] < 0) || ((*end != ',') && (*end != '\0'))) {
+            usage(stderr, argv[0], EXIT_FAILURE);
+        }
+        next = (*end == ',') ? end + 1 : end;
+    }
+    if (starts < 1) {
+        usage(stderr, argv[0], EXIT_FAILURE);
+    }
+    int fd_logic = spawn_openLogic(binary);
+    int fd_null = open("/dev/null", O_RDWR | O_CLOEXEC);
+    uint64_t* blocked = malloc((size_t) starts * sizeof(uint64_t));
+    if ((fd_logic == -1) || (fd_null == -1) || (blocked == NULL)) {
+        fprintf(stderr, "%s: could not open %s: %s\n", argv[0], binary, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    fprintf(stdout, "%-12s %10s %10s %10s %10s %12s   (us)\n", "method", "parent MiB", "p50", "p99", "mean",
+            "until exit");
+    char* parent = NULL;
+    for (int s = 0; s < sizeCount; s++) {
+        // the parent memory is touched, so its page tables are populated like those of a grown server
+        size_t size = (size_t) sizes[s] * 1024 * 1024;
+        free(parent);
+        parent = (size > 0) ? malloc(size) : NULL;
+        if ((size > 0) && (parent == NULL)) {
+            fprintf(stderr, "%s: could not allocate %ld MiB\n", argv[0], sizes[s]);
+            return EXIT_FAILURE;
+        }
+        if (parent != NULL) {
+            memset(parent, 1, size);
+        }
+        for (int m = 0; m < METHOD_COUNT; m++) {
+            uint64_t total = 0, sum = 0;
+            for (long i = 0; i < starts; i++) {
+                uint64_t begin = now();
+                pid_t pid = start((enum spawnMethod) m, binary, fd_logic, fd_null);
+                uint64_t started = now();
+                if (pid == -1) {
+                    fprintf(stderr, "%s: could not start %s: %s\n", argv[0], binary, strerror(errno));
+                    return EXIT_FAILURE;
+                }
+                waitpid(pid, NULL, 0);
+                total += now() - begin;
+                blocked[i] = started - begin;
+                sum += blocked[i];
+            }
+            qsort(blocked, (size_t) starts, sizeof(uint64_t), compareTimes);
+            fprintf(stdout, "%-12s %10ld %10.1f %10.1f %10.1f %12.1f\n", methodNames[m], sizes[s],
+                    (double) blocked[starts / 2] / 1e3, (double) blocked[(starts * 99) / 100] / 1e3,
+                    (double) sum / (double) starts / 1e3, (double) total / (double) starts / 1e3);
+        }
+    }
+    free(parent);
+    free(blocked);
+    close(fd_null);
+    close(fd_logic);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief starts the binary with /dev/null as stdin and stdout
+ * @param method enum spawnMethod: how to start it
+ * @param binary const char*: path of the binary
+ * @param fd_logic int: the pre-opened binary
+ * @param fd_null int: /dev/null
+ * @return pid_t: process of the binary, -1 on failure (errno is set)
+ */
+static pid_t start(enum spawnMethod method, const char* binary, int fd_logic, int fd_null) {
+    if (method == METHOD_SPAWN) {
+        return spawn_logic(fd_logic, binary, binary, fd_null);
+    }
+    // the sequence of the spawning server before the spawn
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(fd_null, STDIN_FILENO);
+        dup2(fd_null, STDOUT_FILENO);
+        execl(binary, binary, NULL);
+        _exit(EXIT_FAILURE);
+    }
+    return pid;
+}
+
+/**
+ * @brief orders times ascending for qsort()
+ * @param a const void*: first uint64_t
+ * @param b const void*: second uint64_t
+ * @return int: <0, 0 or >0
+ */
+static int compareTimes(const void* a, const void* b) {
+    uint64_t first = *(const uint64_t*) a;
+    uint64_t second = *(const uint64_t*) b;
+    return (first > second) - (first < second);
+}
+
+/**
+ * @brief reads the monotonic clock
+ * @return uint64_t: time in ns
+ */
+static uint64_t now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) time.tv_sec * 1000000000ull + (uint64_t) time.tv_nsec;
+}
+
+/**
+ * @brief prints the usage and terminates
+ * @param stream FILE*: the stream to write the usage information to
+ * @param cmnd const char*: name of the executable
+ * @param exitcode int: the exit code
+ */
+static void usage(FILE* stream, const char* cmnd, int exitcode) {
+    fprintf(stream, "usage: %s [-b <binary>] [-n <starts>] [-m <MiB>,...]\n", cmnd);
+    fprintf(stream, "\t-b <binary>\t binary to start [default: %s]\n", SPAWNBENCH_BINARY);
+    fprintf(stream, "\t-n <starts>\t starts per method and parent size [default: %d]\n", SPAWNBENCH_STARTS);
+    fprintf(stream, "\t-m <MiB>,...\t sizes of the parent [default: %s]\n", SPAWNBENCH_SIZES);
+    fprintf(stream, "\t-h\t\t outputs this info\n");
+    exit(exitcode);
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
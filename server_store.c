@@ -0,0 +1,802 @@
+/**
+ * @file server_store.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 22.12.18
+ *
+ * @brief Append-only, memory-mapped message store of the bulletin board.
+ * The store file starts with a header holding the end of the reserved records (tail) and the allocated length
+ * of the file (capacity), the records follow. Every process maps the file shared. An append allocates the file
+ * space first, then reserves its record at the tail by setting the length of the record with a compare and
+ * exchange, moves the tail behind it, copies the message and commits the record by setting its state last.
+ * A writer which finds the record at the tail reserved by another one moves the tail on for it. So threads and
+ * processes append without a lock, and every record in front of the tail has a valid length.
+ * Readers scan the committed records in order and keep an offset index of them. A record still being written
+ * ends the scan until it is committed, unless its writer has died: the pid of the writer is kept in the length
+ * until the commit, such a record is marked abandoned and skipped.
+ * A process which attaches while no other process has the store open recovers it: records torn by a crashed
+ * writer are marked abandoned and skipped, and the store is compacted into a new file when the abandoned
+ * records take too much of it. A bulletin board file in the former text
+ * format ("<timestamp> <user length> <img length> <message length>\n" and the fields) is imported then.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#define _GNU_SOURCE         // provides fallocate()
+#include <stdlib.h>         // provides malloc(), realloc(), free()
+#include <stdio.h>          // provides snprintf(), sscanf()
+#include <string.h>         // provides memcpy(), memcmp(), memchr()
+#include <errno.h>          // provides errno
+#include <stdint.h>         // provides uint64_t, uint32_t
+#include <stddef.h>         // provides offsetof()
+#include <stdatomic.h>      // provides atomic_ullong, atomic_uint
+#include <pthread.h>        // provides pthread_mutex_lock()
+#include <signal.h>         // provides kill()
+#include <fcntl.h>          // provides open(), fallocate()
+#include <unistd.h>         // provides pread(), close(), fsync()
+#include <limits.h>         // provides PATH_MAX
+#include <sys/mman.h>       // provides mmap()
+#include <sys/file.h>       // provides flock()
+#include <sys/stat.h>       // provides fstat()
+#include <zlib.h>           // provides crc32()
+#include "server_store.h"
+
+// --------------------------------------------------------------- defines --
+/** @brief first bytes of a store file */
+#define STORE_MAGIC "SMSTORE1"
+/** @brief length of STORE_MAGIC */
+#define STORE_MAGICLENGTH 8
+/** @brief address space mapped per process, the store cannot grow beyond */
+#define STORE_MAPSIZE (1ull << 30)
+/** @brief the file is allocated in steps of this size */
+#define STORE_GROWTH (1024 * 1024)
+/** @brief records start at multiples of this */
+#define STORE_ALIGNMENT 8
+/** @brief offset of the first record, behind the header */
+#define STORE_DATASTART 64
+/** @brief abandoned records are compacted away if they exceed this and a quarter of the store */
+#define STORE_COMPACTMINIMUM (64 * 1024)
+/** @brief attempts to attach while other processes replace the file */
+#define STORE_ATTEMPTS 8
+/** @brief first allocation of the offset index */
+#define STORE_INDEXSIZE 64
+/** @brief maximal length of the header line of a record in the former text format */
+#define LEGACY_HEADERLENGTH 96
+/** @brief the reservation keeps the pid of the writer in the length above this bit until the commit */
+#define STORE_WRITERSHIFT 32
+/** @brief bits of the length of a record, the store is far smaller than 4 GiB */
+#define STORE_LENGTHMASK ((1ull << STORE_WRITERSHIFT) - 1)
+
+// -------------------------------------------------------------- typedefs --
+/** @brief State of a record, set last by the writer */
+enum entryState {
+    ENTRY_WRITING = 0,          /**< Reserved, the message is being copied, zeroed file space reads like this */
+    ENTRY_COMMITTED,            /**< Complete, the message may be read */
+    ENTRY_ABANDONED             /**< Torn by a crashed writer, skipped and removed by the compaction */
+};
+
+/** @brief Header at the start of the store file, shared by all processes */
+typedef struct storeHeader {
+    char magic[STORE_MAGICLENGTH];      /**< STORE_MAGIC */
+    atomic_ullong tail;                 /**< End of the reserved records */
+    atomic_ullong capacity;             /**< Allocated length of the file, only grows */
+} storeHeader;
+
+/** @brief Header of a record, followed by user, img and message */
+typedef struct storeEntry {
+    atomic_uint state;          /**< enum entryState */
+    uint32_t checksum;          /**< CRC-32 of the fields from length on and of the data */
+    atomic_ullong length;       /**< Length of the record with its header, aligned to STORE_ALIGNMENT, set first by
+                                     the reservation, with the pid of the writer above STORE_WRITERSHIFT until
+                                     the commit */
+    int64_t timestamp;          /**< Time of the post, seconds since the epoch */
+    uint64_t userLength;        /**< Length of the user */
+    uint64_t imgLength;         /**< Length of the image URL */
+    uint64_t messageLength;     /**< Length of the message */
+} storeEntry;
+
+/** @brief A new store file which is filled and then replaces the store */
+typedef struct storeBuilder {
+    char temporary[PATH_MAX + 8];       /**< Path of the new file until it is renamed */
+    int fd;                             /**< The new file */
+    char* base;                         /**< Its mapping */
+    uint64_t end;                       /**< End of the records written */
+    uint64_t capacity;                  /**< Allocated length */
+} storeBuilder;
+
+_Static_assert(sizeof(storeHeader) <= STORE_DATASTART, "the header must fit in front of the records");
+_Static_assert(STORE_MAPSIZE <= STORE_LENGTHMASK, "a record length must fit below the pid of the writer");
+_Static_assert((ATOMIC_LLONG_LOCK_FREE == 2) && (ATOMIC_INT_LOCK_FREE == 2),
+               "atomics in a shared mapping must be lock free");
+
+// --------------------------------------------------------------- globals --
+/** @brief protects the attachment and the offset index */
+static pthread_mutex_t storeLock = PTHREAD_MUTEX_INITIALIZER;
+/** @brief 1 after the store is mapped, mapping and fd_store are set before */
+static atomic_int attached;
+/** @brief the mapped store file */
+static char* mapping = NULL;
+/** @brief the store file, a shared lock on it is held as long as the process lives */
+static int fd_store = -1;
+/** @brief offsets of the committed records in order */
+static uint64_t* offsets = NULL;
+/** @brief number of records in offsets */
+static size_t indexed = 0;
+/** @brief allocated elements of offsets */
+static size_t indexCapacity = 0;
+/** @brief offset the next scan continues at */
+static uint64_t scanned = STORE_DATASTART;
+
+// ------------------------------------------------------------- functions --
+static int openStore(const char* path);
+static int isCurrent(int fd, const char* path);
+static int recoverStore(int fd, const char* path);
+static int initStore(int fd);
+static int importLegacy(int fd, const char* path, size_t size);
+static size_t parseLegacy(const char* data, size_t available, storeMessage* message);
+static int builderOpen(storeBuilder* builder, const char* path);
+static int builderAdd(storeBuilder* builder, const storeMessage* message);
+static int builderCommit(storeBuilder* builder, const char* path);
+static void builderAbort(storeBuilder* builder);
+static int growStore(storeHeader* header, int fd, uint64_t end);
+static void writeEntry(char* at, const storeMessage* message, uint64_t length);
+static void readEntry(const char* at, storeMessage* message);
+static int entryFits(const storeEntry* entry, uint64_t offset, uint64_t bound);
+static uint64_t entrySize(const storeEntry* entry);
+static uint64_t findEntry(const char* base, uint64_t from, uint64_t bound);
+static int isZero(const char* data, uint64_t length);
+static int writerAlive(const storeEntry* entry);
+static uint32_t entryChecksum(const storeEntry* entry);
+static uint64_t entryLength(const storeMessage* message);
+
+/**
+ * @brief maps the store file, creates it if it does not exist. The first call of the process opens it,
+ * further calls return at once. Call before any other function of the store.
+ * @param path const char*: path of the store file
+ * @return int: 0 in case of success, -1 on failure (errno is set)
+ */
+int store_attach(const char* path) {
+    if (atomic_load_explicit(&attached, memory_order_acquire)) {
+        return 0;
+    }
+    int result = 0;
+    pthread_mutex_lock(&storeLock);
+    if (!atomic_load_explicit(&attached, memory_order_relaxed)) {
+        result = openStore(path);
+        if (result == 0) {
+            atomic_store_explicit(&attached, 1, memory_order_release);
+        }
+    }
+    pthread_mutex_unlock(&storeLock);
+    return result;
+}
+
+/**
+ * @brief appends a message. The record is reserved by a compare and exchange on its length at the shared
+ * tail, so concurrent appends of threads and processes never wait for each other. The file space is allocated
+ * before, an append which fails reserves nothing.
+ * @param message const storeMessage*: the message, the fields are copied
+ * @return int: 0 in case of success, -1 on failure (errno is set)
+ */
+int store_append(const storeMessage* message) {
+    if (!atomic_load_explicit(&attached, memory_order_acquire)) {
+        errno = EBADF;
+        return -1;
+    }
+    storeHeader* header = (storeHeader*) mapping;
+    uint64_t length = entryLength(message);
+    unsigned long long reservation = length | ((unsigned long long) getpid() << STORE_WRITERSHIFT);
+    unsigned long long offset = atomic_load(&header->tail);
+    while (1) {
+        if (offset + length > STORE_MAPSIZE) {
+            errno = EFBIG;
+            return -1;
+        }
+        if (growStore(header, fd_store, offset + length) == -1) {
+            return -1;
+        }
+        storeEntry* entry = (storeEntry*) (mapping + offset);
+        unsigned long long reserved = 0;
+        if (atomic_compare_exchange_strong(&entry->length, &reserved, reservation)) {
+            // fails only if another writer moved the tail on for this record already
+            unsigned long long expected = offset;
+            atomic_compare_exchange_strong(&header->tail, &expected, offset + length);
+            break;
+        }
+        // reserved by another writer which did not move the tail yet, it may have died in between
+        unsigned long long expected = offset;
+        atomic_compare_exchange_strong(&header->tail, &expected, offset + (reserved & STORE_LENGTHMASK));
+        offset = atomic_load(&header->tail);
+    }
+    writeEntry(mapping + offset, message, length);
+    return 0;
+}
+
+/**
+ * @brief counts the committed messages, the records appended since the last call are added to the index
+ * @param count size_t*: receives the number of messages, it only grows and serves as version of the board
+ * @return int: 0 in case of success, -1 on failure (errno is set)
+ */
+int store_count(size_t* count) {
+    if (!atomic_load_explicit(&attached, memory_order_acquire)) {
+        errno = EBADF;
+        return -1;
+    }
+    const storeHeader* header = (const storeHeader*) mapping;
+    int result = 0;
+    pthread_mutex_lock(&storeLock);
+    uint64_t bound = atomic_load(&header->tail);
+    uint64_t capacity = atomic_load(&header->capacity);
+    if (capacity < bound) {
+        bound = capacity;
+    }
+    while (scanned + sizeof(storeEntry) <= bound) {
+        storeEntry* entry = (storeEntry*) (mapping + scanned);
+        // acquire pairs with the release of the writer, the fields are complete once the state is set
+        unsigned state = atomic_load_explicit(&entry->state, memory_order_acquire);
+        if (state == ENTRY_WRITING) {
+            if (writerAlive(entry)) {
+                break;
+            }
+            // nobody will commit the record any more, all readers skip it from now on
+            unsigned expected = ENTRY_WRITING;
+            atomic_compare_exchange_strong(&entry->state, &expected, ENTRY_ABANDONED);
+            continue;
+        }
+        // the fields of an abandoned record may be torn, only its length is reliable
+        uint64_t length = entrySize(entry);
+        if ((length < sizeof(storeEntry)) || (length > bound - scanned) ||
+            ((state == ENTRY_COMMITTED) && !entryFits(entry, scanned, bound))) {
+            break;
+        }
+        if (state == ENTRY_COMMITTED) {
+            if (indexed == indexCapacity) {
+                size_t grownCapacity = (indexCapacity == 0) ? STORE_INDEXSIZE : 2 * indexCapacity;
+                uint64_t* grown = realloc(offsets, grownCapacity * sizeof(uint64_t));
+                if (grown == NULL) {
+                    result = -1;
+                    break;
+                }
+                offsets = grown;
+                indexCapacity = grownCapacity;
+            }
+            offsets[indexed++] = scanned;
+        }
+        scanned += length;
+    }
+    *count = indexed;
+    pthread_mutex_unlock(&storeLock);
+    return result;
+}
+
+/**
+ * @brief returns a message of the index
+ * @param index size_t: number of the message, below the count of store_count()
+ * @param message storeMessage*: receives the fields, they point into the mapping and stay valid
+ * @return int: 0 in case of success, -1 if the message is not indexed
+ */
+int store_message(size_t index, storeMessage* message) {
+    int result = -1;
+    pthread_mutex_lock(&storeLock);
+    if (index < indexed) {
+        readEntry(mapping + offsets[index], message);
+        result = 0;
+    }
+    pthread_mutex_unlock(&storeLock);
+    if (result == -1) {
+        errno = EINVAL;
+    }
+    return result;
+}
+
+/**
+ * @brief opens and maps the store. Every process holds a shared lock on the file, a process which gets the
+ * exclusive lock is alone and recovers the store. A recovery may replace the file, a process which waited
+ * for its lock on the replaced file opens the new one.
+ * @param path const char*: path of the store file
+ * @return int: 0 in case of success, -1 on failure (errno is set)
+ */
+static int openStore(const char* path) {
+    for (int attempt = 0; attempt < STORE_ATTEMPTS; attempt++) {
+        int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd == -1) {
+            return -1;
+        }
+        int exclusive = (flock(fd, LOCK_EX | LOCK_NB) == 0);
+        int state = (exclusive || (flock(fd, LOCK_SH) == 0)) ? isCurrent(fd, path) : -1;
+        if ((state == 1) && exclusive) {
+            state = recoverStore(fd, path);
+            // another process may recover while the lock is converted, it finds nothing left to do
+            if ((state == 1) && (flock(fd, LOCK_SH) == -1)) {
+                state = -1;
+            }
+        }
+        struct stat storeStat;
+        char* base = MAP_FAILED;
+        if ((state == 1) && (fstat(fd, &storeStat) == 0) && (storeStat.st_size >= STORE_DATASTART)) {
+            base = mmap(NULL, STORE_MAPSIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if ((base != MAP_FAILED) && (memcmp(base, STORE_MAGIC, STORE_MAGICLENGTH) == 0)) {
+            mapping = base;
+            fd_store = fd;
+            return 0;
+        }
+        int error = (state == 1) ? EINVAL : errno;
+        if (base != MAP_FAILED) {
+            munmap(base, STORE_MAPSIZE);
+        }
+        close(fd);
+        if (state != 0) {
+            errno = error;
+            return -1;
+        }
+    }
+    errno = EAGAIN;
+    return -1;
+}
+
+/**
+ * @brief checks if the open file is still the one at the path, a recovery may have replaced it
+ * @param fd int: the open file
+ * @param path const char*: its path
+ * @return int: 1 if it is, 0 if it was replaced, -1 on failure
+ */
+static int isCurrent(int fd, const char* path) {
+    struct stat openStat;
+    struct stat pathStat;
+    if (fstat(fd, &openStat) == -1) {
+        return -1;
+    }
+    if (stat(path, &pathStat) == -1) {
+        return (errno == ENOENT) ? 0 : -1;
+    }
+    return ((openStat.st_dev == pathStat.st_dev) && (openStat.st_ino == pathStat.st_ino)) ? 1 : 0;
+}
+
+/**
+ * @brief recovers the store while no other process has it open. Intact records are kept, a committed record
+ * with a wrong checksum or a record which was never committed is marked abandoned and skipped, every reserved
+ * record has its length. A record reserved by a writer which died before it moved the tail is taken in. A range
+ * without a valid length (a damaged record, or a hole of an older version of the store) is abandoned up to the
+ * next intact record. The space behind the last record is zeroed for the next reservation.
+ * @param fd int: the store file, locked exclusively
+ * @param path const char*: its path
+ * @return int: 1 if the file is ready, 0 if it was replaced by a new one, -1 on failure
+ */
+static int recoverStore(int fd, const char* path) {
+    struct stat storeStat;
+    char magic[STORE_MAGICLENGTH];
+    if (fstat(fd, &storeStat) == -1) {
+        return -1;
+    }
+    if (storeStat.st_size == 0) {
+        return initStore(fd);
+    }
+    if ((storeStat.st_size < STORE_DATASTART) || (pread(fd, magic, STORE_MAGICLENGTH, 0) != STORE_MAGICLENGTH) ||
+        (memcmp(magic, STORE_MAGIC, STORE_MAGICLENGTH) != 0)) {
+        return importLegacy(fd, path, (size_t) storeStat.st_size);
+    }
+    char* base = mmap(NULL, STORE_MAPSIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+    storeHeader* header = (storeHeader*) base;
+    uint64_t size = (uint64_t) storeStat.st_size;
+    uint64_t end = STORE_DATASTART;
+    uint64_t abandoned = 0;
+    // the scan runs past the tail, a writer may have died between its reservation and the move of the tail
+    while (end + sizeof(storeEntry) <= size) {
+        storeEntry* entry = (storeEntry*) (base + end);
+        if (!entryFits(entry, end, size)) {
+            uint64_t next = findEntry(base, end + sizeof(storeEntry), size);
+            if (next == 0) {
+                break;
+            }
+            // the range up to the next intact record becomes an abandoned record without fields
+            entry->userLength = 0;
+            entry->imgLength = 0;
+            entry->messageLength = 0;
+            atomic_store(&entry->length, next - end);
+            atomic_store(&entry->state, ENTRY_ABANDONED);
+        }
+        if ((atomic_load(&entry->state) != ENTRY_COMMITTED) || (entryChecksum(entry) != entry->checksum)) {
+            atomic_store(&entry->state, ENTRY_ABANDONED);
+            atomic_store(&entry->length, entrySize(entry));
+            abandoned += entrySize(entry);
+        }
+        end += entrySize(entry);
+    }
+    // the next reservation must find a zero length behind the last record
+    if (!isZero(base + end, size - end)) {
+        memset(base + end, 0, size - end);
+    }
+    atomic_store(&header->tail, end);
+    atomic_store(&header->capacity, (unsigned long long) storeStat.st_size);
+
+    int result = 1;
+    if ((abandoned >= STORE_COMPACTMINIMUM) && (4 * abandoned >= end)) {
+        storeBuilder builder;
+        if (builderOpen(&builder, path) == 0) {
+            result = 0;
+            for (uint64_t offset = STORE_DATASTART; (result == 0) && (offset < end);
+                 offset += entrySize((storeEntry*) (base + offset))) {
+                if (atomic_load(&((storeEntry*) (base + offset))->state) == ENTRY_COMMITTED) {
+                    storeMessage message;
+                    readEntry(base + offset, &message);
+                    result = builderAdd(&builder, &message);
+                }
+            }
+            if ((result == 0) && (builderCommit(&builder, path) == 0)) {
+                result = 0;
+            } else {
+                // the store stays usable with the abandoned records
+                builderAbort(&builder);
+                result = 1;
+            }
+        }
+    }
+    munmap(base, STORE_MAPSIZE);
+    return result;
+}
+
+/**
+ * @brief writes the header of an empty store
+ * @param fd int: the empty store file, locked exclusively
+ * @return int: 1 in case of success, -1 on failure
+ */
+static int initStore(int fd) {
+    if (fallocate(fd, 0, 0, STORE_GROWTH) == -1) {
+        return -1;
+    }
+    char* base = mmap(NULL, STORE_DATASTART, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+    storeHeader* header = (storeHeader*) base;
+    atomic_store(&header->tail, STORE_DATASTART);
+    atomic_store(&header->capacity, STORE_GROWTH);
+    // the magic last, a store without it is initialized again
+    memcpy(header->magic, STORE_MAGIC, STORE_MAGICLENGTH);
+    munmap(base, STORE_DATASTART);
+    return 1;
+}
+
+/**
+ * @brief replaces a bulletin board file in the former text format by a store with its messages. A torn
+ * record at the end is dropped, a file which does not start with a record is left alone.
+ * @param fd int: the board file, locked exclusively
+ * @param path const char*: its path
+ * @param size size_t: its length
+ * @return int: 0 if it was replaced, -1 on failure
+ */
+static int importLegacy(int fd, const char* path, size_t size) {
+    char* board = malloc(size);
+    if (board == NULL) {
+        return -1;
+    }
+    size_t loaded = 0;
+    while (loaded < size) {
+        ssize_t received = pread(fd, board + loaded, size - loaded, (off_t) loaded);
+        if ((received == -1) && (errno == EINTR)) {
+            continue;
+        }
+        if (received <= 0) {
+            free(board);
+            return -1;
+        }
+        loaded += (size_t) received;
+    }
+    storeMessage message;
+    if (parseLegacy(board, size, &message) == 0) {
+        free(board);
+        errno = EINVAL;
+        return -1;
+    }
+    storeBuilder builder;
+    int result = builderOpen(&builder, path);
+    size_t offset = 0;
+    while ((result == 0) && (offset < size)) {
+        size_t recordLength = parseLegacy(board + offset, size - offset, &message);
+        if (recordLength == 0) {
+            break;
+        }
+        result = builderAdd(&builder, &message);
+        offset += recordLength;
+    }
+    if (result == 0) {
+        result = builderCommit(&builder, path);
+    } else {
+        builderAbort(&builder);
+    }
+    free(board);
+    return result;
+}
+
+/**
+ * @brief parses one record of the former text format
+ * @param data const char*: start of the record
+ * @param available size_t: bytes left in the file
+ * @param message storeMessage*: receives the fields, they point into data
+ * @return size_t: length of the complete record, 0 if the record is incomplete or damaged
+ */
+static size_t parseLegacy(const char* data, size_t available, storeMessage* message) {
+    char header[LEGACY_HEADERLENGTH];
+    const char* delimiter = memchr(data, '\n', available);
+    if ((delimiter == NULL) || ((size_t) (delimiter - data) >= sizeof(header))) {
+        return 0;
+    }
+    size_t headerLength = (size_t) (delimiter - data) + 1;
+    memcpy(header, data, headerLength - 1);
+    header[headerLength - 1] = '\0';
+    if (sscanf(header, "%ld %zu %zu %zu", &message->timestamp, &message->userLength, &message->imgLength,
+               &message->messageLength) != 4) {
+        return 0;
+    }
+    size_t left = available - headerLength;
+    if ((message->userLength > left) || (message->imgLength > left - message->userLength) ||
+        (message->messageLength > left - message->userLength - message->imgLength)) {
+        return 0;
+    }
+    message->user = data + headerLength;
+    message->img = message->user + message->userLength;
+    message->message = message->img + message->imgLength;
+    return headerLength + message->userLength + message->imgLength + message->messageLength;
+}
+
+/**
+ * @brief creates a temporary store file next to the store
+ * @param builder storeBuilder*: receives the new file
+ * @param path const char*: path of the store
+ * @return int: 0 in case of success, -1 on failure
+ */
+static int builderOpen(storeBuilder* builder, const char* path) {
+    snprintf(builder->temporary, sizeof(builder->temporary), "%s.XXXXXX", path);
+    builder->fd = mkostemp(builder->temporary, O_CLOEXEC);
+    if (builder->fd == -1) {
+        return -1;
+    }
+    builder->base = mmap(NULL, STORE_MAPSIZE, PROT_READ | PROT_WRITE, MAP_SHARED, builder->fd, 0);
+    if (builder->base == MAP_FAILED) {
+        close(builder->fd);
+        unlink(builder->temporary);
+        return -1;
+    }
+    builder->end = STORE_DATASTART;
+    builder->capacity = 0;
+    return 0;
+}
+
+/**
+ * @brief appends a committed record to the new file
+ * @param builder storeBuilder*: the new file
+ * @param message const storeMessage*: the message
+ * @return int: 0 in case of success, -1 on failure
+ */
+static int builderAdd(storeBuilder* builder, const storeMessage* message) {
+    uint64_t length = entryLength(message);
+    if (builder->end + length > STORE_MAPSIZE) {
+        errno = EFBIG;
+        return -1;
+    }
+    if (builder->end + length > builder->capacity) {
+        uint64_t capacity = (builder->end + length + STORE_GROWTH - 1) / STORE_GROWTH * STORE_GROWTH;
+        if (fallocate(builder->fd, 0, 0, (off_t) capacity) == -1) {
+            return -1;
+        }
+        builder->capacity = capacity;
+    }
+    writeEntry(builder->base + builder->end, message, length);
+    builder->end += length;
+    return 0;
+}
+
+/**
+ * @brief completes the new file, writes it to disk and replaces the store with it
+ * @param builder storeBuilder*: the new file, closed afterwards
+ * @param path const char*: path of the store
+ * @return int: 0 in case of success, -1 on failure (the new file is removed)
+ */
+static int builderCommit(storeBuilder* builder, const char* path) {
+    if ((builder->capacity == 0) && (fallocate(builder->fd, 0, 0, STORE_GROWTH) == -1)) {
+        builderAbort(builder);
+        return -1;
+    }
+    if (builder->capacity == 0) {
+        builder->capacity = STORE_GROWTH;
+    }
+    storeHeader* header = (storeHeader*) builder->base;
+    atomic_store(&header->tail, builder->end);
+    atomic_store(&header->capacity, builder->capacity);
+    memcpy(header->magic, STORE_MAGIC, STORE_MAGICLENGTH);
+    // the records must be on disk before the name points to them
+    if ((fchmod(builder->fd, 0644) == -1) || (fsync(builder->fd) == -1) ||
+        (rename(builder->temporary, path) == -1)) {
+        builderAbort(builder);
+        return -1;
+    }
+    munmap(builder->base, STORE_MAPSIZE);
+    close(builder->fd);
+    return 0;
+}
+
+/**
+ * @brief removes the new file
+ * @param builder storeBuilder*: the new file, closed afterwards
+ */
+static void builderAbort(storeBuilder* builder) {
+    munmap(builder->base, STORE_MAPSIZE);
+    close(builder->fd);
+    unlink(builder->temporary);
+}
+
+/**
+ * @brief makes sure the file is allocated up to the end of a record. Concurrent writers may grow it at the
+ * same time, fallocate() never shrinks the file and the capacity only increases.
+ * @param header storeHeader*: header of the store
+ * @param fd int: the store file
+ * @param end uint64_t: end of the record
+ * @return int: 0 in case of success, -1 on failure
+ */
+static int growStore(storeHeader* header, int fd, uint64_t end) {
+    unsigned long long capacity = atomic_load(&header->capacity);
+    while (capacity < end) {
+        unsigned long long grown = (end + STORE_GROWTH - 1) / STORE_GROWTH * STORE_GROWTH;
+        if (fallocate(fd, 0, (off_t) capacity, (off_t) (grown - capacity)) == -1) {
+            return -1;
+        }
+        // a failed exchange loads the capacity another writer set
+        if (atomic_compare_exchange_weak(&header->capacity, &capacity, grown)) {
+            break;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief writes a record and commits it
+ * @param at char*: start of the reserved record
+ * @param message const storeMessage*: the message
+ * @param length uint64_t: length of the record
+ */
+static void writeEntry(char* at, const storeMessage* message, uint64_t length) {
+    storeEntry* entry = (storeEntry*) at;
+    // the pid of the writer is not needed any more, the checksum covers the plain length
+    atomic_store_explicit(&entry->length, length, memory_order_relaxed);
+    entry->timestamp = message->timestamp;
+    entry->userLength = message->userLength;
+    entry->imgLength = message->imgLength;
+    entry->messageLength = message->messageLength;
+    char* data = at + sizeof(storeEntry);
+    if (message->userLength > 0) {
+        memcpy(data, message->user, message->userLength);
+    }
+    if (message->imgLength > 0) {
+        memcpy(data + message->userLength, message->img, message->imgLength);
+    }
+    if (message->messageLength > 0) {
+        memcpy(data + message->userLength + message->imgLength, message->message, message->messageLength);
+    }
+    entry->checksum = entryChecksum(entry);
+    // release publishes the fields to the readers which acquire the state
+    atomic_store_explicit(&entry->state, ENTRY_COMMITTED, memory_order_release);
+}
+
+/**
+ * @brief reads the fields of a committed record
+ * @param at const char*: start of the record
+ * @param message storeMessage*: receives the fields, they point into the record
+ */
+static void readEntry(const char* at, storeMessage* message) {
+    const storeEntry* entry = (const storeEntry*) at;
+    message->timestamp = (long) entry->timestamp;
+    message->user = at + sizeof(storeEntry);
+    message->userLength = (size_t) entry->userLength;
+    message->img = message->user + message->userLength;
+    message->imgLength = (size_t) entry->imgLength;
+    message->message = message->img + message->imgLength;
+    message->messageLength = (size_t) entry->messageLength;
+}
+
+/**
+ * @brief checks the length fields of a record against the bound of the scan
+ * @param entry const storeEntry*: the record
+ * @param offset uint64_t: its offset
+ * @param bound uint64_t: end of the scanned range
+ * @return int: 1 if the record lies within the range and its fields within the record, 0 if not
+ */
+static int entryFits(const storeEntry* entry, uint64_t offset, uint64_t bound) {
+    uint64_t length = entrySize(entry);
+    if ((length < sizeof(storeEntry)) || (length % STORE_ALIGNMENT != 0) || (length > bound - offset)) {
+        return 0;
+    }
+    uint64_t data = length - sizeof(storeEntry);
+    return (entry->userLength <= data) && (entry->imgLength <= data - entry->userLength) &&
+           (entry->messageLength <= data - entry->userLength - entry->imgLength);
+}
+
+/**
+ * @brief returns the length of a record without the pid of its writer
+ * @param entry const storeEntry*: the record
+ * @return uint64_t: length of the record, 0 if it is not reserved
+ */
+static uint64_t entrySize(const storeEntry* entry) {
+    return atomic_load_explicit(&entry->length, memory_order_relaxed) & STORE_LENGTHMASK;
+}
+
+/**
+ * @brief searches the next committed record with a valid checksum, used to skip a range without a valid length
+ * @param base const char*: the mapped store
+ * @param from uint64_t: first offset searched, aligned to STORE_ALIGNMENT
+ * @param bound uint64_t: end of the searched range
+ * @return uint64_t: offset of the record, 0 if there is none
+ */
+static uint64_t findEntry(const char* base, uint64_t from, uint64_t bound) {
+    for (uint64_t offset = from; offset + sizeof(storeEntry) <= bound; offset += STORE_ALIGNMENT) {
+        const storeEntry* entry = (const storeEntry*) (base + offset);
+        if ((atomic_load(&entry->state) == ENTRY_COMMITTED) && entryFits(entry, offset, bound) &&
+            (entryChecksum(entry) == entry->checksum)) {
+            return offset;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief checks if a range contains only zeros
+ * @param data const char*: start of the range, aligned to STORE_ALIGNMENT
+ * @param length uint64_t: length of the range, a multiple of STORE_ALIGNMENT
+ * @return int: 1 if all bytes are zero, 0 if not
+ */
+static int isZero(const char* data, uint64_t length) {
+    const uint64_t* words = (const uint64_t*) data;
+    for (uint64_t i = 0; i < length / sizeof(uint64_t); i++) {
+        if (words[i] != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief checks if the writer of a record which is not committed yet is still running
+ * @param entry const storeEntry*: the record, ENTRY_WRITING
+ * @return int: 1 if it runs or can not be checked, 0 if it has terminated
+ */
+static int writerAlive(const storeEntry* entry) {
+    pid_t writer = (pid_t) (atomic_load(&entry->length) >> STORE_WRITERSHIFT);
+    if (writer == 0) {
+        return 1;   // the writer is committing it, the state is read again by the next scan
+    }
+    return ((kill(writer, 0) == 0) || (errno != ESRCH)) ? 1 : 0;
+}
+
+/**
+ * @brief computes the checksum of a record, the state and the checksum itself are not included
+ * @param entry const storeEntry*: the record, its length fields fit
+ * @return uint32_t: CRC-32
+ */
+static uint32_t entryChecksum(const storeEntry* entry) {
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, (const Bytef*) &entry->length, sizeof(storeEntry) - offsetof(storeEntry, length));
+    crc = crc32(crc, (const Bytef*) (entry + 1),
+                (uInt) (entry->userLength + entry->imgLength + entry->messageLength));
+    return (uint32_t) crc;
+}
+
+/**
+ * @brief computes the length of the record of a message
+ * @param message const storeMessage*: the message
+ * @return uint64_t: length with the header, aligned to STORE_ALIGNMENT
+ */
+static uint64_t entryLength(const storeMessage* message) {
+    uint64_t length = sizeof(storeEntry) + message->userLength + message->imgLength + message->messageLength;
+    return (length + STORE_ALIGNMENT - 1) / STORE_ALIGNMENT * STORE_ALIGNMENT;
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
@@ -0,0 +1,33 @@
+/**
+ * @file server_store.h
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 22.12.18
+ *
+ * @brief Append-only, memory-mapped message store of the bulletin board
+ * TCP/IP Lecture Distributed Systems
+ */
+#ifndef SERVER_STORE_H
+#define SERVER_STORE_H
+
+#include <stddef.h>         // provides size_t
+
+// -------------------------------------------------------------- typedefs --
+/** @brief One message of the bulletin board, the fields point into the mapped store and are not terminated */
+typedef struct storeMessage {
+    long timestamp;             /**< Time of the post, seconds since the epoch */
+    const char* user;           /**< Name of the posting user */
+    size_t userLength;          /**< Length of user */
+    const char* img;            /**< URL of the user image */
+    size_t imgLength;           /**< Length of img, 0 if none was given */
+    const char* message;        /**< The message */
+    size_t messageLength;       /**< Length of message */
+} storeMessage;
+
+// ------------------------------------------------------------- functions --
+int store_attach(const char* path);
+int store_append(const storeMessage* message);
+int store_count(size_t* count);
+int store_message(size_t index, storeMessage* message);
+
+#endif // SERVER_STORE_H
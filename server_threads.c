@@ -0,0 +1,175 @@
+/**
+ * @file server_threads.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 08.12.18
+ *
+ * @brief Multi-threaded server with one SO_REUSEPORT listening socket per thread and address.
+ * Every thread owns a listening socket bound to every address and runs its own accept loop, the kernel
+ * spreads the incoming connections over the sockets. A unix socket can not be bound twice, the threads share it.
+ * A thread with more than one socket waits for them in poll(). Every thread is pinned to its own core, so accepting
+ * and serving a connection stays on one core and the accept rate scales with the number of cores.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#define _GNU_SOURCE         // provides accept4(), pthread_setaffinity_np()
+#include <stdlib.h>         // provides calloc()
+#include <stdio.h>          // provides the printf()
+#include <string.h>         // provide strerror()
+#include <errno.h>          // provides errno
+#include <pthread.h>        // provides pthread_create()
+#include <sched.h>          // provides cpu_set_t
+#include <time.h>           // provides nanosleep()
+#include <unistd.h>         // provides sysconf(), close()
+#include <sys/types.h>
+#include <poll.h>           // provides poll()
+#include <fcntl.h>          // provides fcntl(), O_NONBLOCK
+#include <sys/socket.h>     // provides accept4()
+#include "server_threads.h"
+#include "server_metrics.h" // provides metrics_add(), metrics_observe()
+#include "trace.h"          // provides TRACE()
+
+// --------------------------------------------------------------- defines --
+/** @brief Line output. prints filename, functionname and linenumber from caller */
+#define LINEOUTPUT fprintf(stdout, "[%s, %s, %d]: ",  __FILE__, __func__, __LINE__)
+/** @brief nanoseconds to wait before the next accept() if the process ran out of file descriptors */
+#define ACCEPT_PAUSE 10000000
+
+// -------------------------------------------------------------- typedefs --
+/** @brief One listener thread */
+typedef struct listenerThread {
+    pthread_t thread;               /**< The created thread, unset for the first one, the calling thread */
+    int index;                      /**< Number of the thread, selects the core */
+    listenSet sockets;              /**< Own listening sockets, the unix sockets are shared */
+    const threadsConfig* config;    /**< Configuration of all threads */
+} listenerThread;
+
+// ------------------------------------------------------------- functions --
+static void* acceptLoop(void* argument);
+
+/**
+ * @brief runs the listener threads, the calling thread becomes the first of them. The first thread uses the
+ * given listening sockets, which must have SO_REUSEPORT set, the others open their own sockets on the same
+ * addresses. Does not return unless the threads could not be started.
+ * @param listeners const listenSet*: bound and listening sockets of the first thread
+ * @param config const threadsConfig*: configuration, threads > 0
+ * @return int: -1 if the threads could not be set up (errno is set)
+ */
+int threads_run(const listenSet* listeners, const threadsConfig* config) {
+    listenerThread* threads = calloc((size_t) config->threads, sizeof(listenerThread));
+    if (threads == NULL) {
+        return -1;
+    }
+    threads[0].sockets = *listeners;
+    for (int i = 1; i < config->threads; i++) {
+        if (listen_copySet(listeners, &threads[i].sockets, config->backlog) == -1) {
+            return -1;
+        }
+    }
+    for (int i = 0; i < config->threads; i++) {
+        threads[i].index = i;
+        threads[i].config = config;
+        // a thread waits in poll() for several sockets, a shared unix socket may be taken by another thread
+        for (int j = 0; (j < threads[i].sockets.count) && (threads[i].sockets.count > 1); j++) {
+            int flags = fcntl(threads[i].sockets.fds[j], F_GETFL);
+            if ((flags == -1) || (fcntl(threads[i].sockets.fds[j], F_SETFL, flags | O_NONBLOCK) == -1)) {
+                return -1;
+            }
+        }
+    }
+    for (int i = 1; i < config->threads; i++) {
+        int status = pthread_create(&threads[i].thread, NULL, acceptLoop, &threads[i]);
+        if (status != 0) {
+            errno = status;
+            return -1;
+        }
+    }
+    acceptLoop(&threads[0]);
+    return -1;
+}
+
+/**
+ * @brief accept loop of one listener thread, pins the thread to its core first
+ * @param argument void*: the listenerThread of this thread
+ * @return void*: NULL if the handler asked for termination
+ */
+static void* acceptLoop(void* argument) {
+    listenerThread* listener = argument;
+    const threadsConfig* config = listener->config;
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores > 0) {
+        cpu_set_t core;
+        CPU_ZERO(&core);
+        CPU_SET(listener->index % cores, &core);
+        // the handle in listener is written by pthread_create(), which may return after the thread started
+        int status = pthread_setaffinity_np(pthread_self(), sizeof(core), &core);
+        if ((status != 0) && (config->verbose == 1)) {
+            LINEOUTPUT;
+            fprintf(stdout, "Could not pin thread %d: %s\n", listener->index, strerror(status));
+        } else if (config->verbose == 1) {
+            LINEOUTPUT;
+            fprintf(stdout, "Thread %d accepts on core %ld\n", listener->index, listener->index % cores);
+        }
+    }
+
+    const listenSet* sockets = &listener->sockets;
+    int next = 0;
+    while (1) {
+        // a single socket is waited for in accept() itself
+        int fd_listen = sockets->fds[0];
+        if (sockets->count > 1) {
+            struct pollfd pollListen[LISTEN_MAXSOCKETS];
+            for (int i = 0; i < sockets->count; i++) {
+                pollListen[i].fd = sockets->fds[i];
+                pollListen[i].events = POLLIN;
+            }
+            if (poll(pollListen, (nfds_t) sockets->count, -1) == -1) {
+                continue;
+            }
+            for (int i = 0; i < sockets->count; i++) {
+                next = (next + 1) % sockets->count;
+                if (pollListen[next].revents != 0) {
+                    break;
+                }
+            }
+            fd_listen = sockets->fds[next];
+        }
+        // close on exec: a business logic executed by another thread must not inherit this connection
+        int fd_connected = accept4(fd_listen, NULL, NULL, SOCK_CLOEXEC);
+        if (fd_connected < 0) {
+            if ((errno == EINTR) || (errno == ECONNABORTED) || (errno == EAGAIN)) {
+                continue;
+            }
+            fprintf(stderr, "Thread %d could not accept socket: %s\n", listener->index, strerror(errno));
+            if ((errno == EMFILE) || (errno == ENFILE) || (errno == ENOBUFS) || (errno == ENOMEM)) {
+                // temporary shortage, the connection stays in the backlog until handlers have finished
+                struct timespec pause = {0, ACCEPT_PAUSE};
+                nanosleep(&pause, NULL);
+                continue;
+            }
+            break;
+        }
+        uint64_t started = metrics_now();
+        metrics_add(METRICS_ACCEPTED, 1);
+        metrics_add(METRICS_ACTIVE, 1);
+        trace_connection();
+        TRACE(TRACE_ACCEPT, (uint64_t) fd_connected, (uint32_t) listener->index);
+        int status = config->serve(fd_listen, fd_connected, config->context);
+        metrics_add(METRICS_ACTIVE, -1);
+        metrics_observe(METRICS_HANDLER, metrics_now() - started);
+        if (status != 0) {
+            break;
+        }
+    }
+    return NULL;
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
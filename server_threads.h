@@ -0,0 +1,38 @@
+/**
+ * @file server_threads.h
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 08.12.18
+ *
+ * @brief Multi-threaded server with one SO_REUSEPORT listening socket per thread and address
+ * TCP/IP Lecture Distributed Systems
+ */
+#ifndef SERVER_THREADS_H
+#define SERVER_THREADS_H
+
+#include "server_listen.h"  // provides listenSet
+
+// -------------------------------------------------------------- typedefs --
+/**
+ * @brief Connection handler called in the accepting thread for every accepted connection.
+ * The handler owns fd_connected and must close it.
+ * @param fd_listen int: listening socket of the connection
+ * @param fd_connected int: accepted connection
+ * @param context void*: context pointer of the configuration
+ * @return int: 0 to continue accepting, -1 to terminate the thread
+ */
+typedef int (*threadsServe)(int fd_listen, int fd_connected, void* context);
+
+/** @brief Configuration of the listener threads */
+typedef struct threadsConfig {
+    int threads;                        /**< Number of listener threads, 0 disables the threaded mode */
+    int backlog;                        /**< Backlog of every listening socket */
+    threadsServe serve;                 /**< Connection handler */
+    void* context;                      /**< Passed through to serve */
+    int verbose;                        /**< Output in verbose mode 0 off, 1 on */
+} threadsConfig;
+
+// ------------------------------------------------------------- functions --
+int threads_run(const listenSet* listeners, const threadsConfig* config);
+
+#endif // SERVER_THREADS_H
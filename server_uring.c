@@ -0,0 +1,280 @@
+/**
+ * @file server_uring.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 10.12.18
+ *
+ * @brief io_uring based server core.
+ * One thread drives all connections through a single ring: a multishot accept per listening socket delivers
+ * every new connection,
+ * requests are received and responses sent with recv/send entries (pipelined requests of a persistent connection
+ * are answered together), sockets are closed by the ring as well.
+ * All entries prepared while a batch of completions is handled are submitted with one system call, which
+ * also waits for the next completions.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#include <stdlib.h>         // provides calloc(), free()
+#include <stdio.h>          // provides the printf()
+#include <string.h>         // provide strerror()
+#include <errno.h>          // provides errno
+#include <stdint.h>         // provides uintptr_t
+#include <sys/types.h>
+#include <sys/socket.h>     // provides MSG_NOSIGNAL, SOCK_CLOEXEC
+#include "server_uring.h"
+#include "uring.h"          // provides uring_init()
+#include "server_metrics.h" // provides metrics_add(), metrics_observe()
+#include "trace.h"          // provides TRACE()
+
+// --------------------------------------------------------------- defines --
+/** @brief minimal free space in the request buffer before a receive */
+#define URING_READCHUNK 2048
+/** @brief user data tags, stored in the low bits of the connection pointer */
+#define TAG_ACCEPT 0u
+#define TAG_RECV 1u
+#define TAG_SEND 2u
+#define TAG_CLOSE 3u
+#define TAG_MASK 3u
+/** @brief flag of an accept armed without multishot */
+#define ACCEPT_SINGLE 4u
+/** @brief an accept carries the index of its listening socket instead of a connection pointer */
+#define ACCEPT_LISTENERSHIFT 3
+
+// -------------------------------------------------------------- typedefs --
+/** @brief A connection driven by the ring */
+typedef struct uringConnection {
+    int fd;                     /**< Connected socket */
+    logicSession session;       /**< Requests received and responses to send */
+    uint64_t started;           /**< Time of the accept for the metrics */
+    uint32_t trace;             /**< Connection number of the trace */
+} uringConnection;
+
+/** @brief State of the server loop */
+typedef struct uringServer {
+    uring ring;                         /**< The ring of the server */
+    const listenSet* listeners;         /**< Listening sockets */
+    int multishot;                      /**< 1 while multishot accept is supported by the kernel */
+    const uringServerConfig* config;    /**< Configuration of the server */
+} uringServer;
+
+// ------------------------------------------------------------- functions --
+static struct io_uring_sqe* nextSqe(uringServer* server, int opcode, int fd, const void* addr, unsigned length,
+                                    uint64_t userData);
+static void armAccept(uringServer* server, int listener);
+static void armRecv(uringServer* server, uringConnection* connection);
+static void armSend(uringServer* server, uringConnection* connection);
+static void closeConnection(uringServer* server, uringConnection* connection);
+static void continueConnection(uringServer* server, uringConnection* connection);
+static void handleCompletion(uringServer* server, struct io_uring_cqe* cqe);
+
+/**
+ * @brief runs the io_uring server on the given listening sockets in the calling thread.
+ * Does not return unless the ring could not be set up.
+ * @param listeners const listenSet*: bound and listening sockets
+ * @param config const uringServerConfig*: configuration, logic set
+ * @return int: -1 if io_uring is not available (errno is set)
+ */
+int uringserver_run(const listenSet* listeners, const uringServerConfig* config) {
+    uringServer server;
+    server.listeners = listeners;
+    server.multishot = 1;
+    server.config = config;
+    if (uring_init(&server.ring, config->entries) == -1) {
+        return -1;
+    }
+    for (int i = 0; i < listeners->count; i++) {
+        armAccept(&server, i);
+    }
+    while (1) {
+        // submits everything prepared in the last round and waits for at least one completion
+        if ((uring_submit(&server.ring, 1) == -1) && (errno != EBUSY)) {
+            fprintf(stderr, "Could not submit to the ring: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        struct io_uring_cqe* cqe;
+        while ((cqe = uring_peekCqe(&server.ring)) != NULL) {
+            struct io_uring_cqe completion = *cqe;
+            uring_cqeSeen(&server.ring);
+            handleCompletion(&server, &completion);
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief dispatches one completion to the connection it belongs to
+ * @param server uringServer*: the server
+ * @param cqe struct io_uring_cqe*: copy of the completion
+ */
+static void handleCompletion(uringServer* server, struct io_uring_cqe* cqe) {
+    unsigned tag = (unsigned) (cqe->user_data & TAG_MASK);
+    // an accept carries the listening socket instead of a connection, a close carries nothing
+    uringConnection* connection = NULL;
+    if (tag != TAG_ACCEPT) {
+        connection = (uringConnection*) (uintptr_t) (cqe->user_data & ~(uint64_t) TAG_MASK);
+    }
+    if (connection != NULL) {
+        trace_setConnection(connection->trace);
+    }
+
+    switch (tag) {
+        case TAG_ACCEPT:
+            if (!(cqe->flags & IORING_CQE_F_MORE)) {
+                // multishot ended or is not supported by this kernel, continue with single accepts
+                if (cqe->res == -EINVAL) {
+                    if (cqe->user_data & ACCEPT_SINGLE) {
+                        fprintf(stderr, "Could not accept socket: %s\n", strerror(-cqe->res));
+                        exit(EXIT_FAILURE);
+                    }
+                    server->multishot = 0;
+                }
+                armAccept(server, (int) (cqe->user_data >> ACCEPT_LISTENERSHIFT));
+            }
+            if (cqe->res < 0) {
+                if ((cqe->res != -EINVAL) && (cqe->res != -ECONNABORTED) && (cqe->res != -EINTR)) {
+                    fprintf(stderr, "Could not accept socket: %s\n", strerror(-cqe->res));
+                }
+                return;
+            }
+            connection = calloc(1, sizeof(uringConnection));
+            if (connection == NULL) {
+                nextSqe(server, IORING_OP_CLOSE, cqe->res, NULL, 0, TAG_CLOSE);
+                return;
+            }
+            connection->fd = cqe->res;
+            connection->started = metrics_now();
+            metrics_add(METRICS_ACCEPTED, 1);
+            metrics_add(METRICS_ACTIVE, 1);
+            connection->trace = trace_connection();
+            TRACE(TRACE_ACCEPT, (uint64_t) connection->fd, 0);
+            armRecv(server, connection);
+            return;
+        case TAG_RECV:
+            if (cqe->res < 0) {
+                closeConnection(server, connection);
+                return;
+            }
+            connection->session.request.length += (size_t) cqe->res;
+            connection->session.eof = (cqe->res == 0);
+            if (logic_sessionReceived(server->config->logic, &connection->session) == -1) {
+                closeConnection(server, connection);
+                return;
+            }
+            continueConnection(server, connection);
+            return;
+        case TAG_SEND:
+            if (cqe->res < 0) {
+                closeConnection(server, connection);
+                return;
+            }
+            connection->session.send.sent += (size_t) cqe->res;
+            if (connection->session.send.sent < connection->session.response.length) {
+                armSend(server, connection);
+                return;
+            }
+            logic_sessionSent(&connection->session);
+            continueConnection(server, connection);
+            return;
+        default:
+            return;     // TAG_CLOSE, nothing left to do
+    }
+}
+
+/**
+ * @brief arms the next operation of a connection: sends the pending responses, receives further requests or
+ * closes the connection once everything is answered
+ * @param connection uringConnection*: the connection, no operation of it may be in flight
+ */
+static void continueConnection(uringServer* server, uringConnection* connection) {
+    if (logic_sessionPending(&connection->session)) {
+        // the ring has no sendfile(), contents the logic references in files are sent from memory
+        if (logic_inlineFiles(&connection->session.response) == -1) {
+            closeConnection(server, connection);
+            return;
+        }
+        armSend(server, connection);
+    } else if (logic_sessionFinished(&connection->session)) {
+        closeConnection(server, connection);
+    } else {
+        armRecv(server, connection);
+    }
+}
+
+/**
+ * @brief prepares the next entry, submits the prepared ones first if the submission queue is full
+ * @return struct io_uring_sqe*: the entry
+ */
+static struct io_uring_sqe* nextSqe(uringServer* server, int opcode, int fd, const void* addr, unsigned length,
+                                    uint64_t userData) {
+    struct io_uring_sqe* sqe;
+    while ((sqe = uring_getSqe(&server->ring, opcode, fd, addr, length, 0, userData)) == NULL) {
+        uring_submit(&server->ring, 0);
+    }
+    return sqe;
+}
+
+/**
+ * @brief arms the accept of a listening socket, multishot if the kernel supports it
+ * @param server uringServer*: the server
+ * @param listener int: index of the listening socket
+ */
+static void armAccept(uringServer* server, int listener) {
+    uint64_t userData = ((uint64_t) listener << ACCEPT_LISTENERSHIFT) | (server->multishot ? 0 : ACCEPT_SINGLE) |
+                        TAG_ACCEPT;
+    struct io_uring_sqe* sqe = nextSqe(server, IORING_OP_ACCEPT, server->listeners->fds[listener], NULL, 0,
+                                       userData);
+    sqe->accept_flags = SOCK_CLOEXEC;
+    if (server->multishot) {
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    }
+}
+
+/**
+ * @brief receives the next part of the request into the free space of the request buffer
+ * @param connection uringConnection*: the connection
+ */
+static void armRecv(uringServer* server, uringConnection* connection) {
+    logicBuffer* request = &connection->session.request;
+    if (logic_reserve(request, URING_READCHUNK) == -1) {
+        closeConnection(server, connection);
+        return;
+    }
+    nextSqe(server, IORING_OP_RECV, connection->fd, request->data + request->length,
+            (unsigned) (request->capacity - request->length),
+            (uint64_t) (uintptr_t) connection | TAG_RECV);
+}
+
+/**
+ * @brief sends the unsent rest of the response
+ * @param connection uringConnection*: the connection
+ */
+static void armSend(uringServer* server, uringConnection* connection) {
+    struct io_uring_sqe* sqe = nextSqe(server, IORING_OP_SEND, connection->fd,
+                                       connection->session.response.data + connection->session.send.sent,
+                                       (unsigned) (connection->session.response.length -
+                                                   connection->session.send.sent),
+                                       (uint64_t) (uintptr_t) connection | TAG_SEND);
+    sqe->msg_flags = MSG_NOSIGNAL;
+}
+
+/**
+ * @brief closes the socket through the ring and frees the connection
+ * @param connection uringConnection*: the connection, no operation of it may be in flight
+ */
+static void closeConnection(uringServer* server, uringConnection* connection) {
+    metrics_add(METRICS_ACTIVE, -1);
+    metrics_observe(METRICS_HANDLER, metrics_now() - connection->started);
+    TRACE(TRACE_CLOSE, (uint64_t) connection->fd, 0);
+    nextSqe(server, IORING_OP_CLOSE, connection->fd, NULL, 0, TAG_CLOSE);
+    logic_freeSession(&connection->session);
+    free(connection);
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
@@ -0,0 +1,27 @@
+/**
+ * @file server_uring.h
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 10.12.18
+ *
+ * @brief io_uring based server core
+ * TCP/IP Lecture Distributed Systems
+ */
+#ifndef SERVER_URING_H
+#define SERVER_URING_H
+
+#include "server_logic.h"   // provides logicHandler
+#include "server_listen.h"  // provides listenSet
+
+// -------------------------------------------------------------- typedefs --
+/** @brief Configuration of the io_uring server */
+typedef struct uringServerConfig {
+    unsigned entries;           /**< Size of the submission queue */
+    const logicHandler* logic;  /**< In-process business logic, required */
+    int verbose;                /**< Output in verbose mode 0 off, 1 on */
+} uringServerConfig;
+
+// ------------------------------------------------------------- functions --
+int uringserver_run(const listenSet* listeners, const uringServerConfig* config);
+
+#endif // SERVER_URING_H
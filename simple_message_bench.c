@@ -0,0 +1,486 @@
+/**
+ * @file simple_message_bench.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 14.12.18
+ *
+ * @brief Load generator and latency benchmark for simple_message_server.
+ * Every thread posts messages over its own connections with the same protocol as simple_message_client: connect,
+ * send the request, shut down the write direction and receive the response until the server closes. Closed loop
+ * (default) starts the next request of a thread when the last one is answered, open loop (--rate) starts the
+ * requests at fixed times and measures the latencies from these times, so a stalled server is not hidden by the
+ * requests which were not sent meanwhile. The latencies of the connect, first byte and complete response phases
+ * are recorded in log-linear histograms (64 sub-buckets per power of two, below 1.6% error) and reported as
+ * percentiles.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#define _GNU_SOURCE         // provides getopt_long()
+#include <stdlib.h>         // provides malloc(), free(), strtol()
+#include <stdio.h>          // provides the printf()
+#include <string.h>         // provide strerror(), memset()
+#include <errno.h>          // provides errno
+#include <stdint.h>         // provides uint64_t
+#include <getopt.h>         // provides getopt_long()
+#include <pthread.h>        // provides pthread_create()
+#include <time.h>           // provides clock_gettime(), clock_nanosleep()
+#include <unistd.h>         // provides close()
+#include <netdb.h>          // provides getaddrinfo()
+#include <sys/types.h>
+#include <sys/socket.h>     // provides socket(), connect(), shutdown()
+
+// --------------------------------------------------------------- defines --
+/** @brief sub-buckets per power of two of a histogram */
+#define HISTOGRAM_SUBBUCKETS 64
+/** @brief half of the sub-buckets, the lower half is only used by the first power of two */
+#define HISTOGRAM_HALF (HISTOGRAM_SUBBUCKETS / 2)
+/** @brief powers of two of a histogram, covers every 64 bit nanosecond value */
+#define HISTOGRAM_MAGNITUDES 59
+/** @brief size of the receive buffer of a connection */
+#define BENCH_RECEIVEBUFFER (64 * 1024)
+/** @brief default number of threads */
+#define BENCH_DEFAULTCONCURRENCY 4
+/** @brief default number of requests */
+#define BENCH_DEFAULTREQUESTS 1000
+/** @brief default message size in bytes */
+#define BENCH_DEFAULTMESSAGESIZE 64
+/** @brief image URL sent with --image */
+#define BENCH_IMAGEURL "http://localhost/simple_message_bench.png"
+/** @brief nanoseconds per second */
+#define NSEC_PER_SEC 1000000000LL
+
+// -------------------------------------------------------------- typedefs --
+/** @brief Phases of a request with a latency histogram each */
+enum benchPhase {
+    PHASE_CONNECT,              /**< From the start until the connection is established */
+    PHASE_FIRSTBYTE,            /**< From the start until the first byte of the response */
+    PHASE_RESPONSE,             /**< From the start until the server closed the connection */
+    PHASE_COUNT                 /**< Number of phases */
+};
+
+/** @brief Log-linear latency histogram in nanoseconds */
+typedef struct benchHistogram {
+    uint64_t counts[HISTOGRAM_MAGNITUDES][HISTOGRAM_SUBBUCKETS];   /**< Values per bucket */
+    uint64_t count;                                                 /**< Number of values */
+    uint64_t max;                                                   /**< Largest value */
+} benchHistogram;
+
+/** @brief Configuration of the benchmark */
+typedef struct benchConfig {
+    const char* server;         /**< Hostname or address of the server */
+    const char* port;           /**< Port of the server */
+    struct addrinfo* address;   /**< Resolved address of the server */
+    int concurrency;            /**< Number of threads, each with one connection at a time */
+    long requests;              /**< Number of requests of all threads, unless duration is set */
+    double duration;            /**< Seconds to run, 0 to run requests */
+    double rate;                /**< Requests per second of all threads for open loop, 0 for closed loop */
+    char* request;              /**< The request sent every time */
+    size_t requestLength;       /**< Length of request */
+} benchConfig;
+
+/** @brief One load generating thread */
+typedef struct benchThread {
+    pthread_t thread;                           /**< The thread */
+    int index;                                  /**< Number of the thread */
+    const benchConfig* config;                  /**< Configuration of the benchmark */
+    long requests;                              /**< Requests of this thread, unless a duration is set */
+    benchHistogram histograms[PHASE_COUNT];     /**< Latencies of the phases */
+    long completed;                             /**< Requests answered with status 0 */
+    long errors;                                /**< Requests which failed or got another status */
+    uint64_t received;                          /**< Bytes received */
+} benchThread;
+
+// ------------------------------------------------------------- functions --
+static void usage(FILE* stream, const char* cmnd, int exitcode);
+static void* benchLoop(void* argument);
+static int benchRequest(benchThread* thread, int64_t start, char* buffer);
+static int64_t now(void);
+static void sleepUntil(int64_t time);
+static void histogramRecord(benchHistogram* histogram, uint64_t value);
+static void histogramMerge(benchHistogram* destination, const benchHistogram* source);
+static uint64_t histogramPercentile(const benchHistogram* histogram, double percentile);
+
+/**
+ * @brief main routine of the benchmark, parses the options, runs the threads and prints the report
+ * @param argc int: number of program arguments
+ * @param argv char**: pointerarray with the given arguments
+ * @return int: 0 if all requests succeeded, 1 if not
+ */
+int main(int argc, char* argv[]) {
+    benchConfig config;
+    memset(&config, 0, sizeof(config));
+    config.concurrency = BENCH_DEFAULTCONCURRENCY;
+    config.requests = BENCH_DEFAULTREQUESTS;
+    long messageSize = BENCH_DEFAULTMESSAGESIZE;
+    int image = 0;
+    char* endpointer = NULL;
+    int opt;
+    static const struct option longOptions[] = {
+            {"server",       required_argument, NULL, 's'},
+            {"port",         required_argument, NULL, 'p'},
+            {"concurrency",  required_argument, NULL, 'c'},
+            {"requests",     required_argument, NULL, 'n'},
+            {"duration",     required_argument, NULL, 'd'},
+            {"rate",         required_argument, NULL, 'r'},
+            {"message-size", required_argument, NULL, 'm'},
+            {"image",        no_argument,       NULL, 'i'},
+            {"help",         no_argument,       NULL, 'h'},
+            {NULL, 0,                           NULL, 0}
+    };
+    while ((opt = getopt_long(argc, argv, "s:p:c:n:d:r:m:ih", longOptions, NULL)) != -1) {
+        switch (opt) {
+            case 's':
+                config.server = optarg;
+                break;
+            case 'p':
+                config.port = optarg;
+                break;
+            case 'c':
+                config.concurrency = (int) strtol(optarg, &endpointer, 10);
+                if ((*endpointer != 0) || (config.concurrency < 1) || (config.concurrency > 4096)) {
+                    usage(stderr, argv[0], 1);
+                }
+                break;
+            case 'n':
+                config.requests = strtol(optarg, &endpointer, 10);
+                if ((*endpointer != 0) || (config.requests < 1)) {
+                    usage(stderr, argv[0], 1);
+                }
+                break;
+            case 'd':
+                config.duration = strtod(optarg, &endpointer);
+                if ((*endpointer != 0) || (config.duration <= 0)) {
+                    usage(stderr, argv[0], 1);
+                }
+                break;
+            case 'r':
+                config.rate = strtod(optarg, &endpointer);
+                if ((*endpointer != 0) || (config.rate < 0)) {
+                    usage(stderr, argv[0], 1);
+                }
+                break;
+            case 'm':
+                messageSize = strtol(optarg, &endpointer, 10);
+                if ((*endpointer != 0) || (messageSize < 1) || (messageSize > 1024 * 1024)) {
+                    usage(stderr, argv[0], 1);
+                }
+                break;
+            case 'i':
+                image = 1;
+                break;
+            case 'h':
+                usage(stdout, argv[0], 0);
+                break;
+            default:
+                usage(stderr, argv[0], 1);
+                break;
+        }
+    }
+    if ((config.server == NULL) || (config.port == NULL) || (optind != argc)) {
+        usage(stderr, argv[0], 1);
+    }
+
+    // the request is built once, every thread sends the same bytes
+    const char* header = image ? "user=bench\nimg=" BENCH_IMAGEURL "\n" : "user=bench\n";
+    config.requestLength = strlen(header) + (size_t) messageSize;
+    config.request = malloc(config.requestLength);
+    if (config.request == NULL) {
+        fprintf(stderr, "%s: Could not allocate memory: %s\n", argv[0], strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    memcpy(config.request, header, strlen(header));
+    memset(config.request + strlen(header), 'x', (size_t) messageSize);
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int addrinfoError = getaddrinfo(config.server, config.port, &hints, &config.address);
+    if (addrinfoError != 0) {
+        fprintf(stderr, "%s: Could not resolve hostname: %s\n", argv[0], gai_strerror(addrinfoError));
+        exit(EXIT_FAILURE);
+    }
+
+    benchThread* threads = calloc((size_t) config.concurrency, sizeof(benchThread));
+    if (threads == NULL) {
+        fprintf(stderr, "%s: Could not allocate memory: %s\n", argv[0], strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    int64_t start = now();
+    for (int i = 0; i < config.concurrency; i++) {
+        threads[i].index = i;
+        threads[i].config = &config;
+        threads[i].requests = config.requests / config.concurrency + (i < config.requests % config.concurrency);
+        if ((errno = pthread_create(&threads[i].thread, NULL, benchLoop, &threads[i])) != 0) {
+            fprintf(stderr, "%s: Could not start thread: %s\n", argv[0], strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    benchHistogram* total = calloc(PHASE_COUNT, sizeof(benchHistogram));
+    if (total == NULL) {
+        fprintf(stderr, "%s: Could not allocate memory: %s\n", argv[0], strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    long completed = 0;
+    long errors = 0;
+    uint64_t received = 0;
+    for (int i = 0; i < config.concurrency; i++) {
+        pthread_join(threads[i].thread, NULL);
+        for (int phase = 0; phase < PHASE_COUNT; phase++) {
+            histogramMerge(&total[phase], &threads[i].histograms[phase]);
+        }
+        completed += threads[i].completed;
+        errors += threads[i].errors;
+        received += threads[i].received;
+    }
+    double elapsed = (double) (now() - start) / NSEC_PER_SEC;
+
+    fprintf(stdout, "server: %s:%s, concurrency: %d, %s, message: %ld bytes%s\n", config.server, config.port,
+            config.concurrency, (config.rate > 0) ? "open loop" : "closed loop", messageSize,
+            image ? " + image" : "");
+    if (config.rate > 0) {
+        fprintf(stdout, "target rate: %.1f requests/s\n", config.rate);
+    }
+    fprintf(stdout, "requests: %ld, errors: %ld, elapsed: %.3f s\n", completed + errors, errors, elapsed);
+    fprintf(stdout, "throughput: %.1f requests/s, %.2f MiB/s received\n", (double) completed / elapsed,
+            (double) received / elapsed / (1024.0 * 1024.0));
+    const char* names[PHASE_COUNT] = {"connect", "first-byte", "response"};
+    fprintf(stdout, "%-12s %10s %10s %10s %10s %10s   (ms)\n", "phase", "p50", "p90", "p99", "p999", "max");
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        fprintf(stdout, "%-12s %10.3f %10.3f %10.3f %10.3f %10.3f\n", names[phase],
+                (double) histogramPercentile(&total[phase], 50.0) / 1e6,
+                (double) histogramPercentile(&total[phase], 90.0) / 1e6,
+                (double) histogramPercentile(&total[phase], 99.0) / 1e6,
+                (double) histogramPercentile(&total[phase], 99.9) / 1e6, (double) total[phase].max / 1e6);
+    }
+
+    free(total);
+    free(threads);
+    free(config.request);
+    freeaddrinfo(config.address);
+    return (errors == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief prints the usage of the benchmark and terminates the program
+ * @param stream FILE*: stream the usage is printed to
+ * @param cmnd const char*: name of the program
+ * @param exitcode int: exit code of the program
+ */
+static void usage(FILE* stream, const char* cmnd, int exitcode) {
+    fprintf(stream, "usage: %s options\n", cmnd);
+    fprintf(stream, "options:\n");
+    fprintf(stream, "\t-s, --server <server>\tfull qualified domain name or IP address of the server\n");
+    fprintf(stream, "\t-p, --port <port>\tport of the server\n");
+    fprintf(stream, "\t-c, --concurrency <n>\tthreads, each with one request at a time [default: %d]\n",
+            BENCH_DEFAULTCONCURRENCY);
+    fprintf(stream, "\t-n, --requests <n>\trequests of all threads [default: %d]\n", BENCH_DEFAULTREQUESTS);
+    fprintf(stream, "\t-d, --duration <s>\trun for s seconds instead of a number of requests\n");
+    fprintf(stream, "\t-r, --rate <n>\t\topen loop with n requests per second of all threads [default: closed loop]\n");
+    fprintf(stream, "\t-m, --message-size <n>\tbytes of the message [default: %d]\n", BENCH_DEFAULTMESSAGESIZE);
+    fprintf(stream, "\t-i, --image\t\tsend an image URL with every message\n");
+    fprintf(stream, "\t-h, --help\n");
+    exit(exitcode);
+}
+
+/**
+ * @brief load loop of one thread: sends its requests, in open loop at fixed times
+ * @param argument void*: the benchThread
+ * @return void*: NULL
+ */
+static void* benchLoop(void* argument) {
+    benchThread* thread = argument;
+    const benchConfig* config = thread->config;
+    char* buffer = malloc(BENCH_RECEIVEBUFFER);
+    if (buffer == NULL) {
+        thread->errors = thread->requests;
+        return NULL;
+    }
+    int64_t begin = now();
+    int64_t end = begin + (int64_t) (config->duration * NSEC_PER_SEC);
+    // open loop: the threads start shifted, so the requests of all threads are evenly spaced
+    int64_t interval = (config->rate > 0) ? (int64_t) (config->concurrency * NSEC_PER_SEC / config->rate) : 0;
+    int64_t scheduled = begin + interval * thread->index / config->concurrency;
+    for (long i = 0; (config->duration > 0) || (i < thread->requests); i++) {
+        int64_t start;
+        if (interval > 0) {
+            sleepUntil(scheduled);
+            start = scheduled;      // the latency includes the time the request waited for its turn
+            scheduled += interval;
+        } else {
+            start = now();
+        }
+        if ((config->duration > 0) && (start >= end)) {
+            break;
+        }
+        if (benchRequest(thread, start, buffer) == 0) {
+            thread->completed++;
+        } else {
+            thread->errors++;
+        }
+    }
+    free(buffer);
+    return NULL;
+}
+
+/**
+ * @brief sends one request on a new connection and receives the response until the server closes
+ * @param thread benchThread*: the thread, histograms and received are updated
+ * @param start int64_t: time the request is due, the latencies are measured from it
+ * @param buffer char*: receive buffer of BENCH_RECEIVEBUFFER bytes
+ * @return int: 0 if the response had status 0, -1 otherwise
+ */
+static int benchRequest(benchThread* thread, int64_t start, char* buffer) {
+    const benchConfig* config = thread->config;
+    struct addrinfo* address = config->address;
+    int fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+    if (fd == -1) {
+        return -1;
+    }
+    if (connect(fd, address->ai_addr, address->ai_addrlen) == -1) {
+        close(fd);
+        return -1;
+    }
+    histogramRecord(&thread->histograms[PHASE_CONNECT], (uint64_t) (now() - start));
+
+    size_t sent = 0;
+    while (sent < config->requestLength) {
+        ssize_t written = send(fd, config->request + sent, config->requestLength - sent, MSG_NOSIGNAL);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            close(fd);
+            return -1;
+        }
+        sent += (size_t) written;
+    }
+    if (shutdown(fd, SHUT_WR) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    // the status line is the beginning of the response, "status=0\n" means success
+    char status[sizeof("status=0\n")];
+    size_t statusLength = 0;
+    uint64_t total = 0;
+    while (1) {
+        ssize_t received = recv(fd, buffer, BENCH_RECEIVEBUFFER, 0);
+        if (received == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            close(fd);
+            return -1;
+        }
+        if (received == 0) {
+            break;
+        }
+        if (total == 0) {
+            histogramRecord(&thread->histograms[PHASE_FIRSTBYTE], (uint64_t) (now() - start));
+        }
+        while ((statusLength < sizeof(status)) && (statusLength < total + (uint64_t) received)) {
+            status[statusLength] = buffer[statusLength - total];
+            statusLength++;
+        }
+        total += (uint64_t) received;
+    }
+    histogramRecord(&thread->histograms[PHASE_RESPONSE], (uint64_t) (now() - start));
+    close(fd);
+    thread->received += total;
+    if ((statusLength < sizeof(status) - 1) || (memcmp(status, "status=0\n", sizeof(status) - 1) != 0)) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief current time
+ * @return int64_t: nanoseconds of CLOCK_MONOTONIC
+ */
+static int64_t now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (int64_t) time.tv_sec * NSEC_PER_SEC + time.tv_nsec;
+}
+
+/**
+ * @brief sleeps until the given time, returns at once if it is over
+ * @param time int64_t: nanoseconds of CLOCK_MONOTONIC
+ */
+static void sleepUntil(int64_t time) {
+    struct timespec until;
+    until.tv_sec = (time_t) (time / NSEC_PER_SEC);
+    until.tv_nsec = (long) (time % NSEC_PER_SEC);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR) {
+    }
+}
+
+/**
+ * @brief records a value: values below HISTOGRAM_SUBBUCKETS are exact, larger ones are kept with the 6 most
+ * significant bits
+ * @param histogram benchHistogram*: the histogram
+ * @param value uint64_t: latency in nanoseconds
+ */
+static void histogramRecord(benchHistogram* histogram, uint64_t value) {
+    int magnitude = 0;
+    if (value >= HISTOGRAM_SUBBUCKETS) {
+        magnitude = 63 - __builtin_clzll(value) - 5;    // value >> magnitude is in [32, 63]
+    }
+    histogram->counts[magnitude][value >> magnitude]++;
+    histogram->count++;
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+}
+
+/**
+ * @brief adds all values of source to destination
+ * @param destination benchHistogram*: the histogram added to
+ * @param source const benchHistogram*: the histogram added
+ */
+static void histogramMerge(benchHistogram* destination, const benchHistogram* source) {
+    for (int magnitude = 0; magnitude < HISTOGRAM_MAGNITUDES; magnitude++) {
+        for (int bucket = 0; bucket < HISTOGRAM_SUBBUCKETS; bucket++) {
+            destination->counts[magnitude][bucket] += source->counts[magnitude][bucket];
+        }
+    }
+    destination->count += source->count;
+    if (source->max > destination->max) {
+        destination->max = source->max;
+    }
+}
+
+/**
+ * @brief value at the given percentile, the largest value of its bucket
+ * @param histogram const benchHistogram*: the histogram
+ * @param percentile double: percentile [0..100]
+ * @return uint64_t: the value in nanoseconds, 0 for an empty histogram
+ */
+static uint64_t histogramPercentile(const benchHistogram* histogram, double percentile) {
+    uint64_t wanted = (uint64_t) ((double) histogram->count * percentile / 100.0 + 0.5);
+    if (wanted == 0) {
+        wanted = 1;
+    }
+    uint64_t seen = 0;
+    for (int magnitude = 0; magnitude < HISTOGRAM_MAGNITUDES; magnitude++) {
+        for (int bucket = (magnitude == 0) ? 0 : HISTOGRAM_HALF; bucket < HISTOGRAM_SUBBUCKETS; bucket++) {
+            seen += histogram->counts[magnitude][bucket];
+            if (seen >= wanted) {
+                uint64_t highest = (((uint64_t) bucket + 1) << magnitude) - 1;
+                return (highest < histogram->max) ? highest : histogram->max;
+            }
+        }
+    }
+    return histogram->max;
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
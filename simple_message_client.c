@@ -8,6 +8,7 @@
  */
 
 // -------------------------------------------------------------- includes --
+#define _GNU_SOURCE         // provides splice(), pipe2(), F_SETPIPE_SZ
 #include <stdlib.h>         // provides exit(), EXIT_FAILURE
 #include <stdio.h>          // provides the printf()
 #include <string.h>         // provide strerror(), strlen()
@@ -17,20 +18,57 @@
 #include <arpa/inet.h>      // provides inet_address
 #include <unistd.h>         // provides read(), write(), close()
 #include <netdb.h>          // provides getaddrinfo()
-#include <simple_message_client_commandline_handling.h> // provides smc_parsecommandline()
-#include <math.h>           // provides floor()
+#include <getopt.h>         // provides getopt_long()
+#include <fcntl.h>          // provides open(), splice()
 #include <stdbool.h>        // provides true, false
 #include <limits.h>         // provide max file length
+#include "uring.h"          // provides uring_init(), uring_submit()
+#include "client_batch.h"   // provides batch_run()
+#include "client_parser.h"  // provides parser_next()
+#include "client_connect.h" // provides connect_server()
+#include "client_fanout.h"  // provides fanout_run()
+#include "client_writer.h"  // provides writer_start(), writer_append()
+#include "client_decoder.h" // provides decoder_start(), decoder_feed()
+#include "trace.h"          // provides trace_open(), TRACE()
 
 // --------------------------------------------------------------- defines --
-/** @brief length of the field status max 10 */
-#define STATUSLENGTH 10
-/** @brief length of the field filename max 256 bytes */
-#define MAXFILENAMELENGTH _POSIX_PATH_MAX
-/** @brief length of the field file length max 10 bytes i.e 10^10 Bytes far enough */
-#define MAXFILELENGTH 20
-/** @brief chunck size of the reading buffer  */
-#define CHUNK 256
+/** @brief size of the receive buffer, also used to copy the files if splice() is not possible */
+#define RECEIVEBUFFER (128 * 1024)
+/** @brief requested size of the pipe between socket and file, the default pipe size works as well */
+#define SPLICE_PIPESIZE (1024 * 1024)
+/** @brief buffer size of one receive of the uring engine */
+#define URING_CHUNK (64 * 1024)
+/** @brief receive/write pairs in one submitted chain of the uring engine */
+#define URING_PAIRS 16
+/** @brief name of the option selecting the receive engine, not handled by parseCommandline() */
+#define ENGINE_OPTION "--engine"
+/** @brief name of the option sending the request length framed, not handled by parseCommandline() */
+#define PERSISTENT_OPTION "--persistent"
+/** @brief name of the option offering deflate encoded files, implies --persistent */
+#define COMPRESS_OPTION "--compress"
+/** @brief encoding offered in the length line of the request */
+#define COMPRESS_ENCODING "deflate"
+/** @brief name of the option selecting the batch mode with the file of the messages */
+#define BATCH_OPTION "--batch"
+/** @brief name of the option setting the number of connections of the batch mode */
+#define CONNECTIONS_OPTION "--connections"
+/** @brief name of the option posting to every server of the comma separated -s argument */
+#define FANOUT_OPTION "--fanout"
+/** @brief name of the option posting to every resolved address of the servers */
+#define ALLADDRESSES_OPTION "--all-addresses"
+/** @brief options limiting the length of a file and of the whole response, 0 is no limit */
+#define MAXFILE_OPTION "--max-file"
+#define MAXRESPONSE_OPTION "--max-response"
+/** @brief default limits, a file of the message board is far smaller */
+#define DEFAULT_MAXFILE (1ull << 30)
+#define DEFAULT_MAXRESPONSE (4ull << 30)
+/** @brief files of at least this length are allocated on the disk before they are received */
+#define PREALLOCATE_MINIMUM RECEIVEBUFFER
+/** @brief options of the writer threads: number of threads and how the files reach the disk */
+#define WRITERS_OPTION "--writers"
+#define WRITEPOLICY_OPTION "--write-policy"
+/** @brief name of the option writing the binary trace to <prefix>.<pid> */
+#define TRACE_OPTION "--trace"
 /** @brief LINEOUTPUT prints filename, functionname and linenumber from caller */
 #define LINEOUTPUT fprintf(stdout, "[%s, %s, %d]: ",  __FILE__, __func__, __LINE__)
 /** @brief FIELD_DELIMITER defines the delimiter between the fields defined in the protocol */
@@ -39,32 +77,74 @@
 #define FIELD_ASSIGNMENT '='
 
 // -------------------------------------------------------------- typedefs --
+/** @brief receive engines for the file contents */
+enum receiveEngine {
+    ENGINE_SPLICE,              /**< splice() from the socket through a pipe into the file */
+    ENGINE_PORTABLE,            /**< read()/write() through the receive buffer */
+    ENGINE_URING                /**< linked receive and write operations on an io_uring */
+};
+
+/** @brief receiveBuffer holds the received chunk the parser works on, the file contents can bypass it */
+typedef struct receiveBuffer {
+    char* data;                 /**< RECEIVEBUFFER bytes */
+    size_t start;               /**< First byte not consumed yet */
+    size_t end;                 /**< End of the received bytes */
+    bool eof;                   /**< The server closed the connection */
+} receiveBuffer;
+
 /** @brief ressourcesContainer stores all needed ressources in one single place */
 typedef struct ressourcesContainer {
-    FILE* filepointerClientRead;             /**< File Pointer for Read operation */
+    receiveBuffer receive;                   /**< Buffer for Read operation */
     FILE* filepointerClientWrite;            /**< File Pointer for Write operation */
-    FILE* filepointerClientWriteDisk;        /**< File Pointer for Hard Disk operation */
+    int fileDescriptorWriteDisk;             /**< File Descriptor for Hard Disk operation */
     int socketDescriptorRead;                /**< Socket for Read operation */
     int socketDescriptorWrite;               /**< Socket for Write operation */
     const char* progname;                    /**< Program Name argv[0] */
     int verbose;                             /**< Output in verbose mode 0 off, 1 on */
+    enum receiveEngine engine;               /**< Engine receiving the file contents */
+    int pipe[2];                             /**< Pipe of the splice engine, -1 until it is used */
+    uring* ring;                             /**< Ring of the uring engine, NULL for the other engines */
+    int persistent;                          /**< Request sent length framed 0 off, 1 on */
+    int compress;                            /**< Deflate encoded files offered 0 off, 1 on */
+    contentDecoder* decoder;                 /**< Decoder of the encoded files, NULL until the first one */
+    batchConfig batch;                       /**< Batch mode, input is NULL for a single message */
+    fanoutConfig fanout;                     /**< Fan-out mode, enabled is 0 for a single server */
+    parserLimits limits;                     /**< Limits of the response */
+    int writerThreads;                       /**< Writer threads, 0 writes the files in the receive loop */
+    enum writerPolicy writePolicy;           /**< How the writer threads write the files */
+    writerPool* writer;                      /**< Writer threads, NULL if the receive loop writes the files */
 } ressourcesContainer;
 
 // --------------------------------------------------------------- globals --
 /** @brief progname char*: stores the program name for correct error codes */
 const char* progname;
-/** @brief filenamePrefix const char*: the filename prefix used by this protocol */
-const char* filenameKey = "file=\0";
-/** @brief lengthPrefix const char*: file length prefix used by this protcol */
-const char* lengthKey = "len=\0";
+/** @brief requestKey const char*: prefix of the length line in front of a framed request */
+const char* requestKey = "request=";
 
 // ------------------------------------------------------------- functions --
 static void errorMessage(const char* userMessage, const char* errorMessage, ressourcesContainer* ressources);
 static void usage(FILE* stream, const char* cmnd, int exitcode);
+static void parseCommandline(int argc, const char* argv[], ressourcesContainer* ressources, const char** server,
+                             const char** port, const char** user, const char** message, const char** imgUrl);
 static int printAddress(struct sockaddr* sockaddr);
 static bool writeToDisk(long length, ressourcesContainer* ressources);
+static bool spliceToDisk(long* remaining, ressourcesContainer* ressources);
+static bool writeToDiskUring(long length, ressourcesContainer* ressources);
+static bool receiveToWriter(long length, ressourcesContainer* ressources);
+static bool fillReceiveBuffer(ressourcesContainer* ressources);
+static void closeDiskFile(ressourcesContainer* ressources);
+static int writeAll(int fd, const char* data, size_t length);
+static int writeDecoded(void* context, const char* data, size_t length);
+static void preallocate(uint64_t length, ressourcesContainer* ressources);
+static int extractOptions(int* argc, const char* argv[], ressourcesContainer* ressources);
+static int optionValue(int argc, const char* argv[], int* i, const char* name, const char** value);
+static int parseSize(const char* value, uint64_t* size);
+static void runBatch(int argc, const char* argv[], ressourcesContainer* ressources);
+static void runFanout(ressourcesContainer* ressources);
+static void connectServer(const char* serverIP, const char* serverPort, ressourcesContainer* ressources);
+static void sendRequest(const char* user, const char* imgUrl, const char* messageOut,
+                        ressourcesContainer* ressources);
 static long parseIntfromString(const char* buffer);
-static int parseField(char* fieldBuffer, char** filename);
 static void closeAllRessources(ressourcesContainer* ressources);
 
 /**
@@ -76,13 +156,7 @@ static void closeAllRessources(ressourcesContainer* ressources);
 
 // --------------------------------------------------------------- main --
 int main(int argc, const char* argv[]) {
-    struct addrinfo* serveraddr, * currentServerAddr;    // Returnvalue of getaddrinfo(), currentAddr used for loop
-    struct addrinfo hints;								 // Hints struct for the addr info function
-    char statusBuffer[STATUSLENGTH];					 // Buffer for the Status
-    int statusValue;                                 // integer holds status
-    char filenameBuffer[MAXFILENAMELENGTH];				 // Buffer for File name max 255 Chars
-    char lengthBuffer[MAXFILELENGTH];                // Max size of length
-    long fileLengthValue;
+    int statusValue = -1;                            // integer holds status
 
     //--------------------------------------------------
     //----------allocate the ressources struct----------
@@ -96,13 +170,32 @@ int main(int argc, const char* argv[]) {
     //--------------------------------------------
     //----------set al values to default----------
     //--------------------------------------------
-    ressources->filepointerClientRead = NULL;
+    memset(&ressources->receive, 0, sizeof(ressources->receive));
     ressources->filepointerClientWrite = NULL;
-    ressources->filepointerClientWriteDisk = NULL;
+    ressources->fileDescriptorWriteDisk = -1;
     ressources->socketDescriptorRead = -1;
     ressources->socketDescriptorWrite = -1;
     ressources->progname = argv[0];
     ressources->verbose = 0;
+    ressources->engine = ENGINE_SPLICE;
+    ressources->pipe[0] = -1;
+    ressources->pipe[1] = -1;
+    ressources->ring = NULL;
+    ressources->persistent = 0;
+    ressources->compress = 0;
+    ressources->decoder = NULL;
+    memset(&ressources->batch, 0, sizeof(ressources->batch));
+    ressources->batch.connections = BATCH_DEFAULTCONNECTIONS;
+    memset(&ressources->fanout, 0, sizeof(ressources->fanout));
+    ressources->limits.file = DEFAULT_MAXFILE;
+    ressources->limits.response = DEFAULT_MAXRESPONSE;
+    ressources->writerThreads = 0;
+    ressources->writePolicy = WRITER_BUFFERED;
+    ressources->writer = NULL;
+    ressources->receive.data = malloc(RECEIVEBUFFER);
+    if (ressources->receive.data == NULL) {
+        errorMessage("Could not allocate memory for the receive buffer", strerror(errno), ressources);
+    }
 
     //---------------------------------------------------------
     //----------declare variables for the line parser----------
@@ -113,8 +206,14 @@ int main(int argc, const char* argv[]) {
     const char* messageOut = NULL;
     const char* imgUrl = NULL;
 
-    // call the argument parser
-    smc_parsecommandline(argc, argv, usage, &serverIP, &serverPort, &user, &messageOut, &imgUrl, &ressources->verbose);
+    // call the argument parser, engine and persistent options are removed before, parseCommandline() does not know them
+    if (extractOptions(&argc, argv, ressources) == -1) {
+        usage(stderr, argv[0], 1);
+    }
+    if (ressources->batch.input != NULL) {
+        runBatch(argc, argv, ressources);   // does not return
+    }
+    parseCommandline(argc, argv, ressources, &serverIP, &serverPort, &user, &messageOut, &imgUrl);
     int serverPortInt = parseIntfromString(serverPort);
 
     if ((serverPortInt < 0) || (serverPortInt > 65535)) {
@@ -129,68 +228,205 @@ int main(int argc, const char* argv[]) {
     // set the progname to the global
     progname = argv[0];
 
-    // Get the type of connection Hint struct!
-    memset(&hints, 0, sizeof(hints));   // set to NULL
-    hints.ai_family = AF_UNSPEC;            // Allows IP4 and IP6
-    hints.ai_socktype = SOCK_STREAM;        // TCP
-    hints.ai_protocol = 0;
-    hints.ai_flags = 0;
-    //----------------------------------------------------
-    //----------initialise members of serveraddr----------
-    //----------------------------------------------------
-    int addrinfoError = 0;
-    //getaddrinfo returns 0 if succeeded, works on serveraddr & hints with known serverPort&IP
-    if ((addrinfoError = getaddrinfo(serverIP, serverPort, &hints, &serveraddr) !=
-            0)) {
-        errorMessage("Could not resolve hostname.", gai_strerror(addrinfoError), ressources);
-    }
-    // use the struct coming from getaddrinfo
+    if (ressources->fanout.enabled == 1) {
+        ressources->fanout.servers = serverIP;
+        ressources->fanout.port = serverPort;
+        ressources->fanout.user = user;
+        ressources->fanout.message = messageOut;
+        ressources->fanout.image = imgUrl;
+        ressources->fanout.limits = ressources->limits;
+        runFanout(ressources);  // does not return
+    }
+    if (ressources->writerThreads > 0) {
+        ressources->writer = malloc(sizeof(writerPool));
+        if ((ressources->writer == NULL) ||
+            (writer_start(ressources->writer, ressources->writerThreads, ressources->writePolicy) == -1)) {
+            free(ressources->writer);
+            ressources->writer = NULL;
+            errorMessage("Could not start the writer threads", strerror(errno), ressources);
+        }
+    }
+
+    connectServer(serverIP, serverPort, ressources);
+    sendRequest(user, imgUrl, messageOut, ressources);
+
+    //---------------------------------------------------------------------------------------------------
+    //------------------ parse the response as it is received -------------------------------------------
+    //---------------------------------------------------------------------------------------------------
+    responseParser parser;
+    parser_init(&parser);
+    parser_limit(&parser, &ressources->limits);
+    receiveBuffer* receive = &ressources->receive;
+    bool complete = false;
+    while (!complete) {
+        const char* data = receive->data + receive->start;
+        size_t available = receive->end - receive->start;
+        parserView view;
+        enum parserEvent event = parser_next(&parser, &data, &available, &view);
+        receive->start = (size_t) (data - receive->data);
+        switch (event) {
+            case PARSER_MORE:
+                if (fillReceiveBuffer(ressources) == false) {
+                    // the server closed the connection, a legacy response ends here
+                    if (parser_complete(&parser) == 0) {
+                        errorMessage("The response is incomplete", "", ressources);
+                    }
+                    complete = true;
+                }
+                break;
+            case PARSER_FRAME:
+                TRACE(TRACE_RESPONSE, parser.frameLength, 0);
+                break;
+            case PARSER_STATUS:
+                if ((ressources->persistent == 1) && (parser.framed == 0)) {
+                    // the server answered without length, it does not know the framing: the request is sent again
+                    if (ressources->verbose == 1) {
+                        LINEOUTPUT;
+                        fprintf(stdout, "Server does not support persistent connections, sending the request again\n");
+                    }
+                    close(ressources->socketDescriptorRead);
+                    ressources->socketDescriptorRead = -1;
+                    receive->start = receive->end = 0;
+                    receive->eof = false;
+                    ressources->persistent = 0;
+                    connectServer(serverIP, serverPort, ressources);
+                    sendRequest(user, imgUrl, messageOut, ressources);
+                    parser_init(&parser);
+                    parser_limit(&parser, &ressources->limits);
+                    break;
+                }
+                statusValue = parser.status;
+                TRACE(TRACE_STATUS, (uint64_t) statusValue, 0);
+                break;
+            case PARSER_FILE: {
+                TRACE(TRACE_FILE, parser.remaining, parser.encoding);
+                // the decoded length of an encoded file is not known, remaining counts the compressed bytes
+                uint64_t announced = (parser.encoding == PARSER_IDENTITY) ? parser.remaining : 0;
+                // the parser accepts plain names only, the file is created in the working directory
+                if (ressources->writer != NULL) {
+                    if (writer_open(ressources->writer, view.data, announced) == -1) {
+                        errorMessage("Error in writing to disk", strerror(errno), ressources);
+                    }
+                } else {
+                    ressources->fileDescriptorWriteDisk = open(view.data, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                                                               0666);
+                    if (ressources->fileDescriptorWriteDisk == -1) {
+                        errorMessage("Could not open the file", strerror(errno), ressources);
+                    }
+                    preallocate(announced, ressources);
+                }
+                if (parser.encoding == PARSER_DEFLATE) {
+                    if (ressources->decoder == NULL) {
+                        ressources->decoder = malloc(sizeof(contentDecoder));
+                    }
+                    if ((ressources->decoder == NULL) ||
+                        (decoder_start(ressources->decoder, ressources->limits.file, writeDecoded, ressources) == -1)) {
+                        errorMessage("Could not decode the file", "out of memory", ressources);
+                    }
+                }
+                if (parser.remaining == 0) {
+                    closeDiskFile(ressources);
+                }
+                break;
+            }
+            case PARSER_CONTENT:
+                if (parser.encoding == PARSER_DEFLATE) {
+                    if (decoder_feed(ressources->decoder, view.data, view.length) == -1) {
+                        errorMessage("Could not decode the file", ressources->decoder->error, ressources);
+                    }
+                } else if (((ressources->writer != NULL) ? writer_append(ressources->writer, view.data, view.length)
+                                                         : writeAll(ressources->fileDescriptorWriteDisk, view.data,
+                                                                    view.length)) == -1) {
+                    errorMessage("Error in writing to disk", strerror(errno), ressources);
+                }
+                if (parser.remaining == 0) {
+                    closeDiskFile(ressources);
+                }
+                break;
+            case PARSER_END:
+                complete = true;    // a framed response ends with its length, not with the connection
+                break;
+            case PARSER_ERROR:
+                errorMessage("Invalid response:", parser.error, ressources);
+                break;
+        }
+        // the rest of a file which is not received yet is moved to the disk by the engine, bypassing the parser,
+        // an encoded file is received through the parser and the decoder
+        if ((parser.state == PARSER_STATE_CONTENT) && (parser.encoding == PARSER_IDENTITY) &&
+            (receive->start == receive->end)) {
+            long rest = (long) parser.remaining;
+            bool isEOF;
+            if (ressources->writer != NULL) {
+                isEOF = receiveToWriter(rest, ressources);
+            } else if (ressources->engine == ENGINE_URING) {
+                isEOF = writeToDiskUring(rest, ressources);
+            } else {
+                isEOF = writeToDisk(rest, ressources);
+            }
+            if (isEOF) {
+                errorMessage("The response is incomplete", "", ressources);
+            }
+            parser_skip(&parser, (uint64_t) rest);
+        }
+    }
+
+    //---------------------------------------------------------------------------------------------------
+    //------------------ close the socket to read (socketDescriptorRead) --------------------------------
+    //---------------------------------------------------------------------------------------------------
+
+    /* Close the read connection from the client, over and out ... */
+    if (close(ressources->socketDescriptorRead) != 0) {
+        ressources->socketDescriptorRead = -1;
+        errorMessage("Could not close the read socket", strerror(errno), ressources);
+    }
+    ressources->socketDescriptorRead = -1;
+    if (ressources->verbose == 1) {
+        LINEOUTPUT;
+        fprintf(stdout, "Closing Socket Client Read \n");
+    }
+    // the response is received, the writers finish the files
+    if (ressources->writer != NULL) {
+        int written = writer_stop(ressources->writer);
+        free(ressources->writer);
+        ressources->writer = NULL;
+        if (written == -1) {
+            errorMessage("Error in writing to disk", strerror(errno), ressources);
+        }
+    }
+
+    // Everything went well, deallocate the ressources struct
+    closeAllRessources(ressources);
+    free(ressources);
+    return statusValue;
+}
 
+/**
+* @brief connectServer races the addresses of the server (client_connect.c) and opens the write stream on the
+* socket, the duplicate socketDescriptorRead is used for reading. Exits on failure.
+* @param serverIP const char*: hostname or address of the server
+* @param serverPort const char*: port of the server
+* @param ressources ressourcesContainer*: socketDescriptorWrite, socketDescriptorRead and filepointerClientWrite are set
+*/
+static void connectServer(const char* serverIP, const char* serverPort, ressourcesContainer* ressources) {
     //--------------------------------------------------------------------------
     //----------connect client to serverSocket (socketDescriptorWrite)----------
     //--------------------------------------------------------------------------
-    // looping though the linked list to find a working address
-    for (currentServerAddr = serveraddr;
-         currentServerAddr != NULL; currentServerAddr = currentServerAddr->ai_next) {
-        // Create a SOCKET(), return value is a file descriptor
-        //socket returns socket descriptor (int), negative value if failed
-        ressources->socketDescriptorWrite = socket(currentServerAddr->ai_family, currentServerAddr->ai_socktype,
-                                                   currentServerAddr->ai_protocol);
-        if (ressources->socketDescriptorWrite < 0) {
-            fprintf(stderr, "Could not create a socket:\n");
-            close(ressources->socketDescriptorWrite);
-            continue; // try next pointer
-        }
-        if (ressources->verbose == 1) {
-            LINEOUTPUT;
-            fprintf(stdout, "Client Socket created.\n");
-        }
-        // try to CONNECT() to the serverIP
-        //connect returns -1 if failed to connect
-        int success = connect(ressources->socketDescriptorWrite, currentServerAddr->ai_addr,
-                              currentServerAddr->ai_addrlen);
-        if (success == -1) {
-            fprintf(stderr, "Could not connect to a Server: %s\n", gai_strerror(success));
-            close(ressources->socketDescriptorWrite);  // connection failed, close socket.
-            continue;   // try next pointer
-        }
-        break; // connection established
-    }
-
-    // if the currentPointer is Null at this point, something was going wrong
-    if (currentServerAddr == NULL) {
-        freeaddrinfo(serveraddr);   // Free the allocated pointer before quitting
-        errorMessage("Connection failed.", strerror(errno), ressources);
-    }
-    freeaddrinfo(serveraddr);   // free the allocated pointer
-
+    // the addresses are raced, IPv6 and IPv4 alternating, a broken address costs CONNECT_ATTEMPTDELAY ms
+    struct sockaddr_storage peer;
+    const char* error = NULL;
+    ressources->socketDescriptorWrite = connect_server(serverIP, serverPort, &peer, &error);
+    if (ressources->socketDescriptorWrite == -1) {
+        errorMessage("Connection failed.", error, ressources);
+    }
+    trace_connection();
+    TRACE(TRACE_CONNECT, (uint64_t) ressources->socketDescriptorWrite, 0);
 
     /* inet_ntop: Convert Internet number in IN to ASCII representation.  The return value
    is a pointer to an internal array containing the string.*/
     if (ressources->verbose == 1) {
         LINEOUTPUT;
         fprintf(stdout, " ... Connection to Server established: ");
-        if ((printAddress(serveraddr->ai_addr)) == -1) {
+        if ((printAddress((struct sockaddr*) &peer)) == -1) {
             fprintf(stderr, "no address was found");
         }
     }
@@ -215,22 +451,43 @@ int main(int argc, const char* argv[]) {
         fprintf(stdout, "Creating a write socket\n");
     }
     //---------------------------------------------------------------------------------------------------
-    //----------open Filepointer to write/read (filepointerClientRead & filepointerClientWrite)----------
+    //----------open Filepointer to write (filepointerClientWrite) --------------------------------------
     //---------------------------------------------------------------------------------------------------
     // fdopen returns NULL if failed
-    // use the copy of the duplicated field descriptor for both file pointer
-    ressources->filepointerClientRead = fdopen(ressources->socketDescriptorRead, "r");
+    // reading is not done with a stream, the receive engines take the file contents from the socket itself
     ressources->filepointerClientWrite = fdopen(ressources->socketDescriptorWrite, "w");
 
-    if (ressources->filepointerClientRead == NULL || ressources->filepointerClientWrite == NULL) {
+    if (ressources->filepointerClientWrite == NULL) {
         // an error occured during cerate Filepointer, close the file descriptor
         errorMessage("Could not create a File Pointer", strerror(errno), ressources);
     }
     if (ressources->verbose == 1) {
         LINEOUTPUT;
-        fprintf(stdout, "Creating filepointer for reading and writing\n");
+        fprintf(stdout, "Creating filepointer for writing\n");
     }
+}
+
+/**
+* @brief sendRequest sends the request, framed with its length on a persistent connection, and shuts down the write
+* direction of the socket. Exits on failure.
+* @param user const char*: name of the posting user
+* @param imgUrl const char*: URL of the image, NULL if none
+* @param messageOut const char*: the message
+* @param ressources ressourcesContainer*: filepointerClientWrite is closed afterwards
+*/
+static void sendRequest(const char* user, const char* imgUrl, const char* messageOut,
+                        ressourcesContainer* ressources) {
     ssize_t sentBytes; //recbytes;
+    if (ressources->persistent == 1) {
+        // the length line in front of the request, its length is known before it is written
+        int requestLength = (imgUrl == NULL) ? snprintf(NULL, 0, "user=%s\n%s", user, messageOut)
+                                             : snprintf(NULL, 0, "user=%s\nimg=%s\n%s", user, imgUrl, messageOut);
+        // the encodings offered follow the length, a server without them sends the files as they are
+        if (fprintf(ressources->filepointerClientWrite, "%s%d%s\n", requestKey, requestLength,
+                    (ressources->compress == 1) ? " " COMPRESS_ENCODING : "") < 0) {
+            errorMessage("Could not write to the File Pointer", strerror(errno), ressources);
+        }
+    }
     if (imgUrl == NULL) {
         //fprintf returns bytes written to messageOut
         sentBytes = fprintf(ressources->filepointerClientWrite, "user=%s\n%s", user, messageOut);
@@ -246,6 +503,7 @@ int main(int argc, const char* argv[]) {
         LINEOUTPUT;
         fprintf(stdout, "Send %ld Bytes to the server\n", sentBytes);
     }
+    TRACE(TRACE_SEND, (uint64_t) sentBytes, 0);
     if (sentBytes == -1) {
         // an error occured during write, close the file descriptor
         errorMessage("Could not write to the File Pointer", strerror(errno), ressources);
@@ -261,7 +519,7 @@ int main(int argc, const char* argv[]) {
     }
 
     // Close the write connection from the client, nothing to say ...
-    if ((shutdown(fileno(ressources->filepointerClientRead), SHUT_WR) < 0)) {
+    if ((shutdown(ressources->socketDescriptorRead, SHUT_WR) < 0)) {
         errorMessage("Could not shutdown the WR socket of the reading socket: ", strerror(errno), ressources);
     }
     // Close the filepointer closes the underlying socket (socketDescriptorWrite)
@@ -274,264 +532,697 @@ int main(int argc, const char* argv[]) {
         LINEOUTPUT;
         fprintf(stdout, "Close Write Filepointer\n");
     }
-    // Get status
-    if (fgets(statusBuffer, STATUSLENGTH, ressources->filepointerClientRead) ==
-        NULL) {     // fgets uses read descriptor
-        errorMessage("Could not read from server: ", strerror(errno), ressources);
-    }
+}
+
+/**
+* @brief writeToDisk writes the received file of the given length to fileDescriptorWriteDisk and closes it.
+* The bytes which were received together with the header lines are written first. The splice engine moves the
+* rest from the socket through a pipe into the file without copying it to user space, if the socket or the file
+* does not support splice() the rest is copied through the receive buffer with read() and write().
+* @param length long: bytes of the received file still to be written onto the disk, the parser handed out the earlier part
+* @param ressources ressourcesContainer*: is a struct containing every information of the used socket, as well as the programname and the information if the output should be verbose
+* @return bool: true if the end of the response was reached
+*/
+static bool writeToDisk(long length, ressourcesContainer* ressources) {
+    receiveBuffer* receive = &ressources->receive;
+    long remaining = length;
+    bool isEOF = false;
+
     //---------------------------------------------------------------------------------------------------
-    //--------------------------- read status field only once -------------------------------------------
+    //------------------ bytes of the file already in the receive buffer --------------------------------
     //---------------------------------------------------------------------------------------------------
-    char* statusValueRaw;
-    int status = parseField(statusBuffer, &statusValueRaw);
-    if (status == -1) {
-        LINEOUTPUT;
-        errorMessage("Error occurred during parsing the status field", strerror(errno), ressources);
+    size_t buffered = receive->end - receive->start;
+    if (buffered > (size_t) remaining) {
+        buffered = (size_t) remaining;
     }
-    if (ressources->verbose == 1) {
-        LINEOUTPUT;
-        fprintf(stdout, "Status buffer: %s Status plain: %s\n", statusBuffer, statusValueRaw);
+    if (writeAll(ressources->fileDescriptorWriteDisk, receive->data + receive->start, buffered) == -1) {
+        errorMessage("Error in writing to disk", strerror(errno), ressources);
     }
-    statusValue = parseIntfromString(statusValueRaw);
-    if (statusValue == -1) {
-        LINEOUTPUT;
-        errorMessage("Error occurred during converting the file length", strerror(errno), ressources);
+    receive->start += buffered;
+    remaining -= (long) buffered;
+    TRACE(TRACE_WRITE, buffered, (uint32_t) remaining);
+
+    //---------------------------------------------------------------------------------------------------
+    //------------------ rest of the file directly from the socket --------------------------------------
+    //---------------------------------------------------------------------------------------------------
+    if ((remaining > 0) && (ressources->engine == ENGINE_SPLICE)) {
+        isEOF = spliceToDisk(&remaining, ressources);
     }
-    if (ressources->verbose == 1) {
-        LINEOUTPUT;
-        fprintf(stdout, "Status is: %d\n", statusValue);
+    if (remaining > 0) {
+        // the receive buffer is empty here, it is reused for the copy
+        receive->start = receive->end = 0;
+    }
+    while ((remaining > 0) && (isEOF == false)) {
+        size_t chunk = (remaining < RECEIVEBUFFER) ? (size_t) remaining : RECEIVEBUFFER;
+        ssize_t readBytes = read(ressources->socketDescriptorRead, receive->data, chunk);
+        if (readBytes == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            errorMessage("Error in reading from socket", strerror(errno), ressources);
+        }
+        if (readBytes == 0) {
+            isEOF = true;
+            receive->eof = true;
+            break;
+        }
+        if (writeAll(ressources->fileDescriptorWriteDisk, receive->data, (size_t) readBytes) == -1) {
+            errorMessage("Error in writing to disk", strerror(errno), ressources);
+        }
+        remaining -= readBytes;
     }
-    free(statusValueRaw);
 
     //---------------------------------------------------------------------------------------------------
-    //------------------ begin read field content loop (filenname + file length) ------------------------
+    //------------------ close file descriptor to disk write (fileDescriptorWriteDisk) ------------------
     //---------------------------------------------------------------------------------------------------
-    bool isEOF = false;
-    do {
-        int status = 0;
-        // get filenameValue from Server
-        if (fgets(filenameBuffer, MAXFILENAMELENGTH, ressources->filepointerClientRead) == NULL) {
-            if (feof(ressources->filepointerClientRead)) {
-                isEOF = true;
-                if (ressources->verbose == 1) {
-                    LINEOUTPUT;
-                    fprintf(stdout, "End of File reached: %d\n", isEOF);
-                }
-                break;
-            } else if (ferror(ressources->filepointerClientRead)) {
-                errorMessage("Could not read from server: ", strerror(errno), ressources);
+    int closed = close(ressources->fileDescriptorWriteDisk);
+    ressources->fileDescriptorWriteDisk = -1;
+    if (closed != 0) {
+        errorMessage("Error in writing to disk", strerror(errno), ressources);
+    }
+    TRACE(TRACE_WRITE, (uint64_t) (length - remaining), (uint32_t) remaining);
+    return isEOF;
+}
+
+/**
+* @brief spliceToDisk moves the rest of the file from the socket into the file through the pipe of the splice
+* engine. If splice() is not supported the engine is switched to ENGINE_PORTABLE and the caller copies the rest.
+* @param remaining long*: bytes of the file still to receive, decreased by the moved bytes
+* @param ressources ressourcesContainer*: sockets, pipe and the open file
+* @return bool: true if the server closed the connection before the file was complete
+*/
+static bool spliceToDisk(long* remaining, ressourcesContainer* ressources) {
+    if (ressources->pipe[0] == -1) {
+        if (pipe2(ressources->pipe, O_CLOEXEC) == -1) {
+            ressources->engine = ENGINE_PORTABLE;
+            return false;
+        }
+        // a larger pipe needs fewer system calls, the default size is used if the limit does not allow it
+        fcntl(ressources->pipe[1], F_SETPIPE_SZ, SPLICE_PIPESIZE);
+    }
+    while (*remaining > 0) {
+        size_t chunk = (*remaining < SPLICE_PIPESIZE) ? (size_t) *remaining : SPLICE_PIPESIZE;
+        ssize_t moved = splice(ressources->socketDescriptorRead, NULL, ressources->pipe[1], NULL, chunk,
+                               SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (moved == -1) {
+            if (errno == EINTR) {
+                continue;
             }
+            if ((errno == EINVAL) || (errno == ENOSYS)) {
+                ressources->engine = ENGINE_PORTABLE;   // the pipe is empty, nothing is lost
+                return false;
+            }
+            errorMessage("Error in reading from socket", strerror(errno), ressources);
+        }
+        if (moved == 0) {
+            ressources->receive.eof = true;
+            return true;
         }
-        // get filelength Value from server
-        if (fgets(lengthBuffer, MAXFILELENGTH, ressources->filepointerClientRead) == NULL) {
-            if (feof(ressources->filepointerClientRead)) {
-                isEOF = true;
-                if (ressources->verbose == 1) {
-                    LINEOUTPUT;
-                    fprintf(stdout, "End of File reached: %d\n", isEOF);
+        *remaining -= moved;
+        // the pipe is emptied into the file before the next receive
+        while (moved > 0) {
+            ssize_t written = splice(ressources->pipe[0], NULL, ressources->fileDescriptorWriteDisk, NULL,
+                                     (size_t) moved, SPLICE_F_MOVE);
+            if ((written == -1) && (errno == EINTR)) {
+                continue;
+            }
+            if ((written == -1) && (errno == EINVAL) && (ressources->engine == ENGINE_SPLICE)) {
+                // the file system does not support splice(), the pipe is drained through the receive buffer
+                ressources->engine = ENGINE_PORTABLE;
+                while (moved > 0) {
+                    size_t chunk = (moved < RECEIVEBUFFER) ? (size_t) moved : RECEIVEBUFFER;
+                    ssize_t drained = read(ressources->pipe[0], ressources->receive.data, chunk);
+                    if ((drained <= 0) ||
+                        (writeAll(ressources->fileDescriptorWriteDisk, ressources->receive.data,
+                                  (size_t) drained) == -1)) {
+                        errorMessage("Error in writing to disk", strerror(errno), ressources);
+                    }
+                    moved -= drained;
                 }
-                break;
-            } else if (ferror(ressources->filepointerClientRead)) {
-                errorMessage("Could not read from server: ", strerror(errno), ressources);
+                ressources->receive.start = ressources->receive.end = 0;
+                return false;
             }
+            if (written <= 0) {
+                errorMessage("Error in writing to disk", strerror(errno), ressources);
+            }
+            moved -= written;
         }
-        // check if the filenameValue has the correct prefix
-        if (strncmp(filenameBuffer, filenameKey, strlen(filenameKey)) != 0) {
-            fprintf(stderr, "filenameKey: %s\n", filenameBuffer);
-            errorMessage("No filenameKey given.", strerror(errno), ressources);
+    }
+    return false;
+}
+
+/**
+* @brief writeToDiskUring is the uring engine of writeToDisk. The file is received and written in chains of
+* linked receive and write operations, the kernel runs a chain in order, so every pair uses the same buffer and
+* a whole chain costs one system call. A receive waits for its complete chunk, a short receive (end of file or a
+* kernel without MSG_WAITALL support) cancels the rest of the chain and its bytes are written here.
+* @param length long: bytes of the file still to receive, the parser handed out the earlier part
+* @param ressources ressourcesContainer*: ring and the open file fileDescriptorWriteDisk, which is closed
+* @return bool: true if the end of the response was reached
+*/
+static bool writeToDiskUring(long length, ressourcesContainer* ressources) {
+    receiveBuffer* receive = &ressources->receive;
+    char* buffer = receive->data;
+    unsigned chunks[URING_PAIRS];
+    int results[2 * URING_PAIRS];
+    int fd_disk = ressources->fileDescriptorWriteDisk;
+    bool isEOF = false;
+
+    // bytes of the file which were received together with the header lines
+    size_t buffered = receive->end - receive->start;
+    if (buffered > (size_t) length) {
+        buffered = (size_t) length;
+    }
+    if (writeAll(fd_disk, receive->data + receive->start, buffered) == -1) {
+        errorMessage("Error in writing to disk", strerror(errno), ressources);
+    }
+    receive->start += buffered;
+    long received = (long) buffered;
+    // the chains write at offsets, base is the offset of the first byte of this call, earlier parts are written
+    off_t base = lseek(fd_disk, 0, SEEK_CUR) - received;
+    if (base < 0) {
+        errorMessage("Error in writing to disk", strerror(errno), ressources);
+    }
+    if (received < length) {
+        // the receive buffer is empty here, it is reused for the chains
+        receive->start = receive->end = 0;
+    }
+
+    while ((received < length) && (isEOF == false)) {
+        unsigned pairs = 0;
+        long queued = received;
+        struct io_uring_sqe* sqe = NULL;
+        while ((queued < length) && (pairs < URING_PAIRS)) {
+            chunks[pairs] = (length - queued < URING_CHUNK) ? (unsigned) (length - queued) : URING_CHUNK;
+            sqe = uring_getSqe(ressources->ring, IORING_OP_RECV, ressources->socketDescriptorRead, buffer,
+                               chunks[pairs], 0, 2 * pairs);
+            sqe->msg_flags = MSG_WAITALL;
+            sqe->flags = IOSQE_IO_LINK;
+            sqe = uring_getSqe(ressources->ring, IORING_OP_WRITE, fd_disk, buffer, chunks[pairs],
+                               (uint64_t) (base + queued), 2 * pairs + 1);
+            sqe->flags = IOSQE_IO_LINK;
+            queued += chunks[pairs];
+            pairs++;
         }
-        char* fileLengthValueRaw = NULL;
-        status = parseField(lengthBuffer, &fileLengthValueRaw);
-        if (ressources->verbose == 1) {
-            LINEOUTPUT;
-            fprintf(stdout, "filelength: %s", lengthBuffer);
+        sqe->flags = 0;     // end of the chain
+        if (uring_submit(ressources->ring, 2 * pairs) == -1) {
+            errorMessage("Could not submit to the ring", strerror(errno), ressources);
         }
-        if (status == -1) {
-            errorMessage("A error occurred during file length parsing\n", strerror(errno), ressources);
+        // every entry of the chain completes, cancelled ones with -ECANCELED
+        for (unsigned seen = 0; seen < 2 * pairs; seen++) {
+            struct io_uring_cqe* cqe;
+            while ((cqe = uring_peekCqe(ressources->ring)) == NULL) {
+                if (uring_submit(ressources->ring, 1) == -1) {
+                    errorMessage("Could not wait for the ring", strerror(errno), ressources);
+                }
+            }
+            results[cqe->user_data] = cqe->res;
+            uring_cqeSeen(ressources->ring);
         }
-        // parse the file length from the incoming buffer
-        fileLengthValue = parseIntfromString(fileLengthValueRaw);
-        if (fileLengthValue == -1) {
-            errorMessage("A error occurred during converting int\n", strerror(errno), ressources);
+        for (unsigned i = 0; i < pairs; i++) {
+            int receivedChunk = results[2 * i], writtenChunk = results[2 * i + 1];
+            if (receivedChunk < 0) {
+                errorMessage("Error in reading from socket", strerror(-receivedChunk), ressources);
+            }
+            if ((unsigned) receivedChunk == chunks[i]) {
+                if ((unsigned) writtenChunk != chunks[i]) {
+                    errorMessage("Error in writing to disk",
+                                 strerror(writtenChunk < 0 ? -writtenChunk : EIO), ressources);
+                }
+                received += receivedChunk;
+                continue;
+            }
+            // short receive, the write of this pair and the rest of the chain are cancelled
+            if (pwrite(fd_disk, buffer, (size_t) receivedChunk, base + received) != receivedChunk) {
+                errorMessage("Error in writing to disk", strerror(errno), ressources);
+            }
+            received += receivedChunk;
+            isEOF = (receivedChunk == 0);
+            receive->eof = isEOF;
+            break;
         }
-        if (ressources->verbose == 1) {
-            LINEOUTPUT;
-            fprintf(stdout, "File length buffer: %s,  length: %ld\n", lengthBuffer, fileLengthValue);
+        TRACE(TRACE_WRITE, (uint64_t) received, (uint32_t) (length - received));
+    }
+    int closed = close(fd_disk);
+    ressources->fileDescriptorWriteDisk = -1;
+    if (closed != 0) {
+        errorMessage("Error in writing to disk", strerror(errno), ressources);
+    }
+    return isEOF;
+}
+
+/**
+* @brief fillReceiveBuffer receives the next chunk of the response into the empty receive buffer
+* @param ressources ressourcesContainer*: receive buffer and socket, exits on a receive error
+* @return bool: true if bytes were received, false if the server closed the connection (receive.eof is set)
+*/
+static bool fillReceiveBuffer(ressourcesContainer* ressources) {
+    receiveBuffer* receive = &ressources->receive;
+    receive->start = receive->end = 0;
+    while (1) {
+        ssize_t readBytes = read(ressources->socketDescriptorRead, receive->data, RECEIVEBUFFER);
+        if (readBytes == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            errorMessage("Could not read from server: ", strerror(errno), ressources);
+        }
+        if (readBytes == 0) {
+            receive->eof = true;
+            return false;
         }
-        // extract the filenameKey from the field
-        char* filenameValue = NULL;
+        receive->end = (size_t) readBytes;
+        return true;
+    }
+}
 
-        // check if the file length has the correct prefix
-        if (strncmp(lengthBuffer, lengthKey, strlen(lengthKey)) != 0) {
-            errorMessage("No file length given.", strerror(errno), ressources);
+/**
+* @brief receiveToWriter receives the rest of the file directly into the buffers of the writer threads and
+* queues the closing of the file, the disk is not waited for
+* @param length long: bytes of the file still to receive, the receive buffer is empty
+* @param ressources ressourcesContainer*: socket and writer, exits on a receive or write error
+* @return bool: true if the end of the response was reached
+*/
+static bool receiveToWriter(long length, ressourcesContainer* ressources) {
+    long remaining = length;
+    while (remaining > 0) {
+        size_t room;
+        char* space = writer_space(ressources->writer, &room);
+        if (space == NULL) {
+            errorMessage("Error in writing to disk", strerror(errno), ressources);
+        }
+        if ((long) room > remaining) {
+            room = (size_t) remaining;
+        }
+        ssize_t readBytes = read(ressources->socketDescriptorRead, space, room);
+        if (readBytes == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            errorMessage("Error in reading from socket", strerror(errno), ressources);
         }
-        // parse the file length
-        status = parseField(filenameBuffer, &filenameValue);
-        if (status == -1) {
-            errorMessage("A error occurred during filenameKey parsing", strerror(errno), ressources);
+        if (readBytes == 0) {
+            ressources->receive.eof = true;
+            break;
         }
-        if (ressources->verbose == 1) {
-            LINEOUTPUT;
-            fprintf(stdout, "Filename: %s\n", filenameValue);
+        if (writer_commit(ressources->writer, (size_t) readBytes) == -1) {
+            errorMessage("Error in writing to disk", strerror(errno), ressources);
         }
-        // open filepointer for disk
-        ressources->filepointerClientWriteDisk = fopen(filenameValue, "w");
+        remaining -= readBytes;
+    }
+    closeDiskFile(ressources);
+    TRACE(TRACE_WRITE, (uint64_t) (length - remaining), (uint32_t) remaining);
+    return remaining > 0;
+}
 
-        // we don't need the pointer anymore free it
-        free(fileLengthValueRaw);
-        fileLengthValueRaw = NULL;
-        free(filenameValue);
-        filenameValue = NULL;
+/**
+* @brief closeDiskFile closes the completely written file (fileDescriptorWriteDisk), with writer threads the
+* closing is queued to the writer of the file. The decoding of an encoded file is finished before.
+* @param ressources ressourcesContainer*: the open file, exits if closing fails
+*/
+static void closeDiskFile(ressourcesContainer* ressources) {
+    if ((ressources->decoder != NULL) && ressources->decoder->active &&
+        (decoder_finish(ressources->decoder) == -1)) {
+        errorMessage("Could not decode the file", ressources->decoder->error, ressources);
+    }
+    if (ressources->writer != NULL) {
+        if (writer_close(ressources->writer) == -1) {
+            errorMessage("Error in writing to disk", strerror(errno), ressources);
+        }
+        return;
+    }
+    int closed = close(ressources->fileDescriptorWriteDisk);
+    ressources->fileDescriptorWriteDisk = -1;
+    if (closed != 0) {
+        errorMessage("Error in writing to disk", strerror(errno), ressources);
+    }
+}
 
-        /* Call the write function */
-        isEOF = writeToDisk(fileLengthValue, ressources);
-    } while (!isEOF);
+/**
+* @brief writeAll writes the complete data, short writes are continued
+* @param fd int: destination
+* @param data const char*: the data
+* @param length size_t: length of data
+* @return int: 0 on success, -1 on failure (errno is set)
+*/
+static int writeAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += written;
+        length -= (size_t) written;
+    }
+    return 0;
+}
 
-    //---------------------------------------------------------------------------------------------------
-    //------------------ close Filepointer to read (filepointerClientRead) ------------------------------
-    //---------------------------------------------------------------------------------------------------
+/**
+* @brief writeDecoded is the sink of the decoder, the decoded contents go to the file like received ones
+* @param context void*: the ressourcesContainer
+* @param data const char*: decoded bytes
+* @param length size_t: number of bytes
+* @return int: 0 on success, -1 on failure (errno is set)
+*/
+static int writeDecoded(void* context, const char* data, size_t length) {
+    ressourcesContainer* ressources = context;
+    if (ressources->writer != NULL) {
+        return writer_append(ressources->writer, data, length);
+    }
+    return writeAll(ressources->fileDescriptorWriteDisk, data, length);
+}
 
-    // close the read filestream and the underlying socket
-    if (fclose(ressources->filepointerClientRead) != 0) {
-        errorMessage("Could not close the read filestream to socket", strerror(errno), ressources);
+/**
+* @brief preallocate allocates the blocks of a large file before it is received, so it is written in place and
+* not fragmented by growing with every write. The size of the file grows with the written bytes, an incomplete file
+* keeps its real length. Exits if the disk is too small, file systems without fallocate() are ignored.
+* @param length uint64_t: length of the file announced by the server
+* @param ressources ressourcesContainer*: fileDescriptorWriteDisk is the opened file
+*/
+static void preallocate(uint64_t length, ressourcesContainer* ressources) {
+    if (length < PREALLOCATE_MINIMUM) {
+        return;
     }
-    /* Close the read connection from the client, over and out ... */
-    ressources->filepointerClientRead = NULL;
-    ressources->socketDescriptorRead = -1;
-    if (ressources->verbose == 1) {
-        LINEOUTPUT;
-        fprintf(stdout, "Closing Filestream Client Read \n");
+    if ((fallocate(ressources->fileDescriptorWriteDisk, FALLOC_FL_KEEP_SIZE, 0, (off_t) length) == -1) &&
+        ((errno == ENOSPC) || (errno == EFBIG))) {
+        errorMessage("Not enough space for the file", strerror(errno), ressources);
     }
-
-    // Everything went well, deallocate the ressources struct
-    free(ressources);
-    return statusValue;
 }
 
 /**
-* @brief writeToDisk writes received message (information) into known location on disk indicated through filepointerClientWriteDisk
-* @param length int: is the length of the received file which is wanted to be written onto the disk
-* @param ressources ressourcesContainer*: is a struct containing every information of the used socket, as well as the programname and the information if the output should be verbose
-* @return int: 0 if failed, 1 if succeeded
+* @brief extractOptions removes the engine option (--engine=<name> or --engine <name>), --persistent and the other
+* options unknown to parseCommandline() from the arguments and sets up the selected engine. The uring engine falls back to the splice engine if io_uring is not
+* available.
+* @param argc int*: number of arguments, decreased by the removed ones
+* @param argv const char*[]: the arguments, compacted
+* @param ressources ressourcesContainer*: engine is set, and ring for the uring engine, persistent is set
+* @return int: 0 on success, -1 if the engine is unknown
 */
-bool writeToDisk(long length, ressourcesContainer* ressources) {
-    static int loops;
-    // create partioned textbuffer for continuous reading
-    char* partioned_read_array = malloc(CHUNK * sizeof(char));
-    memset(partioned_read_array, 0, sizeof(*partioned_read_array));
-
-    // integer declaration for the read and write porcess
-    int readBytes = 0, writeBytes = 0, cycles = 0;
-    int actualRead = 0, actualWrite = 0;
-    // calculate how many partitions we need
-    cycles = floor((double) length / CHUNK);
-
-    // read the file chunk wise in and write those chunks to disk
-    bool isEOF = false;
-    if (ressources->verbose == 1) {
-        LINEOUTPUT;
-        fprintf(stdout, "Begin the read process.\n");
+static int extractOptions(int* argc, const char* argv[], ressourcesContainer* ressources) {
+    const char* engine = NULL;
+    const char* connections = NULL;
+    const char* maxFile = NULL;
+    const char* maxResponse = NULL;
+    const char* writers = NULL;
+    const char* policy = NULL;
+    const char* trace = NULL;
+    int kept = 1;
+    for (int i = 1; i < *argc; i++) {
+        int found = optionValue(*argc, argv, &i, ENGINE_OPTION, &engine);
+        if (found == 0) {
+            found = optionValue(*argc, argv, &i, BATCH_OPTION, &ressources->batch.input);
+        }
+        if (found == 0) {
+            found = optionValue(*argc, argv, &i, CONNECTIONS_OPTION, &connections);
+        }
+        if (found == 0) {
+            found = optionValue(*argc, argv, &i, MAXFILE_OPTION, &maxFile);
+        }
+        if (found == 0) {
+            found = optionValue(*argc, argv, &i, MAXRESPONSE_OPTION, &maxResponse);
+        }
+        if (found == 0) {
+            found = optionValue(*argc, argv, &i, WRITERS_OPTION, &writers);
+        }
+        if (found == 0) {
+            found = optionValue(*argc, argv, &i, WRITEPOLICY_OPTION, &policy);
+        }
+        if (found == 0) {
+            found = optionValue(*argc, argv, &i, TRACE_OPTION, &trace);
+        }
+        if (found == -1) {
+            return -1;
+        }
+        if (found == 1) {
+            continue;
+        }
+        if (strcmp(argv[i], PERSISTENT_OPTION) == 0) {
+            ressources->persistent = 1;
+        } else if (strcmp(argv[i], COMPRESS_OPTION) == 0) {
+            // the encodings are offered in the length line of a framed request
+            ressources->persistent = 1;
+            ressources->compress = 1;
+        } else if (strcmp(argv[i], FANOUT_OPTION) == 0) {
+            ressources->fanout.enabled = 1;
+        } else if (strcmp(argv[i], ALLADDRESSES_OPTION) == 0) {
+            ressources->fanout.enabled = 1;
+            ressources->fanout.allAddresses = 1;
+        } else {
+            argv[kept++] = argv[i];
+        }
     }
-    //---------------------------------------------------------------------------------------------------
-    //------------------ read and write file in block (chunk size) ------- ------------------------------
-    //---------------------------------------------------------------------------------------------------
-
-    for (int i = 0; i < cycles && isEOF == false; i++) {
-        readBytes += fread(partioned_read_array, 1, CHUNK, ressources->filepointerClientRead);
-        // check if EOF
-        if (feof(ressources->filepointerClientRead) != 0) {
-            isEOF = true;
+    argv[kept] = NULL;
+    *argc = kept;
+    if (connections != NULL) {
+        char* end = NULL;
+        long value = strtol(connections, &end, 10);
+        if ((*end != '\0') || (value < 1) || (value > BATCH_MAXCONNECTIONS)) {
+            return -1;
         }
-        if (ferror(ressources->filepointerClientRead) != 0) {
-            closeAllRessources(ressources);
-            errorMessage("Error in reading from socket", strerror(errno), ressources);
+        ressources->batch.connections = (int) value;
+    }
+    if (((maxFile != NULL) && (parseSize(maxFile, &ressources->limits.file) == -1)) ||
+        ((maxResponse != NULL) && (parseSize(maxResponse, &ressources->limits.response) == -1))) {
+        return -1;
+    }
+    if (writers != NULL) {
+        char* end = NULL;
+        long value = strtol(writers, &end, 10);
+        if ((*end != '\0') || (value < 1) || (value > WRITER_MAXTHREADS)) {
+            return -1;
         }
-        writeBytes += fwrite(partioned_read_array, 1, CHUNK, ressources->filepointerClientWriteDisk);
-        if (ferror(ressources->filepointerClientWriteDisk) != 0) {
-            closeAllRessources(ressources);
-            errorMessage("Error in writing to disk", strerror(errno), ressources);
+        ressources->writerThreads = (int) value;
+    }
+    if (policy != NULL) {
+        if (strcmp(policy, "fsync") == 0) {
+            ressources->writePolicy = WRITER_FSYNC;
+        } else if (strcmp(policy, "direct") == 0) {
+            ressources->writePolicy = WRITER_DIRECT;
+        } else if (strcmp(policy, "buffered") != 0) {
+            return -1;
         }
-
-        if (ressources->verbose == 1) {
-            LINEOUTPUT;
-            fprintf(stdout, "Read bytes %d from Server\n", readBytes);
-            LINEOUTPUT;
-            fprintf(stdout, "Written bytes %d to disk\n", writeBytes);
-            LINEOUTPUT;
-            fprintf(stdout, "Number ofCycle: %d of %d\n", i + 1, cycles);
+        if (ressources->writerThreads == 0) {
+            ressources->writerThreads = 1;  // the policy is implemented by the writer threads
         }
     }
+    if ((trace != NULL) && (trace_open(trace) == -1)) {
+        fprintf(stderr, "%s: could not create the trace file: %s\n", argv[0], strerror(errno));
+        return -1;
+    }
+    if ((engine == NULL) || (strcmp(engine, "splice") == 0)) {
+        return 0;
+    }
+    if (strcmp(engine, "portable") == 0) {
+        ressources->engine = ENGINE_PORTABLE;
+        return 0;
+    }
+    if (strcmp(engine, "uring") != 0) {
+        return -1;
+    }
+    ressources->ring = malloc(sizeof(uring));
+    if ((ressources->ring != NULL) && (uring_init(ressources->ring, 2 * URING_PAIRS) == 0)) {
+        ressources->engine = ENGINE_URING;
+        return 0;
+    }
+    fprintf(stderr, "%s: io_uring not available, using the splice engine: %s\n", argv[0], strerror(errno));
+    free(ressources->ring);
+    ressources->ring = NULL;
+    return 0;
+}
 
-    //---------------------------------------------------------------------------------------------------
-    //------------------------- handle the rest if EOF is not set ---------------------------------------
-    //---------------------------------------------------------------------------------------------------
-
-    if (isEOF == false) {
-        int lengthRest = length - readBytes;
-        if (ressources->verbose == 1) {
-            LINEOUTPUT;
-            fprintf(stdout, "Rest to copy: %d\n", lengthRest);
+/**
+* @brief optionValue checks if argv[*i] is the option name, given as "name value" or "name=value"
+* @param argc int: number of arguments
+* @param argv const char*[]: the arguments
+* @param i int*: index of the argument, advanced past the value if it is a separate argument
+* @param name const char*: name of the option
+* @param value const char**: set to the value if the option matches
+* @return int: 1 if the option matches, 0 if not, -1 if the value is missing
+*/
+static int optionValue(int argc, const char* argv[], int* i, const char* name, const char** value) {
+    size_t length = strlen(name);
+    if (strcmp(argv[*i], name) == 0) {
+        if (*i + 1 == argc) {
+            return -1;
         }
+        *value = argv[++*i];
+        return 1;
+    }
+    if ((strncmp(argv[*i], name, length) == 0) && (argv[*i][length] == '=')) {
+        *value = argv[*i] + length + 1;
+        return 1;
+    }
+    return 0;
+}
 
-        // read the lengthRest if needed.
-        if (lengthRest > 0) {
-            char* contentRestOfFile = malloc(lengthRest);
-            if (contentRestOfFile == NULL) {
-                closeAllRessources(ressources);
-                errorMessage("Could not allocate memory for the filebuffer", strerror(errno), ressources);
-            }
-            actualRead = fread(contentRestOfFile, 1, lengthRest, ressources->filepointerClientRead);
-            readBytes += actualRead;
-            // check if EOF
-            if (feof(ressources->filepointerClientRead) != 0) {
-                isEOF = true;
-            }
-            if (ferror(ressources->filepointerClientRead) != 0) {
-                closeAllRessources(ressources);
-                errorMessage("Error in reading from socket", strerror(errno), ressources);
-            }
+/**
+* @brief parseSize parses a size in bytes, optionally followed by the suffix k, M or G
+* @param value const char*: the size
+* @param size uint64_t*: the parsed size
+* @return int: 0 on success, -1 if it is not a size
+*/
+static int parseSize(const char* value, uint64_t* size) {
+    char* end = NULL;
+    errno = 0;
+    unsigned long long parsed = strtoull(value, &end, 10);
+    if ((errno != 0) || (end == value) || (value[0] == '-')) {
+        return -1;
+    }
+    int shift = 0;
+    switch (*end) {
+        case 'k':
+        case 'K':
+            shift = 10;
+            end++;
+            break;
+        case 'M':
+            shift = 20;
+            end++;
+            break;
+        case 'G':
+            shift = 30;
+            end++;
+            break;
+        default:
+            break;
+    }
+    if ((*end != '\0') || (parsed > (UINT64_MAX >> shift))) {
+        return -1;
+    }
+    *size = (uint64_t) parsed << shift;
+    return 0;
+}
 
-            actualWrite = fwrite(contentRestOfFile, 1, lengthRest, ressources->filepointerClientWriteDisk);
-            writeBytes += actualWrite;
-            if (ferror(ressources->filepointerClientWriteDisk) != 0) {
+/**
+* @brief runBatch posts the messages of the batch input instead of a single message and exits. The remaining
+* options are -s, -p and -v, user and message come from the input.
+* @param argc int: number of arguments, the batch options are removed already
+* @param argv const char*[]: the arguments
+* @param ressources ressourcesContainer*: batch is set up, freed before the exit
+*/
+static void runBatch(int argc, const char* argv[], ressourcesContainer* ressources) {
+    int option;
+    while ((option = getopt(argc, (char* const*) argv, "s:p:vh")) != -1) {
+        switch (option) {
+            case 's':
+                ressources->batch.server = optarg;
+                break;
+            case 'p':
+                ressources->batch.port = optarg;
+                break;
+            case 'v':
+                ressources->verbose = 1;
+                break;
+            case 'h':
                 closeAllRessources(ressources);
-                errorMessage("Error in writing to disk", strerror(errno), ressources);
-            }
-            if (ressources->verbose == 1) {
-                LINEOUTPUT;
-                fprintf(stdout, "Wrote %d of %d read Bytes to disk\n", actualWrite, actualRead);
-            }
-
-            free(contentRestOfFile);   // done with the lengthRest
-            contentRestOfFile = NULL;
+                free(ressources);
+                usage(stdout, argv[0], EXIT_SUCCESS);
+                break;
+            default:
+                closeAllRessources(ressources);
+                free(ressources);
+                usage(stderr, argv[0], EXIT_FAILURE);
         }
     }
-
-    //---------------------------------------------------------------------------------------------------
-    //------------------ close Filepointer to disk write (filepointerClientWriteDisk) -------------------
-    //---------------------------------------------------------------------------------------------------
-    fflush(ressources->filepointerClientWriteDisk);
-    fclose(ressources->filepointerClientWriteDisk);  // close the file
-    ressources->filepointerClientWriteDisk = NULL;
-
-    free(partioned_read_array);
-    if (ressources->verbose == 1) {
-        LINEOUTPUT;
-        fprintf(stdout, "Read bytes %d from Server\n", readBytes);
-        LINEOUTPUT;
-        fprintf(stdout, "Written bytes %d to disk\n", writeBytes);
+    if ((ressources->batch.server == NULL) || (ressources->batch.port == NULL) || (optind != argc)) {
+        closeAllRessources(ressources);
+        free(ressources);
+        usage(stderr, argv[0], EXIT_FAILURE);
     }
-    if (ressources->verbose == 1) {
-        LINEOUTPUT;
-        fprintf(stdout, "Is end of File: %d\n", isEOF);
+    ressources->batch.verbose = ressources->verbose;
+    int result = batch_run(&ressources->batch);
+    if (result == -1) {
+        errorMessage("Batch failed:", strerror(errno), ressources);
     }
-    loops++;
-    if (ressources->verbose == 1) {
-        LINEOUTPUT;
-        fprintf(stdout, "Looping the write routine: %d\n", loops);
+    closeAllRessources(ressources);
+    free(ressources);
+    exit((result == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+/**
+ * @brief runs the fan-out mode and exits with its result
+ * @param ressources ressourcesContainer*: the fan-out configuration, released before exiting
+ */
+static void runFanout(ressourcesContainer* ressources) {
+    int result = fanout_run(&ressources->fanout);
+    if (result == -1) {
+        errorMessage("Fan-out failed:", strerror(errno), ressources);
     }
+    closeAllRessources(ressources);
+    free(ressources);
+    exit((result == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
 
-    return isEOF;
+/**
+* @brief parseCommandline parses the options of a single post: -s, -p, -u, -m, the optional -i and -v, also as
+* --server, --port, --user, --message, --image and --verbose. Prints the usage and exits if a required option is
+* missing, an option is unknown or arguments are left over, with -h after printing the usage to stdout.
+* @param argc int: number of arguments
+* @param argv const char*[]: the arguments
+* @param ressources ressourcesContainer*: verbose is set, freed before an exit
+* @param server const char**: receives the server, points into argv
+* @param port const char**: receives the port
+* @param user const char**: receives the name of the posting user
+* @param message const char**: receives the message
+* @param imgUrl const char**: receives the image URL, NULL if none was given
+*/
+static void parseCommandline(int argc, const char* argv[], ressourcesContainer* ressources, const char** server,
+                             const char** port, const char** user, const char** message, const char** imgUrl) {
+    static const struct option longOptions[] = {
+            {"server",  required_argument, NULL, 's'},
+            {"port",    required_argument, NULL, 'p'},
+            {"user",    required_argument, NULL, 'u'},
+            {"image",   required_argument, NULL, 'i'},
+            {"message", required_argument, NULL, 'm'},
+            {"verbose", no_argument,       NULL, 'v'},
+            {"help",    no_argument,       NULL, 'h'},
+            {NULL, 0, NULL, 0}
+    };
+    *server = NULL;
+    *port = NULL;
+    *user = NULL;
+    *message = NULL;
+    *imgUrl = NULL;
+    int option;
+    while ((option = getopt_long(argc, (char* const*) argv, "s:p:u:i:m:vh", longOptions, NULL)) != -1) {
+        switch (option) {
+            case 's':
+                *server = optarg;
+                break;
+            case 'p':
+                *port = optarg;
+                break;
+            case 'u':
+                *user = optarg;
+                break;
+            case 'i':
+                *imgUrl = optarg;
+                break;
+            case 'm':
+                *message = optarg;
+                break;
+            case 'v':
+                ressources->verbose = 1;
+                break;
+            case 'h':
+                closeAllRessources(ressources);
+                free(ressources);
+                usage(stdout, argv[0], EXIT_SUCCESS);
+                break;
+            default:
+                closeAllRessources(ressources);
+                free(ressources);
+                usage(stderr, argv[0], EXIT_FAILURE);
+        }
+    }
+    if ((*server == NULL) || (*port == NULL) || (*user == NULL) || (*message == NULL) || (optind != argc)) {
+        closeAllRessources(ressources);
+        free(ressources);
+        usage(stderr, argv[0], EXIT_FAILURE);
+    }
 }
 
 /**
@@ -543,6 +1234,7 @@ bool writeToDisk(long length, ressourcesContainer* ressources) {
 //no return needed because if function is called, program will be exited in end of the function - return never used
 static void errorMessage(const char* userMessage, const char* errorMessage, ressourcesContainer* ressources) {
     fprintf(stderr, "%s: %s %s\n", ressources->progname, userMessage, errorMessage);
+    TRACE(TRACE_ERROR, (uint64_t) errno, 0);
     closeAllRessources(ressources); // close all open ressources before leaving
     if (ressources != NULL) {
         free(ressources);       // deallocate the ressources before leaving program
@@ -567,6 +1259,21 @@ static void usage(FILE* stream, const char* cmnd, int exitcode) {
     fprintf(stream, "\t-m, <message> \tmessage to be added to the bulletin board\n");
     fprintf(stream, "\t-v, \t\tverbose output\n");
     fprintf(stream, "\t-h, \n");
+    fprintf(stream, "\t--engine <name> \treceive engine: splice, portable or uring [default: splice]\n");
+    fprintf(stream, "\t--persistent \tsend the request length framed, falls back if the server does not support it\n");
+    fprintf(stream, "\t--compress \taccept deflate encoded files, implies --persistent\n");
+    fprintf(stream, "\t--batch <file> \tpost every line of file (- for stdin): user<TAB>message[<TAB>image],\n");
+    fprintf(stream, "\t\t\tneeds only -s and -p\n");
+    fprintf(stream, "\t--connections <n> \tconcurrent connections of the batch mode [default: %d]\n",
+            BATCH_DEFAULTCONNECTIONS);
+    fprintf(stream, "\t--fanout \tpost to every server of -s, separated by '%s', in parallel\n", FANOUT_SEPARATOR);
+    fprintf(stream, "\t--all-addresses \tpost to every resolved address of the servers in parallel\n");
+    fprintf(stream, "\t--max-file <size> \tlongest file accepted, suffix k, M or G, 0 no limit [default: 1G]\n");
+    fprintf(stream, "\t--max-response <size> \tlongest response accepted, 0 no limit [default: 4G]\n");
+    fprintf(stream, "\t--writers <n> \twrite the files with n threads beside the receive loop [1..%d]\n",
+            WRITER_MAXTHREADS);
+    fprintf(stream, "\t--write-policy <policy> \tbuffered, fsync or direct (O_DIRECT) [default: buffered]\n");
+    fprintf(stream, "\t--trace <prefix> \tbinary trace to <prefix>.<pid>, decoded by simple_message_trace\n");
 
     exit(exitcode);
 }
@@ -590,46 +1297,6 @@ static long parseIntfromString(const char* buffer) {
     return result;
 }
 
-/**
- * @brief parseField parses a filename from given buffer with the prefix of 'filename='
- * @param fieldBuffer char *, buffer with prefix
- * @param filename char **, pointer to the filename
- * @return 0 in case parsing was successful, -1 if not
- */
-static int parseField(char* fieldBuffer, char** filename) {
-    int a = 0, b = 0, c = 0;
-    // find the asssignment sign
-    while (fieldBuffer[a]) {
-        if (fieldBuffer[a++] == FIELD_ASSIGNMENT) { break; }
-    }
-    // find the '\0'b
-    b = a;
-    while (fieldBuffer[b++]); // find endline '\0', but before is '\n'
-    // Filename is too long, print out an error
-
-    char* filenameTemp = NULL;
-    // create a new array, b - a is enough because of '\n'
-    filenameTemp = malloc((b - a) * sizeof(char));
-    if (filenameTemp == NULL) {
-        fprintf(stderr, "%s: error allocation memory: %s\n", progname, strerror(errno));
-        return -1;
-    }
-    //copy array -till the delimiter '\n' is found, or till '\0' is found to aviod seg fault
-    while ((fieldBuffer[a] != FIELD_DELIMITER) && (fieldBuffer[a])) {
-        filenameTemp[c++] = fieldBuffer[a++];
-    }
-    // Check if Field delimiter is found, if not error occured.
-    if (b == a) {
-        fprintf(stderr, "%s: no field delimiter is found\n", progname);
-        return -1;
-    }
-    // Termination of the filenameKey
-    filenameTemp[c] = '\0';
-
-    *filename = filenameTemp;
-    return 0;
-}
-
 /**
 * @brief closeAllRessources closes all ressources and prints errormessage if an error occurs
 * @param ressources is a struct containing every information of the used socket, as well as the programname and the information if the output should be verbose
@@ -647,23 +1314,40 @@ static void closeAllRessources(ressourcesContainer* ressources) {
         }
         ressources->socketDescriptorWrite = -1;
     }
-    if (ressources->filepointerClientRead != NULL) {
-        if (fclose(ressources->filepointerClientRead) != 0) {
-            fprintf(stderr, "Could not close filepointerClientRead.\n");
-        }
-        ressources->filepointerClientRead = NULL;
-    }
     if (ressources->filepointerClientWrite != NULL) {
         if (fclose(ressources->filepointerClientWrite) != 0) {
             fprintf(stderr, "Could not close filepointerClientWrite.\n");
         }
         ressources->filepointerClientWrite = NULL;
     }
-    if (ressources->filepointerClientWriteDisk != NULL) {
-        if (fclose(ressources->filepointerClientWriteDisk) != 0) {
-            fprintf(stderr, "Could not close clientWriteDiskFp.\n");
+    if (ressources->fileDescriptorWriteDisk != -1) {
+        if (close(ressources->fileDescriptorWriteDisk) != 0) {
+            fprintf(stderr, "Could not close fileDescriptorWriteDisk.\n");
         }
-        ressources->filepointerClientWriteDisk = NULL;
+        ressources->fileDescriptorWriteDisk = -1;
+    }
+    for (int i = 0; i < 2; i++) {
+        if (ressources->pipe[i] != -1) {
+            close(ressources->pipe[i]);
+            ressources->pipe[i] = -1;
+        }
+    }
+    free(ressources->receive.data);
+    ressources->receive.data = NULL;
+    if (ressources->decoder != NULL) {
+        decoder_end(ressources->decoder);
+        free(ressources->decoder);
+        ressources->decoder = NULL;
+    }
+    if (ressources->writer != NULL) {
+        writer_stop(ressources->writer);
+        free(ressources->writer);
+        ressources->writer = NULL;
+    }
+    if (ressources->ring != NULL) {
+        uring_close(ressources->ring);
+        free(ressources->ring);
+        ressources->ring = NULL;
     }
 }
 
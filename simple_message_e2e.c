@@ -0,0 +1,590 @@
+/**
+ * @file simple_message_e2e.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 21.12.18
+ *
+ * @brief End-to-end test and benchmark of every server mode with the captured sessions.
+ * The requests of the client to server streams of the captures are sent again, one after the other like the
+ * clients of the capture did, to a server started in every mode on an empty board in its own directory. The
+ * external logic modes run the in-tree simple_message_server_logic. The responses of every mode must be byte
+ * identical to the ones of the first mode, only the dates of the posts are masked, they depend on the second
+ * the request was answered in. Reported are the requests per second and the latencies of every mode.
+ * Every server runs in its own process group. The next mode is started only after the whole group is gone and
+ * the port can be bound again, so no request reaches a server or handler left over from the previous mode.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#define _GNU_SOURCE         // provides mkdtemp()
+#include <stdlib.h>         // provides malloc(), realpath(), qsort()
+#include <stdio.h>          // provides the printf()
+#include <string.h>         // provide strerror(), memcpy()
+#include <errno.h>          // provides errno
+#include <stdint.h>         // provides uint64_t
+#include <ctype.h>          // provides isdigit()
+#include <limits.h>         // provides PATH_MAX
+#include <signal.h>         // provides kill()
+#include <time.h>           // provides clock_gettime(), nanosleep()
+#include <fcntl.h>          // provides open()
+#include <dirent.h>         // provides opendir(), readdir()
+#include <unistd.h>         // provides fork(), execv(), getopt()
+#include <sys/types.h>
+#include <sys/wait.h>       // provides waitpid()
+#include <sys/socket.h>     // provides socket(), connect(), shutdown()
+#include <netinet/in.h>     // provides struct sockaddr_in
+#include <arpa/inet.h>      // provides htons(), htonl()
+#include "pcap_reader.h"
+
+// --------------------------------------------------------------- defines --
+/** @brief default server binary */
+#define E2E_SERVER "./simple_message_server"
+/** @brief default business logic of the exec modes */
+#define E2E_LOGIC "./simple_message_server_logic"
+/** @brief default port of the servers */
+#define E2E_PORT 7391
+/** @brief default times the requests of the captures are sent */
+#define E2E_ROUNDS 1
+/** @brief most arguments of a server */
+#define E2E_MAXARGUMENTS 16
+/** @brief ms a server may take to listen */
+#define E2E_STARTTIMEOUT 5000
+/** @brief ms a server and its handlers may take to terminate and release the port, then they are killed */
+#define E2E_STOPTIMEOUT 10000
+/** @brief size of the receive buffer */
+#define E2E_RECEIVEBUFFER (64 * 1024)
+/** @brief template of the directories of the servers */
+#define E2E_DIRECTORY "/tmp/simple_message_e2e.XXXXXX"
+/** @brief masked date of a post, "YYYY-MM-DD HH:MM:SS" */
+#define E2E_DATEPATTERN "dddd-dd-dd dd:dd:dd"
+
+// -------------------------------------------------------------- typedefs --
+/** @brief A server mode, the arguments besides the port and the logic path */
+typedef struct e2eMode {
+    const char* name;                           /**< Name in the report */
+    int exec;                                   /**< 1 if the mode runs the external logic */
+    const char* arguments[E2E_MAXARGUMENTS];    /**< Arguments of the mode, NULL terminated */
+} e2eMode;
+
+/** @brief A captured request */
+typedef struct e2eRequest {
+    const unsigned char* data;  /**< Bytes of the client, owned by the capture */
+    size_t length;              /**< Number of bytes */
+} e2eRequest;
+
+/** @brief Result of a mode */
+typedef struct e2eResult {
+    uint64_t* hashes;           /**< Hash of every masked response */
+    uint64_t* latencies;        /**< Time of every request in ns */
+    size_t count;               /**< Requests answered */
+    uint64_t bytes;             /**< Bytes received */
+    uint64_t elapsed;           /**< Time of all requests in ns */
+} e2eResult;
+
+// --------------------------------------------------------------- globals --
+/** @brief the server modes, the first one is the reference of the comparison */
+static const e2eMode modes[] = {
+        {"spawn",         1, {"-l", "exec", NULL}},
+        {"prefork",       1, {"-l", "exec", "-P", "2", NULL}},
+        {"threads",       1, {"-l", "exec", "-t", "2", NULL}},
+        {"local",         0, {"-l", "local", NULL}},
+        {"local-prefork", 0, {"-l", "local", "-P", "2", NULL}},
+        {"local-threads", 0, {"-l", "local", "-t", "2", NULL}},
+        {"reactor",       0, {"-l", "local", "-r", "2", NULL}},
+        {"uring",         0, {"-l", "local", "-U", NULL}},
+};
+
+// ------------------------------------------------------------- functions --
+static pid_t startServer(const e2eMode* mode, const char* server, const char* logic, int port,
+                         const char* directory);
+static int waitListening(int port, pid_t pid);
+static int stopServer(int port, pid_t pid);
+static int portFree(int port);
+static int runRequests(const e2eRequest* requests, size_t count, long rounds, int port, e2eResult* result);
+static int sendRequest(const e2eRequest* request, int port, char* buffer, uint64_t* hash, uint64_t* received);
+static int connectServer(int port);
+static void removeDirectory(const char* directory);
+static int compareTimes(const void* a, const void* b);
+static uint64_t now(void);
+static void usage(FILE* stream, const char* cmnd, int exitcode);
+
+// ------------------------------------------------------------------- main --
+/**
+ * @brief reads the captures, runs every mode and compares the responses
+ * @param argc int: number of arguments
+ * @param argv char**: the arguments, the captures after the options
+ * @return int: EXIT_SUCCESS if every mode answered every request like the first one, EXIT_FAILURE if not
+ */
+int main(int argc, char** argv) {
+    const char* server = E2E_SERVER;
+    const char* logic = E2E_LOGIC;
+    const char* only = NULL;
+    long port = E2E_PORT;
+    long rounds = E2E_ROUNDS;
+    int option;
+    while ((option = getopt(argc, argv, "s:L:p:n:m:h")) != -1) {
+        switch (option) {
+            case 's':
+                server = optarg;
+                break;
+            case 'L':
+                logic = optarg;
+                break;
+            case 'p':
+                port = strtol(optarg, NULL, 10);
+                break;
+            case 'n':
+                rounds = strtol(optarg, NULL, 10);
+                break;
+            case 'm':
+                only = optarg;
+                break;
+            case 'h':
+                usage(stdout, argv[0], EXIT_SUCCESS);
+                break;
+            default:
+                usage(stderr, argv[0], EXIT_FAILURE);
+        }
+    }
+    if ((optind == argc) || (port < 1) || (port > 65535) || (rounds < 1)) {
+        usage(stderr, argv[0], EXIT_FAILURE);
+    }
+    // the servers run in their own directories, the binaries are given to them with absolute paths
+    char serverPath[PATH_MAX], logicPath[PATH_MAX];
+    if ((realpath(server, serverPath) == NULL) || (realpath(logic, logicPath) == NULL)) {
+        fprintf(stderr, "%s: could not find %s or %s: %s\n", argv[0], server, logic, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    int captureCount = argc - optind;
+    pcapCapture* captures = calloc((size_t) captureCount, sizeof(pcapCapture));
+    e2eRequest* requests = NULL;
+    size_t requestCount = 0;
+    for (int i = 0; (captures != NULL) && (i < captureCount); i++) {
+        if (pcap_read(argv[optind + i], &captures[i]) == -1) {
+            fprintf(stderr, "%s: %s: %s, skipped\n", argv[0], argv[optind + i],
+                    (errno == EINVAL) ? "no packets in the file" : strerror(errno));
+            continue;
+        }
+        for (size_t s = 0; s < captures[i].count; s++) {
+            const pcapStream* stream = &captures[i].streams[s];
+            if (stream->refused || (stream->request.length == 0)) {
+                continue;
+            }
+            e2eRequest* grown = realloc(requests, (requestCount + 1) * sizeof(e2eRequest));
+            if (grown == NULL) {
+                break;
+            }
+            requests = grown;
+            requests[requestCount].data = stream->request.data;
+            requests[requestCount].length = stream->request.length;
+            requestCount++;
+        }
+    }
+    if (requestCount == 0) {
+        fprintf(stderr, "%s: no requests in the captures\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    fprintf(stdout, "%zu captured requests, %ld rounds\n", requestCount, rounds);
+    fprintf(stdout, "%-14s %9s %12s %10s %10s %10s   %s\n", "mode", "requests", "bytes", "req/s", "p50 us",
+            "p99 us", "responses");
+    size_t modeCount = sizeof(modes) / sizeof(modes[0]);
+    e2eResult reference = {NULL, NULL, 0, 0, 0};
+    int failed = 0;
+    for (size_t m = 0; m < modeCount; m++) {
+        if ((only != NULL) && (strcmp(only, modes[m].name) != 0)) {
+            continue;
+        }
+        char directory[] = E2E_DIRECTORY;
+        if (mkdtemp(directory) == NULL) {
+            fprintf(stderr, "%s: could not create a directory: %s\n", argv[0], strerror(errno));
+            return EXIT_FAILURE;
+        }
+        e2eResult result = {NULL, NULL, 0, 0, 0};
+        // a server which could not start is an error of the mode, never compared as a mismatch
+        int started = 0;
+        int status = -1;
+        pid_t pid = -1;
+        if (portFree((int) port) != 1) {
+            fprintf(stderr, "%s: %s: port %ld is in use by another process\n", argv[0], modes[m].name, port);
+        } else if ((pid = startServer(&modes[m], serverPath, logicPath, (int) port, directory)) == -1) {
+            fprintf(stderr, "%s: %s: could not start the server: %s\n", argv[0], modes[m].name, strerror(errno));
+        } else if (waitListening((int) port, pid) == -1) {
+            fprintf(stderr, "%s: %s: the server did not listen on port %ld\n", argv[0], modes[m].name, port);
+        } else {
+            started = 1;
+            status = runRequests(requests, requestCount, rounds, (int) port, &result);
+        }
+        if ((pid != -1) && (stopServer((int) port, pid) == -1)) {
+            fprintf(stderr, "%s: %s: the server did not release port %ld\n", argv[0], modes[m].name, port);
+            status = -1;
+        }
+        removeDirectory(directory);
+
+        const char* verdict = "reference";
+        if (!started) {
+            verdict = "NOT STARTED";
+        } else if (status == -1) {
+            verdict = "FAILED";
+        } else if (reference.hashes != NULL) {
+            verdict = "identical";
+            for (size_t i = 0; i < result.count; i++) {
+                if (result.hashes[i] != reference.hashes[i]) {
+                    verdict = "DIFFERENT";
+                    fprintf(stdout, "%s: response %zu differs from %s\n", modes[m].name, i + 1, modes[0].name);
+                    break;
+                }
+            }
+        }
+        failed |= (status == -1) || (strcmp(verdict, "DIFFERENT") == 0);
+        double seconds = (double) result.elapsed / 1e9;
+        qsort(result.latencies, result.count, sizeof(uint64_t), compareTimes);
+        fprintf(stdout, "%-14s %9zu %12llu %10.1f %10.1f %10.1f   %s\n", modes[m].name, result.count,
+                (unsigned long long) result.bytes, (seconds > 0) ? (double) result.count / seconds : 0.0,
+                (result.count > 0) ? (double) result.latencies[result.count / 2] / 1e3 : 0.0,
+                (result.count > 0) ? (double) result.latencies[(result.count * 99) / 100] / 1e3 : 0.0, verdict);
+        free(result.latencies);
+        if ((reference.hashes == NULL) && (status == 0)) {
+            reference = result;
+        } else {
+            free(result.hashes);
+        }
+    }
+    free(reference.hashes);
+    free(requests);
+    for (int i = 0; (captures != NULL) && (i < captureCount); i++) {
+        pcap_free(&captures[i]);
+    }
+    free(captures);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * @brief starts the server of a mode in its directory, its output is discarded
+ * @param mode const e2eMode*: the mode
+ * @param server const char*: absolute path of the server
+ * @param logic const char*: absolute path of the business logic of the exec modes
+ * @param port int: listening port
+ * @param directory const char*: working directory of the server, the board is created there
+ * @return pid_t: the server, -1 if it could not be started (errno is set)
+ */
+static pid_t startServer(const e2eMode* mode, const char* server, const char* logic, int port,
+                         const char* directory) {
+    char portText[16];
+    snprintf(portText, sizeof(portText), "%d", port);
+    const char* arguments[E2E_MAXARGUMENTS + 6];
+    int count = 0;
+    arguments[count++] = server;
+    arguments[count++] = "-p";
+    arguments[count++] = portText;
+    if (mode->exec) {
+        arguments[count++] = "--logic-path";
+        arguments[count++] = logic;
+    }
+    for (int i = 0; mode->arguments[i] != NULL; i++) {
+        arguments[count++] = mode->arguments[i];
+    }
+    arguments[count] = NULL;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // the own process group lets stopServer() find the handlers and workers of the server as well
+        setpgid(0, 0);
+        int fd_null = open("/dev/null", O_RDWR);
+        if ((chdir(directory) == -1) || (fd_null == -1)) {
+            _exit(EXIT_FAILURE);
+        }
+        dup2(fd_null, STDIN_FILENO);
+        dup2(fd_null, STDOUT_FILENO);
+        dup2(fd_null, STDERR_FILENO);
+        execv(server, (char* const*) arguments);
+        _exit(EXIT_FAILURE);
+    }
+    if (pid > 0) {
+        setpgid(pid, pid);  // also in the parent, the child may not have run yet
+    }
+    return pid;
+}
+
+/**
+ * @brief waits until the server accepts connections
+ * @param port int: listening port
+ * @param pid pid_t: the server, which must not have terminated
+ * @return int: 0 if the server listens, -1 if it terminated or did not listen in time
+ */
+static int waitListening(int port, pid_t pid) {
+    struct timespec interval = {0, 10 * 1000000L};
+    for (int waited = 0; waited < E2E_STARTTIMEOUT; waited += 10) {
+        if (waitpid(pid, NULL, WNOHANG) == pid) {
+            return -1;
+        }
+        // the probe is a connection without request, the server answers it like an empty request
+        int fd_probe = connectServer(port);
+        if (fd_probe != -1) {
+            close(fd_probe);
+            return 0;
+        }
+        nanosleep(&interval, NULL);
+    }
+    return -1;
+}
+
+/**
+ * @brief terminates the server and waits until its process group is gone and the port can be bound again.
+ * Whatever is left after E2E_STOPTIMEOUT is killed.
+ * @param port int: listening port
+ * @param pid pid_t: the server, leader of its own process group
+ * @return int: 0 if the port is free, -1 if it is still bound
+ */
+static int stopServer(int port, pid_t pid) {
+    struct timespec interval = {0, 10 * 1000000L};
+    int reaped = 0;
+    kill(pid, SIGTERM);
+    for (int waited = 0; waited < E2E_STOPTIMEOUT; waited += 10) {
+        if (!reaped && (waitpid(pid, NULL, WNOHANG) == pid)) {
+            reaped = 1;
+        }
+        // the handlers and workers are not our children, they are gone when the group is empty
+        if (reaped && (kill(-pid, 0) == -1) && (errno == ESRCH) && (portFree(port) == 1)) {
+            return 0;
+        }
+        nanosleep(&interval, NULL);
+    }
+    kill(-pid, SIGKILL);
+    if (!reaped) {
+        waitpid(pid, NULL, 0);
+    }
+    for (int waited = 0; waited < E2E_STOPTIMEOUT; waited += 10) {
+        if (portFree(port) == 1) {
+            return 0;
+        }
+        nanosleep(&interval, NULL);
+    }
+    return -1;
+}
+
+/**
+ * @brief checks if the port can be bound, a listening socket on the wildcard address of any family blocks it
+ * @param port int: the port
+ * @return int: 1 if it is free, 0 if it is in use, -1 if the check failed
+ */
+static int portFree(int port) {
+    int fd_probe = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_probe == -1) {
+        return -1;
+    }
+    // connections of the previous mode in TIME_WAIT do not keep the next server from binding
+    int reuse = 1;
+    setsockopt(fd_probe, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t) port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    int result = 1;
+    if (bind(fd_probe, (struct sockaddr*) &address, sizeof(address)) == -1) {
+        result = (errno == EADDRINUSE) ? 0 : -1;
+    }
+    close(fd_probe);
+    return result;
+}
+
+/**
+ * @brief sends all requests rounds times, each after the response to the last one
+ * @param requests const e2eRequest*: the requests
+ * @param count size_t: number of requests
+ * @param rounds long: how often the requests are sent
+ * @param port int: port of the server
+ * @param result e2eResult*: receives the hashes, latencies and totals, freed by the caller
+ * @return int: 0 if every request was answered, -1 on failure
+ */
+static int runRequests(const e2eRequest* requests, size_t count, long rounds, int port, e2eResult* result) {
+    size_t total = count * (size_t) rounds;
+    result->hashes = malloc(total * sizeof(uint64_t));
+    result->latencies = malloc(total * sizeof(uint64_t));
+    char* buffer = malloc(E2E_RECEIVEBUFFER);
+    if ((result->hashes == NULL) || (result->latencies == NULL) || (buffer == NULL)) {
+        free(buffer);
+        return -1;
+    }
+    uint64_t started = now();
+    int status = 0;
+    for (size_t i = 0; (i < total) && (status == 0); i++) {
+        uint64_t begin = now();
+        status = sendRequest(&requests[i % count], port, buffer, &result->hashes[i], &result->bytes);
+        if (status == 0) {
+            result->latencies[result->count++] = now() - begin;
+        }
+    }
+    result->elapsed = now() - started;
+    free(buffer);
+    return status;
+}
+
+/**
+ * @brief sends a request and hashes the response with the dates masked. A date may be split over two
+ * receives, the masking follows the pattern across them.
+ * @param request const e2eRequest*: the request
+ * @param port int: port of the server
+ * @param buffer char*: receive buffer of E2E_RECEIVEBUFFER bytes
+ * @param hash uint64_t*: receives the FNV-1a hash of the masked response
+ * @param received uint64_t*: increased by the bytes of the response
+ * @return int: 0 if the response was received, -1 on failure
+ */
+static int sendRequest(const e2eRequest* request, int port, char* buffer, uint64_t* hash, uint64_t* received) {
+    int fd_socket = connectServer(port);
+    if (fd_socket == -1) {
+        return -1;
+    }
+    size_t sent = 0;
+    while (sent < request->length) {
+        ssize_t written = send(fd_socket, request->data + sent, request->length - sent, MSG_NOSIGNAL);
+        if ((written == -1) && (errno != EINTR)) {
+            close(fd_socket);
+            return -1;
+        }
+        sent += (written > 0) ? (size_t) written : 0;
+    }
+    shutdown(fd_socket, SHUT_WR);
+
+    // position in E2E_DATEPATTERN of the bytes before, the digits of a complete date become 0
+    const char* pattern = E2E_DATEPATTERN;
+    size_t matched = 0;
+    char pending[sizeof(E2E_DATEPATTERN)];
+    uint64_t value = 0xcbf29ce484222325ull;
+    while (1) {
+        ssize_t length = read(fd_socket, buffer, E2E_RECEIVEBUFFER);
+        if (length == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            close(fd_socket);
+            return -1;
+        }
+        if (length == 0) {
+            break;
+        }
+        *received += (uint64_t) length;
+        for (ssize_t i = 0; i < length; i++) {
+            char c = buffer[i];
+            int fits = (pattern[matched] == 'd') ? isdigit((unsigned char) c) : (c == pattern[matched]);
+            if (!fits) {
+                // the bytes matched so far are no date, they are hashed as they are
+                for (size_t j = 0; j < matched; j++) {
+                    value = (value ^ (unsigned char) pending[j]) * 0x100000001b3ull;
+                }
+                matched = 0;
+                fits = (pattern[0] == 'd') && isdigit((unsigned char) c);
+            }
+            if (!fits) {
+                value = (value ^ (unsigned char) c) * 0x100000001b3ull;
+                continue;
+            }
+            pending[matched++] = c;
+            if (matched == strlen(pattern)) {
+                for (size_t j = 0; j < matched; j++) {
+                    value = (value ^ (unsigned char) ((pattern[j] == 'd') ? '0' : pending[j])) * 0x100000001b3ull;
+                }
+                matched = 0;
+            }
+        }
+    }
+    for (size_t j = 0; j < matched; j++) {
+        value = (value ^ (unsigned char) pending[j]) * 0x100000001b3ull;
+    }
+    close(fd_socket);
+    *hash = value;
+    return 0;
+}
+
+/**
+ * @brief connects to the server on the loopback address
+ * @param port int: port of the server
+ * @return int: the connected socket, -1 on failure (errno is set)
+ */
+static int connectServer(int port) {
+    int fd_socket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_socket == -1) {
+        return -1;
+    }
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t) port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd_socket, (struct sockaddr*) &address, sizeof(address)) == -1) {
+        close(fd_socket);
+        return -1;
+    }
+    return fd_socket;
+}
+
+/**
+ * @brief removes the directory of a server with the board files in it
+ * @param directory const char*: the directory, it has no subdirectories
+ */
+static void removeDirectory(const char* directory) {
+    DIR* entries = opendir(directory);
+    if (entries != NULL) {
+        struct dirent* entry;
+        while ((entry = readdir(entries)) != NULL) {
+            if ((strcmp(entry->d_name, ".") != 0) && (strcmp(entry->d_name, "..") != 0)) {
+                unlinkat(dirfd(entries), entry->d_name, 0);
+            }
+        }
+        closedir(entries);
+    }
+    rmdir(directory);
+}
+
+/**
+ * @brief orders times ascending for qsort()
+ * @param a const void*: first uint64_t
+ * @param b const void*: second uint64_t
+ * @return int: <0, 0 or >0
+ */
+static int compareTimes(const void* a, const void* b) {
+    uint64_t first = *(const uint64_t*) a;
+    uint64_t second = *(const uint64_t*) b;
+    return (first > second) - (first < second);
+}
+
+/**
+ * @brief reads the monotonic clock
+ * @return uint64_t: time in ns
+ */
+static uint64_t now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) time.tv_sec * 1000000000ull + (uint64_t) time.tv_nsec;
+}
+
+/**
+ * @brief prints the usage and terminates
+ * @param stream FILE*: the stream to write the usage information to
+ * @param cmnd const char*: name of the executable
+ * @param exitcode int: the exit code
+ */
+static void usage(FILE* stream, const char* cmnd, int exitcode) {
+    fprintf(stream, "usage: %s [-s <server>] [-L <logic>] [-p <port>] [-n <rounds>] [-m <mode>] <capture>...\n",
+            cmnd);
+    fprintf(stream, "\t-s <server>\t server binary [default: %s]\n", E2E_SERVER);
+    fprintf(stream, "\t-L <logic>\t business logic of the exec modes [default: %s]\n", E2E_LOGIC);
+    fprintf(stream, "\t-p <port>\t port of the servers [default: %d]\n", E2E_PORT);
+    fprintf(stream, "\t-n <rounds>\t times the captured requests are sent [default: %d]\n", E2E_ROUNDS);
+    fprintf(stream, "\t-m <mode>\t only this mode:");
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        fprintf(stream, " %s", modes[m].name);
+    }
+    fprintf(stream, "\n\t-h\t\t outputs this info\n");
+    exit(exitcode);
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
@@ -0,0 +1,592 @@
+/**
+ * @file simple_message_replay.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 21.12.18
+ *
+ * @brief Replays the captured sessions of tcpDump_Protocols against a running server.
+ * The client to server streams of the captures are sent again at the times they were captured, divided by a
+ * speed-up factor, so the arrivals keep the shape of the real traffic; speed-up 0 sends them as fast as the
+ * threads can. The sessions are started by a pool of threads, a session which is late because all threads are
+ * busy is measured from its scheduled time, so a slow server is not hidden. Every response is compared with
+ * the captured server to client stream: identical after masking the dates of the posts, the same records
+ * (status and file names, the board may hold other posts), the same status (another logic sends other files,
+ * the lecture's logic sends an image beside the response page), or different. Reported are the comparison,
+ * the throughput and the latency percentiles.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#define _GNU_SOURCE         // provides getopt_long()
+#include <stdlib.h>         // provides malloc(), realloc(), qsort(), strtod()
+#include <stdio.h>          // provides the printf()
+#include <string.h>         // provide strerror(), memcmp()
+#include <errno.h>          // provides errno
+#include <stdint.h>         // provides uint64_t
+#include <ctype.h>          // provides isdigit()
+#include <getopt.h>         // provides getopt_long()
+#include <pthread.h>        // provides pthread_create()
+#include <stdatomic.h>      // provides atomic_fetch_add()
+#include <time.h>           // provides clock_gettime(), clock_nanosleep()
+#include <unistd.h>         // provides close()
+#include <netdb.h>          // provides getaddrinfo()
+#include <sys/types.h>
+#include <sys/socket.h>     // provides socket(), connect(), shutdown()
+#include "pcap_reader.h"
+#include "client_parser.h"
+
+// --------------------------------------------------------------- defines --
+/** @brief default speed-up of the captured times */
+#define REPLAY_DEFAULTSPEEDUP 1.0
+/** @brief default number of threads */
+#define REPLAY_DEFAULTCONCURRENCY 4
+/** @brief default times the sessions are replayed */
+#define REPLAY_DEFAULTROUNDS 1
+/** @brief pause between two rounds in captured time, ns */
+#define REPLAY_ROUNDGAP 1000000LL
+/** @brief date of a post, "YYYY-MM-DD HH:MM:SS", masked before the comparison */
+#define REPLAY_DATEPATTERN "dddd-dd-dd dd:dd:dd"
+/** @brief initial size of the receive buffer of a thread */
+#define REPLAY_RECEIVEBUFFER (64 * 1024)
+/** @brief nanoseconds per second */
+#define NSEC_PER_SEC 1000000000LL
+
+// -------------------------------------------------------------- typedefs --
+/** @brief Result of the comparison of a response with the captured one */
+enum replayVerdict {
+    VERDICT_IDENTICAL,          /**< Byte identical after masking the dates */
+    VERDICT_RECORDS,            /**< The same status and file names, other contents */
+    VERDICT_STATUS,             /**< The same status, other files */
+    VERDICT_DIFFERENT,          /**< Another status or an invalid response */
+    VERDICT_UNCAPTURED,         /**< The capture has no response to compare with */
+    VERDICT_FAILED,             /**< Connection or receive error */
+    VERDICT_COUNT               /**< Number of verdicts */
+};
+
+/** @brief A captured session */
+typedef struct replaySession {
+    const pcapStream* stream;   /**< The stream, owned by the capture */
+    int64_t offset;             /**< Captured start relative to the first session in ns */
+    char* response;             /**< Captured response with the dates masked, NULL if none */
+    uint64_t shape;             /**< Hash of status and file names of the captured response */
+    int status;                 /**< Status of the captured response, -1 if it is invalid */
+} replaySession;
+
+/** @brief Configuration of the replay */
+typedef struct replayConfig {
+    struct addrinfo* address;   /**< Resolved address of the server */
+    replaySession* sessions;    /**< The sessions */
+    size_t count;               /**< Number of sessions */
+    long rounds;                /**< Times the sessions are replayed */
+    double speedup;             /**< Divisor of the captured times, 0 sends without pauses */
+    int64_t span;               /**< Captured time of a round in ns */
+    int64_t start;              /**< Start of the replay */
+    int verbose;                /**< 1 prints every session which is not identical */
+    atomic_long next;           /**< Next session to start, counted over all rounds */
+} replayConfig;
+
+/** @brief One replaying thread */
+typedef struct replayThread {
+    pthread_t thread;                   /**< The thread */
+    replayConfig* config;               /**< The replay */
+    uint64_t* latencies;                /**< Latencies of the answered sessions in ns */
+    size_t answered;                    /**< Number of latencies */
+    long verdicts[VERDICT_COUNT];       /**< Sessions per verdict */
+    uint64_t received;                  /**< Bytes received */
+} replayThread;
+
+// --------------------------------------------------------------- globals --
+static const char* const verdictNames[VERDICT_COUNT] = {
+        "identical", "same records", "same status", "different", "not captured", "failed"
+};
+
+// ------------------------------------------------------------- functions --
+static void* replayLoop(void* argument);
+static enum replayVerdict replayOne(replayThread* thread, const replaySession* session, char** buffer,
+                                   size_t* capacity, size_t* length);
+static int connectServer(const struct addrinfo* address);
+static void maskDates(char* data, size_t length);
+static uint64_t responseShape(const char* data, size_t length, int* status);
+static int compareSessions(const void* a, const void* b);
+static int compareTimes(const void* a, const void* b);
+static int64_t now(void);
+static void sleepUntil(int64_t time);
+static void usage(FILE* stream, const char* cmnd, int exitcode);
+
+// ------------------------------------------------------------------- main --
+/**
+ * @brief reads the captures, replays the sessions with the threads and prints the report
+ * @param argc int: number of program arguments
+ * @param argv char**: the options and the captures
+ * @return int: 0 if every session was answered, 1 if not
+ */
+int main(int argc, char* argv[]) {
+    replayConfig config;
+    memset(&config, 0, sizeof(config));
+    config.speedup = REPLAY_DEFAULTSPEEDUP;
+    config.rounds = REPLAY_DEFAULTROUNDS;
+    atomic_init(&config.next, 0);
+    const char* server = NULL;
+    const char* port = NULL;
+    int concurrency = REPLAY_DEFAULTCONCURRENCY;
+    char* endpointer = NULL;
+    int opt;
+    static const struct option longOptions[] = {
+            {"server",      required_argument, NULL, 's'},
+            {"port",        required_argument, NULL, 'p'},
+            {"speedup",     required_argument, NULL, 'x'},
+            {"concurrency", required_argument, NULL, 'c'},
+            {"rounds",      required_argument, NULL, 'n'},
+            {"verbose",     no_argument,       NULL, 'v'},
+            {"help",        no_argument,       NULL, 'h'},
+            {NULL, 0,                          NULL, 0}
+    };
+    while ((opt = getopt_long(argc, argv, "s:p:x:c:n:vh", longOptions, NULL)) != -1) {
+        switch (opt) {
+            case 's':
+                server = optarg;
+                break;
+            case 'p':
+                port = optarg;
+                break;
+            case 'x':
+                config.speedup = strtod(optarg, &endpointer);
+                if ((*endpointer != 0) || (config.speedup < 0)) {
+                    usage(stderr, argv[0], 1);
+                }
+                break;
+            case 'c':
+                concurrency = (int) strtol(optarg, &endpointer, 10);
+                if ((*endpointer != 0) || (concurrency < 1) || (concurrency > 4096)) {
+                    usage(stderr, argv[0], 1);
+                }
+                break;
+            case 'n':
+                config.rounds = strtol(optarg, &endpointer, 10);
+                if ((*endpointer != 0) || (config.rounds < 1)) {
+                    usage(stderr, argv[0], 1);
+                }
+                break;
+            case 'v':
+                config.verbose = 1;
+                break;
+            case 'h':
+                usage(stdout, argv[0], 0);
+                break;
+            default:
+                usage(stderr, argv[0], 1);
+                break;
+        }
+    }
+    if ((server == NULL) || (port == NULL) || (optind == argc)) {
+        usage(stderr, argv[0], 1);
+    }
+
+    // the sessions of all captures, each capture keeps its own time line starting at 0
+    int captureCount = argc - optind;
+    pcapCapture* captures = calloc((size_t) captureCount, sizeof(pcapCapture));
+    if (captures == NULL) {
+        fprintf(stderr, "%s: Could not allocate memory: %s\n", argv[0], strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < captureCount; i++) {
+        if (pcap_read(argv[optind + i], &captures[i]) == -1) {
+            fprintf(stderr, "%s: %s: %s, skipped\n", argv[0], argv[optind + i],
+                    (errno == EINVAL) ? "no packets in the file" : strerror(errno));
+            continue;
+        }
+        uint64_t first = 0;
+        for (size_t s = 0; s < captures[i].count; s++) {
+            const pcapStream* stream = &captures[i].streams[s];
+            if (stream->refused || (stream->request.length == 0)) {
+                continue;
+            }
+            if (first == 0) {
+                first = stream->start;
+            }
+            replaySession* grown = realloc(config.sessions, (config.count + 1) * sizeof(replaySession));
+            if (grown == NULL) {
+                fprintf(stderr, "%s: Could not allocate memory: %s\n", argv[0], strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+            config.sessions = grown;
+            replaySession* session = &config.sessions[config.count++];
+            session->stream = stream;
+            session->offset = (int64_t) (stream->start - first);
+            session->response = NULL;
+            session->shape = 0;
+            session->status = -1;
+            if (config.span < session->offset) {
+                config.span = session->offset;
+            }
+            // a response cut by a gap of the capture is not compared
+            if ((stream->response.length > 0) && !stream->response.gap) {
+                session->response = malloc(stream->response.length);
+                if (session->response == NULL) {
+                    fprintf(stderr, "%s: Could not allocate memory: %s\n", argv[0], strerror(errno));
+                    exit(EXIT_FAILURE);
+                }
+                memcpy(session->response, stream->response.data, stream->response.length);
+                maskDates(session->response, stream->response.length);
+                session->shape = responseShape(session->response, stream->response.length, &session->status);
+            }
+        }
+    }
+    if (config.count == 0) {
+        fprintf(stderr, "%s: no sessions in the captures\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    config.span += REPLAY_ROUNDGAP;
+    // the threads take the sessions in this order, a session must not wait behind a later one
+    qsort(config.sessions, config.count, sizeof(replaySession), compareSessions);
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int addrinfoError = getaddrinfo(server, port, &hints, &config.address);
+    if (addrinfoError != 0) {
+        fprintf(stderr, "%s: Could not resolve hostname: %s\n", argv[0], gai_strerror(addrinfoError));
+        exit(EXIT_FAILURE);
+    }
+
+    size_t total = config.count * (size_t) config.rounds;
+    replayThread* threads = calloc((size_t) concurrency, sizeof(replayThread));
+    if (threads == NULL) {
+        fprintf(stderr, "%s: Could not allocate memory: %s\n", argv[0], strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    config.start = now();
+    for (int i = 0; i < concurrency; i++) {
+        threads[i].config = &config;
+        threads[i].latencies = malloc(total * sizeof(uint64_t));
+        if ((threads[i].latencies == NULL) ||
+            ((errno = pthread_create(&threads[i].thread, NULL, replayLoop, &threads[i])) != 0)) {
+            fprintf(stderr, "%s: Could not start thread: %s\n", argv[0], strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    uint64_t* latencies = malloc(total * sizeof(uint64_t));
+    if (latencies == NULL) {
+        fprintf(stderr, "%s: Could not allocate memory: %s\n", argv[0], strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    long verdicts[VERDICT_COUNT] = {0};
+    size_t answered = 0;
+    uint64_t received = 0;
+    for (int i = 0; i < concurrency; i++) {
+        pthread_join(threads[i].thread, NULL);
+        memcpy(latencies + answered, threads[i].latencies, threads[i].answered * sizeof(uint64_t));
+        answered += threads[i].answered;
+        received += threads[i].received;
+        for (int v = 0; v < VERDICT_COUNT; v++) {
+            verdicts[v] += threads[i].verdicts[v];
+        }
+        free(threads[i].latencies);
+    }
+    double elapsed = (double) (now() - config.start) / NSEC_PER_SEC;
+    qsort(latencies, answered, sizeof(uint64_t), compareTimes);
+
+    fprintf(stdout, "server: %s:%s, %zu sessions of %d captures, %ld rounds, speed-up %s%.1f, concurrency: %d\n",
+            server, port, config.count, captureCount, config.rounds, (config.speedup > 0) ? "" : "unlimited ",
+            config.speedup, concurrency);
+    for (int v = 0; v < VERDICT_COUNT; v++) {
+        fprintf(stdout, "%-14s %8ld\n", verdictNames[v], verdicts[v]);
+    }
+    fprintf(stdout, "elapsed: %.3f s, %.1f sessions/s, %.2f MiB/s received\n", elapsed,
+            (double) answered / elapsed, (double) received / elapsed / (1024.0 * 1024.0));
+    if (answered > 0) {
+        fprintf(stdout, "latency (us): p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+                (double) latencies[answered / 2] / 1e3, (double) latencies[(answered * 9) / 10] / 1e3,
+                (double) latencies[(answered * 99) / 100] / 1e3, (double) latencies[answered - 1] / 1e3);
+    }
+
+    free(latencies);
+    free(threads);
+    freeaddrinfo(config.address);
+    for (size_t s = 0; s < config.count; s++) {
+        free(config.sessions[s].response);
+    }
+    free(config.sessions);
+    for (int i = 0; i < captureCount; i++) {
+        pcap_free(&captures[i]);
+    }
+    free(captures);
+    return (verdicts[VERDICT_FAILED] == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief loop of a thread: takes the next session, waits for its time and replays it
+ * @param argument void*: the replayThread
+ * @return void*: NULL
+ */
+static void* replayLoop(void* argument) {
+    replayThread* thread = argument;
+    replayConfig* config = thread->config;
+    size_t total = config->count * (size_t) config->rounds;
+    size_t capacity = REPLAY_RECEIVEBUFFER;
+    char* buffer = malloc(capacity);
+    if (buffer == NULL) {
+        return NULL;
+    }
+    while (1) {
+        size_t index = (size_t) atomic_fetch_add(&config->next, 1);
+        if (index >= total) {
+            break;
+        }
+        const replaySession* session = &config->sessions[index % config->count];
+        int64_t round = (int64_t) (index / config->count);
+        int64_t scheduled = now();
+        if (config->speedup > 0) {
+            scheduled = config->start + (int64_t) ((double) (round * config->span + session->offset) /
+                                                   config->speedup);
+            sleepUntil(scheduled);
+        }
+        size_t length = 0;
+        enum replayVerdict verdict = replayOne(thread, session, &buffer, &capacity, &length);
+        if (verdict != VERDICT_FAILED) {
+            thread->latencies[thread->answered++] = (uint64_t) (now() - scheduled);
+        }
+        thread->verdicts[verdict]++;
+        if (config->verbose && (verdict != VERDICT_IDENTICAL)) {
+            fprintf(stdout, "session %zu, client port %u: %s, %zu bytes, captured %zu bytes\n",
+                    index % config->count + 1, session->stream->clientPort, verdictNames[verdict], length,
+                    session->stream->response.length);
+        }
+    }
+    free(buffer);
+    return NULL;
+}
+
+/**
+ * @brief sends the captured request, receives the response and compares it with the captured one
+ * @param thread replayThread*: the thread, received is increased
+ * @param session const replaySession*: the session
+ * @param buffer char**: receive buffer, grown to the response
+ * @param capacity size_t*: size of the buffer
+ * @param length size_t*: receives the length of the response
+ * @return enum replayVerdict: the result of the comparison
+ */
+static enum replayVerdict replayOne(replayThread* thread, const replaySession* session, char** buffer,
+                                   size_t* capacity, size_t* length) {
+    int fd_socket = connectServer(thread->config->address);
+    if (fd_socket == -1) {
+        return VERDICT_FAILED;
+    }
+    const pcapData* request = &session->stream->request;
+    size_t sent = 0;
+    while (sent < request->length) {
+        ssize_t written = send(fd_socket, request->data + sent, request->length - sent, MSG_NOSIGNAL);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            close(fd_socket);
+            return VERDICT_FAILED;
+        }
+        sent += (size_t) written;
+    }
+    shutdown(fd_socket, SHUT_WR);
+    while (1) {
+        if (*length == *capacity) {
+            char* grown = realloc(*buffer, 2 * *capacity);
+            if (grown == NULL) {
+                close(fd_socket);
+                return VERDICT_FAILED;
+            }
+            *buffer = grown;
+            *capacity *= 2;
+        }
+        ssize_t readBytes = read(fd_socket, *buffer + *length, *capacity - *length);
+        if (readBytes == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            close(fd_socket);
+            return VERDICT_FAILED;
+        }
+        if (readBytes == 0) {
+            break;
+        }
+        *length += (size_t) readBytes;
+    }
+    close(fd_socket);
+    thread->received += *length;
+
+    if (session->response == NULL) {
+        return VERDICT_UNCAPTURED;
+    }
+    maskDates(*buffer, *length);
+    if ((*length == session->stream->response.length) && (memcmp(*buffer, session->response, *length) == 0)) {
+        return VERDICT_IDENTICAL;
+    }
+    int status;
+    if (responseShape(*buffer, *length, &status) == session->shape) {
+        return VERDICT_RECORDS;
+    }
+    return ((status != -1) && (status == session->status)) ? VERDICT_STATUS : VERDICT_DIFFERENT;
+}
+
+/**
+ * @brief connects to the first address of the server which accepts the connection
+ * @param address const struct addrinfo*: the resolved addresses
+ * @return int: the connected socket, -1 on failure
+ */
+static int connectServer(const struct addrinfo* address) {
+    for (const struct addrinfo* next = address; next != NULL; next = next->ai_next) {
+        int fd_socket = socket(next->ai_family, next->ai_socktype | SOCK_CLOEXEC, next->ai_protocol);
+        if (fd_socket == -1) {
+            continue;
+        }
+        if (connect(fd_socket, next->ai_addr, next->ai_addrlen) == 0) {
+            return fd_socket;
+        }
+        close(fd_socket);
+    }
+    return -1;
+}
+
+/**
+ * @brief replaces the digits of every date of a post with 0, the dates depend on the time of the replay
+ * @param data char*: the response
+ * @param length size_t: length of the response
+ */
+static void maskDates(char* data, size_t length) {
+    const char* pattern = REPLAY_DATEPATTERN;
+    size_t patternLength = strlen(pattern);
+    for (size_t i = 0; i + patternLength <= length; i++) {
+        size_t j = 0;
+        while ((j < patternLength) &&
+               ((pattern[j] == 'd') ? isdigit((unsigned char) data[i + j]) : (data[i + j] == pattern[j]))) {
+            j++;
+        }
+        if (j < patternLength) {
+            continue;
+        }
+        for (j = 0; j < patternLength; j++) {
+            if (pattern[j] == 'd') {
+                data[i + j] = '0';
+            }
+        }
+        i += patternLength - 1;
+    }
+}
+
+/**
+ * @brief hashes the status and the file names of a response, the contents are skipped
+ * @param data const char*: the response
+ * @param length size_t: length of the response
+ * @param status int*: receives the status of the response, -1 if it is invalid
+ * @return uint64_t: FNV-1a hash, the hash of an invalid response includes the error
+ */
+static uint64_t responseShape(const char* data, size_t length, int* status) {
+    responseParser parser;
+    parser_init(&parser);
+    *status = -1;
+    uint64_t hash = 0xcbf29ce484222325ull;
+    while (1) {
+        parserView view;
+        enum parserEvent event = parser_next(&parser, &data, &length, &view);
+        const char* part = NULL;
+        size_t partLength = 0;
+        char number[16];
+        if (event == PARSER_STATUS) {
+            *status = parser.status;
+            partLength = (size_t) snprintf(number, sizeof(number), "%d", parser.status);
+            part = number;
+        } else if (event == PARSER_FILE) {
+            part = view.data;
+            partLength = view.length;
+        } else if (event == PARSER_ERROR) {
+            part = parser.error;
+            partLength = strlen(parser.error);
+            *status = -1;
+        } else if ((event == PARSER_MORE) || (event == PARSER_END)) {
+            break;
+        }
+        for (size_t i = 0; i < partLength; i++) {
+            hash = (hash ^ (unsigned char) part[i]) * 0x100000001b3ull;
+        }
+        hash = (hash ^ '\n') * 0x100000001b3ull;
+        if (event == PARSER_ERROR) {
+            break;
+        }
+    }
+    return hash;
+}
+
+/**
+ * @brief orders the sessions by their captured start for qsort(), sessions of the same time keep no order
+ * @param a const void*: first replaySession
+ * @param b const void*: second replaySession
+ * @return int: <0, 0 or >0
+ */
+static int compareSessions(const void* a, const void* b) {
+    const replaySession* first = a;
+    const replaySession* second = b;
+    return (first->offset > second->offset) - (first->offset < second->offset);
+}
+
+/**
+ * @brief orders times ascending for qsort()
+ * @param a const void*: first uint64_t
+ * @param b const void*: second uint64_t
+ * @return int: <0, 0 or >0
+ */
+static int compareTimes(const void* a, const void* b) {
+    uint64_t first = *(const uint64_t*) a;
+    uint64_t second = *(const uint64_t*) b;
+    return (first > second) - (first < second);
+}
+
+/**
+ * @brief reads the monotonic clock
+ * @return int64_t: time in ns
+ */
+static int64_t now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (int64_t) time.tv_sec * NSEC_PER_SEC + time.tv_nsec;
+}
+
+/**
+ * @brief sleeps until a time of the monotonic clock
+ * @param time int64_t: the time in ns
+ */
+static void sleepUntil(int64_t time) {
+    struct timespec until;
+    until.tv_sec = (time_t) (time / NSEC_PER_SEC);
+    until.tv_nsec = (long) (time % NSEC_PER_SEC);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR) {
+    }
+}
+
+/**
+ * @brief prints the usage and terminates
+ * @param stream FILE*: the stream to write the usage information to
+ * @param cmnd const char*: name of the executable
+ * @param exitcode int: the exit code
+ */
+static void usage(FILE* stream, const char* cmnd, int exitcode) {
+    fprintf(stream, "usage: %s -s <server> -p <port> [options] <capture>...\n", cmnd);
+    fprintf(stream, "\t-s, --server <host>\t\tserver to replay the sessions against\n");
+    fprintf(stream, "\t-p, --port <port>\t\tport of the server\n");
+    fprintf(stream, "\t-x, --speedup <factor>\t\tdivisor of the captured times, 0 without pauses [default: %.0f]\n",
+            REPLAY_DEFAULTSPEEDUP);
+    fprintf(stream, "\t-c, --concurrency <n>\t\tthreads replaying sessions at the same time [default: %d]\n",
+            REPLAY_DEFAULTCONCURRENCY);
+    fprintf(stream, "\t-n, --rounds <n>\t\ttimes the sessions are replayed [default: %d]\n", REPLAY_DEFAULTROUNDS);
+    fprintf(stream, "\t-v, --verbose\t\t\tprint every session whose response is not identical\n");
+    fprintf(stream, "\t-h, --help\t\t\toutputs this info\n");
+    fprintf(stream, "captures are pcap files or the text output of tcpdump -X\n");
+    exit(exitcode);
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
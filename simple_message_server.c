@@ -15,39 +15,108 @@
 #include <sys/types.h>
 #include <sys/socket.h>     // provides socket
 #include <errno.h>          // provides errno
-#include <arpa/inet.h>      // provides inet_address
 #include <unistd.h>         // provides read(), write(), close()
 #include <wait.h>           // provides waitpid()
 #include <netdb.h>
+#include <getopt.h>         // provides getopt_long()
+#include <signal.h>         // provides sigaction()
+#include "server_prefork.h" // provides prefork_run()
+#include "server_logic.h"   // provides logic_serveConnection()
+#include "server_reactor.h" // provides reactor_run()
+#include "server_threads.h" // provides threads_run()
+#include "server_listen.h"  // provides listen_add(), listen_openSet()
+#include "server_uring.h"   // provides uringserver_run()
+#include "server_cache.h"   // provides cache_setLimit(), cache_report()
+#include "server_admission.h" // provides admission_run()
+#include "server_metrics.h" // provides metrics_init(), metrics_serve()
+#include "trace.h"          // provides trace_open(), TRACE()
+#include "server_spawn.h"   // provides spawn_logic()
 
 // --------------------------------------------------------------- defines --
 /** @brief Line output. note all log notes must be on stderr, because stdout
  * redirected to the socket */
 #define LINEOUTPUT fprintf(stdout, "[%s, %s, %d]: ",  __FILE__, __func__, __LINE__)
 
-/** @brief maximal amount of requests on listening socket */
-#define BACKLOG 5
-/** @brief absolute path to the business logic */
+/** @brief default of the maximal amount of pending connections on a listening socket, the kernel limits it
+ * to net.core.somaxconn */
+#define BACKLOG SOMAXCONN
+/** @brief default path of the business logic, another one is given with --logic-path */
 #define LOGICS_PATH "/usr/local/bin/simple_message_server_logic"
 /** @brief name of the business logic application called in this function */
 #define LOGICS_NAME "simple_message_server_logic"
+/** @brief values of the long options without a short option, outside of the char range */
+#define OPT_MINSPARE 256
+#define OPT_MAXSPARE 257
+#define OPT_MAXWORKERS 258
+#define OPT_BOARD 259
+#define OPT_BACKLOG 260
+#define OPT_CACHESIZE 261
+#define OPT_MAXHANDLERS 262
+#define OPT_MAXPENDING 263
+#define OPT_PENDINGTIMEOUT 264
+#define OPT_MAXPERSOURCE 265
+#define OPT_METRICS 266
+#define OPT_TRACE 267
+#define OPT_LISTEN 268
+#define OPT_LOGICPATH 269
+/** @brief upper limit of --cache-size in KiB */
+#define CACHESIZE_MAX (4 * 1024 * 1024)
+/** @brief size of the submission queue of the io_uring server */
+#define URING_ENTRIES 256
+/** @brief name of the --logic value which executes the external business logic */
+#define LOGIC_EXEC "exec"
 
 
 // -------------------------------------------------------------- typedefs --
 /** @brief Struct holds all needed ressources, both file descriptors */
 typedef struct ressourcesContainer {
-    int fd_socket_listen;        /**< File descriptor for the listening socket */
+    int fd_socket_listen;        /**< File descriptor for the listening socket of the connection */
+    listenSet* listeners;        /**< All listening sockets, NULL in the handlers of the connections */
     int fd_socket_connected;     /**< File descriptor for the connected socket */
     const char* progname;        /**< Progamm name argv[0] */
+    int verbose;                 /**< Output in verbose mode 0 off, 1 on */
+    const logicHandler* logic;   /**< In-process business logic, NULL executes logicPath */
+    const char* logicPath;       /**< Path of the external business logic */
+    int fd_logic;                /**< Pre-opened logicPath, -1 executes it by its path */
 } ressources;
 
+/** @brief Struct holds all options given on the command line */
+typedef struct serverOptions {
+    uint16_t port;               /**< Listening port of the server */
+    const char* listen[LISTEN_MAXSOCKETS]; /**< Addresses given with --listen */
+    int listenCount;             /**< Number of addresses, 0 listens on the dual-stack wildcard */
+    int verbose;                 /**< Output in verbose mode 0 off, 1 on */
+    preforkConfig prefork;       /**< Worker pool, startWorkers 0 runs the spawning server */
+    const logicHandler* logic;   /**< In-process business logic, NULL executes logicPath */
+    const char* logicPath;       /**< Path of the external business logic */
+    int reactorThreads;          /**< Event loop threads, 0 runs without the reactor */
+    int listenerThreads;         /**< Threads with an own SO_REUSEPORT listener, 0 runs without threads */
+    int backlog;                 /**< Maximal amount of pending connections per listening socket */
+    int uring;                   /**< 1 runs the io_uring server, 0 runs without io_uring */
+    admissionConfig admission;   /**< Limits of the handlers of the spawning server */
+    const char* metrics;         /**< Endpoint of the metrics, NULL disables them */
+    const char* trace;           /**< Prefix of the trace files, NULL disables the tracing */
+} serverOptions;
+
+// --------------------------------------------------------------- globals --
+/** @brief environment of the server, passed on to the business logic */
+extern char** environ;
+
 // ------------------------------------------------------------- functions --
 static void errorMessage(char* userMessage, char* errorMessage, ressources serverRessources);
 static void usage(FILE* stream, const char* cmnd, int exitcode);
 static void closeRessources(ressources res);
-static void printAddress(struct sockaddr_in sockaddr);
-static void evaluateParameters(int argc, char* const* argv, u_int16_t* port, int* verbose);
+static void evaluateParameters(int argc, char* const* argv, serverOptions* options);
+static int parseCount(const char* argument, const char* cmnd);
 static void sigchild_handler(int s);
+static void sigusr1_handler(int s);
+static void execBusinessLogic(ressources serverRessources);
+static int serveBusinessLogic(ressources serverRessources);
+static int preforkServeLogic(int fd_listen, int fd_connected, void* context);
+static int handlerServeLogic(int fd_listen, int fd_connected, void* context);
+static void handlerPrepareLogic(void* context);
+static int threadServeLogic(int fd_listen, int fd_connected, void* context);
+static pid_t spawnBusinessLogic(int fd_connected, void* context);
 
 // ------------------------------------------------------------------- main --
 /**
@@ -67,138 +136,179 @@ int main(int argc, char* const* argv) {
     serverRessources.fd_socket_listen = -1; // initialize the file descriptors
     serverRessources.fd_socket_connected = -1;
     serverRessources.progname = argv[0];
+    serverRessources.verbose = 0;
+    serverRessources.logic = NULL;
+    serverRessources.logicPath = LOGICS_PATH;
+    serverRessources.fd_logic = -1;
+    serverRessources.listeners = NULL;
 
-    struct sockaddr_in server_add, client_add;  // Server Socket, Client Socket
+    listenSet listeners;                        // Server Sockets
+    memset(&listeners, 0, sizeof(listeners));
     struct sigaction signalact;
-    uint16_t port = 0;                          // Initialize Port Variable for Parameter check
-    int verbose = 0;
+    serverOptions options;
+    memset(&options, 0, sizeof(options));       // port 0, verbose off, no worker pool, default admission limits
+    options.backlog = BACKLOG;
+    options.logicPath = LOGICS_PATH;
 
-    evaluateParameters(argc, argv, &port, &verbose);
+    evaluateParameters(argc, argv, &options);
+    int verbose = options.verbose;
+    serverRessources.verbose = verbose;
+    serverRessources.logic = options.logic;
+    serverRessources.logicPath = options.logicPath;
+    // the business logic is opened once, every connection executes this binary without a path lookup
+    if ((options.logic == NULL) && ((serverRessources.fd_logic = spawn_openLogic(options.logicPath)) == -1) &&
+        (verbose == 1)) {
+        LINEOUTPUT;
+        fprintf(stdout, "Could not open %s (%s), executing it by its path\n", options.logicPath, strerror(errno));
+    }
+    // the local logic sends files with sendfile(), which has no MSG_NOSIGNAL
+    if (options.logic != NULL) {
+        signal(SIGPIPE, SIG_IGN);
+        // kill -USR1 prints the counters of the response cache
+        struct sigaction reportAction;
+        memset(&reportAction, 0, sizeof(reportAction));
+        reportAction.sa_handler = sigusr1_handler;
+        sigemptyset(&reportAction.sa_mask);
+        reportAction.sa_flags = SA_RESTART;
+        sigaction(SIGUSR1, &reportAction, NULL);
+    }
+    if ((options.trace != NULL) && (trace_open(options.trace) == -1)) {
+        errorMessage("Could not create the trace file: ", strerror(errno), serverRessources);
+    }
+    // the shared counters must exist before the first fork, the thread before the signal handling
+    if (options.metrics != NULL) {
+        if (metrics_init() == -1) {
+            errorMessage("Could not create the metrics: ", strerror(errno), serverRessources);
+        }
+        if (metrics_serve(options.metrics) == -1) {
+            errorMessage("Could not open the metrics endpoint: ", strerror(errno), serverRessources);
+        }
+        if (verbose == 1) {
+            LINEOUTPUT;
+            fprintf(stdout, "Metrics served on %s\n", options.metrics);
+        }
+    }
     //---------------------------------------------------------------------------------------------------
     //------------------------------- create server socket socket for listening -------------------------
     //---------------------------------------------------------------------------------------------------
 
-    serverRessources.fd_socket_listen = socket(AF_INET, SOCK_STREAM, 0);
-    if (serverRessources.fd_socket_listen < 0) {
-        errorMessage("Could not create a socket: ", strerror(errno), serverRessources);
+    // the addresses without a port of their own get the port of -p, without --listen the dual-stack wildcard
+    if (options.listenCount == 0) {
+        options.listen[options.listenCount++] = LISTEN_WILDCARD;
     }
-
-    // initialize struct with 0
-    memset(&server_add, 0, sizeof(server_add));
-    server_add.sin_family = AF_INET;
-    server_add.sin_port = htons(port);
-    /* Convert Internet host address from numbers-and-dots notation in CP
-   into binary data in network byte order.  */
-    server_add.sin_addr.s_addr = htonl(INADDR_ANY);
-
-    // Set socket options to reuse address
-    int retval;
-    int optval = 1;     // set reuse adress to 1;
-    retval = setsockopt(serverRessources.fd_socket_listen, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
-    if (retval == -1) {
-        errorMessage("Reuse address failed", strerror(errno), serverRessources);
+    for (int i = 0; i < options.listenCount; i++) {
+        if (listen_add(&listeners, options.listen[i], options.port) == -1) {
+            fprintf(stderr, "%s: invalid listen address %s\n", argv[0], options.listen[i]);
+            usage(stderr, argv[0], 1);
+        }
     }
 
     //---------------------------------------------------------------------------------------------------
-    //---------------------------- bind server to socket  -----------------------------------------------
+    //---------------------------- bind server to socket and listen -------------------------------------
     //---------------------------------------------------------------------------------------------------
-    if (bind(serverRessources.fd_socket_listen, (struct sockaddr*) &server_add, sizeof(server_add)) < 0) {
-        errorMessage("Could not bind to socket: ", strerror(errno), serverRessources);
-    }
-    fprintf(stdout, "Server Socket:%d created.\n",
-            ntohs(server_add.sin_port));
-    // LISTEN()
-    if (listen(serverRessources.fd_socket_listen, BACKLOG) < 0) {
-        errorMessage("Could not listen to socket: ", strerror(errno), serverRessources);
+    // every listener thread binds its own sockets to the ports, this needs SO_REUSEPORT
+    serverRessources.listeners = &listeners;
+    if (listen_openSet(&listeners, options.backlog, options.listenerThreads > 0) == -1) {
+        int save_errno = errno;
+        char address[LISTEN_MAXTEXT] = "";
+        char message[LISTEN_MAXTEXT + 64];
+        for (int i = 0; (i < listeners.count) && (address[0] == '\0'); i++) {
+            if (listeners.fds[i] == -1) {
+                listen_format(&listeners.addresses[i], address, sizeof(address));
+            }
+        }
+        snprintf(message, sizeof(message), "Could not open the listening socket %s:", address);
+        errorMessage(message, strerror(save_errno), serverRessources);
     }
+    fprintf(stdout, "Server Socket:%d created.\n", options.port);
     if (verbose == 1) {
-        LINEOUTPUT;
-        fprintf(stdout, "Server listen on: ");
-        printAddress(server_add);
+        char address[LISTEN_MAXTEXT];
+        for (int i = 0; i < listeners.count; i++) {
+            listen_format(&listeners.addresses[i], address, sizeof(address));
+            LINEOUTPUT;
+            fprintf(stdout, "Server listen on: %s\n", address);
+        }
         fprintf(stdout, "Server listening. Waiting ...\n");
     }
-    // add the child handler to the address struct
-    signalact.sa_handler = sigchild_handler;        // let the child action be handled by function
-    sigemptyset(&signalact.sa_mask);
-    signalact.sa_flags = SA_RESTART;
-    if (sigaction(SIGCHLD, &signalact, NULL) == -1) {
-        errorMessage("Error in Child signal process", strerror(errno), serverRessources);
-    }
-    // Endless loop, Server must be killed manually
-    socklen_t len_client = sizeof(client_add);
 
     //---------------------------------------------------------------------------------------------------
-    //----------------------- start the spawning server routine, main loop ------------------------------
+    //----------------------- io_uring server, the reactor is the fallback without io_uring -------------
     //---------------------------------------------------------------------------------------------------
-    while (1) {
-        serverRessources.fd_socket_connected = accept(serverRessources.fd_socket_listen, (struct sockaddr*) &client_add,
-                                                      &len_client);
-        if (serverRessources.fd_socket_connected < 0) {
-            errorMessage("Could not accept socket: ", strerror(errno), serverRessources);
-        }
+    if (options.uring == 1) {
+        uringServerConfig ring = {URING_ENTRIES, options.logic, verbose};
+        uringserver_run(&listeners, &ring);
         if (verbose == 1) {
             LINEOUTPUT;
-            fprintf(stdout, "Got connection from: ");
-            printAddress(client_add);
-        }
-        // Forking a new process
-        int fork_return = fork();
-        // ------ ERROR CASE --------
-        if (fork_return == -1) {
-            // child process routine
-            // Close the listening socket
-            errorMessage("fork failed!", strerror(errno), serverRessources);
+            fprintf(stdout, "io_uring not available (%s), using the reactor\n", strerror(errno));
         }
-            // ------- CHILD PART --------
-        else if (fork_return == 0) {
-            // Child process
-            // Redirect the STDIN to the socket
-            if (verbose == 1) {
-                LINEOUTPUT;
-                fprintf(stdout, "Child process, forking done\n");   // prints must be done to stderr,
-            }
-            if (serverRessources.fd_socket_connected != STDIN_FILENO) {
-                int statusDupRead = dup2(serverRessources.fd_socket_connected, STDIN_FILENO);
-                if (statusDupRead == -1) {
-                    errorMessage("Could not redirect the read socket", strerror(errno), serverRessources);
-                }
-            }
-
-            // Redirect the STDOUT to the socket
-            if (serverRessources.fd_socket_connected != STDOUT_FILENO) {
-                int statusDupWrite = dup2(serverRessources.fd_socket_connected, STDOUT_FILENO);
-                if (statusDupWrite == -1) {
-                    errorMessage("Could not redirect the write socket", strerror(errno), serverRessources);
-                }
-            }
+        options.reactorThreads = 1;
+    }
 
-            // close listen connection in the child process
-            if (close(serverRessources.fd_socket_listen) != 0) {
-                errorMessage("Cloud not close the listen socket in child process", strerror(errno), serverRessources);
-            }
-            serverRessources.fd_socket_listen = -1;
-
-            // *** Do the exec here ***
-            close(serverRessources.fd_socket_connected);
-            int status = execl(LOGICS_PATH, LOGICS_NAME, NULL);
-            if (status == -1) {
-                errorMessage("Could not execute business logic", "error in execl", serverRessources);
-                exit(EXIT_FAILURE);
-            }
+    //---------------------------------------------------------------------------------------------------
+    //----------------------- event driven reactor, connections multiplexed on few threads --------------
+    //---------------------------------------------------------------------------------------------------
+    if (options.reactorThreads > 0) {
+        reactorConfig reactor = {options.reactorThreads, options.logic, verbose};
+        if (verbose == 1) {
+            LINEOUTPUT;
+            fprintf(stdout, "Reactor with %d event loop threads\n", reactor.threads);
+        }
+        reactor_run(&listeners, &reactor);
+        errorMessage("Could not run the reactor: ", strerror(errno), serverRessources);
+    }
 
+    //---------------------------------------------------------------------------------------------------
+    //----------------------- pre-forked worker pool, workers accept themselves -------------------------
+    //---------------------------------------------------------------------------------------------------
+    if (options.prefork.startWorkers > 0) {
+        if (verbose == 1) {
+            LINEOUTPUT;
+            fprintf(stdout, "Prefork %d workers, spare %d..%d, max %d\n", options.prefork.startWorkers,
+                    options.prefork.minSpare, options.prefork.maxSpare, options.prefork.maxWorkers);
         }
-            // ------- PARENT PROCESS --------
-        else {
-            // Parent Process
-            // Close the connected socket in the parent process
-            if (verbose == 1) {
-                LINEOUTPUT;
-                fprintf(stdout, "Parent process, close the connected socket\n");
-            }
-            close(serverRessources.fd_socket_connected);
-            continue;   // next iteration
+        if (prefork_run(&listeners, &options.prefork, preforkServeLogic, &serverRessources,
+                        verbose) == -1) {
+            errorMessage("Could not run the worker pool: ", strerror(errno), serverRessources);
         }
+        closeRessources(serverRessources);
+        return 0;
+    }
+    // add the child handler to the address struct
+    signalact.sa_handler = sigchild_handler;        // let the child action be handled by function
+    sigemptyset(&signalact.sa_mask);
+    signalact.sa_flags = SA_RESTART;
+    if (sigaction(SIGCHLD, &signalact, NULL) == -1) {
+        errorMessage("Error in Child signal process", strerror(errno), serverRessources);
+    }
+
+    //---------------------------------------------------------------------------------------------------
+    //----------------------- listener threads, one SO_REUSEPORT socket per core ------------------------
+    //---------------------------------------------------------------------------------------------------
+    if (options.listenerThreads > 0) {
+        threadsConfig threads;
+        memset(&threads, 0, sizeof(threads));
+        threads.threads = options.listenerThreads;
+        threads.backlog = options.backlog;
+        threads.serve = threadServeLogic;
+        threads.context = &serverRessources;
+        threads.verbose = verbose;
+        threads_run(&listeners, &threads);
+        errorMessage("Could not run the listener threads: ", strerror(errno), serverRessources);
+    }
+    //---------------------------------------------------------------------------------------------------
+    //----------------------- start the spawning server routine, a handler per connection ---------------
+    //---------------------------------------------------------------------------------------------------
+    if (verbose == 1) {
+        LINEOUTPUT;
+        fprintf(stdout, "At most %d handlers, %d waiting connections for %d ms, %d per source\n",
+                options.admission.maxHandlers, options.admission.maxPending, options.admission.pendingTimeout,
+                options.admission.maxPerSource);
     }
+    // the handlers serve like the pre-forked workers, but exit after their connection. The external logic
+    // is spawned, without the copy of the page tables of the server by fork()
+    admission_run(&listeners, &options.admission, handlerServeLogic,
+                  (options.logic == NULL) ? spawnBusinessLogic : NULL, handlerPrepareLogic, &serverRessources);
+    errorMessage("Could not accept socket: ", strerror(errno), serverRessources);
     return 0;
 }
 
@@ -214,41 +324,340 @@ static void sigchild_handler(int s) {
     fprintf(stdout, "signal: %d", s);
 }
 
+/**
+ * @brief signal handler of SIGUSR1, prints the counters of the response cache to stderr
+ * @param s int: signal
+ */
+static void sigusr1_handler(int s) {
+    (void) s;
+    int save_errno = errno;
+    cache_report(STDERR_FILENO);
+    errno = save_errno;
+}
+
+/**
+ * @brief Child part of the spawning server. Redirects stdin and stdout to the connected socket and
+ * executes the business logic, does not return.
+ * @param serverRessources ressources: struct containing the listening and the connected socket
+ */
+static void execBusinessLogic(ressources serverRessources) {
+    // stdout becomes the socket, the child traces instead of printing
+    TRACE(TRACE_EXEC, (uint64_t) serverRessources.fd_socket_connected, 0);
+    if (serverRessources.fd_socket_connected != STDIN_FILENO) {
+        int statusDupRead = dup2(serverRessources.fd_socket_connected, STDIN_FILENO);
+        if (statusDupRead == -1) {
+            errorMessage("Could not redirect the read socket", strerror(errno), serverRessources);
+        }
+    }
+
+    // Redirect the STDOUT to the socket
+    if (serverRessources.fd_socket_connected != STDOUT_FILENO) {
+        int statusDupWrite = dup2(serverRessources.fd_socket_connected, STDOUT_FILENO);
+        if (statusDupWrite == -1) {
+            errorMessage("Could not redirect the write socket", strerror(errno), serverRessources);
+        }
+    }
+
+    // close listen connection in the child process, a handler of one connection closed all of them before
+    if ((serverRessources.fd_socket_listen != -1) && (close(serverRessources.fd_socket_listen) != 0)) {
+        errorMessage("Cloud not close the listen socket in child process", strerror(errno), serverRessources);
+    }
+    serverRessources.fd_socket_listen = -1;
+
+    // the signal mask survives the exec, the business logic must start without blocked signals
+    sigset_t noSignals;
+    sigemptyset(&noSignals);
+    sigprocmask(SIG_SETMASK, &noSignals, NULL);
+
+    // *** Do the exec here ***
+    close(serverRessources.fd_socket_connected);
+    serverRessources.fd_socket_connected = -1;
+    trace_flush();      // the exec discards the rings
+    if (serverRessources.fd_logic != -1) {
+        char* const logicArguments[] = {LOGICS_NAME, NULL};
+        fexecve(serverRessources.fd_logic, logicArguments, environ);
+    }
+    int status = execl(serverRessources.logicPath, LOGICS_NAME, NULL);
+    if (status == -1) {
+        errorMessage("Could not execute business logic", "error in execl", serverRessources);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Serves the connected socket with the in-process business logic and closes it.
+ * Errors only concern this connection, they are reported but do not terminate the server.
+ * @param serverRessources ressources: struct containing the connected socket and the logic
+ * @return int: 0 in case of success, -1 on failure
+ */
+static int serveBusinessLogic(ressources serverRessources) {
+    int status = logic_serveConnection(serverRessources.logic, serverRessources.fd_socket_connected);
+    if (status == -1) {
+        fprintf(stderr, "%s: Could not serve the connection: %s\n", serverRessources.progname, strerror(errno));
+        TRACE(TRACE_ERROR, (uint64_t) errno, 0);
+    }
+    TRACE(TRACE_CLOSE, (uint64_t) serverRessources.fd_socket_connected, 0);
+    close(serverRessources.fd_socket_connected);
+    return status;
+}
+
+/**
+ * @brief Connection handler of the pre-forked workers. With the in-process business logic the worker
+ * serves the connection and waits for the next one. Otherwise the worker itself becomes the business
+ * logic and is used up: the pool forks a replacement for every connection, only the fork is moved out of
+ * the accept path, the fork and exec per connection remain. The pool pays off with --logic local only.
+ * @param fd_listen int: listening socket
+ * @param fd_connected int: accepted connection
+ * @param context void*: ressources of the server
+ * @return int: 0, the worker stays alive
+ */
+static int preforkServeLogic(int fd_listen, int fd_connected, void* context) {
+    ressources workerRessources = *(ressources*) context;
+    workerRessources.listeners = NULL;  // the sockets belong to the server, a worker must not remove them
+    workerRessources.fd_socket_listen = fd_listen;
+    workerRessources.fd_socket_connected = fd_connected;
+    if (workerRessources.logic != NULL) {
+        serveBusinessLogic(workerRessources);
+        return 0;
+    }
+    execBusinessLogic(workerRessources);
+    return -1;
+}
+
+/**
+ * @brief Connection handler of the forked handlers of the spawning server, one per connection. The admission
+ * control closed all listening sockets before: a handler which outlives the server must neither keep the
+ * ports bound nor collect connections in a backlog nobody accepts from.
+ * @param fd_listen int: -1, no listening socket is open
+ * @param fd_connected int: accepted connection
+ * @param context void*: ressources of the server
+ * @return int: 0 in case of success, -1 on failure
+ */
+static int handlerServeLogic(int fd_listen, int fd_connected, void* context) {
+    ressources handlerRessources = *(ressources*) context;
+    handlerRessources.listeners = NULL;
+    handlerRessources.fd_socket_listen = fd_listen;
+    handlerRessources.fd_socket_connected = fd_connected;
+    if (handlerRessources.logic != NULL) {
+        return serveBusinessLogic(handlerRessources);
+    }
+    execBusinessLogic(handlerRessources);
+    return -1;
+}
+
+/**
+ * @brief Prepares the in-process business logic in the server before a handler is forked, e.g. the local
+ * logic renders the rows of the new messages once instead of in every handler
+ * @param context void*: ressources of the server
+ */
+static void handlerPrepareLogic(void* context) {
+    const ressources* serverRessources = context;
+    if ((serverRessources->logic != NULL) && (serverRessources->logic->prepare != NULL)) {
+        serverRessources->logic->prepare();
+    }
+}
+
+/**
+ * @brief Connection handler of the listener threads. The in-process business logic is run in the
+ * accepting thread, the external business logic is spawned.
+ * @param fd_listen int: listening socket of the thread
+ * @param fd_connected int: accepted connection
+ * @param context void*: ressources of the server
+ * @return int: 0, the thread continues accepting
+ */
+static int threadServeLogic(int fd_listen, int fd_connected, void* context) {
+    ressources threadRessources = *(ressources*) context;
+    threadRessources.listeners = NULL;
+    threadRessources.fd_socket_listen = fd_listen;
+    threadRessources.fd_socket_connected = fd_connected;
+    if (threadRessources.logic != NULL) {
+        serveBusinessLogic(threadRessources);
+        return 0;
+    }
+    uint64_t forking = metrics_now();
+    pid_t pid = spawnBusinessLogic(fd_connected, &threadRessources);
+    if (pid == -1) {
+        // only this connection is lost, the other threads keep on serving
+        fprintf(stderr, "%s: Could not start the business logic! %s\n", threadRessources.progname, strerror(errno));
+    } else {
+        metrics_observe(METRICS_SPAWN, metrics_now() - forking);
+        TRACE(TRACE_SPAWN, (uint64_t) pid, 0);
+    }
+    close(fd_connected);
+    return 0;
+}
+
+/**
+ * @brief Starts the external business logic on a connection with posix_spawn(), the connection becomes
+ * stdin and stdout of the logic. The server keeps fd_connected and closes it.
+ * @param fd_connected int: accepted connection
+ * @param context void*: ressources of the server
+ * @return pid_t: process of the business logic, -1 on failure (errno is set)
+ */
+static pid_t spawnBusinessLogic(int fd_connected, void* context) {
+    const ressources* serverRessources = context;
+    return spawn_logic(serverRessources->fd_logic, serverRessources->logicPath, LOGICS_NAME, fd_connected);
+}
+
 /**
  * @brief Parameter check for the Server function.
  * @param argc int_ Number of incoming parameters
  * @param argv char*: Pointerarray containing all parametres
- * @param port u_int16_t: listening port of the server
+ * @param options serverOptions*: struct receiving the options
  */
-static void evaluateParameters(int argc, char* const* argv, u_int16_t* port, int* verbose) {
+static void evaluateParameters(int argc, char* const* argv, serverOptions* options) {
     int opt;
     char* endpointer = NULL;
     int tempPort = 0;
+    long cacheSize = 0;
+    static const struct option longOptions[] = {
+            {"port",        required_argument, NULL, 'p'},
+            {"help",        no_argument,       NULL, 'h'},
+            {"verbose",     no_argument,       NULL, 'v'},
+            {"prefork",     required_argument, NULL, 'P'},
+            {"min-spare",   required_argument, NULL, OPT_MINSPARE},
+            {"max-spare",   required_argument, NULL, OPT_MAXSPARE},
+            {"max-workers", required_argument, NULL, OPT_MAXWORKERS},
+            {"logic",       required_argument, NULL, 'l'},
+            {"board",       required_argument, NULL, OPT_BOARD},
+            {"reactor",     required_argument, NULL, 'r'},
+            {"threads",     required_argument, NULL, 't'},
+            {"backlog",     required_argument, NULL, OPT_BACKLOG},
+            {"cache-size",  required_argument, NULL, OPT_CACHESIZE},
+            {"uring",       no_argument,       NULL, 'U'},
+            {"max-handlers", required_argument, NULL, OPT_MAXHANDLERS},
+            {"max-pending", required_argument, NULL, OPT_MAXPENDING},
+            {"pending-timeout", required_argument, NULL, OPT_PENDINGTIMEOUT},
+            {"max-per-source", required_argument, NULL, OPT_MAXPERSOURCE},
+            {"metrics",     required_argument, NULL, OPT_METRICS},
+            {"trace",       required_argument, NULL, OPT_TRACE},
+            {"listen",      required_argument, NULL, OPT_LISTEN},
+            {"logic-path",  required_argument, NULL, OPT_LOGICPATH},
+            {NULL, 0,                          NULL, 0}
+    };
     /* check the parameters from command line */
     // check if any parameter are given
     if (argc < 2) {
         usage(stderr, argv[0], 1);
     }
-    while ((opt = getopt(argc, argv, "hvp:")) != -1) {
+    while ((opt = getopt_long(argc, argv, "hvp:P:l:r:t:U", longOptions, NULL)) != -1) {
         switch (opt) {
             case 'p':
                 tempPort = (int) strtol(optarg, &endpointer, 10);
                 if ((*endpointer != 0) || (tempPort < 0 || tempPort > 65535)) {
                     usage(stderr, "wrong port range", 1);
                 }
-                *port = (uint16_t) tempPort;       // check passed
+                options->port = (uint16_t) tempPort;       // check passed
                 break;
             case 'h':
                 usage(stdout, argv[0], 0);
                 break;
             case 'v':
-                *verbose = 1;
+                options->verbose = 1;
+                break;
+            case 'P':
+                options->prefork.startWorkers = parseCount(optarg, argv[0]);
+                break;
+            case OPT_MINSPARE:
+                options->prefork.minSpare = parseCount(optarg, argv[0]);
+                break;
+            case OPT_MAXSPARE:
+                options->prefork.maxSpare = parseCount(optarg, argv[0]);
+                break;
+            case OPT_MAXWORKERS:
+                options->prefork.maxWorkers = parseCount(optarg, argv[0]);
+                break;
+            case 'l':
+                if (strcmp(optarg, LOGIC_EXEC) == 0) {
+                    options->logic = NULL;
+                } else if ((options->logic = logic_find(optarg)) == NULL) {
+                    usage(stderr, argv[0], 1);
+                }
+                break;
+            case OPT_BOARD:
+                logic_setBoardPath(optarg);
+                break;
+            case OPT_LOGICPATH:
+                options->logicPath = optarg;
+                break;
+            case 'r':
+                options->reactorThreads = parseCount(optarg, argv[0]);
+                break;
+            case 't':
+                options->listenerThreads = parseCount(optarg, argv[0]);
+                break;
+            case OPT_BACKLOG:
+                options->backlog = parseCount(optarg, argv[0]);
+                break;
+            case OPT_CACHESIZE:
+                cacheSize = strtol(optarg, &endpointer, 10);
+                if ((*endpointer != 0) || (cacheSize < 0) || (cacheSize > CACHESIZE_MAX)) {
+                    usage(stderr, argv[0], 1);
+                }
+                cache_setLimit((size_t) cacheSize * 1024);
+                break;
+            case 'U':
+                options->uring = 1;
+                break;
+            case OPT_MAXHANDLERS:
+                options->admission.maxHandlers = parseCount(optarg, argv[0]);
+                break;
+            case OPT_MAXPENDING:
+                options->admission.maxPending = parseCount(optarg, argv[0]);
+                break;
+            case OPT_PENDINGTIMEOUT:
+                options->admission.pendingTimeout = parseCount(optarg, argv[0]);
+                break;
+            case OPT_MAXPERSOURCE:
+                options->admission.maxPerSource = parseCount(optarg, argv[0]);
+                break;
+            case OPT_METRICS:
+                options->metrics = optarg;
+                break;
+            case OPT_TRACE:
+                options->trace = optarg;
+                break;
+            case OPT_LISTEN:
+                if (options->listenCount == LISTEN_MAXSOCKETS) {
+                    usage(stderr, argv[0], 1);
+                }
+                options->listen[options->listenCount++] = optarg;
                 break;
             default:
                 usage(stderr, argv[0], 1);
                 break;
         }
     }
+    if (((options->reactorThreads > 0) || (options->uring == 1)) && (options->logic == NULL)) {
+        fprintf(stderr, "%s: --reactor and --uring need an in-process logic (--logic local)\n", argv[0]);
+        usage(stderr, argv[0], 1);
+    }
+    if ((options->reactorThreads > 0) + (options->prefork.startWorkers > 0) + (options->listenerThreads > 0) +
+        options->uring > 1) {
+        fprintf(stderr, "%s: only one of --reactor, --prefork, --threads and --uring can be used\n", argv[0]);
+        usage(stderr, argv[0], 1);
+    }
+    if ((options->prefork.startWorkers > 0) && (prefork_configure(&options->prefork) == -1)) {
+        fprintf(stderr, "%s: inconsistent worker limits, need 1 <= min-spare <= max-spare <= max-workers\n",
+                argv[0]);
+        usage(stderr, argv[0], 1);
+    }
+    admission_configure(&options->admission);
+}
+
+/**
+ * @brief parses a positive count from a command line argument, terminates with the usage on failure
+ * @param argument const char*: the argument
+ * @param cmnd const char*: name of the program for the usage
+ * @return int: the count [1..65535]
+ */
+static int parseCount(const char* argument, const char* cmnd) {
+    char* endpointer = NULL;
+    long count = strtol(argument, &endpointer, 10);
+    if ((*endpointer != 0) || (count < 1) || (count > 65535)) {
+        usage(stderr, cmnd, 1);
+    }
+    return (int) count;
 }
 
 /**
@@ -276,6 +685,9 @@ static void closeRessources(ressources res) {
         (void) close(res.fd_socket_listen); // close listen socket
         res.fd_socket_listen = -1;      // set to initialize value
     }
+    if (res.listeners != NULL) {
+        listen_closeSet(res.listeners); // close all listen sockets, remove the unix sockets
+    }
 }
 
 /**
@@ -290,21 +702,37 @@ static void closeRessources(ressources res) {
 static void usage(FILE* stream, const char* cmnd, int exitcode) {
     fprintf(stream, "usage: %s option\n", cmnd);
     fprintf(stream, "\t-p <port> \t well-known port of the server [0..65535]\n");
+    fprintf(stream, "\t--listen <address>\t listen on <host>[:port], [<IPv6>][:port] or %s<path>, repeatable up to %d\n"
+                    "\t\t\t [default: [::]:port, IPv4 and IPv6]\n", LISTEN_UNIXPREFIX, LISTEN_MAXSOCKETS);
     fprintf(stream, "\t-h \t\t outputs this info\n");
     fprintf(stream, "\t-v\t\t verbose output \n");
+    fprintf(stream, "\t-P, --prefork <n>\t start a pool of n pre-forked workers, they are reused with --logic local\n"
+                    "\t\t\t only, with --logic exec every worker becomes the logic of one connection\n");
+    fprintf(stream, "\t--min-spare <n>\t minimum of idle workers [default: n of --prefork]\n");
+    fprintf(stream, "\t--max-spare <n>\t maximum of idle workers [default: 2 * min-spare]\n");
+    fprintf(stream, "\t--max-workers <n>\t maximum of workers at all [default: 16 * n of --prefork]\n");
+    fprintf(stream, "\t-l, --logic <name>\t business logic: exec (the binary of --logic-path) or local [default: exec]\n");
+    fprintf(stream, "\t--logic-path <binary>\t business logic executed by --logic exec, e.g. the in-tree\n"
+                    "\t\t\t ./simple_message_server_logic [default: %s]\n", LOGICS_PATH);
+    fprintf(stream, "\t--board <file>\t bulletin board file of the local logic\n");
+    fprintf(stream, "\t-r, --reactor <n>\t event driven server with n epoll threads, needs --logic local\n");
+    fprintf(stream, "\t-t, --threads <n>\t n threads with own SO_REUSEPORT listener, pinned to one core each\n");
+    fprintf(stream, "\t--backlog <n>\t pending connections per listening socket [default: %d]\n", BACKLOG);
+    fprintf(stream, "\t--cache-size <KiB>\t memory of the response cache of the local logic, 0 disables it [default: %d]\n",
+            CACHE_DEFAULTLIMIT / 1024);
+    fprintf(stream, "\t-U, --uring\t io_uring server, needs --logic local, falls back to --reactor 1\n");
+    fprintf(stream, "\t--max-handlers <n>\t handlers of the spawning server at the same time [default: %d]\n",
+            ADMISSION_MAXHANDLERS);
+    fprintf(stream, "\t--max-pending <n>\t connections waiting for a handler, more are rejected [default: %d]\n",
+            ADMISSION_MAXPENDING);
+    fprintf(stream, "\t--pending-timeout <ms>\t time a connection may wait for a handler [default: %d]\n",
+            ADMISSION_PENDINGTIMEOUT);
+    fprintf(stream, "\t--max-per-source <n>\t handlers and waiting connections per client address [default: no limit]\n");
+    fprintf(stream, "\t--metrics <port|%s<path>>\t serve Prometheus metrics on 127.0.0.1:port or a unix socket\n",
+            METRICS_UNIXPREFIX);
+    fprintf(stream, "\t--trace <prefix>\t binary trace of every process to <prefix>.<pid>, see simple_message_trace\n");
     exit(exitcode);
 }
-
-/**
- * @brief print the socket address and port to stdout
- * @param sockaddr sockaddr_in: given socket addres
- */
-static void printAddress(struct sockaddr_in sockaddr) {
-    char address_ip4[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &sockaddr.sin_addr, address_ip4, INET_ADDRSTRLEN);
-    fprintf(stdout, "%s:%d\n", address_ip4, ntohs(sockaddr.sin_port));
-
-}
 // =================================================================== eof ==
 
 // Local Variables:
@@ -0,0 +1,83 @@
+/**
+ * @file simple_message_server_logic.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 21.12.18
+ *
+ * @brief Reference implementation of the external business logic, the in-tree stand-in for
+ * /usr/local/bin/simple_message_server_logic. The spawning server starts it with the connection as stdin and
+ * stdout (--logic exec --logic-path <this binary>). It reads the request until the end of file and answers with
+ * the status=, file= and len= records of the captured sessions, the local handler of server_logic.c builds
+ * them. So every server mode can run and be compared without the binary of the lecture.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#include <stdlib.h>         // provides exit()
+#include <stdio.h>          // provides the printf()
+#include <string.h>         // provide strerror()
+#include <errno.h>          // provides errno
+#include <signal.h>         // provides signal()
+#include <unistd.h>         // provides getopt(), STDIN_FILENO
+#include "server_logic.h"   // provides logic_find(), logic_serveStreams()
+#include "server_cache.h"   // provides cache_setLimit()
+
+// --------------------------------------------------------------- defines --
+/** @brief the in-process handler which builds the responses */
+#define LOGIC_HANDLER "local"
+
+// ------------------------------------------------------------- functions --
+static void usage(FILE* stream, const char* cmnd, int exitcode);
+
+// ------------------------------------------------------------------- main --
+/**
+ * @brief answers the request on stdin on stdout
+ * @param argc int: number of arguments
+ * @param argv char**: the arguments, the server passes none
+ * @return int: EXIT_SUCCESS, EXIT_FAILURE if the request could not be answered
+ */
+int main(int argc, char** argv) {
+    int option;
+    while ((option = getopt(argc, argv, "b:h")) != -1) {
+        switch (option) {
+            case 'b':
+                logic_setBoardPath(optarg);
+                break;
+            case 'h':
+                usage(stdout, argv[0], EXIT_SUCCESS);
+                break;
+            default:
+                usage(stderr, argv[0], EXIT_FAILURE);
+        }
+    }
+    // one request per process, a cached response would never be used again
+    cache_setLimit(0);
+    // a client which closed early is reported by the write, not by the signal
+    signal(SIGPIPE, SIG_IGN);
+    if (logic_serveStreams(logic_find(LOGIC_HANDLER), STDIN_FILENO, STDOUT_FILENO) == -1) {
+        fprintf(stderr, "%s: could not answer the request: %s\n", argv[0], strerror(errno));
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief prints the usage and terminates
+ * @param stream FILE*: the stream to write the usage information to
+ * @param cmnd const char*: name of the executable
+ * @param exitcode int: the exit code
+ */
+static void usage(FILE* stream, const char* cmnd, int exitcode) {
+    fprintf(stream, "usage: %s [-b <board>] < request > response\n", cmnd);
+    fprintf(stream, "\t-b <board>\t bulletin board file [default: simple_message_board.txt]\n");
+    fprintf(stream, "\t-h\t\t outputs this info\n");
+    exit(exitcode);
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
@@ -0,0 +1,166 @@
+/**
+ * @file simple_message_trace.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 20.12.18
+ *
+ * @brief Decoder of the trace files written with --trace. Reads the files of all processes, merges the events
+ * by time and prints one line per event: the seconds since the first event, process, thread, connection, type
+ * and the values. A connection is numbered per process, the processes of a spawning server inherit the number
+ * of the parent.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#include <stdlib.h>         // provides malloc(), realloc(), qsort()
+#include <stdio.h>          // provides the printf(), fopen()
+#include <string.h>         // provide strerror(), memcmp()
+#include <errno.h>          // provides errno
+#include <stdint.h>         // provides uint64_t
+#include <unistd.h>         // provides getopt()
+#include "trace.h"
+
+// -------------------------------------------------------------- typedefs --
+/** @brief An event and the process which traced it */
+typedef struct decodedEvent {
+    traceEvent event;           /**< The event */
+    uint32_t pid;               /**< Process from the header of the file */
+} decodedEvent;
+
+/** @brief All events read so far */
+typedef struct decodedEvents {
+    decodedEvent* events;       /**< The events */
+    size_t count;               /**< Number of events */
+    size_t capacity;            /**< Allocated events */
+} decodedEvents;
+
+// ------------------------------------------------------------- functions --
+static int readFile(const char* path, decodedEvents* all);
+static int compareEvents(const void* a, const void* b);
+static void usage(FILE* stream, const char* cmnd, int exitcode);
+
+// ------------------------------------------------------------------- main --
+/**
+ * @brief reads the trace files given as arguments and prints the merged events
+ * @param argc int: number of arguments
+ * @param argv char**: the arguments
+ * @return int: EXIT_SUCCESS, EXIT_FAILURE if a file could not be read
+ */
+int main(int argc, char** argv) {
+    long connection = -1;
+    int option;
+    while ((option = getopt(argc, argv, "c:h")) != -1) {
+        switch (option) {
+            case 'c':
+                connection = strtol(optarg, NULL, 10);
+                break;
+            case 'h':
+                usage(stdout, argv[0], EXIT_SUCCESS);
+                break;
+            default:
+                usage(stderr, argv[0], EXIT_FAILURE);
+        }
+    }
+    if (optind == argc) {
+        usage(stderr, argv[0], EXIT_FAILURE);
+    }
+    decodedEvents all = {NULL, 0, 0};
+    for (int i = optind; i < argc; i++) {
+        if (readFile(argv[i], &all) == -1) {
+            fprintf(stderr, "%s: could not read %s: %s\n", argv[0], argv[i], strerror(errno));
+            free(all.events);
+            return EXIT_FAILURE;
+        }
+    }
+    qsort(all.events, all.count, sizeof(decodedEvent), compareEvents);
+    uint64_t start = (all.count > 0) ? all.events[0].event.time : 0;
+    for (size_t i = 0; i < all.count; i++) {
+        const traceEvent* event = &all.events[i].event;
+        if ((connection != -1) && (event->connection != (uint32_t) connection)) {
+            continue;
+        }
+        fprintf(stdout, "%14.9f pid %6u tid %6u conn %6u %-8s value %llu extra %u\n",
+                (double) (event->time - start) / 1e9, all.events[i].pid, event->thread, event->connection,
+                trace_name(event->type), (unsigned long long) event->value, event->extra);
+    }
+    free(all.events);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief appends the events of a trace file, a truncated last event is ignored
+ * @param path const char*: the trace file
+ * @param all decodedEvents*: receives the events
+ * @return int: 0 in case of success, -1 if the file could not be read or is no trace file (errno is set)
+ */
+static int readFile(const char* path, decodedEvents* all) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+    traceHeader header;
+    if ((fread(&header, sizeof(header), 1, file) != 1) ||
+        (memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0) ||
+        (header.eventSize != sizeof(traceEvent))) {
+        fclose(file);
+        errno = EINVAL;
+        return -1;
+    }
+    traceEvent event;
+    while (fread(&event, sizeof(event), 1, file) == 1) {
+        if (all->count == all->capacity) {
+            size_t capacity = (all->capacity == 0) ? 4096 : 2 * all->capacity;
+            decodedEvent* events = realloc(all->events, capacity * sizeof(decodedEvent));
+            if (events == NULL) {
+                fclose(file);
+                return -1;
+            }
+            all->events = events;
+            all->capacity = capacity;
+        }
+        all->events[all->count].event = event;
+        all->events[all->count].pid = header.pid;
+        all->count++;
+    }
+    fclose(file);
+    return 0;
+}
+
+/**
+ * @brief orders the events by time, events of the same time by process and thread
+ * @param a const void*: first decodedEvent
+ * @param b const void*: second decodedEvent
+ * @return int: <0, 0 or >0
+ */
+static int compareEvents(const void* a, const void* b) {
+    const decodedEvent* first = a;
+    const decodedEvent* second = b;
+    if (first->event.time != second->event.time) {
+        return (first->event.time < second->event.time) ? -1 : 1;
+    }
+    if (first->pid != second->pid) {
+        return (first->pid < second->pid) ? -1 : 1;
+    }
+    return (first->event.thread < second->event.thread) ? -1 : (first->event.thread > second->event.thread);
+}
+
+/**
+ * @brief prints the usage and terminates
+ * @param stream FILE*: the stream to write the usage information to
+ * @param cmnd const char*: name of the executable
+ * @param exitcode int: the exit code
+ */
+static void usage(FILE* stream, const char* cmnd, int exitcode) {
+    fprintf(stream, "usage: %s [-c <connection>] <trace file>...\n", cmnd);
+    fprintf(stream, "\t-c <connection>\t only the events of this connection\n");
+    fprintf(stream, "\t-h\t\t outputs this info\n");
+    exit(exitcode);
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
@@ -0,0 +1,331 @@
+/**
+ * @file trace.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 20.12.18
+ *
+ * @brief Binary tracing of the client and the server.
+ * Every thread writes its events into a ring of its own, without a lock and without a system call: the event
+ * is filled in and published by a release store of the head. A thread of the process copies the rings to the
+ * trace file every TRACE_FLUSHINTERVAL ms, and at the exit. A thread which is faster than the copying loses
+ * its oldest events, the file records how many. Every process writes its own file, <path>.<pid>, so forked
+ * handlers and workers trace without sharing a file offset; simple_message_trace merges the files by time.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#define _GNU_SOURCE         // provides syscall()
+#include <stdlib.h>         // provides calloc(), atexit()
+#include <stdio.h>          // provides snprintf()
+#include <string.h>         // provides memcpy()
+#include <errno.h>          // provides errno
+#include <signal.h>         // provides sigfillset(), pthread_sigmask()
+#include <stdatomic.h>      // provides atomic_load_explicit(), atomic_store_explicit()
+#include <pthread.h>        // provides pthread_create(), pthread_atfork()
+#include <fcntl.h>          // provides open()
+#include <time.h>           // provides clock_gettime(), nanosleep()
+#include <unistd.h>         // provides write(), close(), getpid()
+#include <limits.h>         // provides PATH_MAX
+#include <sys/types.h>
+#include <sys/syscall.h>    // provides SYS_gettid
+#include "trace.h"
+
+// --------------------------------------------------------------- defines --
+/** @brief events per ring, a power of 2 */
+#define TRACE_RINGEVENTS 16384
+/** @brief ms between two copies of the rings to the file */
+#define TRACE_FLUSHINTERVAL 50
+/** @brief events copied out of a ring at once */
+#define TRACE_FLUSHEVENTS 1024
+
+// -------------------------------------------------------------- typedefs --
+/** @brief Ring of one thread, written by the thread only, read by the flush */
+typedef struct traceRing {
+    atomic_ullong head;                         /**< Events written, published with release */
+    unsigned long long tail;                    /**< Events copied to the file, used by the flush only */
+    uint32_t thread;                            /**< Thread id of the owner */
+    struct traceRing* next;                     /**< Next ring of the process */
+    traceEvent events[TRACE_RINGEVENTS];        /**< The events, head modulo TRACE_RINGEVENTS */
+} traceRing;
+
+// --------------------------------------------------------------- globals --
+int traceEnabled = 0;
+/** @brief prefix of the trace files */
+static char tracePath[PATH_MAX];
+/** @brief trace file of this process, -1 until the first flush of the process */
+static int fd_trace = -1;
+/** @brief rings of the threads of this process, pushed by the threads */
+static _Atomic(traceRing*) rings = NULL;
+/** @brief 1 once the flushing thread of this process runs */
+static atomic_int flusherStarted = 0;
+/** @brief serializes the flushes, the threads writing events never take it */
+static pthread_mutex_t flushLock = PTHREAD_MUTEX_INITIALIZER;
+/** @brief ring of this thread, NULL until its first event */
+static __thread traceRing* ownRing = NULL;
+/** @brief connection the events of this thread belong to, inherited by a forked child */
+static __thread uint32_t traceCurrent = 0;
+/** @brief last connection number of this process */
+static atomic_uint lastConnection = 0;
+/** @brief names of the event types for the decoder */
+static const char* const typeNames[TRACE_TYPES] = {
+        "DROPPED", "ACCEPT", "REJECT", "SPAWN", "EXEC", "REQUEST", "RESPONSE", "CLOSE",
+        "CONNECT", "SEND", "STATUS", "FILE", "WRITE", "ERROR"
+};
+
+// ------------------------------------------------------------- functions --
+static traceRing* newRing(void);
+static void* flushLoop(void* argument);
+static int openFile(void);
+static void drainRing(traceRing* ring);
+static void writeEvents(const traceEvent* events, size_t count);
+static void forkedChild(void);
+static uint64_t now(void);
+
+/**
+ * @brief enables the tracing, the events of every process go to <path>.<pid>
+ * @param path const char*: prefix of the trace files
+ * @return int: 0 in case of success, -1 if the trace file could not be created (errno is set)
+ */
+int trace_open(const char* path) {
+    if (strlen(path) >= sizeof(tracePath)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(tracePath, path);
+    if (openFile() == -1) {
+        return -1;
+    }
+    pthread_atfork(NULL, NULL, forkedChild);
+    atexit(trace_flush);
+    traceEnabled = 1;
+    return 0;
+}
+
+/**
+ * @brief records an event of the current connection of the thread, use TRACE() instead
+ * @param type enum traceType: the event type
+ * @param value uint64_t: depends on the type
+ * @param extra uint32_t: depends on the type
+ */
+void trace_event(enum traceType type, uint64_t value, uint32_t extra) {
+    traceRing* ring = ownRing;
+    if (ring == NULL) {
+        ring = newRing();
+        if (ring == NULL) {
+            return;
+        }
+    }
+    unsigned long long head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    traceEvent* event = &ring->events[head & (TRACE_RINGEVENTS - 1)];
+    event->time = now();
+    event->value = value;
+    event->connection = traceCurrent;
+    event->thread = ring->thread;
+    event->type = (uint32_t) type;
+    event->extra = extra;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/**
+ * @brief numbers a new connection and makes it the current connection of the thread
+ * @return uint32_t: the connection, unique in the process
+ */
+uint32_t trace_connection(void) {
+    traceCurrent = atomic_fetch_add_explicit(&lastConnection, 1, memory_order_relaxed) + 1;
+    return traceCurrent;
+}
+
+/**
+ * @brief makes a connection the current connection of the thread, e.g. in an event loop
+ * @param connection uint32_t: the connection, 0 for none
+ */
+void trace_setConnection(uint32_t connection) {
+    traceCurrent = connection;
+}
+
+/**
+ * @brief copies the events of all rings of the process to the trace file, called before exit() and exec()
+ */
+void trace_flush(void) {
+    if (!traceEnabled) {
+        return;
+    }
+    pthread_mutex_lock(&flushLock);
+    if ((fd_trace != -1) || (openFile() == 0)) {
+        for (traceRing* ring = atomic_load(&rings); ring != NULL; ring = ring->next) {
+            drainRing(ring);
+        }
+    }
+    pthread_mutex_unlock(&flushLock);
+}
+
+/**
+ * @brief name of an event type
+ * @param type uint32_t: the event type
+ * @return const char*: the name, "UNKNOWN" for a type of a newer version
+ */
+const char* trace_name(uint32_t type) {
+    return (type < TRACE_TYPES) ? typeNames[type] : "UNKNOWN";
+}
+
+/**
+ * @brief creates the ring of the calling thread, and the flushing thread with the first ring of the process
+ * @return traceRing*: the ring, NULL if there is no memory
+ */
+static traceRing* newRing(void) {
+    traceRing* ring = calloc(1, sizeof(traceRing));
+    if (ring == NULL) {
+        return NULL;
+    }
+    ring->thread = (uint32_t) syscall(SYS_gettid);
+    ring->next = atomic_load(&rings);
+    while (!atomic_compare_exchange_weak(&rings, &ring->next, ring));
+    ownRing = ring;
+    if (atomic_exchange(&flusherStarted, 1) == 0) {
+        // the thread must not take the signals of the process
+        sigset_t all, previous;
+        sigfillset(&all);
+        pthread_sigmask(SIG_SETMASK, &all, &previous);
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, flushLoop, NULL) == 0) {
+            pthread_detach(thread);
+        }
+        pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    }
+    return ring;
+}
+
+/**
+ * @brief loop of the flushing thread
+ * @param argument void*: unused
+ * @return void*: NULL, the thread runs as long as the process
+ */
+static void* flushLoop(void* argument) {
+    (void) argument;
+    struct timespec interval = {0, TRACE_FLUSHINTERVAL * 1000000L};
+    while (1) {
+        nanosleep(&interval, NULL);
+        trace_flush();
+    }
+    return NULL;
+}
+
+/**
+ * @brief creates the trace file of the process and writes the header
+ * @return int: 0 in case of success, -1 on failure (errno is set)
+ */
+static int openFile(void) {
+    char name[sizeof(tracePath) + 16];
+    snprintf(name, sizeof(name), "%s.%d", tracePath, (int) getpid());
+    fd_trace = open(name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_trace == -1) {
+        return -1;
+    }
+    traceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.pid = (uint32_t) getpid();
+    header.eventSize = sizeof(traceEvent);
+    if (write(fd_trace, &header, sizeof(header)) != (ssize_t) sizeof(header)) {
+        close(fd_trace);
+        fd_trace = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief copies the new events of a ring to the file. The owner may overwrite an event while it is copied,
+ * so the head is read again afterwards and the events which may have been overwritten are dropped.
+ * @param ring traceRing*: the ring, flushLock is held
+ */
+static void drainRing(traceRing* ring) {
+    static traceEvent copy[TRACE_FLUSHEVENTS];
+    while (1) {
+        unsigned long long head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        unsigned long long lost = 0;
+        if (head - ring->tail > TRACE_RINGEVENTS) {
+            lost = head - TRACE_RINGEVENTS - ring->tail;
+            ring->tail = head - TRACE_RINGEVENTS;
+        }
+        unsigned long long count = head - ring->tail;
+        if (count > TRACE_FLUSHEVENTS) {
+            count = TRACE_FLUSHEVENTS;
+        }
+        for (unsigned long long i = 0; i < count; i++) {
+            copy[i] = ring->events[(ring->tail + i) & (TRACE_RINGEVENTS - 1)];
+        }
+        atomic_thread_fence(memory_order_acquire);
+        // the owner is writing event after, which replaces the event after - TRACE_RINGEVENTS
+        unsigned long long after = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        unsigned long long valid = ring->tail;
+        if (after + 1 > TRACE_RINGEVENTS + valid) {
+            valid = after + 1 - TRACE_RINGEVENTS;
+        }
+        unsigned long long skipped = (valid - ring->tail < count) ? valid - ring->tail : count;
+        lost += skipped;
+        if (lost > 0) {
+            traceEvent dropped = {now(), lost, 0, ring->thread, TRACE_DROPPED, 0};
+            writeEvents(&dropped, 1);
+        }
+        writeEvents(copy + skipped, (size_t) (count - skipped));
+        ring->tail += count;
+        if (count < TRACE_FLUSHEVENTS) {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief appends events to the trace file, a failed write loses them
+ * @param events const traceEvent*: the events
+ * @param count size_t: number of events
+ */
+static void writeEvents(const traceEvent* events, size_t count) {
+    const char* data = (const char*) events;
+    size_t length = count * sizeof(traceEvent);
+    while (length > 0) {
+        ssize_t written = write(fd_trace, data, length);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += written;
+        length -= (size_t) written;
+    }
+}
+
+/**
+ * @brief child handler of fork(): the child has no flushing thread, and the copied rings and file belong
+ * to the parent. The child starts with an own ring, thread and file, the current connection is kept.
+ */
+static void forkedChild(void) {
+    pthread_mutex_init(&flushLock, NULL);
+    if (fd_trace != -1) {
+        close(fd_trace);
+        fd_trace = -1;
+    }
+    atomic_store(&rings, NULL);
+    atomic_store(&flusherStarted, 0);
+    ownRing = NULL;
+}
+
+/**
+ * @brief reads the monotonic clock
+ * @return uint64_t: time in ns
+ */
+static uint64_t now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) time.tv_sec * 1000000000ull + (uint64_t) time.tv_nsec;
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
@@ -0,0 +1,75 @@
+/**
+ * @file trace.h
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 20.12.18
+ *
+ * @brief Binary tracing of the client and the server, fixed size events in per thread rings
+ * TCP/IP Lecture Distributed Systems
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>         // provides uint64_t, uint32_t
+
+// --------------------------------------------------------------- defines --
+/** @brief magic at the start of a trace file, the last character is the version */
+#define TRACE_MAGIC "SMTRACE1"
+/** @brief records an event of the current connection if tracing is enabled, costs one branch otherwise */
+#define TRACE(type, value, extra) \
+    do { \
+        if (traceEnabled) { \
+            trace_event((type), (value), (extra)); \
+        } \
+    } while (0)
+
+// -------------------------------------------------------------- typedefs --
+/** @brief Event types, value and extra are described per type */
+enum traceType {
+    TRACE_DROPPED = 0,          /**< value: events lost because the ring was full */
+    TRACE_ACCEPT,               /**< value: accepted socket, extra: running handlers or listener thread */
+    TRACE_REJECT,               /**< value: rejected socket, extra: reason of the admission control */
+    TRACE_SPAWN,                /**< value: pid of the forked handler or worker */
+    TRACE_EXEC,                 /**< value: socket handed to the business logic */
+    TRACE_REQUEST,              /**< value: bytes of the request */
+    TRACE_RESPONSE,             /**< value: bytes of the response, extra: result of the logic */
+    TRACE_CLOSE,                /**< value: closed socket */
+    TRACE_CONNECT,              /**< value: connected socket */
+    TRACE_SEND,                 /**< value: bytes sent */
+    TRACE_STATUS,               /**< value: status of the response */
+    TRACE_FILE,                 /**< value: length of the file, extra: encoding, 0 none, 1 deflate */
+    TRACE_WRITE,                /**< value: bytes of the file received so far, extra: bytes left */
+    TRACE_ERROR,                /**< value: errno */
+    TRACE_TYPES                 /**< Number of event types */
+};
+
+/** @brief An event, 32 bytes in the rings and the files */
+typedef struct traceEvent {
+    uint64_t time;              /**< CLOCK_MONOTONIC in ns, comparable between the processes */
+    uint64_t value;             /**< Depends on the type */
+    uint32_t connection;        /**< Connection of the event, numbered per process, 0 if none */
+    uint32_t thread;            /**< Thread id of the tracing thread */
+    uint32_t type;              /**< enum traceType */
+    uint32_t extra;             /**< Depends on the type */
+} traceEvent;
+
+/** @brief Header of a trace file, followed by the events */
+typedef struct traceHeader {
+    char magic[8];              /**< TRACE_MAGIC without the terminating 0 */
+    uint32_t pid;               /**< Process which wrote the file */
+    uint32_t eventSize;         /**< sizeof(traceEvent) */
+} traceHeader;
+
+// --------------------------------------------------------------- globals --
+/** @brief 1 after trace_open(), read by TRACE() */
+extern int traceEnabled;
+
+// ------------------------------------------------------------- functions --
+int trace_open(const char* path);
+void trace_event(enum traceType type, uint64_t value, uint32_t extra);
+uint32_t trace_connection(void);
+void trace_setConnection(uint32_t connection);
+void trace_flush(void);
+const char* trace_name(uint32_t type);
+
+#endif // TRACE_H
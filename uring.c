@@ -0,0 +1,185 @@
+/**
+ * @file uring.c
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 10.12.18
+ *
+ * @brief Minimal io_uring wrapper on top of the raw system calls, used by client and server.
+ * Only what both programs need: set up a ring, prepare entries, submit and wait, reap completions.
+ * TCP/IP Lecture Distributed Systems
+ */
+
+// -------------------------------------------------------------- includes --
+#define _GNU_SOURCE         // provides syscall()
+#include <string.h>         // provides memset()
+#include <errno.h>          // provides errno
+#include <signal.h>         // provides _NSIG
+#include <unistd.h>         // provides syscall(), close()
+#include <sys/mman.h>       // provides mmap()
+#include <sys/syscall.h>    // provides __NR_io_uring_setup, __NR_io_uring_enter
+#include "uring.h"
+
+/**
+ * @brief sets up a ring and maps its queues
+ * @param ring uring*: the ring to set up
+ * @param entries unsigned: size of the submission queue, rounded up to a power of two by the kernel
+ * @return int: 0 in case of success, -1 if io_uring is not available (errno is set)
+ */
+int uring_init(uring* ring, unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd == -1) {
+        return -1;
+    }
+    ring->entries = params.sq_entries;
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cqRingSize > ring->sqRingSize) {
+            ring->sqRingSize = ring->cqRingSize;
+        }
+        ring->cqRingSize = ring->sqRingSize;
+    }
+    ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                        IORING_OFF_SQ_RING);
+    if (ring->sqRing == MAP_FAILED) {
+        goto failed;
+    }
+    ring->cqRing = ring->sqRing;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        ring->cqRing = mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                            IORING_OFF_CQ_RING);
+        if (ring->cqRing == MAP_FAILED) {
+            munmap(ring->sqRing, ring->sqRingSize);
+            goto failed;
+        }
+    }
+    ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                      IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        munmap(ring->sqRing, ring->sqRingSize);
+        if (ring->cqRing != ring->sqRing) {
+            munmap(ring->cqRing, ring->cqRingSize);
+        }
+        goto failed;
+    }
+    char* sq = ring->sqRing;
+    char* cq = ring->cqRing;
+    ring->sqHead = (unsigned*) (sq + params.sq_off.head);
+    ring->sqTail = (unsigned*) (sq + params.sq_off.tail);
+    ring->sqMask = *(unsigned*) (sq + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned*) (sq + params.sq_off.array);
+    ring->cqHead = (unsigned*) (cq + params.cq_off.head);
+    ring->cqTail = (unsigned*) (cq + params.cq_off.tail);
+    ring->cqMask = *(unsigned*) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+    return 0;
+
+failed:;
+    int save_errno = errno;
+    close(ring->fd);
+    ring->fd = -1;
+    errno = save_errno;
+    return -1;
+}
+
+/**
+ * @brief unmaps the queues and closes the ring
+ * @param ring uring*: a ring set up by uring_init()
+ */
+void uring_close(uring* ring) {
+    if (ring->fd == -1) {
+        return;
+    }
+    munmap(ring->sqes, ring->sqesSize);
+    if (ring->cqRing != ring->sqRing) {
+        munmap(ring->cqRing, ring->cqRingSize);
+    }
+    munmap(ring->sqRing, ring->sqRingSize);
+    close(ring->fd);
+    ring->fd = -1;
+}
+
+/**
+ * @brief prepares the next submission entry, the caller may set further fields (flags, ioprio, msg_flags)
+ * @param ring uring*: the ring
+ * @param opcode int: IORING_OP_*
+ * @param fd int: file descriptor of the operation
+ * @param addr const void*: buffer of the operation
+ * @param length unsigned: length of the buffer
+ * @param offset uint64_t: file offset, -1 for the current position
+ * @param userData uint64_t: returned with the completion
+ * @return struct io_uring_sqe*: the entry, NULL if the submission queue is full
+ */
+struct io_uring_sqe* uring_getSqe(uring* ring, int opcode, int fd, const void* addr, unsigned length,
+                                  uint64_t offset, uint64_t userData) {
+    unsigned head = __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE);
+    unsigned tail = *ring->sqTail + ring->sqePending;
+    if (tail - head >= ring->entries) {
+        return NULL;
+    }
+    unsigned index = tail & ring->sqMask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (__u8) opcode;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t) (uintptr_t) addr;
+    sqe->len = length;
+    sqe->off = offset;
+    sqe->user_data = userData;
+    ring->sqArray[index] = index;
+    ring->sqePending++;
+    return sqe;
+}
+
+/**
+ * @brief publishes all prepared entries and submits them with one system call
+ * @param ring uring*: the ring
+ * @param waitFor unsigned: number of completions to wait for, 0 returns immediately
+ * @return int: number of submitted entries, -1 on failure (errno is set)
+ */
+int uring_submit(uring* ring, unsigned waitFor) {
+    unsigned submit = ring->sqePending;
+    __atomic_store_n(ring->sqTail, *ring->sqTail + submit, __ATOMIC_RELEASE);
+    ring->sqePending = 0;
+    while (1) {
+        long submitted = syscall(__NR_io_uring_enter, ring->fd, submit, waitFor,
+                                 waitFor > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, _NSIG / 8);
+        if ((submitted == -1) && (errno == EINTR)) {
+            continue;       // the kernel only consumes the published entries, retrying is safe
+        }
+        return (int) submitted;
+    }
+}
+
+/**
+ * @brief returns the next completion without waiting
+ * @param ring uring*: the ring
+ * @return struct io_uring_cqe*: the completion, NULL if there is none
+ */
+struct io_uring_cqe* uring_peekCqe(uring* ring) {
+    unsigned head = *ring->cqHead;
+    if (head == __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    return &ring->cqes[head & ring->cqMask];
+}
+
+/**
+ * @brief marks the completion returned by uring_peekCqe() as consumed
+ * @param ring uring*: the ring
+ */
+void uring_cqeSeen(uring* ring) {
+    __atomic_store_n(ring->cqHead, *ring->cqHead + 1, __ATOMIC_RELEASE);
+}
+// =================================================================== eof ==
+
+// Local Variables:
+// mode: c
+// c-mode: k&r
+// c-basic-offset: 8
+// indent-tabs-mode: t
+// End:
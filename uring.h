@@ -0,0 +1,48 @@
+/**
+ * @file uring.h
+ * @author Valentin Platzgummer - ic17b096
+ * @author Lara Kammerer - ic17b001
+ * @date 10.12.18
+ *
+ * @brief Minimal io_uring wrapper on top of the raw system calls, used by client and server
+ * TCP/IP Lecture Distributed Systems
+ */
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>         // provides size_t
+#include <stdint.h>         // provides uint64_t
+#include <linux/io_uring.h> // provides struct io_uring_sqe, struct io_uring_cqe
+
+// -------------------------------------------------------------- typedefs --
+/** @brief A submission and completion queue pair shared with the kernel */
+typedef struct uring {
+    int fd;                         /**< File descriptor of the ring, -1 if not set up */
+    unsigned* sqHead;               /**< Submission queue head, advanced by the kernel */
+    unsigned* sqTail;               /**< Submission queue tail, advanced by us */
+    unsigned sqMask;                /**< Ring mask of the submission queue */
+    unsigned* sqArray;              /**< Indices into sqes */
+    struct io_uring_sqe* sqes;      /**< Submission queue entries */
+    unsigned sqePending;            /**< Entries prepared but not yet published to the kernel */
+    unsigned* cqHead;               /**< Completion queue head, advanced by us */
+    unsigned* cqTail;               /**< Completion queue tail, advanced by the kernel */
+    unsigned cqMask;                /**< Ring mask of the completion queue */
+    struct io_uring_cqe* cqes;      /**< Completion queue entries */
+    void* sqRing;                   /**< Mapping of the submission ring */
+    size_t sqRingSize;              /**< Size of the mapping of the submission ring */
+    void* cqRing;                   /**< Mapping of the completion ring, may equal sqRing */
+    size_t cqRingSize;              /**< Size of the mapping of the completion ring */
+    size_t sqesSize;                /**< Size of the mapping of the submission entries */
+    unsigned entries;               /**< Number of submission entries */
+} uring;
+
+// ------------------------------------------------------------- functions --
+int uring_init(uring* ring, unsigned entries);
+void uring_close(uring* ring);
+struct io_uring_sqe* uring_getSqe(uring* ring, int opcode, int fd, const void* addr, unsigned length,
+                                  uint64_t offset, uint64_t userData);
+int uring_submit(uring* ring, unsigned waitFor);
+struct io_uring_cqe* uring_peekCqe(uring* ring);
+void uring_cqeSeen(uring* ring);
+
+#endif // URING_H